@@ -1555,7 +1555,12 @@ obs_data_array_t *OBSBasic::SaveTransitions()
 			continue;
 
 		obs_data_t *sourceData = obs_data_create();
-		obs_data_t *settings = obs_source_get_settings(tr);
+		obs_data_t *settings = obs_data_create();
+		obs_data_t *trSettings = obs_source_get_settings(tr);
+
+		/* copied, the data is saved on another thread */
+		obs_data_apply(settings, trSettings);
+		obs_data_release(trSettings);
 
 		obs_data_set_string(sourceData, "name",
 				    obs_source_get_name(tr));
@@ -415,6 +415,15 @@ OBSBasic::OBSBasic(QWidget *parent)
 		SLOT(ScenesReordered()));
 }
 
+/* the save data is written on another thread, so it can't reference any
+ * objects that may still be modified */
+static obs_data_t *CopySaveData(obs_data_t *data)
+{
+	obs_data_t *copy = obs_data_create();
+	obs_data_apply(copy, data);
+	return copy;
+}
+
 static void SaveAudioDevice(const char *name, int channel, obs_data_t *parent,
 			    vector<OBSSource> &audioSources)
 {
@@ -425,9 +434,11 @@ static void SaveAudioDevice(const char *name, int channel, obs_data_t *parent,
 	audioSources.push_back(source);
 
 	obs_data_t *data = obs_save_source(source);
+	obs_data_t *copy = CopySaveData(data);
 
-	obs_data_set_obj(parent, name, data);
+	obs_data_set_obj(parent, name, copy);
 
+	obs_data_release(copy);
 	obs_data_release(data);
 	obs_source_release(source);
 }
@@ -660,12 +671,14 @@ void OBSBasic::Save(const char *file)
 	if (api) {
 		obs_data_t *moduleObj = obs_data_create();
 		api->on_save(moduleObj);
-		obs_data_set_obj(saveData, "modules", moduleObj);
+
+		obs_data_t *copy = CopySaveData(moduleObj);
+		obs_data_set_obj(saveData, "modules", copy);
+		obs_data_release(copy);
 		obs_data_release(moduleObj);
 	}
 
-	if (!obs_data_save_json_safe(saveData, file, "tmp", "bak"))
-		blog(LOG_ERROR, "Could not save scene data to %s", file);
+	QueueSave(saveData, file);
 
 	obs_data_release(saveData);
 	obs_data_array_release(sceneOrder);
@@ -674,6 +687,74 @@ void OBSBasic::Save(const char *file)
 	obs_data_array_release(savedProjectorList);
 }
 
+void OBSBasic::SaveThread()
+{
+	std::unique_lock<std::mutex> lock(saveMutex);
+
+	for (;;) {
+		saveCV.wait(lock, [this]() {
+			return saveThreadExit || pendingSaveData != nullptr;
+		});
+
+		if (pendingSaveData == nullptr)
+			break;
+
+		OBSData saveData = std::move(pendingSaveData);
+		std::string file = std::move(pendingSavePath);
+		saveWriting = true;
+		lock.unlock();
+
+		if (!obs_data_save_json_safe(saveData, file.c_str(), "tmp",
+					     "bak"))
+			blog(LOG_ERROR, "Could not save scene data to %s",
+			     file.c_str());
+
+		lock.lock();
+		saveWriting = false;
+		saveCV.notify_all();
+	}
+}
+
+void OBSBasic::QueueSave(obs_data_t *saveData, const char *file)
+{
+	std::unique_lock<std::mutex> lock(saveMutex);
+
+	/* only a save to the same file can replace a pending one */
+	if (pendingSaveData != nullptr && pendingSavePath != file)
+		saveCV.wait(lock, [this]() {
+			return pendingSaveData == nullptr;
+		});
+
+	pendingSaveData = saveData;
+	pendingSavePath = file;
+
+	if (!saveThread.joinable())
+		saveThread = std::thread([this]() { SaveThread(); });
+
+	saveCV.notify_all();
+}
+
+void OBSBasic::FlushSave()
+{
+	std::unique_lock<std::mutex> lock(saveMutex);
+	saveCV.wait(lock, [this]() {
+		return pendingSaveData == nullptr && !saveWriting;
+	});
+}
+
+void OBSBasic::StopSaveThread()
+{
+	{
+		std::lock_guard<std::mutex> lock(saveMutex);
+		saveThreadExit = true;
+	}
+
+	saveCV.notify_all();
+
+	if (saveThread.joinable())
+		saveThread.join();
+}
+
 void OBSBasic::DeferSaveBegin()
 {
 	os_atomic_inc_long(&disableSaving);
@@ -896,6 +977,7 @@ void OBSBasic::LogScenes()
 
 void OBSBasic::Load(const char *file)
 {
+	FlushSave();
 	disableSaving++;
 
 	obs_data_t *data = obs_data_create_from_json_file_safe(file, "bak");
@@ -2448,6 +2530,8 @@ OBSBasic::~OBSBasic()
 	/* clear out UI event queue */
 	QApplication::sendPostedEvents(App());
 
+	StopSaveThread();
+
 	if (updateCheckThread && updateCheckThread->isRunning())
 		updateCheckThread->wait();
 
@@ -2575,6 +2659,7 @@ void OBSBasic::SaveProjectNow()
 
 	projectChanged = true;
 	SaveProjectDeferred();
+	FlushSave();
 }
 
 void OBSBasic::SaveProject()
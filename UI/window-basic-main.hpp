@@ -25,6 +25,9 @@
 #include <obs.hpp>
 #include <vector>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "window-main.hpp"
 #include "window-basic-interaction.hpp"
 #include "window-basic-properties.hpp"
@@ -195,6 +198,16 @@ private:
 	bool projectChanged = false;
 	bool previewEnabled = true;
 
+	/* scene collection files are written on this thread, only the latest
+	 * pending save data is kept */
+	std::thread saveThread;
+	std::mutex saveMutex;
+	std::condition_variable saveCV;
+	OBSData pendingSaveData;
+	std::string pendingSavePath;
+	bool saveWriting = false;
+	bool saveThreadExit = false;
+
 	std::list<const char *> copyStrings;
 	const char *copyFiltersString = nullptr;
 	bool copyVisible = true;
@@ -310,6 +323,11 @@ private:
 	void Save(const char *file);
 	void Load(const char *file);
 
+	void SaveThread();
+	void QueueSave(obs_data_t *saveData, const char *file);
+	void FlushSave();
+	void StopSaveThread();
+
 	void InitHotkeys();
 	void CreateHotkeys();
 	void ClearHotkeys();
@@ -26,6 +26,7 @@
 #include "../util/util_uint64.h"
 
 #include "audio-io.h"
+#include "audio-mix.h"
 #include "audio-resampler.h"
 
 extern profiler_name_store_t *obs_get_profiler_name_store(void);
@@ -70,8 +71,14 @@ struct audio_output {
 	void *input_param;
 	pthread_mutex_t input_mutex;
 	struct audio_mix mixes[MAX_AUDIO_MIXES];
+
+	/* timestamp the next output is expected to have, only used by the
+	 * audio thread */
+	uint64_t next_ts;
 };
 
+static const float silence[AUDIO_OUTPUT_FRAMES] = {0};
+
 /* ------------------------------------------------------------------------- */
 
 static bool resample_audio_output(struct audio_input *input,
@@ -100,7 +107,8 @@ static bool resample_audio_output(struct audio_input *input,
 }
 
 static inline void do_audio_output(struct audio_output *audio, size_t mix_idx,
-				   uint64_t timestamp, uint32_t frames)
+				   uint64_t timestamp, uint32_t frames,
+				   bool silent)
 {
 	struct audio_mix *mix = &audio->mixes[mix_idx];
 	struct audio_data data;
@@ -111,7 +119,8 @@ static inline void do_audio_output(struct audio_output *audio, size_t mix_idx,
 		struct audio_input *input = mix->inputs.array + (i - 1);
 
 		for (size_t i = 0; i < audio->planes; i++)
-			data.data[i] = (uint8_t *)mix->buffer[i];
+			data.data[i] = silent ? (uint8_t *)silence
+					      : (uint8_t *)mix->buffer[i];
 		data.frames = frames;
 		data.timestamp = timestamp;
 
@@ -133,17 +142,35 @@ static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
 		if (!mix->inputs.num)
 			continue;
 
-		for (size_t plane = 0; plane < audio->planes; plane++) {
-			float *mix_data = mix->buffer[plane];
-			float *mix_end = &mix_data[float_size];
+		for (size_t plane = 0; plane < audio->planes; plane++)
+			audio_clamp(mix->buffer[plane], float_size);
+	}
+}
+
+/* ticks that were dropped to shrink audio buffering leave a gap in the
+ * timestamps.  the gap is output as silence, so that the frame count that
+ * encoders derive their timestamps from keeps matching the audio timestamps */
+static void fill_audio_gap(struct audio_output *audio, uint64_t timestamp)
+{
+	size_t rate = audio->info.samples_per_sec;
+	uint64_t tick_ns = audio_frames_to_ns(rate, AUDIO_OUTPUT_FRAMES);
+	uint64_t ticks;
 
-			while (mix_data < mix_end) {
-				float val = *mix_data;
-				val = (val > 1.0f) ? 1.0f : val;
-				val = (val < -1.0f) ? -1.0f : val;
-				*(mix_data++) = val;
-			}
-		}
+	if (!audio->next_ts || timestamp <= audio->next_ts)
+		return;
+
+	ticks = (timestamp - audio->next_ts + tick_ns / 2) / tick_ns;
+	if (!ticks || ticks * AUDIO_OUTPUT_FRAMES > rate)
+		return;
+
+	for (uint64_t tick = 0; tick < ticks; tick++) {
+		uint64_t ts = audio->next_ts +
+			      audio_frames_to_ns(rate,
+						 tick * AUDIO_OUTPUT_FRAMES);
+
+		for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
+			do_audio_output(audio, i, ts, AUDIO_OUTPUT_FRAMES,
+					true);
 	}
 }
 
@@ -191,8 +218,14 @@ static void input_and_output(struct audio_output *audio, uint64_t audio_time,
 	clamp_audio_output(audio, bytes);
 
 	/* output */
+	fill_audio_gap(audio, new_ts);
+
 	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
-		do_audio_output(audio, i, new_ts, AUDIO_OUTPUT_FRAMES);
+		do_audio_output(audio, i, new_ts, AUDIO_OUTPUT_FRAMES, false);
+
+	audio->next_ts =
+		new_ts + audio_frames_to_ns(audio->info.samples_per_sec,
+					    AUDIO_OUTPUT_FRAMES);
 }
 
 static void *audio_thread(void *param)
@@ -0,0 +1,125 @@
+/******************************************************************************
+    Copyright (C) 2020 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "audio-mix.h"
+
+#include "../util/sse-intrin.h"
+
+/* 16 floats per iteration keeps four independent vectors in flight; the
+ * remainder is handled by the scalar tail */
+
+void audio_mix_add(float *dst, const float *src, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m128 a0 = _mm_loadu_ps(dst + i);
+		__m128 a1 = _mm_loadu_ps(dst + i + 4);
+		__m128 a2 = _mm_loadu_ps(dst + i + 8);
+		__m128 a3 = _mm_loadu_ps(dst + i + 12);
+
+		a0 = _mm_add_ps(a0, _mm_loadu_ps(src + i));
+		a1 = _mm_add_ps(a1, _mm_loadu_ps(src + i + 4));
+		a2 = _mm_add_ps(a2, _mm_loadu_ps(src + i + 8));
+		a3 = _mm_add_ps(a3, _mm_loadu_ps(src + i + 12));
+
+		_mm_storeu_ps(dst + i, a0);
+		_mm_storeu_ps(dst + i + 4, a1);
+		_mm_storeu_ps(dst + i + 8, a2);
+		_mm_storeu_ps(dst + i + 12, a3);
+	}
+
+	for (; i < count; i++)
+		dst[i] += src[i];
+}
+
+void audio_mix_add_mul(float *dst, const float *src, const float *gain,
+		       size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 m0 = _mm_mul_ps(_mm_loadu_ps(src + i),
+				       _mm_loadu_ps(gain + i));
+		__m128 m1 = _mm_mul_ps(_mm_loadu_ps(src + i + 4),
+				       _mm_loadu_ps(gain + i + 4));
+
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), m0));
+		_mm_storeu_ps(dst + i + 4,
+			      _mm_add_ps(_mm_loadu_ps(dst + i + 4), m1));
+	}
+
+	for (; i < count; i++)
+		dst[i] += src[i] * gain[i];
+}
+
+void audio_mul(float *data, float gain, size_t count)
+{
+	__m128 g = _mm_set1_ps(gain);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		_mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), g));
+		_mm_storeu_ps(data + i + 4,
+			      _mm_mul_ps(_mm_loadu_ps(data + i + 4), g));
+	}
+
+	for (; i < count; i++)
+		data[i] *= gain;
+}
+
+void audio_mul_array(float *data, const float *gain, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		_mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i),
+						   _mm_loadu_ps(gain + i)));
+		_mm_storeu_ps(data + i + 4,
+			      _mm_mul_ps(_mm_loadu_ps(data + i + 4),
+					 _mm_loadu_ps(gain + i + 4)));
+	}
+
+	for (; i < count; i++)
+		data[i] *= gain[i];
+}
+
+void audio_clamp(float *data, size_t count)
+{
+	__m128 max_val = _mm_set1_ps(1.0f);
+	__m128 min_val = _mm_set1_ps(-1.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 v0 = _mm_loadu_ps(data + i);
+		__m128 v1 = _mm_loadu_ps(data + i + 4);
+
+		v0 = _mm_max_ps(_mm_min_ps(v0, max_val), min_val);
+		v1 = _mm_max_ps(_mm_min_ps(v1, max_val), min_val);
+
+		_mm_storeu_ps(data + i, v0);
+		_mm_storeu_ps(data + i + 4, v1);
+	}
+
+	/* same operand order as minps/maxps so NaN clamps to 1.0 here too */
+	for (; i < count; i++) {
+		float val = data[i];
+		val = (val < 1.0f) ? val : 1.0f;
+		val = (val > -1.0f) ? val : -1.0f;
+		data[i] = val;
+	}
+}
@@ -0,0 +1,49 @@
+/******************************************************************************
+    Copyright (C) 2020 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Vectorized kernels for planar float audio.  Buffers do not need any
+ * particular alignment.
+ */
+
+/* dst[i] += src[i] */
+EXPORT void audio_mix_add(float *dst, const float *src, size_t count);
+
+/* dst[i] += src[i] * gain[i] */
+EXPORT void audio_mix_add_mul(float *dst, const float *src, const float *gain,
+			      size_t count);
+
+/* data[i] *= gain */
+EXPORT void audio_mul(float *data, float gain, size_t count);
+
+/* data[i] *= gain[i] */
+EXPORT void audio_mul_array(float *data, const float *gain, size_t count);
+
+/* clamps data[i] to [-1.0, 1.0] */
+EXPORT void audio_clamp(float *data, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
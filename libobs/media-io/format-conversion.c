@@ -19,6 +19,20 @@
 
 #include "../util/sse-intrin.h"
 
+#if !NEEDS_SIMDE && (defined(__x86_64__) || defined(_M_X64) || \
+		     defined(__i386__) || defined(_M_IX86))
+#define ENABLE_AVX2_KERNELS 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#else
+#define ENABLE_AVX2_KERNELS 0
+#endif
+
 /* ...surprisingly, if I don't use a macro to force inlining, it causes the
  * CPU usage to boost by a tremendous amount in debug builds. */
 
@@ -90,10 +104,318 @@ static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
 	return a < b ? a : b;
 }
 
+/* ------------------------------------------------------------------------- */
+/* AVX2 kernels: 8 pixels per iteration, selected at runtime                 */
+
+#if ENABLE_AVX2_KERNELS
+
+static bool cpu_has_avx2(void)
+{
+#ifdef _MSC_VER
+	int info[4];
+
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	/* AVX2 also needs the OS to save the upper ymm state (OSXSAVE) */
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+		return false;
+	if ((_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+static inline bool use_avx2(void)
+{
+	/* benign race: every thread computes the same value */
+	static volatile int avx2_supported = -1;
+
+	if (avx2_supported == -1)
+		avx2_supported = cpu_has_avx2() ? 1 : 0;
+	return avx2_supported == 1;
+}
+
+/* the 256-bit pack instructions work per 128-bit lane, so the low dwords of
+ * each lane (pixels 0-3 and 4-7) are gathered before storing */
+#define gather_lanes(val)            \
+	_mm256_permutevar8x32_epi32( \
+		val, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7))
+
+#define store_m256_64_0(ptr, val) \
+	_mm_storel_epi64((__m128i *)(ptr), _mm256_castsi256_si128(val))
+#define store_m256_64_1(ptr, val)          \
+	_mm_storel_epi64((__m128i *)(ptr), \
+			 _mm_srli_si128(_mm256_castsi256_si128(val), 8))
+
+#define pack_shift_avx2(lum_plane, lum_pos0, lum_pos1, line1, line2, mask,     \
+			sh)                                                    \
+	do {                                                                   \
+		__m256i pack_val = _mm256_packs_epi32(                         \
+			_mm256_srli_si256(_mm256_and_si256(line1, mask), sh),  \
+			_mm256_srli_si256(_mm256_and_si256(line2, mask), sh)); \
+		pack_val = gather_lanes(                                       \
+			_mm256_packus_epi16(pack_val, pack_val));              \
+                                                                               \
+		store_m256_64_0(lum_plane + lum_pos0, pack_val);               \
+		store_m256_64_1(lum_plane + lum_pos1, pack_val);               \
+	} while (false)
+
+#define pack_val_avx2(lum_plane, lum_pos0, lum_pos1, line1, line2, mask)   \
+	do {                                                               \
+		__m256i pack_val =                                         \
+			_mm256_packs_epi32(_mm256_and_si256(line1, mask),  \
+					   _mm256_and_si256(line2, mask)); \
+		pack_val = gather_lanes(                                   \
+			_mm256_packus_epi16(pack_val, pack_val));          \
+                                                                           \
+		store_m256_64_0(lum_plane + lum_pos0, pack_val);           \
+		store_m256_64_1(lum_plane + lum_pos1, pack_val);           \
+	} while (false)
+
+#define avg_ch_avx2(avg_val, line1, line2, uv_mask)                          \
+	do {                                                                 \
+		__m256i add_val =                                            \
+			_mm256_add_epi64(_mm256_and_si256(line1, uv_mask),   \
+					 _mm256_and_si256(line2, uv_mask));  \
+		avg_val = _mm256_add_epi64(                                  \
+			add_val, _mm256_shuffle_epi32(                       \
+					 add_val, _MM_SHUFFLE(2, 3, 0, 1))); \
+		avg_val = _mm256_srai_epi16(avg_val, 2);                     \
+		avg_val = _mm256_shuffle_epi32(avg_val,                      \
+					       _MM_SHUFFLE(3, 1, 2, 0));     \
+	} while (false)
+
+#define pack_ch_1plane_avx2(uv_plane, chroma_pos, line1, line2, uv_mask) \
+	do {                                                             \
+		__m256i avg_val;                                         \
+		avg_ch_avx2(avg_val, line1, line2, uv_mask);             \
+		avg_val = gather_lanes(                                  \
+			_mm256_packus_epi16(avg_val, avg_val));          \
+                                                                         \
+		store_m256_64_0(uv_plane + chroma_pos, avg_val);         \
+	} while (false)
+
+#define pack_ch_2plane_avx2(u_plane, v_plane, chroma_pos, line1, line2,     \
+			    uv_mask)                                        \
+	do {                                                                \
+		__m256i avg_val;                                            \
+		uint32_t packed_vals[2];                                    \
+                                                                            \
+		avg_ch_avx2(avg_val, line1, line2, uv_mask);                \
+		avg_val = _mm256_shufflelo_epi16(avg_val,                   \
+						 _MM_SHUFFLE(3, 1, 2, 0));  \
+		avg_val = gather_lanes(                                     \
+			_mm256_packus_epi16(avg_val, avg_val));             \
+		store_m256_64_0(packed_vals, avg_val);                      \
+                                                                            \
+		*(uint32_t *)(u_plane + chroma_pos) =                       \
+			(packed_vals[0] & 0xFFFF) | (packed_vals[1] << 16); \
+		*(uint32_t *)(v_plane + chroma_pos) =                       \
+			(packed_vals[0] >> 16) |                            \
+			(packed_vals[1] & 0xFFFF0000);                      \
+	} while (false)
+
+AVX2_TARGET
+static void compress_uyvx_to_i420_avx2(const uint8_t *input,
+				       uint32_t in_linesize, uint32_t start_y,
+				       uint32_t end_y, uint8_t *output[],
+				       const uint32_t out_linesize[])
+{
+	uint8_t *lum_plane = output[0];
+	uint8_t *u_plane = output[1];
+	uint8_t *v_plane = output[2];
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t width_avx2 = width & ~7;
+	uint32_t y;
+
+	__m256i lum_mask = _mm256_set1_epi32(0x0000FF00);
+	__m256i uv_mask = _mm256_set1_epi16(0x00FF);
+	__m128i lum_mask_sse = _mm_set1_epi32(0x0000FF00);
+	__m128i uv_mask_sse = _mm_set1_epi16(0x00FF);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos = y * in_linesize;
+		uint32_t chroma_y_pos = (y >> 1) * out_linesize[1];
+		uint32_t lum_y_pos = y * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < width_avx2; x += 8) {
+			const uint8_t *img = input + y_pos + x * 4;
+			uint32_t lum_pos0 = lum_y_pos + x;
+			uint32_t lum_pos1 = lum_pos0 + out_linesize[0];
+
+			__m256i line1 =
+				_mm256_loadu_si256((const __m256i *)img);
+			__m256i line2 = _mm256_loadu_si256(
+				(const __m256i *)(img + in_linesize));
+
+			pack_shift_avx2(lum_plane, lum_pos0, lum_pos1, line1,
+					line2, lum_mask, 1);
+			pack_ch_2plane_avx2(u_plane, v_plane,
+					    chroma_y_pos + (x >> 1), line1,
+					    line2, uv_mask);
+		}
+
+		for (; x < width; x += 4) {
+			const uint8_t *img = input + y_pos + x * 4;
+			uint32_t lum_pos0 = lum_y_pos + x;
+			uint32_t lum_pos1 = lum_pos0 + out_linesize[0];
+
+			__m128i line1 = _mm_load_si128((const __m128i *)img);
+			__m128i line2 = _mm_load_si128(
+				(const __m128i *)(img + in_linesize));
+
+			pack_shift(lum_plane, lum_pos0, lum_pos1, line1, line2,
+				   lum_mask_sse, 1);
+			pack_ch_2plane(u_plane, v_plane,
+				       chroma_y_pos + (x >> 1), line1, line2,
+				       uv_mask_sse);
+		}
+	}
+}
+
+AVX2_TARGET
+static void compress_uyvx_to_nv12_avx2(const uint8_t *input,
+				       uint32_t in_linesize, uint32_t start_y,
+				       uint32_t end_y, uint8_t *output[],
+				       const uint32_t out_linesize[])
+{
+	uint8_t *lum_plane = output[0];
+	uint8_t *chroma_plane = output[1];
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t width_avx2 = width & ~7;
+	uint32_t y;
+
+	__m256i lum_mask = _mm256_set1_epi32(0x0000FF00);
+	__m256i uv_mask = _mm256_set1_epi16(0x00FF);
+	__m128i lum_mask_sse = _mm_set1_epi32(0x0000FF00);
+	__m128i uv_mask_sse = _mm_set1_epi16(0x00FF);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos = y * in_linesize;
+		uint32_t chroma_y_pos = (y >> 1) * out_linesize[1];
+		uint32_t lum_y_pos = y * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < width_avx2; x += 8) {
+			const uint8_t *img = input + y_pos + x * 4;
+			uint32_t lum_pos0 = lum_y_pos + x;
+			uint32_t lum_pos1 = lum_pos0 + out_linesize[0];
+
+			__m256i line1 =
+				_mm256_loadu_si256((const __m256i *)img);
+			__m256i line2 = _mm256_loadu_si256(
+				(const __m256i *)(img + in_linesize));
+
+			pack_shift_avx2(lum_plane, lum_pos0, lum_pos1, line1,
+					line2, lum_mask, 1);
+			pack_ch_1plane_avx2(chroma_plane, chroma_y_pos + x,
+					    line1, line2, uv_mask);
+		}
+
+		for (; x < width; x += 4) {
+			const uint8_t *img = input + y_pos + x * 4;
+			uint32_t lum_pos0 = lum_y_pos + x;
+			uint32_t lum_pos1 = lum_pos0 + out_linesize[0];
+
+			__m128i line1 = _mm_load_si128((const __m128i *)img);
+			__m128i line2 = _mm_load_si128(
+				(const __m128i *)(img + in_linesize));
+
+			pack_shift(lum_plane, lum_pos0, lum_pos1, line1, line2,
+				   lum_mask_sse, 1);
+			pack_ch_1plane(chroma_plane, chroma_y_pos + x, line1,
+				       line2, uv_mask_sse);
+		}
+	}
+}
+
+AVX2_TARGET
+static void convert_uyvx_to_i444_avx2(const uint8_t *input,
+				      uint32_t in_linesize, uint32_t start_y,
+				      uint32_t end_y, uint8_t *output[],
+				      const uint32_t out_linesize[])
+{
+	uint8_t *lum_plane = output[0];
+	uint8_t *u_plane = output[1];
+	uint8_t *v_plane = output[2];
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t width_avx2 = width & ~7;
+	uint32_t y;
+
+	__m256i lum_mask = _mm256_set1_epi32(0x0000FF00);
+	__m256i u_mask = _mm256_set1_epi32(0x000000FF);
+	__m256i v_mask = _mm256_set1_epi32(0x00FF0000);
+	__m128i lum_mask_sse = _mm_set1_epi32(0x0000FF00);
+	__m128i u_mask_sse = _mm_set1_epi32(0x000000FF);
+	__m128i v_mask_sse = _mm_set1_epi32(0x00FF0000);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos = y * in_linesize;
+		uint32_t lum_y_pos = y * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < width_avx2; x += 8) {
+			const uint8_t *img = input + y_pos + x * 4;
+			uint32_t lum_pos0 = lum_y_pos + x;
+			uint32_t lum_pos1 = lum_pos0 + out_linesize[0];
+
+			__m256i line1 =
+				_mm256_loadu_si256((const __m256i *)img);
+			__m256i line2 = _mm256_loadu_si256(
+				(const __m256i *)(img + in_linesize));
+
+			pack_shift_avx2(lum_plane, lum_pos0, lum_pos1, line1,
+					line2, lum_mask, 1);
+			pack_val_avx2(u_plane, lum_pos0, lum_pos1, line1,
+				      line2, u_mask);
+			pack_shift_avx2(v_plane, lum_pos0, lum_pos1, line1,
+					line2, v_mask, 2);
+		}
+
+		for (; x < width; x += 4) {
+			const uint8_t *img = input + y_pos + x * 4;
+			uint32_t lum_pos0 = lum_y_pos + x;
+			uint32_t lum_pos1 = lum_pos0 + out_linesize[0];
+
+			__m128i line1 = _mm_load_si128((const __m128i *)img);
+			__m128i line2 = _mm_load_si128(
+				(const __m128i *)(img + in_linesize));
+
+			pack_shift(lum_plane, lum_pos0, lum_pos1, line1, line2,
+				   lum_mask_sse, 1);
+			pack_val(u_plane, lum_pos0, lum_pos1, line1, line2,
+				 u_mask_sse);
+			pack_shift(v_plane, lum_pos0, lum_pos1, line1, line2,
+				   v_mask_sse, 2);
+		}
+	}
+}
+
+#endif
+
+/* ------------------------------------------------------------------------- */
+
 void compress_uyvx_to_i420(const uint8_t *input, uint32_t in_linesize,
 			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
 			   const uint32_t out_linesize[])
 {
+#if ENABLE_AVX2_KERNELS
+	if (use_avx2()) {
+		compress_uyvx_to_i420_avx2(input, in_linesize, start_y, end_y,
+					   output, out_linesize);
+		return;
+	}
+#endif
+
 	uint8_t *lum_plane = output[0];
 	uint8_t *u_plane = output[1];
 	uint8_t *v_plane = output[2];
@@ -131,6 +453,14 @@ void compress_uyvx_to_nv12(const uint8_t *input, uint32_t in_linesize,
 			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
 			   const uint32_t out_linesize[])
 {
+#if ENABLE_AVX2_KERNELS
+	if (use_avx2()) {
+		compress_uyvx_to_nv12_avx2(input, in_linesize, start_y, end_y,
+					   output, out_linesize);
+		return;
+	}
+#endif
+
 	uint8_t *lum_plane = output[0];
 	uint8_t *chroma_plane = output[1];
 	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
@@ -166,6 +496,14 @@ void convert_uyvx_to_i444(const uint8_t *input, uint32_t in_linesize,
 			  uint32_t start_y, uint32_t end_y, uint8_t *output[],
 			  const uint32_t out_linesize[])
 {
+#if ENABLE_AVX2_KERNELS
+	if (use_avx2()) {
+		convert_uyvx_to_i444_avx2(input, in_linesize, start_y, end_y,
+					   output, out_linesize);
+		return;
+	}
+#endif
+
 	uint8_t *lum_plane = output[0];
 	uint8_t *u_plane = output[1];
 	uint8_t *v_plane = output[2];
@@ -19,9 +19,23 @@
 
 #define ALIGN_SIZE(size, align) size = (((size) + (align - 1)) & (~(align - 1)))
 
-/* messy code alarm */
+static void *frame_alloc(size_t size, void *param)
+{
+	UNUSED_PARAMETER(param);
+	return bmalloc(size);
+}
+
 void video_frame_init(struct video_frame *frame, enum video_format format,
 		      uint32_t width, uint32_t height)
+{
+	video_frame_init_alloc(frame, format, width, height, frame_alloc, NULL);
+}
+
+/* messy code alarm */
+void video_frame_init_alloc(struct video_frame *frame,
+			    enum video_format format, uint32_t width,
+			    uint32_t height, video_frame_alloc_t alloc,
+			    void *param)
 {
 	size_t size;
 	size_t offsets[MAX_AV_PLANES];
@@ -46,7 +60,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 		offsets[1] = size;
 		size += (width / 2) * (height / 2);
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = alloc(size, param);
 		frame->data[1] = (uint8_t *)frame->data[0] + offsets[0];
 		frame->data[2] = (uint8_t *)frame->data[0] + offsets[1];
 		frame->linesize[0] = width;
@@ -60,7 +74,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 		offsets[0] = size;
 		size += (width / 2) * (height / 2) * 2;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = alloc(size, param);
 		frame->data[1] = (uint8_t *)frame->data[0] + offsets[0];
 		frame->linesize[0] = width;
 		frame->linesize[1] = width;
@@ -69,7 +83,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 	case VIDEO_FORMAT_Y800:
 		size = width * height;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = alloc(size, param);
 		frame->linesize[0] = width;
 		break;
 
@@ -78,7 +92,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 	case VIDEO_FORMAT_UYVY:
 		size = width * height * 2;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = alloc(size, param);
 		frame->linesize[0] = width * 2;
 		break;
 
@@ -88,14 +102,14 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 	case VIDEO_FORMAT_AYUV:
 		size = width * height * 4;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = alloc(size, param);
 		frame->linesize[0] = width * 4;
 		break;
 
 	case VIDEO_FORMAT_I444:
 		size = width * height;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size * 3);
+		frame->data[0] = alloc(size * 3, param);
 		frame->data[1] = (uint8_t *)frame->data[0] + size;
 		frame->data[2] = (uint8_t *)frame->data[1] + size;
 		frame->linesize[0] = width;
@@ -106,7 +120,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 	case VIDEO_FORMAT_BGR3:
 		size = width * height * 3;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = alloc(size, param);
 		frame->linesize[0] = width * 3;
 		break;
 
@@ -119,7 +133,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 		offsets[1] = size;
 		size += (width / 2) * height;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = alloc(size, param);
 		frame->data[1] = (uint8_t *)frame->data[0] + offsets[0];
 		frame->data[2] = (uint8_t *)frame->data[0] + offsets[1];
 		frame->linesize[0] = width;
@@ -139,7 +153,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 		offsets[2] = size;
 		size += width * height;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = alloc(size, param);
 		frame->data[1] = (uint8_t *)frame->data[0] + offsets[0];
 		frame->data[2] = (uint8_t *)frame->data[0] + offsets[1];
 		frame->data[3] = (uint8_t *)frame->data[0] + offsets[2];
@@ -161,7 +175,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 		offsets[2] = size;
 		size += width * height;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = alloc(size, param);
 		frame->data[1] = (uint8_t *)frame->data[0] + offsets[0];
 		frame->data[2] = (uint8_t *)frame->data[0] + offsets[1];
 		frame->data[3] = (uint8_t *)frame->data[0] + offsets[2];
@@ -183,7 +197,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 		offsets[2] = size;
 		size += width * height;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = alloc(size, param);
 		frame->data[1] = (uint8_t *)frame->data[0] + offsets[0];
 		frame->data[2] = (uint8_t *)frame->data[0] + offsets[1];
 		frame->data[3] = (uint8_t *)frame->data[0] + offsets[2];
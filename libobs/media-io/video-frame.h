@@ -25,10 +25,19 @@ struct video_frame {
 	uint32_t linesize[MAX_AV_PLANES];
 };
 
+typedef void *(*video_frame_alloc_t)(size_t size, void *param);
+
 EXPORT void video_frame_init(struct video_frame *frame,
 			     enum video_format format, uint32_t width,
 			     uint32_t height);
 
+/* same as video_frame_init, but gets the memory of the frame from alloc,
+ * which is called once with the total size of all planes */
+EXPORT void video_frame_init_alloc(struct video_frame *frame,
+				   enum video_format format, uint32_t width,
+				   uint32_t height, video_frame_alloc_t alloc,
+				   void *param);
+
 static inline void video_frame_free(struct video_frame *frame)
 {
 	if (frame) {
@@ -33,27 +33,122 @@ extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
 #define MAX_CONVERT_BUFFERS 3
 #define MAX_CACHE_SIZE 16
+#define MAX_WORKER_THREADS 8
+#define MAX_QUEUE_SIZE 8
+#define DEFAULT_QUEUE_SIZE 3
+
+/* queued inputs hold on to scaled frames, one for each frame in the queue and
+ * one in the callback */
+#define MAX_SCALED_FRAMES (MAX_CONVERT_BUFFERS + MAX_QUEUE_SIZE + 1)
 
 struct cached_frame_info {
 	struct video_data frame;
-	int skipped;
-	int count;
+	volatile long skipped;
+	volatile long count;
+
+	/* one reference for the video thread until the frame is done, and one
+	 * for each queued input that holds on to it; the slot is only reused
+	 * once all of them are released */
+	volatile long refs;
+
+	/* set for frames queued with video_output_share_frame; the planes in
+	 * shared belong to the caller until release is called */
+	struct video_data shared;
+	void (*release)(void *param);
+	void *release_param;
+};
+
+/* a scaled frame is referenced by its input for as long as the input exists,
+ * and by each queued input that holds on to it */
+struct scaled_frame {
+	struct video_frame frame;
+	volatile long refs;
+};
+
+struct queued_frame {
+	struct video_data data;
+	struct cached_frame_info *cached;
+	struct scaled_frame *scaled;
+	uint64_t queue_ts;
+};
+
+struct video_output;
+
+struct video_input_thread {
+	struct video_output *video;
+	pthread_t thread;
+	os_sem_t *semaphore;
+	os_event_t *space_event;
+
+	void (*callback)(void *param, struct video_data *frame);
+	void *param;
+
+	pthread_mutex_t mutex;
+	struct queued_frame queue[MAX_QUEUE_SIZE];
+	size_t head;
+	size_t num;
+	size_t size;
+	enum video_queue_policy policy;
+	struct video_queue_stats stats;
+	uint64_t total_latency_ns;
+	volatile bool stop;
 };
 
 struct video_input {
 	struct video_scale_info conversion;
 	video_scaler_t *scaler;
-	struct video_frame frame[MAX_CONVERT_BUFFERS];
+	struct video_scale_info scale_from;
+	struct scaled_frame *frames[MAX_SCALED_FRAMES];
 	int cur_frame;
 
+	/* result of the current frame's conversion; inputs with an identical
+	 * conversion read the result of the input at scaled_by instead of
+	 * scaling the frame again */
+	struct video_data scaled;
+	struct scaled_frame *scaled_frame;
+	bool scale_success;
+	size_t scaled_by;
+
+	/* renditions are scaled from the result of the next larger input
+	 * (scale_parent) instead of the full frame when there is one */
+	bool rendition;
+	size_t scale_parent;
+
+	/* set for queued inputs, their callback runs on a thread of its own */
+	struct video_input_thread *thread;
+
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
 };
 
+struct video_input_ref {
+	void (*callback)(void *param, struct video_data *frame);
+	void *param;
+};
+
+static struct scaled_frame *
+create_scaled_frame(const struct video_scale_info *info)
+{
+	struct scaled_frame *frame = bzalloc(sizeof(*frame));
+
+	video_frame_init(&frame->frame, info->format, info->width,
+			 info->height);
+	frame->refs = 1;
+	return frame;
+}
+
+static inline void release_scaled_frame(struct scaled_frame *frame)
+{
+	if (frame && os_atomic_dec_long(&frame->refs) == 0) {
+		video_frame_free(&frame->frame);
+		bfree(frame);
+	}
+}
+
 static inline void video_input_free(struct video_input *input)
 {
-	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-		video_frame_free(&input->frame[i]);
+	for (size_t i = 0; i < MAX_SCALED_FRAMES; i++)
+		release_scaled_frame(input->frames[i]);
 	video_scaler_destroy(input->scaler);
 }
 
@@ -61,7 +156,6 @@ struct video_output {
 	struct video_output_info info;
 
 	pthread_t thread;
-	pthread_mutex_t data_mutex;
 	bool stop;
 
 	os_sem_t *update_semaphore;
@@ -74,9 +168,32 @@ struct video_output {
 	pthread_mutex_t input_mutex;
 	DARRAY(struct video_input) inputs;
 
-	size_t available_frames;
-	size_t first_added;
-	size_t last_added;
+	/* conversions of one frame for different inputs are spread across the
+	 * video thread and these workers.  pending_work counts unfinished jobs
+	 * plus woken workers, so the video thread knows when nothing touches
+	 * the job list anymore. */
+	DARRAY(pthread_t) workers;
+	os_sem_t *work_semaphore;
+	os_event_t *work_done_event;
+	DARRAY(size_t) scale_jobs;
+	const struct video_data *scale_source;
+	volatile long next_job;
+	volatile long pending_work;
+	volatile bool workers_stop;
+
+	/* the video thread may hold input_mutex while it waits for room in
+	 * the queue of an input, so queued inputs that disconnect from their
+	 * own callback are removed by the video thread instead */
+	pthread_mutex_t deferred_mutex;
+	DARRAY(struct video_input_ref) deferred_disconnects;
+
+	/* Frames are handed from the graphics thread to the video thread
+	 * through a single-producer/single-consumer ring.  write_idx is only
+	 * touched by the producer, read_idx only by the video thread, and
+	 * queued_frames is the only value both sides modify. */
+	size_t write_idx;
+	size_t read_idx;
+	volatile long queued_frames;
 	struct cached_frame_info cache[MAX_CACHE_SIZE];
 
 	volatile bool raw_active;
@@ -85,86 +202,471 @@ struct video_output {
 
 /* ------------------------------------------------------------------------- */
 
-static inline bool scale_video_output(struct video_input *input,
-				      struct video_data *data)
+/* a scaled frame can be reused once only its input references it */
+static struct scaled_frame *next_scaled_frame(struct video_input *input)
 {
-	bool success = true;
+	for (int i = 1; i <= MAX_CONVERT_BUFFERS; i++) {
+		int idx = (input->cur_frame + i) % MAX_CONVERT_BUFFERS;
 
-	if (input->scaler) {
-		struct video_frame *frame;
+		if (os_atomic_load_long(&input->frames[idx]->refs) == 1) {
+			input->cur_frame = idx;
+			return input->frames[idx];
+		}
+	}
+
+	/* the others are only needed while queues hold on to frames */
+	for (int idx = MAX_CONVERT_BUFFERS; idx < MAX_SCALED_FRAMES; idx++) {
+		if (!input->frames[idx])
+			input->frames[idx] =
+				create_scaled_frame(&input->conversion);
+
+		if (os_atomic_load_long(&input->frames[idx]->refs) == 1) {
+			input->cur_frame = idx;
+			return input->frames[idx];
+		}
+	}
 
-		if (++input->cur_frame == MAX_CONVERT_BUFFERS)
-			input->cur_frame = 0;
+	return NULL;
+}
 
-		frame = &input->frame[input->cur_frame];
+static inline void scale_video_output(struct video_input *input,
+				      const struct video_data *data)
+{
+	struct scaled_frame *scaled = next_scaled_frame(input);
+	struct video_frame *frame;
+
+	/* queues hold on to every frame, which drops this one for the inputs
+	 * of this conversion */
+	input->scaled_frame = scaled;
+	if (!scaled) {
+		input->scale_success = false;
+		return;
+	}
 
-		success = video_scaler_scale(input->scaler, frame->data,
-					     frame->linesize,
-					     (const uint8_t *const *)data->data,
-					     data->linesize);
+	frame = &scaled->frame;
 
-		if (success) {
-			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-				data->data[i] = frame->data[i];
-				data->linesize[i] = frame->linesize[i];
-			}
+	input->scale_success = video_scaler_scale(
+		input->scaler, frame->data, frame->linesize,
+		(const uint8_t *const *)data->data, data->linesize);
+
+	if (input->scale_success) {
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			input->scaled.data[i] = frame->data[i];
+			input->scaled.linesize[i] = frame->linesize[i];
+		}
+		input->scaled.timestamp = data->timestamp;
+	} else {
+		blog(LOG_WARNING, "video-io: Could not scale frame!");
+	}
+}
+
+static inline bool same_conversion(const struct video_scale_info *a,
+				   const struct video_scale_info *b)
+{
+	return a->format == b->format && a->width == b->width &&
+	       a->height == b->height && a->range == b->range &&
+	       a->colorspace == b->colorspace;
+}
+
+static inline void finish_work(struct video_output *video)
+{
+	if (os_atomic_dec_long(&video->pending_work) == 0)
+		os_event_signal(video->work_done_event);
+}
+
+/* scales an input and then the renditions that are scaled from its result,
+ * so a whole cascade is one job */
+static void scale_cascade(struct video_output *video, size_t idx,
+			  const struct video_data *data)
+{
+	struct video_input *input = video->inputs.array + idx;
+
+	if (data)
+		scale_video_output(input, data);
+	else
+		input->scale_success = false;
+
+	for (size_t i = 0; i < video->inputs.num; i++) {
+		if (video->inputs.array[i].scale_parent == idx)
+			scale_cascade(video, i,
+				      input->scale_success ? &input->scaled
+							   : NULL);
+	}
+}
+
+static void run_scale_jobs(struct video_output *video)
+{
+	for (;;) {
+		size_t idx = (size_t)os_atomic_inc_long(&video->next_job) - 1;
+		if (idx >= video->scale_jobs.num)
+			break;
+
+		scale_cascade(video, video->scale_jobs.array[idx],
+			      video->scale_source);
+		finish_work(video);
+	}
+}
+
+static void *video_worker_thread(void *param)
+{
+	struct video_output *video = param;
+
+	os_set_thread_name("video-io: conversion worker");
+
+	while (os_sem_wait(video->work_semaphore) == 0) {
+		if (os_atomic_load_bool(&video->workers_stop))
+			break;
+
+		run_scale_jobs(video);
+		finish_work(video);
+	}
+
+	return NULL;
+}
+
+/* must be called with input_mutex held */
+static void scale_inputs(struct video_output *video,
+			 const struct video_data *data)
+{
+	long wake = 0;
+
+	da_resize(video->scale_jobs, 0);
+
+	for (size_t i = 0; i < video->inputs.num; i++) {
+		struct video_input *input = video->inputs.array + i;
+
+		if (input->scaler && input->scaled_by == i &&
+		    input->scale_parent == DARRAY_INVALID)
+			da_push_back(video->scale_jobs, &i);
+	}
+
+	if (!video->scale_jobs.num)
+		return;
+
+	if (video->scale_jobs.num > 1) {
+		wake = (long)video->workers.num;
+		if (wake > (long)video->scale_jobs.num - 1)
+			wake = (long)video->scale_jobs.num - 1;
+	}
+
+	video->scale_source = data;
+	os_atomic_set_long(&video->next_job, 0);
+	os_atomic_set_long(&video->pending_work,
+			   (long)video->scale_jobs.num + wake);
+
+	for (long i = 0; i < wake; i++)
+		os_sem_post(video->work_semaphore);
+
+	run_scale_jobs(video);
+	os_event_wait(video->work_done_event);
+}
+
+static inline void release_cached_frame(struct cached_frame_info *cfi)
+{
+	/* the slot may be reused as soon as the last reference is gone */
+	void (*release)(void *param) = cfi->release;
+	void *release_param = cfi->release_param;
+
+	if (os_atomic_dec_long(&cfi->refs) == 0 && release)
+		release(release_param);
+}
+
+static inline void release_queued_frame(struct queued_frame *qf)
+{
+	if (qf->scaled)
+		release_scaled_frame(qf->scaled);
+	if (qf->cached)
+		release_cached_frame(qf->cached);
+}
+
+static THREAD_LOCAL struct video_input_thread *cur_input_thread = NULL;
+
+/* must be called with the mutex of the thread held */
+static inline bool pop_queued_frame(struct video_input_thread *thread,
+				    struct queued_frame *qf)
+{
+	if (!thread->num)
+		return false;
+
+	*qf = thread->queue[thread->head];
+	thread->head = (thread->head + 1) % MAX_QUEUE_SIZE;
+	thread->num--;
+	thread->stats.depth = thread->num;
+	return true;
+}
+
+static void flush_queued_frames(struct video_input_thread *thread)
+{
+	struct queued_frame qf;
+
+	pthread_mutex_lock(&thread->mutex);
+	while (pop_queued_frame(thread, &qf))
+		release_queued_frame(&qf);
+	pthread_mutex_unlock(&thread->mutex);
+
+	os_event_signal(thread->space_event);
+}
+
+static void *video_input_thread(void *param)
+{
+	struct video_input_thread *thread = param;
+
+	os_set_thread_name("video-io: input thread");
+	cur_input_thread = thread;
+
+	while (os_sem_wait(thread->semaphore) == 0) {
+		struct queued_frame qf;
+		bool have_frame;
+
+		if (os_atomic_load_bool(&thread->stop))
+			break;
+
+		pthread_mutex_lock(&thread->mutex);
+		have_frame = pop_queued_frame(thread, &qf);
+		pthread_mutex_unlock(&thread->mutex);
+
+		/* frames dropped from the front of the queue leave posts
+		 * without a frame behind */
+		if (!have_frame)
+			continue;
+
+		os_event_signal(thread->space_event);
+
+		thread->callback(thread->param, &qf.data);
+		release_queued_frame(&qf);
+
+		uint64_t latency = os_gettime_ns() - qf.queue_ts;
+
+		pthread_mutex_lock(&thread->mutex);
+		thread->stats.frames++;
+		thread->total_latency_ns += latency;
+		if (latency > thread->stats.max_latency_ns)
+			thread->stats.max_latency_ns = latency;
+		pthread_mutex_unlock(&thread->mutex);
+
+		profile_reenable_thread();
+	}
+
+	flush_queued_frames(thread);
+	return NULL;
+}
+
+/* must be called with input_mutex held; takes over the reference of qf */
+static void queue_input_frame(struct video_input_thread *thread,
+			      struct queued_frame *qf)
+{
+	struct queued_frame dropped = {0};
+	bool queued = true;
+
+	pthread_mutex_lock(&thread->mutex);
+
+	if (thread->num == thread->size &&
+	    thread->policy == VIDEO_QUEUE_BLOCK) {
+		uint64_t start = os_gettime_ns();
+
+		while (thread->num == thread->size &&
+		       !os_atomic_load_bool(&thread->stop)) {
+			pthread_mutex_unlock(&thread->mutex);
+			os_event_wait(thread->space_event);
+			pthread_mutex_lock(&thread->mutex);
+		}
+
+		thread->stats.blocked_ns += os_gettime_ns() - start;
+	}
+
+	if (os_atomic_load_bool(&thread->stop)) {
+		dropped = *qf;
+		queued = false;
+
+	} else if (thread->num == thread->size) {
+		thread->stats.dropped++;
+
+		if (thread->policy == VIDEO_QUEUE_DROP_NEWEST) {
+			dropped = *qf;
+			queued = false;
 		} else {
-			blog(LOG_WARNING, "video-io: Could not scale frame!");
+			pop_queued_frame(thread, &dropped);
 		}
 	}
 
-	return success;
+	if (queued) {
+		size_t idx = (thread->head + thread->num) % MAX_QUEUE_SIZE;
+
+		thread->queue[idx] = *qf;
+		thread->num++;
+		thread->stats.depth = thread->num;
+		if (thread->num > thread->stats.max_depth)
+			thread->stats.max_depth = thread->num;
+	}
+
+	pthread_mutex_unlock(&thread->mutex);
+
+	release_queued_frame(&dropped);
+	if (queued)
+		os_sem_post(thread->semaphore);
 }
 
-static inline bool video_output_cur_frame(struct video_output *video)
+static struct video_input_thread *
+create_input_thread(struct video_output *video, struct video_input *input,
+		    const struct video_queue_info *queue)
 {
-	struct cached_frame_info *frame_info;
-	bool complete;
-	bool skipped;
+	struct video_input_thread *thread = bzalloc(sizeof(*thread));
+
+	thread->video = video;
+	thread->callback = input->callback;
+	thread->param = input->param;
+	thread->policy = queue ? queue->policy : VIDEO_QUEUE_BLOCK;
+	thread->size = queue && queue->size ? queue->size : DEFAULT_QUEUE_SIZE;
+	if (thread->size > MAX_QUEUE_SIZE)
+		thread->size = MAX_QUEUE_SIZE;
+	thread->stats.size = thread->size;
+
+	if (pthread_mutex_init(&thread->mutex, NULL) != 0)
+		goto fail_mutex;
+	if (os_sem_init(&thread->semaphore, 0) != 0)
+		goto fail;
+	if (os_event_init(&thread->space_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+	if (pthread_create(&thread->thread, NULL, video_input_thread,
+			   thread) != 0)
+		goto fail;
 
-	/* -------------------------------- */
+	return thread;
+
+fail:
+	pthread_mutex_destroy(&thread->mutex);
+fail_mutex:
+	os_sem_destroy(thread->semaphore);
+	os_event_destroy(thread->space_event);
+	bfree(thread);
+	return NULL;
+}
+
+/* frames that are still queued are dropped, the one in the callback is
+ * finished first */
+static void destroy_input_thread(struct video_input_thread *thread)
+{
+	void *thread_ret;
+
+	if (!thread)
+		return;
+
+	os_atomic_set_bool(&thread->stop, true);
+	os_sem_post(thread->semaphore);
+	pthread_join(thread->thread, &thread_ret);
+
+	os_sem_destroy(thread->semaphore);
+	os_event_destroy(thread->space_event);
+	pthread_mutex_destroy(&thread->mutex);
+	bfree(thread);
+}
+
+/* must be called with input_mutex held */
+static inline void queue_input(struct video_input *input,
+			       struct cached_frame_info *frame_info,
+			       struct video_input *src,
+			       const struct video_data *frame)
+{
+	struct queued_frame qf = {.data = *frame,
+				  .queue_ts = os_gettime_ns()};
+
+	if (src) {
+		qf.scaled = src->scaled_frame;
+		os_atomic_inc_long(&qf.scaled->refs);
+	} else {
+		qf.cached = frame_info;
+		os_atomic_inc_long(&qf.cached->refs);
+	}
 
-	pthread_mutex_lock(&video->data_mutex);
+	queue_input_frame(input->thread, &qf);
+}
 
-	frame_info = &video->cache[video->first_added];
+static void remove_input(struct video_output *video, size_t idx);
 
-	pthread_mutex_unlock(&video->data_mutex);
+static size_t video_get_input_idx(const video_t *video,
+				  void (*callback)(void *param,
+						   struct video_data *frame),
+				  void *param);
+
+/* must be called with input_mutex held */
+static void remove_deferred_inputs(struct video_output *video)
+{
+	pthread_mutex_lock(&video->deferred_mutex);
+
+	for (size_t i = 0; i < video->deferred_disconnects.num; i++) {
+		struct video_input_ref *ref =
+			video->deferred_disconnects.array + i;
+		size_t idx =
+			video_get_input_idx(video, ref->callback, ref->param);
+		if (idx != DARRAY_INVALID)
+			remove_input(video, idx);
+	}
+
+	da_resize(video->deferred_disconnects, 0);
+	pthread_mutex_unlock(&video->deferred_mutex);
+}
+
+static inline bool video_output_cur_frame(struct video_output *video)
+{
+	struct cached_frame_info *frame_info = &video->cache[video->read_idx];
+	struct video_data source = frame_info->frame;
+	bool complete;
+
+	if (frame_info->release) {
+		memcpy(source.data, frame_info->shared.data,
+		       sizeof(source.data));
+		memcpy(source.linesize, frame_info->shared.linesize,
+		       sizeof(source.linesize));
+	}
 
 	/* -------------------------------- */
 
 	pthread_mutex_lock(&video->input_mutex);
 
+	scale_inputs(video, &source);
+
 	for (size_t i = 0; i < video->inputs.num; i++) {
 		struct video_input *input = video->inputs.array + i;
-		struct video_data frame = frame_info->frame;
+		struct video_input *src = NULL;
+		struct video_data frame = source;
 
-		if (scale_video_output(input, &frame))
+		if (input->scaler) {
+			src = video->inputs.array + input->scaled_by;
+			if (!src->scale_success)
+				continue;
+
+			frame = src->scaled;
+		}
+
+		if (input->thread) {
+			queue_input(input, frame_info, src, &frame);
+		} else {
 			input->callback(input->param, &frame);
+		}
 	}
 
+	remove_deferred_inputs(video);
+
 	pthread_mutex_unlock(&video->input_mutex);
 
 	/* -------------------------------- */
 
-	pthread_mutex_lock(&video->data_mutex);
-
 	frame_info->frame.timestamp += video->frame_time;
-	complete = --frame_info->count == 0;
-	skipped = frame_info->skipped > 0;
+	complete = os_atomic_dec_long(&frame_info->count) == 0;
 
 	if (complete) {
-		if (++video->first_added == video->info.cache_size)
-			video->first_added = 0;
+		release_cached_frame(frame_info);
+
+		if (++video->read_idx == video->info.cache_size)
+			video->read_idx = 0;
+
+		os_atomic_dec_long(&video->queued_frames);
 
-		if (++video->available_frames == video->info.cache_size)
-			video->last_added = video->first_added;
-	} else if (skipped) {
-		--frame_info->skipped;
+	} else if (os_atomic_load_long(&frame_info->skipped) > 0) {
+		os_atomic_dec_long(&frame_info->skipped);
 		os_atomic_inc_long(&video->skipped_frames);
 	}
 
-	pthread_mutex_unlock(&video->data_mutex);
-
 	/* -------------------------------- */
 
 	return complete;
@@ -219,7 +721,54 @@ static inline void init_cache(struct video_output *video)
 				 video->info.height);
 	}
 
-	video->available_frames = video->info.cache_size;
+	video->write_idx = 0;
+	video->read_idx = 0;
+	video->queued_frames = 0;
+}
+
+static void stop_workers(struct video_output *video)
+{
+	void *thread_ret;
+
+	if (!video->workers.num)
+		return;
+
+	os_atomic_set_bool(&video->workers_stop, true);
+	for (size_t i = 0; i < video->workers.num; i++)
+		os_sem_post(video->work_semaphore);
+	for (size_t i = 0; i < video->workers.num; i++)
+		pthread_join(video->workers.array[i], &thread_ret);
+
+	da_free(video->workers);
+	os_atomic_set_bool(&video->workers_stop, false);
+}
+
+/* the workers only run while the video thread holds input_mutex and waits
+ * for them in scale_inputs, so they are idle while it is held here */
+void video_output_set_worker_threads(video_t *video, size_t count)
+{
+	if (!video)
+		return;
+
+	if (count > MAX_WORKER_THREADS)
+		count = MAX_WORKER_THREADS;
+
+	pthread_mutex_lock(&video->input_mutex);
+	stop_workers(video);
+
+	/* the video thread itself performs one of the conversions */
+	for (size_t i = 1; i < count; i++) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, video_worker_thread, video) !=
+		    0) {
+			blog(LOG_WARNING, "video-io: Failed to create "
+					  "conversion worker");
+			break;
+		}
+		da_push_back(video->workers, &thread);
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
 }
 
 int video_output_open(video_t **video, struct video_output_info *info)
@@ -243,12 +792,16 @@ int video_output_open(video_t **video, struct video_output_info *info)
 		goto fail;
 	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
 		goto fail;
-	if (pthread_mutex_init(&out->data_mutex, &attr) != 0)
-		goto fail;
 	if (pthread_mutex_init(&out->input_mutex, &attr) != 0)
 		goto fail;
 	if (os_sem_init(&out->update_semaphore, 0) != 0)
 		goto fail;
+	if (os_sem_init(&out->work_semaphore, 0) != 0)
+		goto fail;
+	if (os_event_init(&out->work_done_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+	if (pthread_mutex_init(&out->deferred_mutex, NULL) != 0)
+		goto fail;
 	if (pthread_create(&out->thread, NULL, video_thread, out) != 0)
 		goto fail;
 
@@ -269,16 +822,31 @@ void video_output_close(video_t *video)
 		return;
 
 	video_output_stop(video);
+	stop_workers(video);
 
-	for (size_t i = 0; i < video->inputs.num; i++)
+	for (size_t i = 0; i < video->inputs.num; i++) {
+		destroy_input_thread(video->inputs.array[i].thread);
 		video_input_free(&video->inputs.array[i]);
+	}
 	da_free(video->inputs);
+	da_free(video->scale_jobs);
+	da_free(video->deferred_disconnects);
+
+	/* hand back shared planes of frames that were never processed */
+	long queued = os_atomic_load_long(&video->queued_frames);
+	for (long i = 0; i < queued; i++) {
+		size_t idx = (video->read_idx + (size_t)i) %
+			     video->info.cache_size;
+		release_cached_frame(&video->cache[idx]);
+	}
 
 	for (size_t i = 0; i < video->info.cache_size; i++)
 		video_frame_free((struct video_frame *)&video->cache[i]);
 
 	os_sem_destroy(video->update_semaphore);
-	pthread_mutex_destroy(&video->data_mutex);
+	os_sem_destroy(video->work_semaphore);
+	os_event_destroy(video->work_done_event);
+	pthread_mutex_destroy(&video->deferred_mutex);
 	pthread_mutex_destroy(&video->input_mutex);
 	bfree(video);
 }
@@ -297,22 +865,42 @@ static size_t video_get_input_idx(const video_t *video,
 	return DARRAY_INVALID;
 }
 
+static inline void get_output_conversion(const struct video_output *video,
+					 struct video_scale_info *info)
+{
+	info->format = video->info.format;
+	info->width = video->info.width;
+	info->height = video->info.height;
+	info->range = video->info.range;
+	info->colorspace = video->info.colorspace;
+}
+
+static int create_input_scaler(struct video_input *input,
+			       const struct video_scale_info *from)
+{
+	video_scaler_t *scaler;
+	int ret = video_scaler_create(&scaler, &input->conversion, from,
+				      VIDEO_SCALE_FAST_BILINEAR);
+
+	if (ret == VIDEO_SCALER_SUCCESS) {
+		video_scaler_destroy(input->scaler);
+		input->scaler = scaler;
+		input->scale_from = *from;
+	}
+
+	return ret;
+}
+
 static inline bool video_input_init(struct video_input *input,
 				    struct video_output *video)
 {
 	if (input->conversion.width != video->info.width ||
 	    input->conversion.height != video->info.height ||
 	    input->conversion.format != video->info.format) {
-		struct video_scale_info from = {.format = video->info.format,
-						.width = video->info.width,
-						.height = video->info.height,
-						.range = video->info.range,
-						.colorspace =
-							video->info.colorspace};
-
-		int ret = video_scaler_create(&input->scaler,
-					      &input->conversion, &from,
-					      VIDEO_SCALE_FAST_BILINEAR);
+		struct video_scale_info from;
+		get_output_conversion(video, &from);
+
+		int ret = create_input_scaler(input, &from);
 		if (ret != VIDEO_SCALER_SUCCESS) {
 			if (ret == VIDEO_SCALER_BAD_CONVERSION)
 				blog(LOG_ERROR, "video_input_init: Bad "
@@ -325,24 +913,141 @@ static inline bool video_input_init(struct video_input *input,
 		}
 
 		for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-			video_frame_init(&input->frame[i],
-					 input->conversion.format,
-					 input->conversion.width,
-					 input->conversion.height);
+			input->frames[i] =
+				create_scaled_frame(&input->conversion);
 	}
 
 	return true;
 }
 
+/* the smallest input that is larger than the rendition in both dimensions */
+static size_t find_scale_parent(struct video_output *video, size_t idx)
+{
+	const struct video_scale_info *info =
+		&video->inputs.array[idx].conversion;
+	uint64_t area = (uint64_t)info->width * info->height;
+	uint64_t best_area = 0;
+	size_t best = DARRAY_INVALID;
+
+	for (size_t i = 0; i < video->inputs.num; i++) {
+		struct video_input *input = video->inputs.array + i;
+		const struct video_scale_info *cur = &input->conversion;
+		uint64_t cur_area = (uint64_t)cur->width * cur->height;
+
+		if (!input->scaler || input->scaled_by != i)
+			continue;
+		if (cur->width < info->width || cur->height < info->height ||
+		    cur_area <= area)
+			continue;
+
+		if (best == DARRAY_INVALID || cur_area < best_area) {
+			best = i;
+			best_area = cur_area;
+		}
+	}
+
+	return best;
+}
+
+/* decides which inputs share a conversion and where each rendition is
+ * scaled from; must be called with input_mutex held whenever the inputs
+ * change */
+static void plan_inputs(struct video_output *video)
+{
+	struct video_scale_info full;
+	get_output_conversion(video, &full);
+
+	for (size_t i = 0; i < video->inputs.num; i++) {
+		struct video_input *input = video->inputs.array + i;
+
+		input->scaled_by = i;
+		input->scale_parent = DARRAY_INVALID;
+		if (!input->scaler)
+			continue;
+
+		for (size_t j = 0; j < i; j++) {
+			struct video_input *prev = video->inputs.array + j;
+			if (prev->scaler &&
+			    prev->rendition == input->rendition &&
+			    same_conversion(&prev->conversion,
+					    &input->conversion)) {
+				input->scaled_by = prev->scaled_by;
+				break;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < video->inputs.num; i++) {
+		struct video_input *input = video->inputs.array + i;
+		const struct video_scale_info *from = &full;
+
+		if (!input->scaler || input->scaled_by != i)
+			continue;
+
+		if (input->rendition) {
+			input->scale_parent = find_scale_parent(video, i);
+			if (input->scale_parent != DARRAY_INVALID)
+				from = &video->inputs.array[input->scale_parent]
+						.conversion;
+		}
+
+		if (same_conversion(&input->scale_from, from))
+			continue;
+
+		if (create_input_scaler(input, from) != VIDEO_SCALER_SUCCESS) {
+			blog(LOG_WARNING,
+			     "video-io: Failed to create cascaded scaler, "
+			     "scaling from the full frame");
+			input->scale_parent = DARRAY_INVALID;
+			if (!same_conversion(&input->scale_from, &full))
+				create_input_scaler(input, &full);
+		}
+	}
+}
+
 static inline void reset_frames(video_t *video)
 {
 	os_atomic_set_long(&video->skipped_frames, 0);
 	os_atomic_set_long(&video->total_frames, 0);
 }
 
-bool video_output_connect(
-	video_t *video, const struct video_scale_info *conversion,
+/* must be called with input_mutex held.  an input that was disconnected from
+ * the callback of a queued input stays until the video thread removes it, so
+ * connecting it again replaces it right away instead */
+static void remove_disconnected_input(
+	struct video_output *video,
 	void (*callback)(void *param, struct video_data *frame), void *param)
+{
+	bool deferred = false;
+	size_t idx;
+
+	pthread_mutex_lock(&video->deferred_mutex);
+
+	for (size_t i = video->deferred_disconnects.num; i > 0; i--) {
+		struct video_input_ref *ref =
+			video->deferred_disconnects.array + (i - 1);
+
+		if (ref->callback == callback && ref->param == param) {
+			da_erase(video->deferred_disconnects, i - 1);
+			deferred = true;
+		}
+	}
+
+	pthread_mutex_unlock(&video->deferred_mutex);
+
+	if (!deferred)
+		return;
+
+	idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID)
+		remove_input(video, idx);
+}
+
+static bool
+connect_input(video_t *video, const struct video_scale_info *conversion,
+	      const struct video_queue_info *queue, bool rendition,
+	      void (*callback)(void *param, struct video_data *frame),
+	      void *param)
 {
 	bool success = false;
 
@@ -351,12 +1056,15 @@ bool video_output_connect(
 
 	pthread_mutex_lock(&video->input_mutex);
 
+	remove_disconnected_input(video, callback, param);
+
 	if (video_get_input_idx(video, callback, param) == DARRAY_INVALID) {
 		struct video_input input;
 		memset(&input, 0, sizeof(input));
 
 		input.callback = callback;
 		input.param = param;
+		input.rendition = rendition;
 
 		if (conversion) {
 			input.conversion = *conversion;
@@ -372,6 +1080,13 @@ bool video_output_connect(
 			input.conversion.height = video->info.height;
 
 		success = video_input_init(&input, video);
+		if (success && (queue || rendition)) {
+			input.thread =
+				create_input_thread(video, &input, queue);
+			if (!input.thread)
+				blog(LOG_WARNING, "video-io: Failed to create "
+						  "input thread");
+		}
 		if (success) {
 			if (video->inputs.num == 0) {
 				if (!os_atomic_load_long(&video->gpu_refs)) {
@@ -380,6 +1095,7 @@ bool video_output_connect(
 				os_atomic_set_bool(&video->raw_active, true);
 			}
 			da_push_back(video->inputs, &input);
+			plan_inputs(video);
 		}
 	}
 
@@ -388,6 +1104,32 @@ bool video_output_connect(
 	return success;
 }
 
+bool video_output_connect(
+	video_t *video, const struct video_scale_info *conversion,
+	void (*callback)(void *param, struct video_data *frame), void *param)
+{
+	return connect_input(video, conversion, NULL, false, callback, param);
+}
+
+bool video_output_connect_queued(
+	video_t *video, const struct video_scale_info *conversion,
+	const struct video_queue_info *queue,
+	void (*callback)(void *param, struct video_data *frame), void *param)
+{
+	struct video_queue_info defaults = {0};
+
+	return connect_input(video, conversion, queue ? queue : &defaults,
+			     false, callback, param);
+}
+
+bool video_output_connect_rendition(
+	video_t *video, const struct video_scale_info *conversion,
+	const struct video_queue_info *queue,
+	void (*callback)(void *param, struct video_data *frame), void *param)
+{
+	return connect_input(video, conversion, queue, true, callback, param);
+}
+
 static void log_skipped(video_t *video)
 {
 	long skipped = os_atomic_load_long(&video->skipped_frames);
@@ -405,6 +1147,22 @@ static void log_skipped(video_t *video)
 		     percentage_skipped);
 }
 
+/* must be called with input_mutex held */
+static void remove_input(struct video_output *video, size_t idx)
+{
+	destroy_input_thread(video->inputs.array[idx].thread);
+	video_input_free(video->inputs.array + idx);
+	da_erase(video->inputs, idx);
+	plan_inputs(video);
+
+	if (video->inputs.num == 0) {
+		os_atomic_set_bool(&video->raw_active, false);
+		if (!os_atomic_load_long(&video->gpu_refs)) {
+			log_skipped(video);
+		}
+	}
+}
+
 void video_output_disconnect(video_t *video,
 			     void (*callback)(void *param,
 					      struct video_data *frame),
@@ -413,22 +1171,72 @@ void video_output_disconnect(video_t *video,
 	if (!video || !callback)
 		return;
 
+	/* called from the callback of a queued input, which can't wait for
+	 * input_mutex or for its own thread.  the input gets no more frames
+	 * and is removed by the video thread */
+	if (cur_input_thread && cur_input_thread->video == video) {
+		struct video_input_ref ref = {callback, param};
+
+		if (cur_input_thread->callback == callback &&
+		    cur_input_thread->param == param) {
+			os_atomic_set_bool(&cur_input_thread->stop, true);
+			os_event_signal(cur_input_thread->space_event);
+		}
+
+		pthread_mutex_lock(&video->deferred_mutex);
+		da_push_back(video->deferred_disconnects, &ref);
+		pthread_mutex_unlock(&video->deferred_mutex);
+		return;
+	}
+
 	pthread_mutex_lock(&video->input_mutex);
 
 	size_t idx = video_get_input_idx(video, callback, param);
-	if (idx != DARRAY_INVALID) {
-		video_input_free(video->inputs.array + idx);
-		da_erase(video->inputs, idx);
-
-		if (video->inputs.num == 0) {
-			os_atomic_set_bool(&video->raw_active, false);
-			if (!os_atomic_load_long(&video->gpu_refs)) {
-				log_skipped(video);
-			}
-		}
+	if (idx != DARRAY_INVALID)
+		remove_input(video, idx);
+
+	pthread_mutex_unlock(&video->input_mutex);
+}
+
+static void get_thread_stats(struct video_input_thread *thread,
+			     struct video_queue_stats *stats)
+{
+	pthread_mutex_lock(&thread->mutex);
+	*stats = thread->stats;
+	if (stats->frames)
+		stats->avg_latency_ns =
+			thread->total_latency_ns / stats->frames;
+	pthread_mutex_unlock(&thread->mutex);
+}
+
+bool video_output_get_queue_stats(
+	video_t *video, void (*callback)(void *param, struct video_data *frame),
+	void *param, struct video_queue_stats *stats)
+{
+	struct video_input_thread *thread = NULL;
+
+	if (!video || !callback || !stats)
+		return false;
+
+	/* like for disconnecting, the callback of a queued input can't wait
+	 * for input_mutex, but its own thread is valid while it runs */
+	if (cur_input_thread && cur_input_thread->video == video &&
+	    cur_input_thread->callback == callback &&
+	    cur_input_thread->param == param) {
+		get_thread_stats(cur_input_thread, stats);
+		return true;
 	}
 
+	pthread_mutex_lock(&video->input_mutex);
+
+	size_t idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID)
+		thread = video->inputs.array[idx].thread;
+	if (thread)
+		get_thread_stats(thread, stats);
+
 	pthread_mutex_unlock(&video->input_mutex);
+	return thread != NULL;
 }
 
 bool video_output_active(const video_t *video)
@@ -443,41 +1251,110 @@ const struct video_output_info *video_output_get_info(const video_t *video)
 	return video ? &video->info : NULL;
 }
 
+/* Adds repeat counts to the most recently queued frame when the ring is full.
+ * Returns false if the video thread retired that frame in the meantime, in
+ * which case a slot has become available and the caller should retry. */
+static inline bool add_to_last_frame(struct video_output *video, long count)
+{
+	size_t last = video->write_idx == 0 ? video->info.cache_size - 1
+					    : video->write_idx - 1;
+	struct cached_frame_info *cfi = &video->cache[last];
+	long cur;
+
+	/* skipped is raised first so the video thread never sees the extra
+	 * repeats without also seeing them as skipped */
+	do {
+		cur = os_atomic_load_long(&cfi->skipped);
+	} while (!os_atomic_compare_swap_long(&cfi->skipped, cur, cur + count));
+
+	do {
+		cur = os_atomic_load_long(&cfi->count);
+		if (cur == 0)
+			return false;
+	} while (!os_atomic_compare_swap_long(&cfi->count, cur, cur + count));
+
+	return true;
+}
+
+static inline void atomic_add_long(volatile long *val, long count)
+{
+	long cur;
+
+	do {
+		cur = os_atomic_load_long(val);
+	} while (!os_atomic_compare_swap_long(val, cur, cur + count));
+}
+
+static struct cached_frame_info *
+lock_cache_slot(struct video_output *video, int count, uint64_t timestamp)
+{
+	struct cached_frame_info *cfi = &video->cache[video->write_idx];
+
+	for (;;) {
+		bool full = (size_t)os_atomic_load_long(
+				    &video->queued_frames) ==
+			    video->info.cache_size;
+		bool held = !full && os_atomic_load_long(&cfi->refs) != 0;
+
+		if (!full && !held)
+			break;
+		if (add_to_last_frame(video, count))
+			return NULL;
+
+		/* the video thread is done with every frame, but queued
+		 * inputs still hold on to the free slot */
+		if (held) {
+			atomic_add_long(&video->skipped_frames, count);
+			atomic_add_long(&video->total_frames, count);
+			return NULL;
+		}
+	}
+
+	/* the slot at write_idx is not visible to the video thread until
+	 * video_output_unlock_frame publishes it */
+	cfi->frame.timestamp = timestamp;
+	cfi->release = NULL;
+	os_atomic_set_long(&cfi->refs, 1);
+	os_atomic_set_long(&cfi->count, count);
+	os_atomic_set_long(&cfi->skipped, 0);
+	return cfi;
+}
+
 bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 			     int count, uint64_t timestamp)
 {
 	struct cached_frame_info *cfi;
-	bool locked;
 
 	if (!video)
 		return false;
 
-	pthread_mutex_lock(&video->data_mutex);
-
-	if (video->available_frames == 0) {
-		video->cache[video->last_added].count += count;
-		video->cache[video->last_added].skipped += count;
-		locked = false;
+	cfi = lock_cache_slot(video, count, timestamp);
+	if (!cfi)
+		return false;
 
-	} else {
-		if (video->available_frames != video->info.cache_size) {
-			if (++video->last_added == video->info.cache_size)
-				video->last_added = 0;
-		}
+	memcpy(frame, &cfi->frame, sizeof(*frame));
+	return true;
+}
 
-		cfi = &video->cache[video->last_added];
-		cfi->frame.timestamp = timestamp;
-		cfi->count = count;
-		cfi->skipped = 0;
+bool video_output_share_frame(video_t *video, const struct video_data *frame,
+			      int count, void (*release)(void *param),
+			      void *param)
+{
+	struct cached_frame_info *cfi;
 
-		memcpy(frame, &cfi->frame, sizeof(*frame));
+	if (!video || !release)
+		return false;
 
-		locked = true;
-	}
+	cfi = lock_cache_slot(video, count, frame->timestamp);
+	if (!cfi)
+		return false;
 
-	pthread_mutex_unlock(&video->data_mutex);
+	cfi->shared = *frame;
+	cfi->release = release;
+	cfi->release_param = param;
 
-	return locked;
+	video_output_unlock_frame(video);
+	return true;
 }
 
 void video_output_unlock_frame(video_t *video)
@@ -485,12 +1362,11 @@ void video_output_unlock_frame(video_t *video)
 	if (!video)
 		return;
 
-	pthread_mutex_lock(&video->data_mutex);
+	if (++video->write_idx == video->info.cache_size)
+		video->write_idx = 0;
 
-	video->available_frames--;
+	os_atomic_inc_long(&video->queued_frames);
 	os_sem_post(video->update_semaphore);
-
-	pthread_mutex_unlock(&video->data_mutex);
 }
 
 uint64_t video_output_get_frame_time(const video_t *video)
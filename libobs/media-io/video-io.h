@@ -219,6 +219,40 @@ struct video_scale_info {
 	enum video_colorspace colorspace;
 };
 
+/* what happens to a frame for a queued input that has no room left */
+enum video_queue_policy {
+	/* the video thread waits for room, which holds up the other inputs
+	 * and shows up as skipped frames like for an input without a queue */
+	VIDEO_QUEUE_BLOCK,
+	/* the oldest frame in the queue is dropped */
+	VIDEO_QUEUE_DROP_OLDEST,
+	/* the new frame is dropped */
+	VIDEO_QUEUE_DROP_NEWEST,
+};
+
+struct video_queue_info {
+	/* 0 for the default, at most 8 */
+	size_t size;
+	enum video_queue_policy policy;
+};
+
+struct video_queue_stats {
+	size_t size;
+	size_t depth;
+	size_t max_depth;
+
+	/* frames passed to the callback and frames dropped by the policy */
+	uint64_t frames;
+	uint64_t dropped;
+
+	/* time the video thread waited for room in the queue */
+	uint64_t blocked_ns;
+
+	/* from queueing a frame to the end of its callback */
+	uint64_t avg_latency_ns;
+	uint64_t max_latency_ns;
+};
+
 EXPORT enum video_format video_format_from_fourcc(uint32_t fourcc);
 
 EXPORT bool video_format_get_parameters(enum video_colorspace color_space,
@@ -233,15 +267,44 @@ EXPORT bool video_format_get_parameters(enum video_colorspace color_space,
 EXPORT int video_output_open(video_t **video, struct video_output_info *info);
 EXPORT void video_output_close(video_t *video);
 
+/* Sets the number of frame conversions for connected inputs that may run at
+ * the same time, including the video thread itself.  0 or 1 (the default)
+ * converts everything on the video thread. */
+EXPORT void video_output_set_worker_threads(video_t *video, size_t count);
+
 EXPORT bool
 video_output_connect(video_t *video, const struct video_scale_info *conversion,
 		     void (*callback)(void *param, struct video_data *frame),
 		     void *param);
+
+/* Connects an input whose callback runs on a thread of its own, fed through a
+ * bounded queue.  Frames are not copied, their planes stay valid until the
+ * callback returns.  queue may be NULL for the defaults.  An input that
+ * disconnects from its own callback gets no more frames and is removed by
+ * the video thread. */
+EXPORT bool video_output_connect_queued(
+	video_t *video, const struct video_scale_info *conversion,
+	const struct video_queue_info *queue,
+	void (*callback)(void *param, struct video_data *frame), void *param);
+
+/* Connects one rendition of a set of encodings of the same video at
+ * decreasing sizes.  Renditions are scaled down from the conversion of the
+ * next larger input instead of the full frame, and are always queued. */
+EXPORT bool video_output_connect_rendition(
+	video_t *video, const struct video_scale_info *conversion,
+	const struct video_queue_info *queue,
+	void (*callback)(void *param, struct video_data *frame), void *param);
 EXPORT void video_output_disconnect(video_t *video,
 				    void (*callback)(void *param,
 						     struct video_data *frame),
 				    void *param);
 
+/* Returns false if the input is not connected or not queued.  Can be called
+ * from the callback of the input itself. */
+EXPORT bool video_output_get_queue_stats(
+	video_t *video, void (*callback)(void *param, struct video_data *frame),
+	void *param, struct video_queue_stats *stats);
+
 EXPORT bool video_output_active(const video_t *video);
 
 EXPORT const struct video_output_info *
@@ -249,6 +312,14 @@ video_output_get_info(const video_t *video);
 EXPORT bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 				    int count, uint64_t timestamp);
 EXPORT void video_output_unlock_frame(video_t *video);
+
+/* Queues a frame without copying its planes.  The planes must stay valid
+ * until release is called from the video thread, once every input has
+ * processed the frame.  Returns false (and never calls release) if the
+ * frame could not be queued, in which case it is counted as skipped. */
+EXPORT bool video_output_share_frame(video_t *video,
+				     const struct video_data *frame, int count,
+				     void (*release)(void *param), void *param);
 EXPORT uint64_t video_output_get_frame_time(const video_t *video);
 EXPORT void video_output_stop(video_t *video);
 EXPORT bool video_output_stopped(video_t *video);
@@ -18,6 +18,7 @@
 #include <inttypes.h>
 #include "obs-internal.h"
 #include "util/util_uint64.h"
+#include "media-io/audio-mix.h"
 
 struct ts_info {
 	uint64_t start;
@@ -26,6 +27,13 @@ struct ts_info {
 
 #define DEBUG_AUDIO 0
 #define MAX_BUFFERING_TICKS 45
+#define MAX_AUDIO_RENDER_THREADS 8
+
+#define BUFFERING_WINDOW_NS 5000000000ULL
+#define BUFFERING_MARGIN_TICKS 2
+#define MAX_SHRINK_WAIT_TICKS 24
+#define MAX_BUFFERING_HISTORY 64
+#define QUIET_THRESHOLD 0.001f
 
 static void push_audio_tree(obs_source_t *parent, obs_source_t *source, void *p)
 {
@@ -66,16 +74,9 @@ static inline void mix_audio(struct audio_output_data *mixes,
 
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
 		for (size_t ch = 0; ch < channels; ch++) {
-			register float *mix = mixes[mix_idx].data[ch];
-			register float *aud =
-				source->audio_output_buf[mix_idx][ch];
-			register float *end;
-
-			mix += start_point;
-			end = aud + total_floats;
-
-			while (aud < end)
-				*(mix++) += *(aud++);
+			audio_mix_add(mixes[mix_idx].data[ch] + start_point,
+				      source->audio_output_buf[mix_idx][ch],
+				      total_floats);
 		}
 	}
 }
@@ -230,6 +231,172 @@ static inline void discard_audio(struct obs_core_audio *audio,
 	source->audio_ts = ts->end;
 }
 
+static inline uint32_t buffering_ticks_to_ms(size_t sample_rate, int ticks)
+{
+	return (uint32_t)((size_t)ticks * AUDIO_OUTPUT_FRAMES * 1000 /
+			  sample_rate);
+}
+
+static void record_buffering_change(struct obs_core_audio *audio,
+				    size_t sample_rate, bool increase)
+{
+	struct obs_audio_buffering_info *info = &audio->buffering_info;
+	struct obs_audio_buffering_change change;
+
+	change.timestamp = os_gettime_ns();
+	change.buffering_ms = buffering_ticks_to_ms(
+		sample_rate, audio->total_buffering_ticks);
+
+	pthread_mutex_lock(&audio->buffering_mutex);
+
+	if (audio->buffering_history.size ==
+	    MAX_BUFFERING_HISTORY * sizeof(change))
+		circlebuf_pop_front(&audio->buffering_history, NULL,
+				    sizeof(change));
+	circlebuf_push_back(&audio->buffering_history, &change,
+			    sizeof(change));
+
+	info->buffering_ms = change.buffering_ms;
+	if (info->max_buffering_ms < change.buffering_ms)
+		info->max_buffering_ms = change.buffering_ms;
+	if (increase)
+		info->increases++;
+	else
+		info->decreases++;
+
+	pthread_mutex_unlock(&audio->buffering_mutex);
+}
+
+/* how far ahead of the current tick a source already has audio queued */
+static inline uint64_t source_slack(const struct obs_source *source,
+				    size_t sample_rate,
+				    const struct ts_info *ts)
+{
+	size_t frames = source->audio_input_buf[0].size / sizeof(float);
+	uint64_t data_end;
+
+	if (source->info.audio_render || !source->audio_ts)
+		return UINT64_MAX;
+	if (source->audio_pending)
+		return 0;
+
+	data_end = source->audio_ts + audio_frames_to_ns(sample_rate, frames);
+	return data_end > ts->end ? data_end - ts->end : 0;
+}
+
+/* once every source has had more audio queued than the buffering requires
+ * for a whole window, the surplus ticks are scheduled for removal */
+static void update_buffering_window(struct obs_core_audio *audio,
+				    size_t sample_rate,
+				    const struct ts_info *ts, uint64_t slack)
+{
+	uint64_t tick_ns = audio_frames_to_ns(sample_rate, AUDIO_OUTPUT_FRAMES);
+	uint64_t margin = tick_ns * BUFFERING_MARGIN_TICKS;
+	uint64_t excess;
+
+	if (audio->shrink_ticks)
+		return;
+
+	if (!audio->window_start) {
+		audio->window_start = ts->start;
+		audio->window_min_slack = slack;
+		return;
+	}
+
+	if (slack < audio->window_min_slack)
+		audio->window_min_slack = slack;
+	if (ts->start - audio->window_start < BUFFERING_WINDOW_NS)
+		return;
+
+	slack = audio->window_min_slack;
+	audio->window_start = 0;
+
+	pthread_mutex_lock(&audio->buffering_mutex);
+	audio->buffering_info.slack_ms =
+		slack / 1000000 > UINT32_MAX ? UINT32_MAX
+					     : (uint32_t)(slack / 1000000);
+	pthread_mutex_unlock(&audio->buffering_mutex);
+
+	if (!audio->total_buffering_ticks || slack <= margin)
+		return;
+
+	excess = (slack - margin) / tick_ns;
+	audio->shrink_ticks = excess < (uint64_t)audio->total_buffering_ticks
+				      ? (int)excess
+				      : audio->total_buffering_ticks;
+}
+
+static bool mix_is_quiet(struct audio_output_data *mixes, uint32_t mixers,
+			 size_t channels)
+{
+	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+		if ((mixers & (1 << mix_idx)) == 0)
+			continue;
+
+		for (size_t ch = 0; ch < channels; ch++) {
+			const float *data = mixes[mix_idx].data[ch];
+
+			for (size_t i = 0; i < AUDIO_OUTPUT_FRAMES; i++) {
+				if (data[i] > QUIET_THRESHOLD ||
+				    data[i] < -QUIET_THRESHOLD)
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/* drops the audio of the next buffered tick, preferably right after a quiet
+ * tick so that the cut cannot be heard.  the output skips the timestamps of
+ * the tick, which audio-io fills with silence to keep audio in sync with
+ * video */
+static void shrink_audio_buffering(struct obs_core_audio *audio,
+				   struct obs_core_data *data,
+				   struct audio_output_data *mixes,
+				   uint32_t mixers, size_t channels,
+				   size_t sample_rate)
+{
+	struct obs_source *source;
+	struct ts_info ts;
+
+	if (!mix_is_quiet(mixes, mixers, channels) &&
+	    ++audio->shrink_wait_ticks < MAX_SHRINK_WAIT_TICKS)
+		return;
+
+	if (audio->buffered_timestamps.size < sizeof(ts)) {
+		audio->shrink_ticks = 0;
+		return;
+	}
+
+	circlebuf_pop_front(&audio->buffered_timestamps, &ts, sizeof(ts));
+
+	pthread_mutex_lock(&data->audio_sources_mutex);
+
+	source = data->first_audio_source;
+	while (source) {
+		pthread_mutex_lock(&source->audio_buf_mutex);
+		discard_audio(audio, source, channels, sample_rate, &ts);
+		pthread_mutex_unlock(&source->audio_buf_mutex);
+
+		source = (struct obs_source *)source->next_audio_source;
+	}
+
+	pthread_mutex_unlock(&data->audio_sources_mutex);
+
+	audio->total_buffering_ticks--;
+	audio->shrink_ticks--;
+	audio->shrink_wait_ticks = 0;
+	record_buffering_change(audio, sample_rate, false);
+
+	blog(LOG_INFO,
+	     "removed %d milliseconds of audio buffering, total "
+	     "audio buffering is now %d milliseconds",
+	     (int)buffering_ticks_to_ms(sample_rate, 1),
+	     (int)buffering_ticks_to_ms(sample_rate,
+					audio->total_buffering_ticks));
+}
+
 static void add_audio_buffering(struct obs_core_audio *audio,
 				size_t sample_rate, struct ts_info *ts,
 				uint64_t min_ts, const char *buffering_name)
@@ -259,6 +426,12 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 		blog(LOG_WARNING, "Max audio buffering reached!");
 	}
 
+	/* slack measured so far no longer applies */
+	audio->window_start = 0;
+	audio->shrink_ticks = 0;
+	audio->shrink_wait_ticks = 0;
+	record_buffering_change(audio, sample_rate, true);
+
 	ms = ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
 	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 /
 		   sample_rate;
@@ -374,6 +547,144 @@ static inline const char *calc_min_ts(struct obs_core_data *data,
 	return buffering_name;
 }
 
+/* audio_render and audio_mix callbacks may read the output of other sources,
+ * so only sources without them can be rendered out of order */
+static inline bool renders_independently(const struct obs_source *source)
+{
+	return !source->info.audio_render && !source->info.audio_mix;
+}
+
+static inline void finish_render_work(struct obs_core_audio *audio)
+{
+	if (os_atomic_dec_long(&audio->pending_render_work) == 0)
+		os_event_signal(audio->render_done_event);
+}
+
+static void run_render_jobs(struct obs_core_audio *audio)
+{
+	size_t size = AUDIO_OUTPUT_FRAMES * sizeof(float);
+
+	for (;;) {
+		size_t idx =
+			(size_t)os_atomic_inc_long(&audio->next_render_job) - 1;
+		if (idx >= audio->render_jobs.num)
+			break;
+
+		obs_source_audio_render(audio->render_jobs.array[idx],
+					audio->render_mixers,
+					audio->render_channels,
+					audio->render_sample_rate, size);
+		finish_render_work(audio);
+	}
+}
+
+static void *audio_render_worker_thread(void *param)
+{
+	struct obs_core_audio *audio = param;
+
+	os_set_thread_name("libobs: audio render worker");
+
+	while (os_sem_wait(audio->render_semaphore) == 0) {
+		if (os_atomic_load_bool(&audio->render_workers_stop))
+			break;
+
+		run_render_jobs(audio);
+		finish_render_work(audio);
+	}
+
+	return NULL;
+}
+
+static void render_audio_sources(struct obs_core_audio *audio,
+				 uint32_t mixers, size_t channels,
+				 size_t sample_rate)
+{
+	size_t size = AUDIO_OUTPUT_FRAMES * sizeof(float);
+	long wake = 0;
+
+	da_resize(audio->render_jobs, 0);
+
+	if (audio->render_workers.num) {
+		for (size_t i = 0; i < audio->render_order.num; i++) {
+			obs_source_t *source = audio->render_order.array[i];
+			if (renders_independently(source))
+				da_push_back(audio->render_jobs, &source);
+		}
+	}
+
+	/* sources only touch their own buffers here, so the order in which
+	 * the jobs finish does not change the result */
+	if (audio->render_jobs.num > 1) {
+		wake = (long)audio->render_workers.num;
+		if (wake > (long)audio->render_jobs.num - 1)
+			wake = (long)audio->render_jobs.num - 1;
+
+		audio->render_mixers = mixers;
+		audio->render_channels = channels;
+		audio->render_sample_rate = sample_rate;
+		os_atomic_set_long(&audio->next_render_job, 0);
+		os_atomic_set_long(&audio->pending_render_work,
+				   (long)audio->render_jobs.num + wake);
+
+		for (long i = 0; i < wake; i++)
+			os_sem_post(audio->render_semaphore);
+
+		run_render_jobs(audio);
+		os_event_wait(audio->render_done_event);
+	}
+
+	for (size_t i = 0; i < audio->render_order.num; i++) {
+		obs_source_t *source = audio->render_order.array[i];
+
+		if (wake && renders_independently(source))
+			continue;
+
+		obs_source_audio_render(source, mixers, channels, sample_rate,
+					size);
+	}
+}
+
+bool obs_init_audio_render_workers(size_t count)
+{
+	struct obs_core_audio *audio = &obs->audio;
+
+	if (count > MAX_AUDIO_RENDER_THREADS)
+		count = MAX_AUDIO_RENDER_THREADS;
+
+	if (os_sem_init(&audio->render_semaphore, 0) != 0)
+		return false;
+	if (os_event_init(&audio->render_done_event, OS_EVENT_TYPE_AUTO) != 0)
+		return false;
+
+	/* the audio thread itself renders one of the sources */
+	for (size_t i = 1; i < count; i++) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, audio_render_worker_thread,
+				   audio) != 0)
+			return false;
+		da_push_back(audio->render_workers, &thread);
+	}
+
+	return true;
+}
+
+void obs_free_audio_render_workers(void)
+{
+	struct obs_core_audio *audio = &obs->audio;
+	void *thread_ret;
+
+	os_atomic_set_bool(&audio->render_workers_stop, true);
+	for (size_t i = 0; i < audio->render_workers.num; i++)
+		os_sem_post(audio->render_semaphore);
+	for (size_t i = 0; i < audio->render_workers.num; i++)
+		pthread_join(audio->render_workers.array[i], &thread_ret);
+
+	da_free(audio->render_workers);
+	da_free(audio->render_jobs);
+	os_sem_destroy(audio->render_semaphore);
+	os_event_destroy(audio->render_done_event);
+}
+
 static inline void release_audio_sources(struct obs_core_audio *audio)
 {
 	for (size_t i = 0; i < audio->render_order.num; i++)
@@ -390,7 +701,7 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	size_t sample_rate = audio_output_get_sample_rate(audio->audio);
 	size_t channels = audio_output_get_channels(audio->audio);
 	struct ts_info ts = {start_ts_in, end_ts_in};
-	size_t audio_size;
+	uint64_t min_slack = UINT64_MAX;
 	uint64_t min_ts;
 
 	da_resize(audio->render_order, 0);
@@ -400,8 +711,6 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	circlebuf_peek_front(&audio->buffered_timestamps, &ts, sizeof(ts));
 	min_ts = ts.start;
 
-	audio_size = AUDIO_OUTPUT_FRAMES * sizeof(float);
-
 #if DEBUG_AUDIO == 1
 	blog(LOG_DEBUG, "ts %llu-%llu", ts.start, ts.end);
 #endif
@@ -432,11 +741,7 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 
 	/* ------------------------------------------------ */
 	/* render audio data */
-	for (size_t i = 0; i < audio->render_order.num; i++) {
-		obs_source_t *source = audio->render_order.array[i];
-		obs_source_audio_render(source, mixers, channels, sample_rate,
-					audio_size);
-	}
+	render_audio_sources(audio, mixers, channels, sample_rate);
 
 	/* ------------------------------------------------ */
 	/* get minimum audio timestamp */
@@ -476,6 +781,11 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	source = data->first_audio_source;
 	while (source) {
 		pthread_mutex_lock(&source->audio_buf_mutex);
+
+		uint64_t slack = source_slack(source, sample_rate, &ts);
+		if (slack < min_slack)
+			min_slack = slack;
+
 		discard_audio(audio, source, channels, sample_rate, &ts);
 		pthread_mutex_unlock(&source->audio_buf_mutex);
 
@@ -490,6 +800,16 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 
 	circlebuf_pop_front(&audio->buffered_timestamps, NULL, sizeof(ts));
 
+	/* ------------------------------------------------ */
+	/* remove buffering that is no longer needed */
+	if (!audio->buffering_wait_ticks) {
+		update_buffering_window(audio, sample_rate, &ts, min_slack);
+
+		if (audio->shrink_ticks)
+			shrink_audio_buffering(audio, data, mixes, mixers,
+					       channels, sample_rate);
+	}
+
 	*out_ts = ts.start;
 
 	if (audio->buffering_wait_ticks) {
@@ -17,6 +17,7 @@
 
 #include "obs.h"
 #include "obs-avc.h"
+#include "obs-internal.h"
 #include "util/array-serializer.h"
 
 bool obs_avc_keyframe(const uint8_t *data, size_t size)
@@ -134,19 +135,22 @@ void obs_parse_avc_packet(struct encoder_packet *avc_packet,
 			  const struct encoder_packet *src)
 {
 	struct array_output_data output;
+	struct encoder_packet parsed = *src;
 	struct serializer s;
-	long ref = 1;
 
 	array_output_serializer_init(&s, &output);
-	*avc_packet = *src;
 
-	serialize(&s, &ref, sizeof(ref));
-	serialize_avc_data(&s, src->data, src->size, &avc_packet->keyframe,
-			   &avc_packet->priority);
+	serialize_avc_data(&s, src->data, src->size, &parsed.keyframe,
+			   &parsed.priority);
 
-	avc_packet->data = output.bytes.array + sizeof(ref);
-	avc_packet->size = output.bytes.num - sizeof(ref);
-	avc_packet->drop_priority = get_drop_priority(avc_packet->priority);
+	parsed.data = output.bytes.array;
+	parsed.size = output.bytes.num;
+	parsed.drop_priority = get_drop_priority(parsed.priority);
+
+	/* the parsed packet is released like any other packet, so its payload
+	 * has to come from the packet pool */
+	obs_encoder_packet_create_instance(avc_packet, &parsed);
+	array_output_serializer_free(&output);
 }
 
 static inline bool has_start_code(const uint8_t *data)
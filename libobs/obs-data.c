@@ -45,7 +45,15 @@ struct obs_data_item {
 struct obs_data {
 	volatile long ref;
 	char *json;
+	uint8_t *binary;
+	size_t binary_size;
 	struct obs_data_item *first_item;
+	struct obs_data_item *last_item;
+	size_t num_items;
+
+	/* name index, only created for objects with many items */
+	struct obs_data_item **index;
+	size_t index_size;
 };
 
 struct obs_data_array {
@@ -302,6 +310,111 @@ static struct obs_data_item *obs_data_item_create(const char *name,
 	return item;
 }
 
+/* ------------------------------------------------------------------------- */
+/* Name index
+ *
+ * Items are stored in a linked list sorted by name.  Once an object has
+ * enough items, a hash table (open addressing, linear probing) of the items
+ * is kept as well so that looking up a name doesn't have to walk the list.
+ * Items are reallocated when their data grows, so the table is updated
+ * whenever an item is reattached. */
+
+#define INDEX_MIN_ITEMS 32
+#define INDEX_MIN_SIZE 64
+
+static inline uint32_t hash_name(const char *name)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*name) {
+		hash ^= (uint8_t)*name++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/* returns the slot of the item with this name, or the empty slot it would be
+ * inserted at */
+static inline size_t index_find(struct obs_data *data, const char *name)
+{
+	size_t mask = data->index_size - 1;
+	size_t slot = hash_name(name) & mask;
+
+	while (data->index[slot] &&
+	       strcmp(get_item_name(data->index[slot]), name) != 0)
+		slot = (slot + 1) & mask;
+
+	return slot;
+}
+
+/* only compares pointers, the item may have already been reallocated */
+static inline size_t index_find_item(struct obs_data *data, const char *name,
+				     struct obs_data_item *item)
+{
+	size_t mask = data->index_size - 1;
+	size_t slot = hash_name(name) & mask;
+
+	while (data->index[slot] != item)
+		slot = (slot + 1) & mask;
+
+	return slot;
+}
+
+static void index_build(struct obs_data *data, size_t size)
+{
+	struct obs_data_item *item = data->first_item;
+
+	bfree(data->index);
+	data->index = bzalloc(size * sizeof(struct obs_data_item *));
+	data->index_size = size;
+
+	while (item) {
+		data->index[index_find(data, get_item_name(item))] = item;
+		item = item->next;
+	}
+}
+
+static void index_add(struct obs_data *data, struct obs_data_item *item)
+{
+	if (data->index) {
+		if (data->num_items * 2 > data->index_size)
+			index_build(data, data->index_size * 2);
+		else
+			data->index[index_find(data, get_item_name(item))] =
+				item;
+
+	} else if (data->num_items >= INDEX_MIN_ITEMS) {
+		size_t size = INDEX_MIN_SIZE;
+		while (size < data->num_items * 4)
+			size *= 2;
+		index_build(data, size);
+	}
+}
+
+static void index_remove(struct obs_data *data, struct obs_data_item *item)
+{
+	size_t mask = data->index_size - 1;
+	size_t slot = index_find_item(data, get_item_name(item), item);
+	size_t next = (slot + 1) & mask;
+
+	/* move back any following items that would no longer be reachable
+	 * from their home slot */
+	while (data->index[next]) {
+		const char *name = get_item_name(data->index[next]);
+		size_t home = hash_name(name) & mask;
+
+		if (((next - home) & mask) >= ((next - slot) & mask)) {
+			data->index[slot] = data->index[next];
+			slot = next;
+		}
+
+		next = (next + 1) & mask;
+	}
+
+	data->index[slot] = NULL;
+}
+
 static struct obs_data_item **get_item_prev_next(struct obs_data *data,
 						 struct obs_data_item *current)
 {
@@ -322,12 +435,29 @@ static struct obs_data_item **get_item_prev_next(struct obs_data *data,
 	return NULL;
 }
 
+/* returns the item that prev_next belongs to, or NULL for the first item */
+static inline struct obs_data_item *
+get_prev_item(struct obs_data *data, struct obs_data_item **prev_next)
+{
+	if (prev_next == &data->first_item)
+		return NULL;
+
+	return (struct obs_data_item *)((uint8_t *)prev_next -
+					offsetof(struct obs_data_item, next));
+}
+
 static inline void obs_data_item_detach(struct obs_data_item *item)
 {
-	struct obs_data_item **prev_next =
-		get_item_prev_next(item->parent, item);
+	struct obs_data *data = item->parent;
+	struct obs_data_item **prev_next = get_item_prev_next(data, item);
 
 	if (prev_next) {
+		if (data->last_item == item)
+			data->last_item = get_prev_item(data, prev_next);
+		if (data->index)
+			index_remove(data, item);
+
+		data->num_items--;
 		*prev_next = item->next;
 		item->next = NULL;
 	}
@@ -336,11 +466,20 @@ static inline void obs_data_item_detach(struct obs_data_item *item)
 static inline void obs_data_item_reattach(struct obs_data_item *old_ptr,
 					  struct obs_data_item *new_ptr)
 {
-	struct obs_data_item **prev_next =
-		get_item_prev_next(new_ptr->parent, old_ptr);
+	struct obs_data *data = new_ptr->parent;
+	struct obs_data_item **prev_next = get_item_prev_next(data, old_ptr);
 
-	if (prev_next)
+	if (prev_next) {
 		*prev_next = new_ptr;
+
+		if (data->last_item == old_ptr)
+			data->last_item = new_ptr;
+		if (data->index) {
+			const char *name = get_item_name(new_ptr);
+			data->index[index_find_item(data, name, old_ptr)] =
+				new_ptr;
+		}
+	}
 }
 
 static struct obs_data_item *
@@ -665,29 +804,31 @@ obs_data_t *obs_data_create_from_json_file(const char *json_file)
 	return data;
 }
 
-obs_data_t *obs_data_create_from_json_file_safe(const char *json_file,
-						const char *backup_ext)
+typedef obs_data_t *(*create_from_file_t)(const char *file);
+
+static obs_data_t *create_from_file_safe(const char *file,
+					 const char *backup_ext,
+					 create_from_file_t create,
+					 const char *func)
 {
-	obs_data_t *file_data = obs_data_create_from_json_file(json_file);
+	obs_data_t *file_data = create(file);
 	if (!file_data && backup_ext && *backup_ext) {
 		struct dstr backup_file = {0};
 
-		dstr_copy(&backup_file, json_file);
+		dstr_copy(&backup_file, file);
 		if (*backup_ext != '.')
 			dstr_cat(&backup_file, ".");
 		dstr_cat(&backup_file, backup_ext);
 
 		if (os_file_exists(backup_file.array)) {
 			blog(LOG_WARNING,
-			     "obs-data.c: "
-			     "[obs_data_create_from_json_file_safe] "
-			     "attempting backup file");
+			     "obs-data.c: [%s] attempting backup file", func);
 
 			/* delete current file if corrupt to prevent it from
 			 * being backed up again */
-			os_rename(backup_file.array, json_file);
+			os_rename(backup_file.array, file);
 
-			file_data = obs_data_create_from_json_file(json_file);
+			file_data = create(file);
 		}
 
 		dstr_free(&backup_file);
@@ -696,6 +837,14 @@ obs_data_t *obs_data_create_from_json_file_safe(const char *json_file,
 	return file_data;
 }
 
+obs_data_t *obs_data_create_from_json_file_safe(const char *json_file,
+						const char *backup_ext)
+{
+	return create_from_file_safe(json_file, backup_ext,
+				     obs_data_create_from_json_file,
+				     "obs_data_create_from_json_file_safe");
+}
+
 void obs_data_addref(obs_data_t *data)
 {
 	if (data)
@@ -706,6 +855,9 @@ static inline void obs_data_destroy(struct obs_data *data)
 {
 	struct obs_data_item *item = data->first_item;
 
+	bfree(data->index);
+	data->index = NULL;
+
 	while (item) {
 		struct obs_data_item *next = item->next;
 		obs_data_item_release(&item);
@@ -714,6 +866,7 @@ static inline void obs_data_destroy(struct obs_data *data)
 
 	/* NOTE: don't use bfree for json text, allocated by json */
 	free(data->json);
+	bfree(data->binary);
 	bfree(data);
 }
 
@@ -767,11 +920,512 @@ bool obs_data_save_json_safe(obs_data_t *data, const char *file,
 	return false;
 }
 
+/* ------------------------------------------------------------------------- */
+/* Binary format
+ *
+ * A compact alternative to JSON, for data that is only ever read back by
+ * libobs.  Everything is little endian:
+ *
+ *   header:  "OBSD", u32 version, u32 key table offset, u32 key count
+ *   root:    object
+ *   keys:    u32 length, name, null terminator (for each key)
+ *
+ *   object:  u32 size of the items in bytes, u32 item count, items
+ *   item:    u32 key index, u8 obs_data_type, value
+ *
+ *   string:  u32 length, string, null terminator
+ *   number:  u8 obs_data_number_type, i64 or double
+ *   boolean: u8
+ *   array:   u32 size of the objects in bytes, u32 object count, objects
+ *
+ * Each item name is stored only once, in the key table.  Strings are null
+ * terminated and everything is referenced by offset, so the data can be read
+ * in place (e.g. from a mapped file).  Like JSON, only user values are saved.
+ */
+
+#define BINARY_MAGIC "OBSD"
+#define BINARY_VERSION 1
+#define BINARY_HEADER_SIZE 16
+#define BINARY_MAX_DEPTH 1024
+
+struct binary_writer {
+	DARRAY(uint8_t) bytes;
+	DARRAY(const char *) keys;
+
+	/* key index + 1, 0 if empty */
+	uint32_t *key_table;
+	size_t key_table_size;
+};
+
+static inline void write_bytes(struct binary_writer *w, const void *data,
+			       size_t size)
+{
+	da_push_back_array(w->bytes, data, size);
+}
+
+static inline void write_u8(struct binary_writer *w, uint8_t val)
+{
+	da_push_back(w->bytes, &val);
+}
+
+static inline void put_l32(uint8_t *p, uint32_t val)
+{
+	p[0] = (uint8_t)val;
+	p[1] = (uint8_t)(val >> 8);
+	p[2] = (uint8_t)(val >> 16);
+	p[3] = (uint8_t)(val >> 24);
+}
+
+static inline void write_l32(struct binary_writer *w, uint32_t val)
+{
+	uint8_t buf[4];
+	put_l32(buf, val);
+	write_bytes(w, buf, sizeof(buf));
+}
+
+static inline void write_l64(struct binary_writer *w, uint64_t val)
+{
+	write_l32(w, (uint32_t)val);
+	write_l32(w, (uint32_t)(val >> 32));
+}
+
+static void grow_key_table(struct binary_writer *w)
+{
+	size_t size = w->key_table_size ? w->key_table_size * 2 : 256;
+	size_t mask = size - 1;
+
+	bfree(w->key_table);
+	w->key_table = bzalloc(size * sizeof(uint32_t));
+	w->key_table_size = size;
+
+	for (size_t i = 0; i < w->keys.num; i++) {
+		size_t slot = hash_name(w->keys.array[i]) & mask;
+		while (w->key_table[slot])
+			slot = (slot + 1) & mask;
+		w->key_table[slot] = (uint32_t)i + 1;
+	}
+}
+
+static uint32_t get_key_index(struct binary_writer *w, const char *name)
+{
+	size_t mask;
+	size_t slot;
+	uint32_t idx;
+
+	if (w->keys.num * 2 >= w->key_table_size)
+		grow_key_table(w);
+
+	mask = w->key_table_size - 1;
+	slot = hash_name(name) & mask;
+
+	while (w->key_table[slot]) {
+		idx = w->key_table[slot] - 1;
+		if (strcmp(w->keys.array[idx], name) == 0)
+			return idx;
+		slot = (slot + 1) & mask;
+	}
+
+	idx = (uint32_t)w->keys.num;
+	da_push_back(w->keys, &name);
+	w->key_table[slot] = idx + 1;
+	return idx;
+}
+
+static inline void write_string(struct binary_writer *w, const char *str)
+{
+	size_t len = str ? strlen(str) : 0;
+
+	write_l32(w, (uint32_t)len);
+	write_bytes(w, str ? str : "", len + 1);
+}
+
+static void write_object(struct binary_writer *w, struct obs_data *data);
+
+static void write_array(struct binary_writer *w, struct obs_data_array *array)
+{
+	size_t start = w->bytes.num;
+	size_t count = array ? array->objects.num : 0;
+
+	write_l32(w, 0);
+	write_l32(w, (uint32_t)count);
+
+	for (size_t i = 0; i < count; i++)
+		write_object(w, array->objects.array[i]);
+
+	put_l32(w->bytes.array + start, (uint32_t)(w->bytes.num - start - 8));
+}
+
+static void write_item(struct binary_writer *w, struct obs_data_item *item)
+{
+	write_l32(w, get_key_index(w, get_item_name(item)));
+	write_u8(w, (uint8_t)item->type);
+
+	if (item->type == OBS_DATA_STRING) {
+		write_string(w, get_item_data(item));
+
+	} else if (item->type == OBS_DATA_NUMBER) {
+		struct obs_data_number *num = get_item_data(item);
+		uint64_t val;
+
+		if (num->type == OBS_DATA_NUM_INT)
+			val = (uint64_t)num->int_val;
+		else
+			memcpy(&val, &num->double_val, sizeof(val));
+
+		write_u8(w, (uint8_t)num->type);
+		write_l64(w, val);
+
+	} else if (item->type == OBS_DATA_BOOLEAN) {
+		write_u8(w, *(bool *)get_item_data(item) ? 1 : 0);
+
+	} else if (item->type == OBS_DATA_OBJECT) {
+		write_object(w, get_item_obj(item));
+
+	} else if (item->type == OBS_DATA_ARRAY) {
+		write_array(w, get_item_array(item));
+	}
+}
+
+static void write_object(struct binary_writer *w, struct obs_data *data)
+{
+	size_t start = w->bytes.num;
+	uint32_t count = 0;
+
+	write_l32(w, 0);
+	write_l32(w, 0);
+
+	for (struct obs_data_item *item = data ? data->first_item : NULL; item;
+	     item = item->next) {
+		if (!obs_data_item_has_user_value(item))
+			continue;
+
+		write_item(w, item);
+		count++;
+	}
+
+	put_l32(w->bytes.array + start, (uint32_t)(w->bytes.num - start - 8));
+	put_l32(w->bytes.array + start + 4, count);
+}
+
+static void write_binary(struct binary_writer *w, struct obs_data *data)
+{
+	write_bytes(w, BINARY_MAGIC, 4);
+	write_l32(w, BINARY_VERSION);
+	write_l32(w, 0);
+	write_l32(w, 0);
+
+	write_object(w, data);
+
+	put_l32(w->bytes.array + 8, (uint32_t)w->bytes.num);
+	put_l32(w->bytes.array + 12, (uint32_t)w->keys.num);
+
+	for (size_t i = 0; i < w->keys.num; i++)
+		write_string(w, w->keys.array[i]);
+}
+
+struct binary_reader {
+	const uint8_t *data;
+	size_t size;
+	size_t pos;
+	const char **keys;
+	uint32_t num_keys;
+	bool error;
+};
+
+static inline const uint8_t *read_bytes(struct binary_reader *r, size_t size)
+{
+	const uint8_t *p;
+
+	if (r->error || size > r->size - r->pos) {
+		r->error = true;
+		return NULL;
+	}
+
+	p = r->data + r->pos;
+	r->pos += size;
+	return p;
+}
+
+static inline uint8_t read_u8(struct binary_reader *r)
+{
+	const uint8_t *p = read_bytes(r, 1);
+	return p ? *p : 0;
+}
+
+static inline uint32_t read_l32(struct binary_reader *r)
+{
+	const uint8_t *p = read_bytes(r, 4);
+	if (!p)
+		return 0;
+
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+	       ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t read_l64(struct binary_reader *r)
+{
+	uint64_t low = read_l32(r);
+	return low | ((uint64_t)read_l32(r) << 32);
+}
+
+static const char *read_string(struct binary_reader *r)
+{
+	uint32_t len = read_l32(r);
+	const char *str = (const char *)read_bytes(r, (size_t)len + 1);
+
+	if (str && str[len] != 0) {
+		r->error = true;
+		return NULL;
+	}
+
+	return str;
+}
+
+static void read_object(struct binary_reader *r, obs_data_t *data, int depth);
+
+static obs_data_array_t *read_array(struct binary_reader *r, int depth)
+{
+	uint32_t size = read_l32(r);
+	uint32_t count = read_l32(r);
+	size_t end = r->pos + size;
+	obs_data_array_t *array;
+
+	if (r->error || size > r->size - r->pos) {
+		r->error = true;
+		return NULL;
+	}
+
+	array = obs_data_array_create();
+
+	for (uint32_t i = 0; i < count && !r->error; i++) {
+		obs_data_t *obj = obs_data_create();
+		read_object(r, obj, depth + 1);
+		obs_data_array_push_back(array, obj);
+		obs_data_release(obj);
+	}
+
+	if (r->pos != end)
+		r->error = true;
+
+	return array;
+}
+
+static void read_item(struct binary_reader *r, obs_data_t *data, int depth)
+{
+	uint32_t key = read_l32(r);
+	uint8_t type = read_u8(r);
+	const char *name;
+
+	if (r->error || key >= r->num_keys) {
+		r->error = true;
+		return;
+	}
+
+	name = r->keys[key];
+
+	if (type == OBS_DATA_STRING) {
+		const char *str = read_string(r);
+		if (str)
+			obs_data_set_string(data, name, str);
+
+	} else if (type == OBS_DATA_NUMBER) {
+		uint8_t num_type = read_u8(r);
+		uint64_t val = read_l64(r);
+
+		if (num_type == OBS_DATA_NUM_INT) {
+			obs_data_set_int(data, name, (long long)val);
+		} else if (num_type == OBS_DATA_NUM_DOUBLE) {
+			double d;
+			memcpy(&d, &val, sizeof(d));
+			obs_data_set_double(data, name, d);
+		} else {
+			r->error = true;
+		}
+
+	} else if (type == OBS_DATA_BOOLEAN) {
+		obs_data_set_bool(data, name, read_u8(r) != 0);
+
+	} else if (type == OBS_DATA_OBJECT) {
+		obs_data_t *obj = obs_data_create();
+		read_object(r, obj, depth + 1);
+		obs_data_set_obj(data, name, obj);
+		obs_data_release(obj);
+
+	} else if (type == OBS_DATA_ARRAY) {
+		obs_data_array_t *array = read_array(r, depth);
+		if (array) {
+			obs_data_set_array(data, name, array);
+			obs_data_array_release(array);
+		}
+
+	} else {
+		r->error = true;
+	}
+}
+
+static void read_object(struct binary_reader *r, obs_data_t *data, int depth)
+{
+	uint32_t size = read_l32(r);
+	uint32_t count = read_l32(r);
+	size_t end = r->pos + size;
+
+	if (r->error || depth > BINARY_MAX_DEPTH ||
+	    size > r->size - r->pos) {
+		r->error = true;
+		return;
+	}
+
+	for (uint32_t i = 0; i < count && !r->error; i++)
+		read_item(r, data, depth);
+
+	if (r->pos != end)
+		r->error = true;
+}
+
+static bool read_keys(struct binary_reader *r)
+{
+	uint32_t offset;
+
+	r->pos = 8;
+	offset = read_l32(r);
+	r->num_keys = read_l32(r);
+
+	if (r->error || offset < BINARY_HEADER_SIZE || offset > r->size ||
+	    r->num_keys > (r->size - offset) / 5)
+		return false;
+
+	r->keys = bmalloc(sizeof(const char *) * r->num_keys);
+	r->pos = offset;
+
+	for (uint32_t i = 0; i < r->num_keys; i++)
+		r->keys[i] = read_string(r);
+
+	r->pos = BINARY_HEADER_SIZE;
+	return !r->error;
+}
+
+obs_data_t *obs_data_create_from_binary(const void *data, size_t size)
+{
+	struct binary_reader r = {data, size};
+	obs_data_t *obj = NULL;
+
+	if (!data || size < BINARY_HEADER_SIZE ||
+	    memcmp(data, BINARY_MAGIC, 4) != 0) {
+		blog(LOG_ERROR, "obs-data.c: [obs_data_create_from_binary] "
+				"Not obs_data binary data");
+		return NULL;
+	}
+
+	r.pos = 4;
+	if (read_l32(&r) != BINARY_VERSION) {
+		blog(LOG_ERROR, "obs-data.c: [obs_data_create_from_binary] "
+				"Unsupported version");
+		return NULL;
+	}
+
+	if (read_keys(&r)) {
+		obj = obs_data_create();
+		read_object(&r, obj, 0);
+	}
+
+	if (r.error) {
+		blog(LOG_ERROR, "obs-data.c: [obs_data_create_from_binary] "
+				"Corrupt binary data");
+		obs_data_release(obj);
+		obj = NULL;
+	}
+
+	bfree(r.keys);
+	return obj;
+}
+
+obs_data_t *obs_data_create_from_binary_file(const char *binary_file)
+{
+	FILE *f = os_fopen(binary_file, "rb");
+	obs_data_t *data = NULL;
+	uint8_t *file_data;
+	int64_t size;
+
+	if (!f)
+		return NULL;
+
+	size = os_fgetsize(f);
+	if (size > 0 && (uint64_t)size <= SIZE_MAX) {
+		file_data = bmalloc((size_t)size);
+		if (fread(file_data, 1, (size_t)size, f) == (size_t)size)
+			data = obs_data_create_from_binary(file_data,
+							   (size_t)size);
+		bfree(file_data);
+	}
+
+	fclose(f);
+	return data;
+}
+
+obs_data_t *obs_data_create_from_binary_file_safe(const char *binary_file,
+						  const char *backup_ext)
+{
+	return create_from_file_safe(binary_file, backup_ext,
+				     obs_data_create_from_binary_file,
+				     "obs_data_create_from_binary_file_safe");
+}
+
+const void *obs_data_get_binary(obs_data_t *data, size_t *size)
+{
+	struct binary_writer w = {0};
+
+	if (size)
+		*size = 0;
+	if (!data)
+		return NULL;
+
+	bfree(data->binary);
+
+	write_binary(&w, data);
+	da_free(w.keys);
+	bfree(w.key_table);
+
+	data->binary = w.bytes.array;
+	data->binary_size = w.bytes.num;
+
+	if (size)
+		*size = data->binary_size;
+	return data->binary;
+}
+
+bool obs_data_save_binary(obs_data_t *data, const char *file)
+{
+	size_t size;
+	const char *binary = obs_data_get_binary(data, &size);
+
+	if (binary && size)
+		return os_quick_write_utf8_file(file, binary, size, false);
+
+	return false;
+}
+
+bool obs_data_save_binary_safe(obs_data_t *data, const char *file,
+			       const char *temp_ext, const char *backup_ext)
+{
+	size_t size;
+	const char *binary = obs_data_get_binary(data, &size);
+
+	if (binary && size) {
+		return os_quick_write_utf8_file_safe(file, binary, size, false,
+						     temp_ext, backup_ext);
+	}
+
+	return false;
+}
+
 static struct obs_data_item *get_item(struct obs_data *data, const char *name)
 {
 	if (!data)
 		return NULL;
 
+	if (data->index)
+		return data->index[index_find(data, name)];
+
 	struct obs_data_item *item = data->first_item;
 
 	while (item) {
@@ -784,17 +1438,18 @@ static struct obs_data_item *get_item(struct obs_data *data, const char *name)
 	return NULL;
 }
 
-static void set_item_data(struct obs_data *data, struct obs_data_item **item,
-			  const char *name, const void *ptr, size_t size,
-			  enum obs_data_type type, bool default_data,
-			  bool autoselect_data)
+static void insert_item(struct obs_data *data, struct obs_data_item *new_item)
 {
-	obs_data_item_t *new_item = NULL;
+	const char *name = get_item_name(new_item);
 
-	if ((!item || (item && !*item)) && data) {
-		new_item = obs_data_item_create(name, ptr, size, type,
-						default_data, autoselect_data);
+	new_item->parent = data;
+
+	/* items are usually added in order, e.g. when loading saved data */
+	if (data->last_item &&
+	    strcmp(get_item_name(data->last_item), name) < 0) {
+		data->last_item->next = new_item;
 
+	} else {
 		obs_data_item_t *prev = obs_data_first(data);
 		obs_data_item_t *next = obs_data_first(data);
 		obs_data_item_next(&next);
@@ -804,7 +1459,6 @@ static void set_item_data(struct obs_data *data, struct obs_data_item **item,
 				break;
 		}
 
-		new_item->parent = data;
 		if (prev && strcmp(get_item_name(prev), name) < 0) {
 			prev->next = new_item;
 			new_item->next = next;
@@ -819,6 +1473,26 @@ static void set_item_data(struct obs_data *data, struct obs_data_item **item,
 
 		obs_data_item_release(&prev);
 		obs_data_item_release(&next);
+	}
+
+	if (!new_item->next)
+		data->last_item = new_item;
+
+	data->num_items++;
+	index_add(data, new_item);
+}
+
+static void set_item_data(struct obs_data *data, struct obs_data_item **item,
+			  const char *name, const void *ptr, size_t size,
+			  enum obs_data_type type, bool default_data,
+			  bool autoselect_data)
+{
+	obs_data_item_t *new_item = NULL;
+
+	if ((!item || (item && !*item)) && data) {
+		new_item = obs_data_item_create(name, ptr, size, type,
+						default_data, autoselect_data);
+		insert_item(data, new_item);
 
 	} else if (default_data) {
 		obs_data_item_set_default_data(item, ptr, size, type);
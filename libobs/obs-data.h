@@ -75,6 +75,22 @@ EXPORT bool obs_data_save_json_safe(obs_data_t *data, const char *file,
 				    const char *temp_ext,
 				    const char *backup_ext);
 
+/*
+ * Compact binary format, much faster to save and load than JSON.  It is only
+ * meant to be read back by libobs, JSON remains the interchange format.
+ */
+EXPORT obs_data_t *obs_data_create_from_binary(const void *data, size_t size);
+EXPORT obs_data_t *obs_data_create_from_binary_file(const char *binary_file);
+EXPORT obs_data_t *
+obs_data_create_from_binary_file_safe(const char *binary_file,
+				      const char *backup_ext);
+
+EXPORT const void *obs_data_get_binary(obs_data_t *data, size_t *size);
+EXPORT bool obs_data_save_binary(obs_data_t *data, const char *file);
+EXPORT bool obs_data_save_binary_safe(obs_data_t *data, const char *file,
+				      const char *temp_ext,
+				      const char *backup_ext);
+
 EXPORT void obs_data_apply(obs_data_t *target, obs_data_t *apply_data);
 
 EXPORT void obs_data_erase(obs_data_t *data, const char *name);
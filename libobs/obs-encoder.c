@@ -15,8 +15,11 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include <inttypes.h>
+
 #include "obs.h"
 #include "obs-internal.h"
+#include "obs-frame-skip.h"
 #include "util/util_uint64.h"
 
 #define encoder_active(encoder) os_atomic_load_bool(&encoder->active)
@@ -211,7 +214,10 @@ static void add_connection(struct obs_encoder *encoder)
 		if (gpu_encode_available(encoder)) {
 			start_gpu_encode(encoder);
 		} else {
-			start_raw_video(encoder->media, &info, receive_video,
+			encoder->last_frame_ts = 0;
+			start_raw_video(encoder->media, &info,
+					&encoder->frame_queue,
+					encoder->rendition, receive_video,
 					encoder);
 		}
 	}
@@ -219,6 +225,31 @@ static void add_connection(struct obs_encoder *encoder)
 	set_encoder_active(encoder, true);
 }
 
+static void log_frame_stats(struct obs_encoder *encoder)
+{
+	struct video_queue_stats stats;
+
+	if (!video_output_get_queue_stats(encoder->media, receive_video,
+					  encoder, &stats))
+		return;
+
+	blog(LOG_INFO,
+	     "encoder '%s': frame queue: %" PRIu64 " frames, %" PRIu64
+	     " dropped, max depth %d/%d, latency avg %.2f ms, "
+	     "max %.2f ms, blocked %.2f ms",
+	     obs_encoder_get_name(encoder), stats.frames, stats.dropped,
+	     (int)stats.max_depth, (int)stats.size,
+	     (double)stats.avg_latency_ns / 1000000.0,
+	     (double)stats.max_latency_ns / 1000000.0,
+	     (double)stats.blocked_ns / 1000000.0);
+
+	if (encoder->skipped_frames)
+		blog(LOG_INFO,
+		     "encoder '%s': %" PRIu32 " frames skipped for "
+		     "congested outputs",
+		     obs_encoder_get_name(encoder), encoder->skipped_frames);
+}
+
 static void remove_connection(struct obs_encoder *encoder, bool shutdown)
 {
 	if (encoder->info.type == OBS_ENCODER_AUDIO) {
@@ -228,6 +259,7 @@ static void remove_connection(struct obs_encoder *encoder, bool shutdown)
 		if (gpu_encode_available(encoder)) {
 			stop_gpu_encode(encoder);
 		} else {
+			log_frame_stats(encoder);
 			stop_raw_video(encoder->media, receive_video, encoder);
 		}
 	}
@@ -579,6 +611,10 @@ static inline void obs_encoder_start_internal(
 		pause_reset(&encoder->pause);
 
 		encoder->cur_pts = 0;
+		encoder->skip_count = 0;
+		encoder->skipped_frames = 0;
+		os_atomic_set_long(&encoder->queued_frames, 0);
+		os_atomic_set_long(&encoder->frames_in_flight, 0);
 		add_connection(encoder);
 	}
 }
@@ -698,6 +734,86 @@ void obs_encoder_set_scaled_size(obs_encoder_t *encoder, uint32_t width,
 	encoder->scaled_height = height;
 }
 
+void obs_encoder_set_rendition(obs_encoder_t *encoder, bool rendition)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_set_rendition"))
+		return;
+	if (encoder->info.type != OBS_ENCODER_VIDEO) {
+		blog(LOG_WARNING,
+		     "obs_encoder_set_rendition: "
+		     "encoder '%s' is not a video encoder",
+		     obs_encoder_get_name(encoder));
+		return;
+	}
+	if (encoder_active(encoder)) {
+		blog(LOG_WARNING,
+		     "encoder '%s': Cannot change the rendition "
+		     "mode while the encoder is active",
+		     obs_encoder_get_name(encoder));
+		return;
+	}
+
+	encoder->rendition = rendition;
+}
+
+bool obs_encoder_is_rendition(const obs_encoder_t *encoder)
+{
+	return obs_encoder_valid(encoder, "obs_encoder_is_rendition")
+		       ? encoder->rendition
+		       : false;
+}
+
+void obs_encoder_set_frame_queue(obs_encoder_t *encoder,
+				 const struct video_queue_info *queue)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_set_frame_queue"))
+		return;
+	if (!obs_ptr_valid(queue, "obs_encoder_set_frame_queue"))
+		return;
+	if (encoder->info.type != OBS_ENCODER_VIDEO) {
+		blog(LOG_WARNING,
+		     "obs_encoder_set_frame_queue: "
+		     "encoder '%s' is not a video encoder",
+		     obs_encoder_get_name(encoder));
+		return;
+	}
+	if (encoder_active(encoder)) {
+		blog(LOG_WARNING,
+		     "encoder '%s': Cannot change the frame "
+		     "queue while the encoder is active",
+		     obs_encoder_get_name(encoder));
+		return;
+	}
+
+	encoder->frame_queue = *queue;
+}
+
+bool obs_encoder_get_frame_queue_stats(const obs_encoder_t *encoder,
+				       struct video_queue_stats *stats)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_frame_queue_stats"))
+		return false;
+	if (!obs_ptr_valid(stats, "obs_encoder_get_frame_queue_stats"))
+		return false;
+	if (encoder->info.type != OBS_ENCODER_VIDEO || !encoder->media)
+		return false;
+
+	return video_output_get_queue_stats(encoder->media, receive_video,
+					    (void *)encoder, stats);
+}
+
+uint32_t obs_encoder_get_frames_in_flight(const obs_encoder_t *encoder)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_frames_in_flight"))
+		return 0;
+	if (encoder->info.type != OBS_ENCODER_VIDEO)
+		return 0;
+
+	return frame_skip_in_flight(
+		os_atomic_load_long(&encoder->queued_frames),
+		os_atomic_load_long(&encoder->frames_in_flight));
+}
+
 bool obs_encoder_scaling_enabled(const obs_encoder_t *encoder)
 {
 	if (!obs_encoder_valid(encoder, "obs_encoder_scaling_enabled"))
@@ -851,12 +967,143 @@ static inline bool get_sei(const struct obs_encoder *encoder, uint8_t **sei,
 	return false;
 }
 
+/* Packet payloads are carved from power-of-two size classes.  When the last
+ * reference to a payload is released it goes back onto the free list of its
+ * class, so once the lists have warmed up encoding no longer allocates. */
+
+#define PACKET_POOL_MIN_SHIFT 8 /* 256 bytes */
+#define PACKET_POOL_CLASSES 15  /* up to 4 MiB, larger ones are not pooled */
+#define PACKET_POOL_MAX_FREE 64 /* per class */
+#define PACKET_POOL_UNPOOLED ((size_t)-1)
+
+struct packet_block {
+	struct packet_block *next;
+	size_t class_idx;
+	volatile long refs;
+};
+
+struct packet_pool_class {
+	struct packet_block *free;
+	size_t num_free;
+};
+
+static pthread_mutex_t packet_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct packet_pool_class packet_pool[PACKET_POOL_CLASSES];
+static bool packet_pool_active = false;
+
+static const char *packet_heap_allocs_name = "encoder packets: heap allocs";
+static const char *packet_pool_reuses_name = "encoder packets: pool reuses";
+
+static inline size_t packet_class(size_t size)
+{
+	size_t class_size = (size_t)1 << PACKET_POOL_MIN_SHIFT;
+
+	for (size_t i = 0; i < PACKET_POOL_CLASSES; i++) {
+		if (size <= class_size)
+			return i;
+		class_size <<= 1;
+	}
+
+	return PACKET_POOL_UNPOOLED;
+}
+
+static inline struct packet_block *get_packet_block(const void *data)
+{
+	return ((struct packet_block *)data) - 1;
+}
+
+static uint8_t *alloc_packet_data(size_t size)
+{
+	size_t class_idx = packet_class(size);
+	struct packet_block *block = NULL;
+
+	if (class_idx != PACKET_POOL_UNPOOLED) {
+		struct packet_pool_class *pc = &packet_pool[class_idx];
+
+		pthread_mutex_lock(&packet_pool_mutex);
+		if (pc->free) {
+			block = pc->free;
+			pc->free = block->next;
+			pc->num_free--;
+		}
+		pthread_mutex_unlock(&packet_pool_mutex);
+
+		if (!block)
+			size = (size_t)1 << (class_idx + PACKET_POOL_MIN_SHIFT);
+	}
+
+	if (block) {
+		profile_count(packet_pool_reuses_name, 1);
+	} else {
+		block = bmalloc(sizeof(*block) + size);
+		block->class_idx = class_idx;
+		profile_count(packet_heap_allocs_name, 1);
+	}
+
+	block->next = NULL;
+	block->refs = 1;
+	return (uint8_t *)(block + 1);
+}
+
+static void free_packet_block(struct packet_block *block)
+{
+	if (block->class_idx != PACKET_POOL_UNPOOLED) {
+		struct packet_pool_class *pc = &packet_pool[block->class_idx];
+
+		pthread_mutex_lock(&packet_pool_mutex);
+		if (packet_pool_active && pc->num_free < PACKET_POOL_MAX_FREE) {
+			block->next = pc->free;
+			pc->free = block;
+			pc->num_free++;
+			block = NULL;
+		}
+		pthread_mutex_unlock(&packet_pool_mutex);
+	}
+
+	bfree(block);
+}
+
+void obs_init_encoder_packet_pool(void)
+{
+	pthread_mutex_lock(&packet_pool_mutex);
+	packet_pool_active = true;
+	pthread_mutex_unlock(&packet_pool_mutex);
+}
+
+/* packets still referenced after this are freed when they are released */
+void obs_free_encoder_packet_pool(void)
+{
+	struct packet_block *blocks = NULL;
+
+	pthread_mutex_lock(&packet_pool_mutex);
+	packet_pool_active = false;
+	for (size_t i = 0; i < PACKET_POOL_CLASSES; i++) {
+		struct packet_block *block = packet_pool[i].free;
+
+		while (block) {
+			struct packet_block *next = block->next;
+			block->next = blocks;
+			blocks = block;
+			block = next;
+		}
+
+		packet_pool[i].free = NULL;
+		packet_pool[i].num_free = 0;
+	}
+	pthread_mutex_unlock(&packet_pool_mutex);
+
+	while (blocks) {
+		struct packet_block *next = blocks->next;
+		bfree(blocks);
+		blocks = next;
+	}
+}
+
 static void send_first_video_packet(struct obs_encoder *encoder,
 				    struct encoder_callback *cb,
 				    struct encoder_packet *packet)
 {
 	struct encoder_packet first_packet;
-	DARRAY(uint8_t) data;
 	uint8_t *sei;
 	size_t size;
 
@@ -864,25 +1111,22 @@ static void send_first_video_packet(struct obs_encoder *encoder,
 	if (!packet->keyframe)
 		return;
 
-	da_init(data);
-
 	if (!get_sei(encoder, &sei, &size) || !sei || !size) {
 		cb->new_packet(cb->param, packet);
 		cb->sent_first_packet = true;
 		return;
 	}
 
-	da_push_back_array(data, sei, size);
-	da_push_back_array(data, packet->data, packet->size);
-
 	first_packet = *packet;
-	first_packet.data = data.array;
-	first_packet.size = data.num;
+	first_packet.size = size + packet->size;
+	first_packet.data = alloc_packet_data(first_packet.size);
+	memcpy(first_packet.data, sei, size);
+	memcpy(first_packet.data + size, packet->data, packet->size);
 
 	cb->new_packet(cb->param, &first_packet);
 	cb->sent_first_packet = true;
 
-	da_free(data);
+	obs_encoder_packet_release(&first_packet);
 }
 
 static inline void send_packet(struct obs_encoder *encoder,
@@ -945,15 +1189,24 @@ void send_off_encoder_packet(obs_encoder_t *encoder, bool success,
 		pkt->sys_dts_usec += encoder->pause.ts_offset / 1000;
 		pthread_mutex_unlock(&encoder->pause.mutex);
 
+		/* the encoder owns pkt->data, so copy it into the pool once;
+		 * every callback can then keep it by reference */
+		struct encoder_packet shared;
+		obs_encoder_packet_create_instance(&shared, pkt);
+
 		pthread_mutex_lock(&encoder->callbacks_mutex);
 
 		for (size_t i = encoder->callbacks.num; i > 0; i--) {
 			struct encoder_callback *cb;
+			struct encoder_packet out = shared;
+
 			cb = encoder->callbacks.array + (i - 1);
-			send_packet(encoder, cb, pkt);
+			send_packet(encoder, cb, &out);
 		}
 
 		pthread_mutex_unlock(&encoder->callbacks_mutex);
+
+		obs_encoder_packet_release(&shared);
 	}
 }
 
@@ -978,6 +1231,13 @@ bool do_encode(struct obs_encoder *encoder, struct encoder_frame *frame)
 	success = encoder->info.encode(encoder->context.data, frame, &pkt,
 				       &received);
 	profile_end(encoder->profile_encoder_encode_name);
+
+	if (success && encoder->info.type == OBS_ENCODER_VIDEO) {
+		os_atomic_inc_long(&encoder->frames_in_flight);
+		if (received)
+			os_atomic_dec_long(&encoder->frames_in_flight);
+	}
+
 	send_off_encoder_packet(encoder, success, received, &pkt);
 
 	profile_end(do_encode_name);
@@ -1015,6 +1275,60 @@ bool video_pause_check(struct pause_data *pause, uint64_t timestamp)
 	return ignore_frame;
 }
 
+/* frames dropped by the frame queue or skipped leave a gap in the timestamps,
+ * which has to be kept in the pts to stay in sync with audio */
+static inline int64_t get_frame_gap(struct obs_encoder *encoder, uint64_t ts)
+{
+	return frame_skip_gap(&encoder->last_frame_ts, ts,
+			      video_output_get_frame_time(encoder->media));
+}
+
+static long get_frame_skip(struct obs_encoder *encoder)
+{
+	long interval = 0;
+	bool first = true;
+
+	pthread_mutex_lock(&encoder->outputs_mutex);
+	for (size_t i = 0; i < encoder->outputs.num; i++) {
+		struct obs_output *output = encoder->outputs.array[i];
+		long skip;
+
+		if (!os_atomic_load_bool(&output->data_active))
+			continue;
+
+		skip = os_atomic_load_long(&output->frame_skip);
+		interval = frame_skip_merge(interval, skip, first);
+		first = false;
+	}
+	pthread_mutex_unlock(&encoder->outputs_mutex);
+
+	return interval;
+}
+
+static bool skip_frame(struct obs_encoder *encoder)
+{
+	long interval;
+
+	if (!encoder->start_ts)
+		return false;
+
+	interval = get_frame_skip(encoder);
+	if (!frame_skip_check(&encoder->skip_count, interval))
+		return false;
+
+	encoder->skipped_frames++;
+	return true;
+}
+
+static inline void update_queued_frames(struct obs_encoder *encoder)
+{
+	struct video_queue_stats stats;
+
+	if (video_output_get_queue_stats(encoder->media, receive_video,
+					 encoder, &stats))
+		os_atomic_set_long(&encoder->queued_frames, (long)stats.depth);
+}
+
 static const char *receive_video_name = "receive_video";
 static void receive_video(void *param, struct video_data *frame)
 {
@@ -1023,6 +1337,7 @@ static void receive_video(void *param, struct video_data *frame)
 	struct obs_encoder *encoder = param;
 	struct obs_encoder *pair = encoder->paired_encoder;
 	struct encoder_frame enc_frame;
+	int64_t gap;
 
 	if (!encoder->first_received && pair) {
 		if (!pair->first_received ||
@@ -1031,9 +1346,18 @@ static void receive_video(void *param, struct video_data *frame)
 		}
 	}
 
-	if (video_pause_check(&encoder->pause, frame->timestamp))
+	update_queued_frames(encoder);
+
+	if (video_pause_check(&encoder->pause, frame->timestamp)) {
+		encoder->last_frame_ts = 0;
+		goto wait_for_audio;
+	}
+
+	if (skip_frame(encoder))
 		goto wait_for_audio;
 
+	gap = get_frame_gap(encoder, frame->timestamp);
+
 	memset(&enc_frame, 0, sizeof(struct encoder_frame));
 
 	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
@@ -1043,6 +1367,8 @@ static void receive_video(void *param, struct video_data *frame)
 
 	if (!encoder->start_ts)
 		encoder->start_ts = frame->timestamp;
+	else
+		encoder->cur_pts += gap * encoder->timebase_num;
 
 	enc_frame.frames = 1;
 	enc_frame.pts = encoder->cur_pts;
@@ -1311,12 +1637,8 @@ void obs_encoder_remove_output(struct obs_encoder *encoder,
 void obs_encoder_packet_create_instance(struct encoder_packet *dst,
 					const struct encoder_packet *src)
 {
-	long *p_refs;
-
 	*dst = *src;
-	p_refs = bmalloc(src->size + sizeof(long));
-	dst->data = (void *)(p_refs + 1);
-	*p_refs = 1;
+	dst->data = alloc_packet_data(src->size);
 	memcpy(dst->data, src->data, src->size);
 }
 
@@ -1339,10 +1661,8 @@ void obs_encoder_packet_ref(struct encoder_packet *dst,
 	if (!src)
 		return;
 
-	if (src->data) {
-		long *p_refs = ((long *)src->data) - 1;
-		os_atomic_inc_long(p_refs);
-	}
+	if (src->data)
+		os_atomic_inc_long(&get_packet_block(src->data)->refs);
 
 	*dst = *src;
 }
@@ -1353,9 +1673,9 @@ void obs_encoder_packet_release(struct encoder_packet *pkt)
 		return;
 
 	if (pkt->data) {
-		long *p_refs = ((long *)pkt->data) - 1;
-		if (os_atomic_dec_long(p_refs) == 0)
-			bfree(p_refs);
+		struct packet_block *block = get_packet_block(pkt->data);
+		if (os_atomic_dec_long(&block->refs) == 0)
+			free_packet_block(block);
 	}
 
 	memset(pkt, 0, sizeof(struct encoder_packet));
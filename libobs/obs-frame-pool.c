@@ -0,0 +1,208 @@
+/******************************************************************************
+    Copyright (C) 2020 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "media-io/video-frame.h"
+#include "util/platform.h"
+#include "obs-internal.h"
+
+/* idle memory kept for later frames unless set with obs_set_frame_pool_limit,
+ * enough for a few seconds of frames from a couple of 1080p sources */
+#define DEFAULT_POOL_LIMIT (256ULL * 1024 * 1024)
+
+/* idle buffers are freed when they haven't been used for this long */
+#define MAX_IDLE_NS 10000000000ULL
+
+#define MIN_CLASS_STEP 4096
+
+static const char *pool_hits_name = "async frame pool: hits";
+static const char *pool_allocs_name = "async frame pool: allocations";
+
+struct pool_frame {
+	struct obs_source_frame frame;
+	uint8_t *buffer;
+	size_t buffer_size;
+};
+
+/* sizes are rounded up to a step of at least 1/16 of the size, so frames of
+ * a similar size share a class without wasting much memory */
+static inline size_t get_size_class(size_t size)
+{
+	size_t step = MIN_CLASS_STEP;
+
+	while (step * 16 < size)
+		step *= 2;
+
+	return (size + step - 1) & ~(step - 1);
+}
+
+bool obs_frame_pool_init(struct obs_frame_pool *pool)
+{
+	if (pthread_mutex_init(&pool->mutex, NULL) != 0)
+		return false;
+
+	da_init(pool->idle);
+	pool->limit = DEFAULT_POOL_LIMIT;
+	return true;
+}
+
+void obs_frame_pool_free(struct obs_frame_pool *pool)
+{
+	for (size_t i = 0; i < pool->idle.num; i++)
+		bfree(pool->idle.array[i].data);
+
+	da_free(pool->idle);
+	pthread_mutex_destroy(&pool->mutex);
+}
+
+static void free_idle_buffer(struct obs_frame_pool *pool, size_t idx)
+{
+	struct obs_frame_pool_buffer *buffer = pool->idle.array + idx;
+
+	pool->bytes_resident -= buffer->size;
+	pool->bytes_idle -= buffer->size;
+	bfree(buffer->data);
+	da_erase(pool->idle, idx);
+}
+
+static void trim_pool(struct obs_frame_pool *pool, uint64_t now)
+{
+	while (pool->idle.num && pool->bytes_idle > pool->limit)
+		free_idle_buffer(pool, 0);
+
+	while (pool->idle.num &&
+	       now - pool->idle.array[0].last_used > MAX_IDLE_NS)
+		free_idle_buffer(pool, 0);
+}
+
+static void *pool_alloc(size_t size, void *param)
+{
+	struct obs_frame_pool *pool = &obs->data.frame_pool;
+	struct pool_frame *frame = param;
+	size_t class_size = get_size_class(size);
+	uint8_t *data = NULL;
+	bool hit;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	/* the most recently used buffer is the most likely to be cached */
+	for (size_t i = pool->idle.num; i > 0; i--) {
+		struct obs_frame_pool_buffer *buffer = pool->idle.array + i - 1;
+
+		if (buffer->size == class_size) {
+			data = buffer->data;
+			pool->bytes_idle -= class_size;
+			da_erase(pool->idle, i - 1);
+			break;
+		}
+	}
+
+	hit = data != NULL;
+	if (hit) {
+		pool->hits++;
+	} else {
+		data = bmalloc(class_size);
+		pool->allocations++;
+		pool->bytes_resident += class_size;
+	}
+
+	trim_pool(pool, os_gettime_ns());
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	profile_count(hit ? pool_hits_name : pool_allocs_name, 1);
+
+	frame->buffer = data;
+	frame->buffer_size = class_size;
+	return data;
+}
+
+struct obs_source_frame *
+obs_frame_pool_create_frame(enum video_format format, uint32_t width,
+			    uint32_t height)
+{
+	struct pool_frame *frame = bzalloc(sizeof(*frame));
+	struct video_frame vid_frame;
+
+	video_frame_init_alloc(&vid_frame, format, width, height, pool_alloc,
+			       frame);
+	frame->frame.format = format;
+	frame->frame.width = width;
+	frame->frame.height = height;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		frame->frame.data[i] = vid_frame.data[i];
+		frame->frame.linesize[i] = vid_frame.linesize[i];
+	}
+
+	return &frame->frame;
+}
+
+void obs_frame_pool_destroy_frame(struct obs_source_frame *frame)
+{
+	struct obs_frame_pool *pool = &obs->data.frame_pool;
+	struct pool_frame *pool_frame = (struct pool_frame *)frame;
+	struct obs_frame_pool_buffer buffer;
+
+	if (!frame)
+		return;
+
+	if (pool_frame->buffer) {
+		buffer.data = pool_frame->buffer;
+		buffer.size = pool_frame->buffer_size;
+		buffer.last_used = os_gettime_ns();
+
+		pthread_mutex_lock(&pool->mutex);
+		da_push_back(pool->idle, &buffer);
+		pool->bytes_idle += buffer.size;
+		trim_pool(pool, buffer.last_used);
+		pthread_mutex_unlock(&pool->mutex);
+	}
+
+	bfree(pool_frame);
+}
+
+void obs_get_frame_pool_stats(struct obs_frame_pool_stats *stats)
+{
+	struct obs_frame_pool *pool;
+
+	if (!obs || !stats)
+		return;
+
+	pool = &obs->data.frame_pool;
+
+	pthread_mutex_lock(&pool->mutex);
+	stats->hits = pool->hits;
+	stats->allocations = pool->allocations;
+	stats->bytes_resident = pool->bytes_resident;
+	stats->bytes_idle = pool->bytes_idle;
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void obs_set_frame_pool_limit(uint64_t bytes)
+{
+	struct obs_frame_pool *pool;
+
+	if (!obs)
+		return;
+
+	pool = &obs->data.frame_pool;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->limit = bytes;
+	trim_pool(pool, os_gettime_ns());
+	pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,74 @@
+/******************************************************************************
+    Copyright (C) 2020 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Frame skipping of video encoders.
+ *
+ * With an interval of N the encoder encodes the first of every N frames it
+ * receives and skips the others.  Skipped frames, like frames dropped by the
+ * frame queue, leave a gap in the frame timestamps that is kept in the pts so
+ * that video stays in sync with audio.
+ */
+
+/* the smallest interval of all active outputs, a shared encoder must not skip
+ * frames for outputs that aren't congested */
+static inline long frame_skip_merge(long cur, long skip, bool first)
+{
+	return first || skip < cur ? skip : cur;
+}
+
+/* returns true if the frame is skipped, count is the number of frames received
+ * since skipping started */
+static inline bool frame_skip_check(uint64_t *count, long interval)
+{
+	if (interval <= 1) {
+		*count = 0;
+		return false;
+	}
+
+	return (*count)++ % (uint64_t)interval != 0;
+}
+
+/* returns the number of frames missing between the last encoded frame and
+ * this one, last_ts is 0 after a pause */
+static inline int64_t frame_skip_gap(uint64_t *last_ts, uint64_t ts,
+				     uint64_t frame_time)
+{
+	uint64_t prev = *last_ts;
+	uint64_t frames;
+
+	*last_ts = ts;
+
+	if (!prev || ts <= prev || !frame_time)
+		return 0;
+
+	frames = (ts - prev + frame_time / 2) / frame_time;
+	return frames > 1 ? (int64_t)frames - 1 : 0;
+}
+
+/* frames waiting in the frame queue plus frames the encoder holds for
+ * lookahead or b-frames */
+static inline uint32_t frame_skip_in_flight(long queued, long encoding)
+{
+	long frames = queued + encoding;
+	return frames > 0 ? (uint32_t)frames : 0;
+}
@@ -0,0 +1,261 @@
+/******************************************************************************
+    Copyright (C) 2020 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <assert.h>
+#include "obs-interleave.h"
+
+static inline size_t get_track(enum obs_encoder_type type, size_t track_idx)
+{
+	if (type == OBS_ENCODER_VIDEO)
+		return 0;
+
+	assert(track_idx < MAX_AUDIO_MIXES);
+	return 1 + track_idx;
+}
+
+static inline bool entry_before(const struct interleave_entry *a,
+				const struct interleave_entry *b)
+{
+	if (a->packet.dts_usec != b->packet.dts_usec)
+		return a->packet.dts_usec < b->packet.dts_usec;
+
+	/* video goes first on equal timestamps */
+	if (a->packet.type != b->packet.type)
+		return a->packet.type == OBS_ENCODER_VIDEO;
+
+	return a->seq < b->seq;
+}
+
+static inline struct interleave_entry *
+track_head(struct interleave_queue *queue, size_t track)
+{
+	struct interleave_track *t = &queue->tracks[track];
+	return &t->entries.array[t->head];
+}
+
+static inline bool heap_less(struct interleave_queue *queue, size_t a,
+			     size_t b)
+{
+	return entry_before(track_head(queue, queue->heap[a]),
+			    track_head(queue, queue->heap[b]));
+}
+
+static inline void heap_swap(struct interleave_queue *queue, size_t a,
+			     size_t b)
+{
+	size_t track = queue->heap[a];
+	queue->heap[a] = queue->heap[b];
+	queue->heap[b] = track;
+
+	queue->heap_pos[queue->heap[a]] = a;
+	queue->heap_pos[queue->heap[b]] = b;
+}
+
+static void heap_sift_up(struct interleave_queue *queue, size_t idx)
+{
+	while (idx) {
+		size_t parent = (idx - 1) / 2;
+		if (!heap_less(queue, idx, parent))
+			break;
+
+		heap_swap(queue, idx, parent);
+		idx = parent;
+	}
+}
+
+static void heap_sift_down(struct interleave_queue *queue, size_t idx)
+{
+	for (;;) {
+		size_t left = idx * 2 + 1;
+		size_t right = left + 1;
+		size_t min = idx;
+
+		if (left < queue->heap_size && heap_less(queue, left, min))
+			min = left;
+		if (right < queue->heap_size && heap_less(queue, right, min))
+			min = right;
+		if (min == idx)
+			break;
+
+		heap_swap(queue, idx, min);
+		idx = min;
+	}
+}
+
+static void heap_insert(struct interleave_queue *queue, size_t track)
+{
+	size_t idx = queue->heap_size++;
+
+	queue->heap[idx] = track;
+	queue->heap_pos[track] = idx;
+	heap_sift_up(queue, idx);
+}
+
+static void heap_remove_min(struct interleave_queue *queue)
+{
+	if (--queue->heap_size) {
+		queue->heap[0] = queue->heap[queue->heap_size];
+		queue->heap_pos[queue->heap[0]] = 0;
+		heap_sift_down(queue, 0);
+	}
+}
+
+/* popping only advances the head, so reclaim the front of the array once
+ * it makes up at least half of it */
+static inline void compact_track(struct interleave_track *track)
+{
+	if (track->head && track->head * 2 >= track->entries.num) {
+		da_erase_range(track->entries, 0, track->head);
+		track->head = 0;
+	}
+}
+
+void interleave_queue_free(struct interleave_queue *queue)
+{
+	for (size_t i = 0; i < INTERLEAVE_TRACKS; i++) {
+		struct interleave_track *track = &queue->tracks[i];
+
+		for (size_t j = track->head; j < track->entries.num; j++)
+			obs_encoder_packet_release(
+				&track->entries.array[j].packet);
+		da_free(track->entries);
+	}
+
+	memset(queue, 0, sizeof(*queue));
+}
+
+void interleave_queue_push(struct interleave_queue *queue,
+			   struct encoder_packet *packet)
+{
+	size_t t = get_track(packet->type, packet->track_idx);
+	struct interleave_track *track = &queue->tracks[t];
+	struct interleave_entry entry = {*packet, queue->next_seq++};
+	bool was_empty = interleave_track_count(track) == 0;
+	size_t idx;
+
+	compact_track(track);
+
+	/* packets nearly always arrive in order, so search from the back */
+	idx = track->entries.num;
+	while (idx > track->head &&
+	       entry_before(&entry, &track->entries.array[idx - 1]))
+		idx--;
+
+	da_insert(track->entries, idx, &entry);
+	queue->num++;
+
+	if (was_empty)
+		heap_insert(queue, t);
+	else if (idx == track->head)
+		heap_sift_up(queue, queue->heap_pos[t]);
+}
+
+struct encoder_packet *interleave_queue_peek(struct interleave_queue *queue)
+{
+	if (!queue->heap_size)
+		return NULL;
+
+	return &track_head(queue, queue->heap[0])->packet;
+}
+
+bool interleave_queue_pop(struct interleave_queue *queue,
+			  struct encoder_packet *packet)
+{
+	struct interleave_track *track;
+
+	if (!queue->heap_size)
+		return false;
+
+	track = &queue->tracks[queue->heap[0]];
+	*packet = track->entries.array[track->head++].packet;
+	queue->num--;
+
+	if (track->head == track->entries.num) {
+		track->entries.num = 0;
+		track->head = 0;
+		heap_remove_min(queue);
+	} else {
+		heap_sift_down(queue, 0);
+	}
+
+	return true;
+}
+
+struct encoder_packet *interleave_queue_first(struct interleave_queue *queue,
+					      enum obs_encoder_type type,
+					      size_t track_idx)
+{
+	struct interleave_track *track =
+		&queue->tracks[get_track(type, track_idx)];
+
+	if (!interleave_track_count(track))
+		return NULL;
+
+	return &track->entries.array[track->head].packet;
+}
+
+struct encoder_packet *interleave_queue_last(struct interleave_queue *queue,
+					     enum obs_encoder_type type,
+					     size_t track_idx)
+{
+	struct interleave_track *track =
+		&queue->tracks[get_track(type, track_idx)];
+
+	if (!interleave_track_count(track))
+		return NULL;
+
+	return &track->entries.array[track->entries.num - 1].packet;
+}
+
+bool interleave_queue_before(const struct encoder_packet *a,
+			     const struct encoder_packet *b)
+{
+	return entry_before((const struct interleave_entry *)a,
+			    (const struct interleave_entry *)b);
+}
+
+void interleave_queue_discard(struct interleave_queue *queue,
+			      const struct encoder_packet *packet,
+			      bool inclusive)
+{
+	/* copy it, the packet may be released below */
+	struct interleave_entry cutoff =
+		*(const struct interleave_entry *)packet;
+	struct interleave_entry *head;
+
+	while (queue->heap_size) {
+		head = track_head(queue, queue->heap[0]);
+
+		if (!entry_before(head, &cutoff) &&
+		    !(inclusive && head->seq == cutoff.seq))
+			break;
+
+		struct encoder_packet out;
+		interleave_queue_pop(queue, &out);
+		obs_encoder_packet_release(&out);
+	}
+}
+
+void interleave_queue_resort(struct interleave_queue *queue)
+{
+	queue->heap_size = 0;
+
+	for (size_t i = 0; i < INTERLEAVE_TRACKS; i++) {
+		if (interleave_track_count(&queue->tracks[i]))
+			heap_insert(queue, i);
+	}
+}
@@ -0,0 +1,118 @@
+/******************************************************************************
+    Copyright (C) 2020 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "util/darray.h"
+#include "obs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Interleave queue for encoded packets.
+ *
+ * Each track (video plus one per audio mix) keeps its own FIFO sorted by
+ * dts_usec, and a min-heap over the track heads merges them.  Packets come
+ * out ordered by dts_usec; on equal timestamps video goes before audio, and
+ * audio packets keep the order they were pushed in.  Encoders produce
+ * packets in dts order, so pushing is O(1) and popping is O(log tracks).
+ *
+ * The queue holds a reference to every packet in it.
+ */
+
+#define INTERLEAVE_TRACKS (1 + MAX_AUDIO_MIXES)
+
+struct interleave_entry {
+	struct encoder_packet packet;
+	uint64_t seq;
+};
+
+struct interleave_track {
+	DARRAY(struct interleave_entry) entries;
+	size_t head;
+};
+
+struct interleave_queue {
+	struct interleave_track tracks[INTERLEAVE_TRACKS];
+	size_t heap[INTERLEAVE_TRACKS];
+	size_t heap_pos[INTERLEAVE_TRACKS];
+	size_t heap_size;
+	size_t num;
+	uint64_t next_seq;
+};
+
+/* releases all packets and frees the queue's memory */
+EXPORT void interleave_queue_free(struct interleave_queue *queue);
+
+/* takes ownership of the packet reference.  audio packets must already have
+ * their track_idx set */
+EXPORT void interleave_queue_push(struct interleave_queue *queue,
+				  struct encoder_packet *packet);
+
+/* returns the next packet to send, or NULL if the queue is empty */
+EXPORT struct encoder_packet *
+interleave_queue_peek(struct interleave_queue *queue);
+
+/* removes the next packet and transfers its reference to the caller */
+EXPORT bool interleave_queue_pop(struct interleave_queue *queue,
+				 struct encoder_packet *packet);
+
+/* returns the first or last packet of a specific track */
+EXPORT struct encoder_packet *
+interleave_queue_first(struct interleave_queue *queue,
+		       enum obs_encoder_type type, size_t track_idx);
+EXPORT struct encoder_packet *
+interleave_queue_last(struct interleave_queue *queue,
+		      enum obs_encoder_type type, size_t track_idx);
+
+/* true if packet a is sent before packet b.  both must be in the queue */
+EXPORT bool interleave_queue_before(const struct encoder_packet *a,
+				    const struct encoder_packet *b);
+
+/* releases every packet sent before the given queued packet, and the packet
+ * itself if inclusive is set */
+EXPORT void interleave_queue_discard(struct interleave_queue *queue,
+				     const struct encoder_packet *packet,
+				     bool inclusive);
+
+/* rebuilds the merge order after the timestamps of queued packets were
+ * changed.  packets within a track must still be in order */
+EXPORT void interleave_queue_resort(struct interleave_queue *queue);
+
+static inline size_t interleave_queue_count(struct interleave_queue *queue)
+{
+	return queue->num;
+}
+
+/* direct access to the queued packets of a track, in order */
+static inline size_t
+interleave_track_count(const struct interleave_track *track)
+{
+	return track->entries.num - track->head;
+}
+
+static inline struct encoder_packet *
+interleave_track_packet(struct interleave_track *track, size_t idx)
+{
+	return &track->entries.array[track->head + idx].packet;
+}
+
+#ifdef __cplusplus
+}
+#endif
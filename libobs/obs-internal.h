@@ -35,6 +35,7 @@
 #include "media-io/audio-io.h"
 
 #include "obs.h"
+#include "obs-interleave.h"
 
 #define NUM_TEXTURES 2
 #define NUM_CHANNELS 3
@@ -241,6 +242,46 @@ struct obs_task_info {
 	void *param;
 };
 
+/* A set of mapped staging surfaces handed to raw video outputs without
+ * copying.  refs is cleared from the video-io thread once every output is
+ * done with the frame; the graphics thread then unmaps the set and reuses
+ * it as a staging target. */
+struct obs_shared_frame {
+	gs_stagesurf_t *surfaces[NUM_CHANNELS];
+	volatile long refs;
+	bool mapped;
+};
+
+#define MAX_SHARED_FRAMES 4
+
+/* The fragment of a fusable filter, and the effect created from it on its
+ * own.  text is the fragment as it was loaded, with '$' in its names */
+struct obs_filter_fragment {
+	char *file;
+	char *text;
+	gs_effect_t *effect;
+};
+
+/* One pass made of several fragments.  params holds, for each fragment in
+ * turn, the param of the fused effect for each param of the effect of the
+ * fragment, or NULL if there is none */
+struct obs_fused_effect {
+	char *key;
+	gs_effect_t *effect;
+	DARRAY(gs_eparam_t *) params;
+};
+
+#define MAX_FUSED_FILTERS 8
+
+/* rows of a plane of an async frame copied to a mapped texture */
+struct async_upload_job {
+	uint8_t *dst;
+	const uint8_t *src;
+	uint32_t dst_linesize;
+	uint32_t src_linesize;
+	uint32_t rows;
+};
+
 struct obs_core_video {
 	graphics_t *graphics;
 	gs_stagesurf_t *copy_surfaces[NUM_TEXTURES][NUM_CHANNELS];
@@ -266,6 +307,8 @@ struct obs_core_video {
 	gs_effect_t *premultiplied_alpha_effect;
 	gs_samplerstate_t *point_sampler;
 	gs_stagesurf_t *mapped_surfaces[NUM_CHANNELS];
+	bool shared_frames_supported;
+	DARRAY(struct obs_shared_frame *) shared_frames;
 	int cur_texture;
 	long raw_active;
 	long gpu_encoder_active;
@@ -314,6 +357,27 @@ struct obs_core_video {
 
 	struct obs_video_info ovi;
 
+	/* set while a scene with static video is rendered to its cache */
+	int static_cache_depth;
+
+	/* effects of fusable filters, and of runs of them fused into a single
+	 * pass, only used within the graphics context */
+	DARRAY(struct obs_filter_fragment) filter_fragments;
+	DARRAY(struct obs_fused_effect) fused_effects;
+
+	/* the planes of the frames async sources show next are copied to
+	 * their mapped textures by the graphics thread and these workers
+	 * before anything is rendered.  pending_upload_work counts unfinished
+	 * jobs plus woken workers */
+	DARRAY(pthread_t) upload_workers;
+	os_sem_t *upload_semaphore;
+	os_event_t *upload_done_event;
+	DARRAY(struct async_upload_job) upload_jobs;
+	DARRAY(struct obs_source *) upload_sources;
+	volatile long next_upload_job;
+	volatile long pending_upload_work;
+	volatile bool upload_workers_stop;
+
 	pthread_mutex_t task_mutex;
 	struct circlebuf tasks;
 };
@@ -326,11 +390,37 @@ struct obs_core_audio {
 	DARRAY(struct obs_source *) render_order;
 	DARRAY(struct obs_source *) root_nodes;
 
+	/* sources that do not render other sources' audio are spread across
+	 * the audio thread and these workers; composites are rendered
+	 * afterwards in render_order.  pending_render_work counts unfinished
+	 * jobs plus woken workers. */
+	DARRAY(pthread_t) render_workers;
+	os_sem_t *render_semaphore;
+	os_event_t *render_done_event;
+	DARRAY(struct obs_source *) render_jobs;
+	volatile long next_render_job;
+	volatile long pending_render_work;
+	volatile bool render_workers_stop;
+	uint32_t render_mixers;
+	size_t render_channels;
+	size_t render_sample_rate;
+
 	uint64_t buffered_ts;
 	struct circlebuf buffered_timestamps;
 	int buffering_wait_ticks;
 	int total_buffering_ticks;
 
+	/* adaptive buffering: the lowest slack of any source over a window
+	 * decides how many ticks of buffering can be dropped again */
+	uint64_t window_start;
+	uint64_t window_min_slack;
+	int shrink_ticks;
+	int shrink_wait_ticks;
+
+	pthread_mutex_t buffering_mutex;
+	struct circlebuf buffering_history;
+	struct obs_audio_buffering_info buffering_info;
+
 	float user_volume;
 
 	pthread_mutex_t monitoring_mutex;
@@ -340,6 +430,44 @@ struct obs_core_audio {
 };
 
 /* user sources, output channels, and displays */
+/* name-keyed hash index over the public contexts of one type.  lookups only
+ * take the lock for reading */
+struct obs_context_index {
+	pthread_rwlock_t lock;
+	struct obs_context_data **buckets;
+	size_t num_buckets;
+	size_t num;
+};
+
+/* Memory of the frames of async sources, shared between all of them.  Idle
+ * buffers are kept by size class, oldest first, until they haven't been used
+ * for a while or the idle buffers take more memory than the limit */
+struct obs_frame_pool_buffer {
+	uint8_t *data;
+	size_t size;
+	uint64_t last_used;
+};
+
+struct obs_frame_pool {
+	pthread_mutex_t mutex;
+	DARRAY(struct obs_frame_pool_buffer) idle;
+	uint64_t limit;
+	uint64_t hits;
+	uint64_t allocations;
+	uint64_t bytes_resident;
+	uint64_t bytes_idle;
+};
+
+extern bool obs_frame_pool_init(struct obs_frame_pool *pool);
+extern void obs_frame_pool_free(struct obs_frame_pool *pool);
+
+/* frames of the async cache of sources, which must only be destroyed with
+ * obs_frame_pool_destroy_frame */
+extern struct obs_source_frame *
+obs_frame_pool_create_frame(enum video_format format, uint32_t width,
+			    uint32_t height);
+extern void obs_frame_pool_destroy_frame(struct obs_source_frame *frame);
+
 struct obs_core_data {
 	struct obs_source *first_source;
 	struct obs_source *first_audio_source;
@@ -355,15 +483,30 @@ struct obs_core_data {
 	pthread_mutex_t services_mutex;
 	pthread_mutex_t audio_sources_mutex;
 	pthread_mutex_t draw_callbacks_mutex;
+	struct obs_context_index source_index;
+	struct obs_context_index output_index;
+	struct obs_context_index encoder_index;
+	struct obs_context_index service_index;
 	DARRAY(struct draw_callback) draw_callbacks;
 	DARRAY(struct tick_callback) tick_callbacks;
 
 	struct obs_view main_view;
 
-	long long unnamed_index;
+	/* sources can be created on several threads at once */
+	volatile long unnamed_index;
+
+	/* incremented when a group changes, its items are also saved by
+	 * the scene containing the group */
+	volatile long scene_save_gen;
+
+	/* incremented when a source is removed, a source changes size or an
+	 * item of a group changes, makes scenes check all of their items */
+	volatile long scene_update_gen;
 
 	obs_data_t *private_data;
 
+	struct obs_frame_pool frame_pool;
+
 	volatile bool valid;
 };
 
@@ -451,6 +594,11 @@ struct obs_graphics_context {
 };
 
 extern void *obs_graphics_thread(void *param);
+extern bool obs_init_upload_workers(size_t count);
+extern void obs_free_upload_workers(void);
+extern void obs_video_add_upload(uint8_t *dst, uint32_t dst_linesize,
+				 const uint8_t *src, uint32_t src_linesize,
+				 uint32_t rows);
 extern bool obs_graphics_thread_loop(struct obs_graphics_context *context);
 #ifdef __APPLE__
 extern void *obs_graphics_thread_autorelease(void *param);
@@ -460,12 +608,17 @@ obs_graphics_thread_loop_autorelease(struct obs_graphics_context *context);
 
 extern gs_effect_t *obs_load_effect(gs_effect_t **effect, const char *file);
 
+extern bool obs_init_copy_surfaces(gs_stagesurf_t *surfaces[NUM_CHANNELS]);
+
 extern bool audio_callback(void *param, uint64_t start_ts_in,
 			   uint64_t end_ts_in, uint64_t *out_ts,
 			   uint32_t mixers, struct audio_output_data *mixes);
+extern bool obs_init_audio_render_workers(size_t count);
+extern void obs_free_audio_render_workers(void);
 
 extern void
 start_raw_video(video_t *video, const struct video_scale_info *conversion,
+		const struct video_queue_info *queue, bool rendition,
 		void (*callback)(void *param, struct video_data *frame),
 		void *param);
 extern void stop_raw_video(video_t *video,
@@ -495,6 +648,10 @@ struct obs_context_data {
 	struct obs_context_data *next;
 	struct obs_context_data **prev_next;
 
+	struct obs_context_index *index;
+	struct obs_context_data *index_next;
+	uint32_t name_hash;
+
 	bool private;
 };
 
@@ -682,6 +839,8 @@ struct obs_source {
 	struct obs_source_frame *async_preload_frame;
 	DARRAY(struct async_frame) async_cache;
 	DARRAY(struct obs_source_frame *) async_frames;
+	struct obs_source_frame *async_upload_frame;
+	bool async_mapped[MAX_AV_PLANES];
 	pthread_mutex_t async_mutex;
 	uint32_t async_width;
 	uint32_t async_height;
@@ -711,6 +870,19 @@ struct obs_source {
 	enum obs_allow_direct_render allow_direct;
 	bool rendering_filter;
 
+	/* fusable filters leave their pass to the filter after them when it
+	 * asks for it with filter_fuse_into while rendering them.  the params
+	 * of the pass are saved in filter_fuse_params */
+	struct obs_source *filter_fuse_into;
+	int filter_fuse_depth;
+	bool filter_fuse_deferred;
+	bool filter_fused;
+	bool filter_fuse_fallback;
+	bool filter_fuse_failed;
+	enum gs_color_format filter_fuse_format;
+	gs_effect_t *filter_fuse_effect;
+	DARRAY(uint8_t) filter_fuse_params;
+
 	/* sources specific hotkeys */
 	obs_hotkey_pair_id mute_unmute_key;
 	obs_hotkey_id push_to_mute_key;
@@ -755,9 +927,67 @@ struct obs_source {
 	enum obs_monitoring_type monitoring_type;
 
 	obs_data_t *private_settings;
+
+	/* size after the last tick, scenes only check their items for size
+	 * changes when the size of a source has changed */
+	uint32_t last_tick_width;
+	uint32_t last_tick_height;
+
+	/* copy of the last data saved by obs_save_sources, only rebuilt when
+	 * something that is saved has changed since then */
+	obs_data_t *save_cache;
+	long save_cache_scene_gen;
+	volatile bool save_dirty;
+
+	/* incremented whenever what the source draws may have changed.  the
+	 * render of sources with static video, and of scenes made only of
+	 * them, is cached until it or the sizes change */
+	volatile long video_gen;
+	gs_texrender_t *static_cache;
+	uint64_t static_cache_gen;
+	uint32_t static_cache_cx;
+	uint32_t static_cache_cy;
+	bool static_cache_valid;
 };
 
 extern struct obs_source_info *get_source_info(const char *id);
+extern void obs_source_mark_dirty(obs_source_t *source);
+
+/* whether the source is known to cover its entire area with opaque pixels
+ * when rendered, only called from the graphics thread */
+extern bool obs_source_video_opaque(const obs_source_t *source);
+
+/* return false if the source may draw something different at any time,
+ * otherwise set gen to a value that changes whenever what it draws changes.
+ * only called from the graphics thread */
+extern bool obs_source_static_video_gen(obs_source_t *source, uint64_t *gen);
+
+/* mixes the next counter that a static render depends on into gen.  unlike a
+ * sum, it depends on the order, so changes of different sources or removed
+ * items can't cancel each other out */
+#define STATIC_VIDEO_GEN_INIT 0xcbf29ce484222325ULL
+
+static inline uint64_t static_video_gen_add(uint64_t gen, uint64_t value)
+{
+	return (gen ^ value) * 0x100000001b3ULL;
+}
+
+/* whether the effect was created with obs_filter_fragment_create */
+extern bool obs_filter_fragment_valid(gs_effect_t *effect);
+
+/* saves the effect of a pass of the filter, along with the current values of
+ * its params, to be drawn later as part of a fused pass */
+extern void obs_filter_fuse_save(obs_source_t *filter, gs_effect_t *effect);
+
+/* sets the params saved by obs_filter_fuse_save on the effect again */
+extern void obs_filter_fuse_restore(obs_source_t *filter);
+
+/* returns the effect that draws the saved passes of the filters in order, with
+ * their params set, or NULL if it could not be created */
+extern gs_effect_t *obs_filter_fuse_chain(obs_source_t **chain, size_t count);
+
+extern void obs_free_filter_fusion(void);
+extern bool obs_scene_static_video_gen(obs_scene_t *scene, uint64_t *gen);
 extern struct obs_source_info *get_source_info2(const char *unversioned_id,
 						uint32_t ver);
 extern bool obs_source_init_context(struct obs_source *source,
@@ -859,6 +1089,12 @@ extern bool set_async_texture_size(struct obs_source *source,
 extern void remove_async_frame(obs_source_t *source,
 			       struct obs_source_frame *frame);
 
+/* when the source shows a new frame, maps its textures and adds the copies of
+ * its planes as upload jobs.  returns true if the textures have to be unmapped
+ * with obs_source_end_async_upload once the jobs are done */
+extern bool obs_source_begin_async_upload(obs_source_t *source);
+extern void obs_source_end_async_upload(obs_source_t *source);
+
 extern void set_deinterlace_texture_size(obs_source_t *source);
 extern void deinterlace_process_last_frame(obs_source_t *source,
 					   uint64_t sys_time);
@@ -920,6 +1156,7 @@ struct obs_output {
 	bool received_audio;
 	volatile bool data_active;
 	volatile bool end_data_capture_thread_active;
+	volatile long frame_skip;
 	int64_t video_offset;
 	int64_t audio_offsets[MAX_AUDIO_MIXES];
 	int64_t highest_audio_ts;
@@ -927,7 +1164,7 @@ struct obs_output {
 	pthread_t end_data_capture_thread;
 	os_event_t *stopping_event;
 	pthread_mutex_t interleaved_mutex;
-	DARRAY(struct encoder_packet) interleaved_packets;
+	struct interleave_queue interleaved_packets;
 	int stop_code;
 
 	int reconnect_retry_sec;
@@ -1017,6 +1254,9 @@ extern const struct obs_output_info *find_output(const char *id);
 extern void obs_output_remove_encoder(struct obs_output *output,
 				      struct obs_encoder *encoder);
 
+extern void obs_init_encoder_packet_pool(void);
+extern void obs_free_encoder_packet_pool(void);
+
 extern void
 obs_encoder_packet_create_instance(struct encoder_packet *dst,
 				   const struct encoder_packet *src);
@@ -1057,6 +1297,21 @@ struct obs_encoder {
 	uint32_t scaled_width;
 	uint32_t scaled_height;
 	enum video_format preferred_format;
+	bool rendition;
+
+	/* raw video is passed to the encoder through a queue, a size of 0
+	 * uses the default size */
+	struct video_queue_info frame_queue;
+	uint64_t last_frame_ts;
+
+	/* raw frames in the frame queue and in the encoder itself (lookahead,
+	 * b-frames), which congested outputs take into account */
+	volatile long queued_frames;
+	volatile long frames_in_flight;
+
+	/* frames skipped because every active output asked for it */
+	uint64_t skip_count;
+	uint32_t skipped_frames;
 
 	volatile bool active;
 	volatile bool paused;
@@ -169,10 +169,7 @@ fail:
 
 static inline void free_packets(struct obs_output *output)
 {
-	for (size_t i = 0; i < output->interleaved_packets.num; i++)
-		obs_encoder_packet_release(output->interleaved_packets.array +
-					   i);
-	da_free(output->interleaved_packets);
+	interleave_queue_free(&output->interleaved_packets);
 }
 
 static inline void clear_audio_buffers(obs_output_t *output)
@@ -1211,7 +1208,6 @@ static bool add_caption(struct obs_output *output, struct encoder_packet *out)
 	sei_t sei;
 	uint8_t *data;
 	size_t size;
-	long ref = 1;
 
 	DARRAY(uint8_t) out_data;
 
@@ -1221,7 +1217,6 @@ static bool add_caption(struct obs_output *output, struct encoder_packet *out)
 	sei_init(&sei, 0.0);
 
 	da_init(out_data);
-	da_push_back_array(out_data, &ref, sizeof(ref));
 	da_push_back_array(out_data, out->data, out->size);
 
 	caption_frame_init(&cf);
@@ -1238,9 +1233,10 @@ static bool add_caption(struct obs_output *output, struct encoder_packet *out)
 
 	obs_encoder_packet_release(out);
 
-	*out = backup;
-	out->data = (uint8_t *)out_data.array + sizeof(ref);
-	out->size = out_data.num - sizeof(ref);
+	backup.data = out_data.array;
+	backup.size = out_data.num;
+	obs_encoder_packet_create_instance(out, &backup);
+	da_free(out_data);
 
 	sei_free(&sei);
 
@@ -1253,7 +1249,8 @@ static bool add_caption(struct obs_output *output, struct encoder_packet *out)
 
 static inline void send_interleaved(struct obs_output *output)
 {
-	struct encoder_packet out = output->interleaved_packets.array[0];
+	struct encoder_packet out =
+		*interleave_queue_peek(&output->interleaved_packets);
 
 	/* do not send an interleaved packet if there's no packet of the
 	 * opposing type of a higher timestamp in the interleave buffer.
@@ -1261,7 +1258,7 @@ static inline void send_interleaved(struct obs_output *output)
 	if (!has_higher_opposing_ts(output, &out))
 		return;
 
-	da_erase(output->interleaved_packets, 0);
+	interleave_queue_pop(&output->interleaved_packets, &out);
 
 	if (out.type == OBS_ENCODER_VIDEO) {
 		output->total_frames++;
@@ -1308,186 +1305,148 @@ static inline void set_higher_ts(struct obs_output *output,
 
 static inline struct encoder_packet *
 find_first_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		       size_t audio_idx);
-static int find_first_packet_type_idx(struct obs_output *output,
-				      enum obs_encoder_type type,
-				      size_t audio_idx);
+		       size_t audio_idx)
+{
+	return interleave_queue_first(&output->interleaved_packets, type,
+				      audio_idx);
+}
+
+static inline struct encoder_packet *
+find_last_packet_type(struct obs_output *output, enum obs_encoder_type type,
+		      size_t audio_idx)
+{
+	return interleave_queue_last(&output->interleaved_packets, type,
+				     audio_idx);
+}
 
 /* gets the point where audio and video are closest together */
-static size_t get_interleaved_start_idx(struct obs_output *output)
+static struct encoder_packet *
+get_interleaved_start_packet(struct obs_output *output)
 {
 	int64_t closest_diff = 0x7FFFFFFFFFFFFFFFLL;
 	struct encoder_packet *first_video =
 		find_first_packet_type(output, OBS_ENCODER_VIDEO, 0);
-	size_t video_idx = DARRAY_INVALID;
-	size_t idx = 0;
-
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		int64_t diff;
-
-		if (packet->type != OBS_ENCODER_AUDIO) {
-			if (packet == first_video)
-				video_idx = i;
-			continue;
-		}
-
-		diff = llabs(packet->dts_usec - first_video->dts_usec);
-		if (diff < closest_diff) {
-			closest_diff = diff;
-			idx = i;
+	struct encoder_packet *closest = NULL;
+
+	for (size_t i = 1; i < INTERLEAVE_TRACKS; i++) {
+		struct interleave_track *track =
+			&output->interleaved_packets.tracks[i];
+
+		for (size_t j = 0; j < interleave_track_count(track); j++) {
+			struct encoder_packet *packet =
+				interleave_track_packet(track, j);
+			int64_t diff;
+
+			diff = llabs(packet->dts_usec - first_video->dts_usec);
+			if (diff < closest_diff ||
+			    (diff == closest_diff &&
+			     interleave_queue_before(packet, closest))) {
+				closest_diff = diff;
+				closest = packet;
+			}
 		}
 	}
 
-	return video_idx < idx ? video_idx : idx;
+	if (!closest)
+		return NULL;
+	return interleave_queue_before(first_video, closest) ? first_video
+							     : closest;
+}
+
+static void discard_to_interleaved_start(struct obs_output *output)
+{
+	struct encoder_packet *start = get_interleaved_start_packet(output);
+	if (start)
+		interleave_queue_discard(&output->interleaved_packets, start,
+					 false);
 }
 
-static int prune_premature_packets(struct obs_output *output)
+/* returns false if a track is missing, otherwise sets the last packet that
+ * needs to be pruned, or NULL if none need to be */
+static bool prune_premature_packets(struct obs_output *output,
+				    struct encoder_packet **last_premature)
 {
 	size_t audio_mixes = num_audio_mixes(output);
 	struct encoder_packet *video;
-	int video_idx;
-	int max_idx;
+	struct encoder_packet *last;
 	int64_t duration_usec;
 	int64_t max_diff = 0;
 	int64_t diff = 0;
 
-	video_idx = find_first_packet_type_idx(output, OBS_ENCODER_VIDEO, 0);
-	if (video_idx == -1) {
+	video = find_first_packet_type(output, OBS_ENCODER_VIDEO, 0);
+	if (!video) {
 		output->received_video = false;
-		return -1;
+		return false;
 	}
 
-	max_idx = video_idx;
-	video = &output->interleaved_packets.array[video_idx];
+	last = video;
 	duration_usec = video->timebase_num * 1000000LL / video->timebase_den;
 
 	for (size_t i = 0; i < audio_mixes; i++) {
 		struct encoder_packet *audio;
-		int audio_idx;
 
-		audio_idx = find_first_packet_type_idx(output,
-						       OBS_ENCODER_AUDIO, i);
-		if (audio_idx == -1) {
+		audio = find_first_packet_type(output, OBS_ENCODER_AUDIO, i);
+		if (!audio) {
 			output->received_audio = false;
-			return -1;
+			return false;
 		}
 
-		audio = &output->interleaved_packets.array[audio_idx];
-		if (audio_idx > max_idx)
-			max_idx = audio_idx;
+		if (interleave_queue_before(last, audio))
+			last = audio;
 
 		diff = audio->dts_usec - video->dts_usec;
 		if (diff > max_diff)
 			max_diff = diff;
 	}
 
-	return diff > duration_usec ? max_idx + 1 : 0;
+	*last_premature = diff > duration_usec ? last : NULL;
+	return true;
 }
 
-static void discard_to_idx(struct obs_output *output, size_t idx)
-{
-	for (size_t i = 0; i < idx; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		obs_encoder_packet_release(packet);
-	}
+#define DEBUG_STARTING_PACKETS 0
 
-	da_erase_range(output->interleaved_packets, 0, idx);
+#if DEBUG_STARTING_PACKETS == 1
+static void log_interleaved_packets(struct obs_output *output)
+{
+	for (size_t i = 0; i < INTERLEAVE_TRACKS; i++) {
+		struct interleave_track *track =
+			&output->interleaved_packets.tracks[i];
+
+		for (size_t j = 0; j < interleave_track_count(track); j++) {
+			struct encoder_packet *packet =
+				interleave_track_packet(track, j);
+			blog(LOG_DEBUG, "packet: %s %d, ts: %lld",
+			     packet->type == OBS_ENCODER_AUDIO ? "audio"
+							       : "video",
+			     (int)packet->track_idx, packet->dts_usec);
+		}
+	}
 }
-
-#define DEBUG_STARTING_PACKETS 0
+#endif
 
 static bool prune_interleaved_packets(struct obs_output *output)
 {
-	size_t start_idx = 0;
-	int prune_start = prune_premature_packets(output);
+	struct encoder_packet *last_premature = NULL;
+
+	if (!prune_premature_packets(output, &last_premature))
+		return false;
 
 #if DEBUG_STARTING_PACKETS == 1
-	blog(LOG_DEBUG, "--------- Pruning! %d ---------", prune_start);
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		blog(LOG_DEBUG, "packet: %s %d, ts: %lld, pruned = %s",
-		     packet->type == OBS_ENCODER_AUDIO ? "audio" : "video",
-		     (int)packet->track_idx, packet->dts_usec,
-		     (int)i < prune_start ? "true" : "false");
-	}
+	blog(LOG_DEBUG, "--------- Pruning! %s ---------",
+	     last_premature ? "premature" : "to start");
+	log_interleaved_packets(output);
 #endif
 
 	/* prunes the first video packet if it's too far away from audio */
-	if (prune_start == -1)
-		return false;
-	else if (prune_start != 0)
-		start_idx = (size_t)prune_start;
+	if (last_premature)
+		interleave_queue_discard(&output->interleaved_packets,
+					 last_premature, true);
 	else
-		start_idx = get_interleaved_start_idx(output);
-
-	if (start_idx)
-		discard_to_idx(output, start_idx);
+		discard_to_interleaved_start(output);
 
 	return true;
 }
 
-static int find_first_packet_type_idx(struct obs_output *output,
-				      enum obs_encoder_type type,
-				      size_t audio_idx)
-{
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-
-		if (packet->type == type) {
-			if (type == OBS_ENCODER_AUDIO &&
-			    packet->track_idx != audio_idx) {
-				continue;
-			}
-
-			return (int)i;
-		}
-	}
-
-	return -1;
-}
-
-static int find_last_packet_type_idx(struct obs_output *output,
-				     enum obs_encoder_type type,
-				     size_t audio_idx)
-{
-	for (size_t i = output->interleaved_packets.num; i > 0; i--) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i - 1];
-
-		if (packet->type == type) {
-			if (type == OBS_ENCODER_AUDIO &&
-			    packet->track_idx != audio_idx) {
-				continue;
-			}
-
-			return (int)(i - 1);
-		}
-	}
-
-	return -1;
-}
-
-static inline struct encoder_packet *
-find_first_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		       size_t audio_idx)
-{
-	int idx = find_first_packet_type_idx(output, type, audio_idx);
-	return (idx != -1) ? &output->interleaved_packets.array[idx] : NULL;
-}
-
-static inline struct encoder_packet *
-find_last_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		      size_t audio_idx)
-{
-	int idx = find_last_packet_type_idx(output, type, audio_idx);
-	return (idx != -1) ? &output->interleaved_packets.array[idx] : NULL;
-}
-
 static bool get_audio_and_video_packets(struct obs_output *output,
 					struct encoder_packet **video,
 					struct encoder_packet **audio,
@@ -1518,7 +1477,6 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 	struct encoder_packet *audio[MAX_AUDIO_MIXES];
 	struct encoder_packet *last_audio[MAX_AUDIO_MIXES];
 	size_t audio_mixes = num_audio_mixes(output);
-	size_t start_idx;
 
 	if (!get_audio_and_video_packets(output, &video, audio, audio_mixes))
 		return false;
@@ -1536,13 +1494,9 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 	}
 
 	/* clear out excess starting audio if it hasn't been already */
-	start_idx = get_interleaved_start_idx(output);
-	if (start_idx) {
-		discard_to_idx(output, start_idx);
-		if (!get_audio_and_video_packets(output, &video, audio,
-						 audio_mixes))
-			return false;
-	}
+	discard_to_interleaved_start(output);
+	if (!get_audio_and_video_packets(output, &video, audio, audio_mixes))
+		return false;
 
 	/* get new offsets */
 	output->video_offset = video->pts;
@@ -1565,63 +1519,36 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 	output->highest_video_ts -= video->dts_usec;
 
 	/* apply new offsets to all existing packet DTS/PTS values */
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		apply_interleaved_packet_offset(output, packet);
-	}
+	for (size_t i = 0; i < INTERLEAVE_TRACKS; i++) {
+		struct interleave_track *track =
+			&output->interleaved_packets.tracks[i];
 
-	return true;
-}
-
-static inline void insert_interleaved_packet(struct obs_output *output,
-					     struct encoder_packet *out)
-{
-	size_t idx;
-	for (idx = 0; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *cur_packet;
-		cur_packet = output->interleaved_packets.array + idx;
-
-		if (out->dts_usec == cur_packet->dts_usec &&
-		    out->type == OBS_ENCODER_VIDEO) {
-			break;
-		} else if (out->dts_usec < cur_packet->dts_usec) {
-			break;
-		}
+		for (size_t j = 0; j < interleave_track_count(track); j++)
+			apply_interleaved_packet_offset(
+				output, interleave_track_packet(track, j));
 	}
 
-	da_insert(output->interleaved_packets, idx, out);
+	return true;
 }
 
-static void resort_interleaved_packets(struct obs_output *output)
+/* every packet of a track gets the same offset, so the tracks themselves stay
+ * sorted and only the merge order between them needs to be rebuilt */
+static inline void resort_interleaved_packets(struct obs_output *output)
 {
-	DARRAY(struct encoder_packet) old_array;
-
-	old_array.da = output->interleaved_packets.da;
-	memset(&output->interleaved_packets, 0,
-	       sizeof(output->interleaved_packets));
-
-	for (size_t i = 0; i < old_array.num; i++)
-		insert_interleaved_packet(output, &old_array.array[i]);
-
-	da_free(old_array);
+	interleave_queue_resort(&output->interleaved_packets);
 }
 
 static void discard_unused_audio_packets(struct obs_output *output,
 					 int64_t dts_usec)
 {
-	size_t idx = 0;
-
-	for (; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *p =
-			&output->interleaved_packets.array[idx];
+	struct interleave_queue *queue = &output->interleaved_packets;
+	struct encoder_packet *p;
 
-		if (p->dts_usec >= dts_usec)
-			break;
+	while ((p = interleave_queue_peek(queue)) && p->dts_usec < dts_usec) {
+		struct encoder_packet out;
+		interleave_queue_pop(queue, &out);
+		obs_encoder_packet_release(&out);
 	}
-
-	if (idx)
-		discard_to_idx(output, idx);
 }
 
 static void interleave_packets(void *data, struct encoder_packet *packet)
@@ -1654,14 +1581,14 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 	if (output->active_delay_ns)
 		out = *packet;
 	else
-		obs_encoder_packet_create_instance(&out, packet);
+		obs_encoder_packet_ref(&out, packet);
 
 	if (was_started)
 		apply_interleaved_packet_offset(output, &out);
 	else
 		check_received(output, packet);
 
-	insert_interleaved_packet(output, &out);
+	interleave_queue_push(&output->interleaved_packets, &out);
 	set_higher_ts(output, &out);
 
 	/* when both video and audio have been received, we're ready
@@ -1892,8 +1819,9 @@ static void hook_data_capture(struct obs_output *output, bool encoded,
 	} else {
 		if (has_video)
 			start_raw_video(output->video,
-					get_video_conversion(output),
-					default_raw_video_callback, output);
+					get_video_conversion(output), NULL,
+					false, default_raw_video_callback,
+					output);
 		if (has_audio)
 			start_raw_audio(output);
 	}
@@ -2138,6 +2066,7 @@ bool obs_output_begin_data_capture(obs_output_t *output, uint32_t flags)
 	if (has_video && has_audio)
 		pair_encoders(output, num_mixes);
 
+	os_atomic_set_long(&output->frame_skip, 0);
 	os_atomic_set_bool(&output->data_active, true);
 	hook_data_capture(output, encoded, has_video, has_audio);
 
@@ -2536,6 +2465,14 @@ float obs_output_get_congestion(obs_output_t *output)
 	return 0;
 }
 
+void obs_output_set_frame_skip(obs_output_t *output, uint32_t interval)
+{
+	if (!obs_output_valid(output, "obs_output_set_frame_skip"))
+		return;
+
+	os_atomic_set_long(&output->frame_skip, (long)interval);
+}
+
 int obs_output_get_connect_time_ms(obs_output_t *output)
 {
 	if (!obs_output_valid(output, "obs_output_get_connect_time_ms"))
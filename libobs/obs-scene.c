@@ -19,6 +19,7 @@
 #include "util/threading.h"
 #include "util/util_uint64.h"
 #include "graphics/math-defs.h"
+#include "media-io/audio-mix.h"
 #include "obs-scene.h"
 
 const struct obs_source_info group_info;
@@ -27,6 +28,8 @@ static void resize_group(obs_sceneitem_t *group);
 static void resize_scene(obs_scene_t *scene);
 static void signal_parent(obs_scene_t *parent, const char *name,
 			  calldata_t *params);
+static void scene_mark_dirty(obs_scene_t *scene);
+static void set_update_transform(obs_sceneitem_t *item);
 static void get_ungrouped_transform(obs_sceneitem_t *group, struct vec2 *pos,
 				    struct vec2 *scale, float *rot);
 static inline bool crop_enabled(const struct obs_sceneitem_crop *crop);
@@ -86,6 +89,7 @@ static void *scene_create(obs_data_t *settings, struct obs_source *source)
 	pthread_mutexattr_t attr;
 	struct obs_scene *scene = bzalloc(sizeof(struct obs_scene));
 	scene->source = source;
+	scene->update_transforms = true;
 
 	if (strcmp(source->info.id, group_info.id) == 0) {
 		scene->is_group = true;
@@ -244,6 +248,8 @@ static inline void attach_sceneitem(struct obs_scene *parent,
 	item->prev = prev;
 	item->parent = parent;
 
+	set_update_transform(item);
+
 	if (prev) {
 		item->next = prev->next;
 		if (prev->next)
@@ -334,6 +340,49 @@ static inline uint32_t calc_cy(const struct obs_scene_item *item,
 	return (crop_cy > height) ? 2 : (height - crop_cy);
 }
 
+static inline void expand_box(struct vec2 *minv, struct vec2 *maxv, float x,
+			      float y)
+{
+	if (x < minv->x)
+		minv->x = x;
+	if (y < minv->y)
+		minv->y = y;
+	if (x > maxv->x)
+		maxv->x = x;
+	if (y > maxv->y)
+		maxv->y = y;
+}
+
+static void transform_box(const struct matrix4 *transform, float cx, float cy,
+			  struct vec2 *minv, struct vec2 *maxv)
+{
+	vec2_set(minv, M_INFINITE, M_INFINITE);
+	vec2_set(maxv, -M_INFINITE, -M_INFINITE);
+
+	for (int i = 0; i < 4; i++) {
+		struct vec3 v;
+
+		vec3_set(&v, (i & 1) ? cx : 0.0f, (i & 2) ? cy : 0.0f, 0.0f);
+		vec3_transform(&v, &v, transform);
+		expand_box(minv, maxv, v.x, v.y);
+	}
+}
+
+static void update_item_boxes(struct obs_scene_item *item, uint32_t cx,
+			      uint32_t cy)
+{
+	const struct matrix4 *draw = &item->draw_transform;
+
+	transform_box(&item->box_transform, 1.0f, 1.0f, &item->box_min,
+		      &item->box_max);
+	transform_box(draw, (float)cx, (float)cy, &item->draw_min,
+		      &item->draw_max);
+
+	item->draw_axis_aligned =
+		(fabsf(draw->x.y) < EPSILON && fabsf(draw->y.x) < EPSILON) ||
+		(fabsf(draw->x.x) < EPSILON && fabsf(draw->y.y) < EPSILON);
+}
+
 static void update_item_transform(struct obs_scene_item *item, bool update_tex)
 {
 	uint32_t width;
@@ -409,6 +458,8 @@ static void update_item_transform(struct obs_scene_item *item, bool update_tex)
 	matrix4_translate3f(&item->box_transform, &item->box_transform,
 			    item->pos.x, item->pos.y, 0.0f);
 
+	update_item_boxes(item, width, height);
+
 	/* ----------------------- */
 
 	calldata_init_fixed(&params, stack, sizeof(stack));
@@ -600,6 +651,62 @@ static void scene_video_tick(void *data, float seconds)
 	UNUSED_PARAMETER(seconds);
 }
 
+/* items only have to be checked when one of them has changed, or when a
+ * source was removed or changed size since they were last checked */
+static bool scene_needs_update(obs_scene_t *scene)
+{
+	long gen = os_atomic_load_long(&obs->data.scene_update_gen);
+	bool update = os_atomic_set_bool(&scene->update_transforms, false);
+
+	if (scene->last_update_gen != gen) {
+		scene->last_update_gen = gen;
+		update = true;
+	}
+
+	return update;
+}
+
+/* besides the items, their transforms also change when sources are removed
+ * or change size, which scene_update_gen counts */
+bool obs_scene_static_video_gen(obs_scene_t *scene, uint64_t *gen)
+{
+	struct obs_scene_item *item;
+	bool is_static = true;
+	uint64_t count = 0;
+
+	*gen = static_video_gen_add(
+		STATIC_VIDEO_GEN_INIT,
+		(uint64_t)os_atomic_load_long(&obs->data.scene_update_gen));
+
+	video_lock(scene);
+	for (item = scene->first_item; item && is_static; item = item->next) {
+		uint64_t item_gen;
+
+		if (!item->user_visible)
+			continue;
+
+		is_static = obs_source_static_video_gen(item->source,
+							&item_gen);
+		*gen = static_video_gen_add(*gen, (uint64_t)item->id);
+		*gen = static_video_gen_add(*gen, item_gen);
+		count++;
+	}
+	video_unlock(scene);
+
+	*gen = static_video_gen_add(*gen, count);
+	return is_static;
+}
+
+static const char *scene_update_name(obs_scene_t *scene)
+{
+	if (!scene->profile_update_name)
+		scene->profile_update_name = profile_store_name(
+			obs_get_profiler_name_store(), "update_transforms(%s)",
+			obs_source_get_name(scene->source));
+
+	return scene->profile_update_name;
+}
+
 /* assumes video lock */
 static void
 update_transforms_and_prune_sources(obs_scene_t *scene,
@@ -626,10 +733,13 @@ update_transforms_and_prune_sources(obs_scene_t *scene,
 		if (item->is_group) {
 			obs_scene_t *group_scene = item->source->context.data;
 
-			video_lock(group_scene);
-			update_transforms_and_prune_sources(group_scene,
-							    remove_items, item);
-			video_unlock(group_scene);
+			if (scene_needs_update(group_scene) ||
+			    os_atomic_load_bool(&item->update_group_resize)) {
+				video_lock(group_scene);
+				update_transforms_and_prune_sources(
+					group_scene, remove_items, item);
+				video_unlock(group_scene);
+			}
 		}
 
 		if (os_atomic_load_bool(&item->update_transform) ||
@@ -646,6 +756,95 @@ update_transforms_and_prune_sources(obs_scene_t *scene,
 		resize_group(group_sceneitem);
 }
 
+#define MAX_OCCLUDERS 8
+
+static const char *culled_outside_name = "scene items: skipped outside";
+static const char *culled_occluded_name = "scene items: skipped occluded";
+
+static inline bool item_outside(const struct obs_scene_item *item, float cx,
+				float cy)
+{
+	const struct vec2 *minv = &item->draw_min;
+	const struct vec2 *maxv = &item->draw_max;
+
+	return maxv->x <= 0.0f || maxv->y <= 0.0f || minv->x >= cx ||
+	       minv->y >= cy || maxv->x - minv->x < EPSILON ||
+	       maxv->y - minv->y < EPSILON;
+}
+
+static inline bool item_covered(const struct obs_scene_item *item,
+				const struct vec2 *minv,
+				const struct vec2 *maxv)
+{
+	return item->draw_min.x >= minv->x && item->draw_min.y >= minv->y &&
+	       item->draw_max.x <= maxv->x && item->draw_max.y <= maxv->y;
+}
+
+/* marks the visible items that don't have to be drawn, either because they
+ * are entirely outside of the scene or cropped away, or because opaque items
+ * above them cover them completely.  items are walked from the top down,
+ * remembering the first few unrotated opaque items as occluders.  groups
+ * aren't clipped to their size while being resized, so only scenes skip items
+ * outside of them.  assumes video lock */
+static void cull_items(struct obs_scene *scene)
+{
+	struct vec2 occluder_min[MAX_OCCLUDERS];
+	struct vec2 occluder_max[MAX_OCCLUDERS];
+	size_t occluders = 0;
+	int64_t outside = 0;
+	int64_t occluded = 0;
+	float cx = (float)obs_source_get_width(scene->source);
+	float cy = (float)obs_source_get_height(scene->source);
+	struct obs_scene_item *item = scene->first_item;
+
+	while (item && item->next)
+		item = item->next;
+
+	for (; item; item = item->prev) {
+		bool covered = false;
+
+		item->draw_culled = false;
+
+		/* items of sources without a size yet are always drawn */
+		if (!item->user_visible || !item->last_width ||
+		    !item->last_height)
+			continue;
+
+		if (!scene->is_group && item_outside(item, cx, cy)) {
+			item->draw_culled = true;
+			outside++;
+			continue;
+		}
+
+		for (size_t i = 0; i < occluders && !covered; i++)
+			covered = item_covered(item, &occluder_min[i],
+					       &occluder_max[i]);
+
+		if (covered) {
+			item->draw_culled = true;
+			occluded++;
+			continue;
+		}
+
+		/* only whole pixels are certain to be covered */
+		if (occluders < MAX_OCCLUDERS && item->draw_axis_aligned &&
+		    obs_source_video_opaque(item->source)) {
+			vec2_set(&occluder_min[occluders],
+				 ceilf(item->draw_min.x),
+				 ceilf(item->draw_min.y));
+			vec2_set(&occluder_max[occluders],
+				 floorf(item->draw_max.x),
+				 floorf(item->draw_max.y));
+			occluders++;
+		}
+	}
+
+	if (outside)
+		profile_count(culled_outside_name, outside);
+	if (occluded)
+		profile_count(culled_occluded_name, occluded);
+}
+
 static void scene_video_render(void *data, gs_effect_t *effect)
 {
 	DARRAY(struct obs_scene_item *) remove_items;
@@ -656,17 +855,23 @@ static void scene_video_render(void *data, gs_effect_t *effect)
 
 	video_lock(scene);
 
-	if (!scene->is_group) {
+	if (!scene->is_group && scene_needs_update(scene)) {
+		const char *name = scene_update_name(scene);
+
+		profile_start(name);
 		update_transforms_and_prune_sources(scene, &remove_items.da,
 						    NULL);
+		profile_end(name);
 	}
 
+	cull_items(scene);
+
 	gs_blend_state_push();
 	gs_reset_blend_state();
 
 	item = scene->first_item;
 	while (item) {
-		if (item->user_visible)
+		if (item->user_visible && !item->draw_culled)
 			render_item(item);
 
 		item = item->next;
@@ -1045,27 +1250,16 @@ static void process_all_audio_actions(struct obs_scene_item *item,
 		;
 }
 
-static void mix_audio_with_buf(float *p_out, float *p_in, float *buf_in,
-			       size_t pos, size_t count)
+static inline void mix_audio_with_buf(float *p_out, float *p_in, float *buf_in,
+				      size_t pos, size_t count)
 {
-	register float *out = p_out;
-	register float *buf = buf_in + pos;
-	register float *in = p_in + pos;
-	register float *end = in + count;
-
-	while (in < end)
-		*(out++) += *(in++) * *(buf++);
+	audio_mix_add_mul(p_out, p_in + pos, buf_in + pos, count);
 }
 
 static inline void mix_audio(float *p_out, float *p_in, size_t pos,
 			     size_t count)
 {
-	register float *out = p_out;
-	register float *in = p_in + pos;
-	register float *end = in + count;
-
-	while (in < end)
-		*(out++) += *(in++);
+	audio_mix_add(p_out, p_in + pos, count);
 }
 
 static bool scene_audio_render(void *data, uint64_t *ts_out,
@@ -1283,6 +1477,11 @@ static inline void duplicate_item_data(struct obs_scene_item *dst,
 	dst->scale_filter = src->scale_filter;
 	dst->box_transform = src->box_transform;
 	dst->box_scale = src->box_scale;
+	dst->box_min = src->box_min;
+	dst->box_max = src->box_max;
+	dst->draw_min = src->draw_min;
+	dst->draw_max = src->draw_max;
+	dst->draw_axis_aligned = src->draw_axis_aligned;
 	dst->draw_transform = src->draw_transform;
 	dst->bounds_type = src->bounds_type;
 	dst->bounds_align = src->bounds_align;
@@ -1302,7 +1501,7 @@ static inline void duplicate_item_data(struct obs_scene_item *dst,
 	obs_sceneitem_set_crop(dst, &src->crop);
 
 	if (defer_texture_update) {
-		os_atomic_set_bool(&dst->update_transform, true);
+		set_update_transform(dst);
 	} else {
 		if (!dst->item_render && item_texture_enabled(dst)) {
 			obs_enter_graphics();
@@ -1644,6 +1843,10 @@ static void sceneitem_renamed(void *param, calldata_t *data)
 	const char *name = calldata_string(data, "new_name");
 
 	sceneitem_rename_hotkey(scene_item, name);
+
+	/* items are saved with the name of their source */
+	if (scene_item->parent)
+		scene_mark_dirty(scene_item->parent);
 }
 
 static inline bool source_has_audio(obs_source_t *source)
@@ -1699,6 +1902,7 @@ static obs_sceneitem_t *obs_scene_add_internal(obs_scene_t *scene,
 	vec2_set(&item->scale, 1.0f, 1.0f);
 	matrix4_identity(&item->draw_transform);
 	matrix4_identity(&item->box_transform);
+	vec2_set(&item->box_max, 1.0f, 1.0f);
 
 	obs_source_addref(source);
 
@@ -1739,6 +1943,9 @@ static obs_sceneitem_t *obs_scene_add_internal(obs_scene_t *scene,
 
 	full_unlock(scene);
 
+	set_update_transform(item);
+	scene_mark_dirty(scene);
+
 	if (!scene->source->context.private)
 		init_hotkeys(scene, item, obs_source_get_name(source));
 
@@ -1843,9 +2050,23 @@ obs_source_t *obs_sceneitem_get_source(const obs_sceneitem_t *item)
 	return item ? item->source : NULL;
 }
 
+static void scene_mark_dirty(obs_scene_t *scene)
+{
+	obs_source_mark_dirty(scene->source);
+
+	/* group items are also saved by the scene that contains the group */
+	if (scene->is_group)
+		os_atomic_inc_long(&obs->data.scene_save_gen);
+}
+
+/* every item change is signaled, so this is also where scenes are marked as
+ * needing to be saved and drawn again */
 static void signal_parent(obs_scene_t *parent, const char *command,
 			  calldata_t *params)
 {
+	scene_mark_dirty(parent);
+	os_atomic_inc_long(&parent->source->video_gen);
+
 	calldata_set_ptr(params, "scene", parent);
 	signal_handler_signal(parent->source->context.signals, command, params);
 }
@@ -1872,12 +2093,28 @@ bool obs_sceneitem_selected(const obs_sceneitem_t *item)
 	return item ? item->selected : false;
 }
 
-#define do_update_transform(item)                                          \
-	do {                                                               \
-		if (!item->parent || item->parent->is_group)               \
-			os_atomic_set_bool(&item->update_transform, true); \
-		else                                                       \
-			update_item_transform(item, false);                \
+static void set_update_transform(obs_sceneitem_t *item)
+{
+	os_atomic_set_bool(&item->update_transform, true);
+
+	/* groups are updated by the scenes that contain them */
+	if (!item->parent)
+		return;
+
+	os_atomic_inc_long(&item->parent->source->video_gen);
+
+	if (item->parent->is_group)
+		os_atomic_inc_long(&obs->data.scene_update_gen);
+	else
+		os_atomic_set_bool(&item->parent->update_transforms, true);
+}
+
+#define do_update_transform(item)                           \
+	do {                                                \
+		if (!item->parent || item->parent->is_group) \
+			set_update_transform(item);         \
+		else                                        \
+			update_item_transform(item, false); \
 	} while (false)
 
 void obs_sceneitem_set_pos(obs_sceneitem_t *item, const struct vec2 *pos)
@@ -2314,7 +2551,7 @@ void obs_sceneitem_set_crop(obs_sceneitem_t *item,
 	if (item->crop.bottom < 0)
 		item->crop.bottom = 0;
 
-	os_atomic_set_bool(&item->update_transform, true);
+	set_update_transform(item);
 }
 
 void obs_sceneitem_get_crop(const obs_sceneitem_t *item,
@@ -2336,7 +2573,7 @@ void obs_sceneitem_set_scale_filter(obs_sceneitem_t *item,
 
 	item->scale_filter = filter;
 
-	os_atomic_set_bool(&item->update_transform, true);
+	set_update_transform(item);
 }
 
 enum obs_scale_type obs_sceneitem_get_scale_filter(obs_sceneitem_t *item)
@@ -2376,8 +2613,10 @@ void obs_sceneitem_defer_group_resize_end(obs_sceneitem_t *item)
 	if (!obs_ptr_valid(item, "obs_sceneitem_defer_group_resize_end"))
 		return;
 
-	if (os_atomic_dec_long(&item->defer_group_resize) == 0)
+	if (os_atomic_dec_long(&item->defer_group_resize) == 0) {
 		os_atomic_set_bool(&item->update_group_resize, true);
+		set_update_transform(item);
+	}
 }
 
 int64_t obs_sceneitem_get_id(const obs_sceneitem_t *item)
@@ -2393,6 +2632,9 @@ obs_data_t *obs_sceneitem_get_private_settings(obs_sceneitem_t *item)
 	if (!obs_ptr_valid(item, "obs_sceneitem_get_private_settings"))
 		return NULL;
 
+	if (item->parent)
+		scene_mark_dirty(item->parent);
+
 	obs_data_addref(item->private_settings);
 	return item->private_settings;
 }
@@ -2485,35 +2727,19 @@ static bool resize_scene_base(obs_scene_t *scene, struct vec2 *minv,
 	}
 
 	while (item) {
-#define get_min_max(x_val, y_val)                             \
-	do {                                                  \
-		struct vec3 v;                                \
-		vec3_set(&v, x_val, y_val, 0.0f);             \
-		vec3_transform(&v, &v, &item->box_transform); \
-		if (v.x < minv->x)                            \
-			minv->x = v.x;                        \
-		if (v.y < minv->y)                            \
-			minv->y = v.y;                        \
-		if (v.x > maxv->x)                            \
-			maxv->x = v.x;                        \
-		if (v.y > maxv->y)                            \
-			maxv->y = v.y;                        \
-	} while (false)
-
-		get_min_max(0.0f, 0.0f);
-		get_min_max(1.0f, 0.0f);
-		get_min_max(0.0f, 1.0f);
-		get_min_max(1.0f, 1.0f);
-#undef get_min_max
-
+		expand_box(minv, maxv, item->box_min.x, item->box_min.y);
+		expand_box(minv, maxv, item->box_max.x, item->box_max.y);
 		item = item->next;
 	}
 
-	item = scene->first_item;
-	while (item) {
-		vec2_sub(&item->pos, &item->pos, minv);
-		update_item_transform(item, false);
-		item = item->next;
+	/* items only need to be moved if the top left corner moved */
+	if (minv->x != 0.0f || minv->y != 0.0f) {
+		item = scene->first_item;
+		while (item) {
+			vec2_sub(&item->pos, &item->pos, minv);
+			update_item_transform(item, false);
+			item = item->next;
+		}
 	}
 
 	vec2_sub(scale, maxv, minv);
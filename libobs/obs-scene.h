@@ -68,6 +68,19 @@ struct obs_scene_item {
 	struct vec2 box_scale;
 	struct matrix4 draw_transform;
 
+	/* axis-aligned bounds of the box transform within the scene, updated
+	 * along with the transforms */
+	struct vec2 box_min;
+	struct vec2 box_max;
+
+	/* axis-aligned bounds of what the draw transform draws, and whether it
+	 * is drawn without rotation, used to skip items that are hidden behind
+	 * opaque items or outside of the scene */
+	struct vec2 draw_min;
+	struct vec2 draw_max;
+	bool draw_axis_aligned;
+	bool draw_culled;
+
 	enum obs_bounds_type bounds_type;
 	uint32_t bounds_align;
 	struct vec2 bounds;
@@ -94,6 +107,13 @@ struct obs_scene {
 
 	int64_t id_counter;
 
+	/* set when the transform of an item needs to be updated, otherwise
+	 * the items are only checked again when obs->data.scene_update_gen
+	 * changes */
+	volatile bool update_transforms;
+	long last_update_gen;
+	const char *profile_update_name;
+
 	pthread_mutex_t video_mutex;
 	pthread_mutex_t audio_mutex;
 	struct obs_scene_item *first_item;
@@ -432,6 +432,8 @@ void obs_source_set_deinterlace_mode(obs_source_t *source,
 	if (source->deinterlace_mode == mode)
 		return;
 
+	obs_source_mark_dirty(source);
+
 	if (source->deinterlace_mode == OBS_DEINTERLACE_MODE_DISABLE) {
 		enable_deinterlacing(source, mode);
 	} else if (mode == OBS_DEINTERLACE_MODE_DISABLE) {
@@ -458,6 +460,8 @@ void obs_source_set_deinterlace_field_order(
 	if (!obs_source_valid(source, "obs_source_set_deinterlace_field_order"))
 		return;
 
+	obs_source_mark_dirty(source);
+
 	source->deinterlace_top_first = field_order ==
 					OBS_DEINTERLACE_FIELD_ORDER_TOP;
 }
@@ -0,0 +1,406 @@
+/******************************************************************************
+    Copyright (C) 2020 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "util/platform.h"
+#include "util/dstr.h"
+#include "obs-internal.h"
+
+/* Filters with OBS_SOURCE_FUSABLE_FILTER only provide a fragment of an
+ * effect, with a '$' in front of every name it declares.  The effect of a
+ * single filter is the fragment with the '$' removed, and runs of such filters
+ * are drawn with one effect that contains the fragments of all of them with a
+ * different prefix for each, calling them one after another for every pixel */
+
+static const char *effect_header = "\
+uniform float4x4 ViewProj;\n\
+uniform texture2d image;\n\
+\n\
+sampler_state textureSampler {\n\
+	Filter    = Linear;\n\
+	AddressU  = Clamp;\n\
+	AddressV  = Clamp;\n\
+};\n\
+\n\
+struct VertData {\n\
+	float4 pos : POSITION;\n\
+	float2 uv  : TEXCOORD0;\n\
+};\n\
+\n\
+VertData VSDefault(VertData v_in)\n\
+{\n\
+	VertData vert_out;\n\
+	vert_out.pos = mul(float4(v_in.pos.xyz, 1.0), ViewProj);\n\
+	vert_out.uv  = v_in.uv;\n\
+	return vert_out;\n\
+}\n\
+\n";
+
+static const char *effect_footer = "\
+	return rgba;\n\
+}\n\
+\n\
+technique Draw\n\
+{\n\
+	pass\n\
+	{\n\
+		vertex_shader = VSDefault(v_in);\n\
+		pixel_shader  = PSFilter(v_in);\n\
+	}\n\
+}\n";
+
+static const char *call_clamped = "\trgba = saturate(%sProcess(rgba));\n";
+static const char *call_last = "\trgba = %sProcess(rgba);\n";
+
+static const char *fused_passes_name = "filter passes: fused";
+
+static inline void fragment_prefix(struct dstr *prefix, size_t idx,
+				   size_t count)
+{
+	if (count > 1)
+		dstr_printf(prefix, "f%d_", (int)idx);
+	else
+		dstr_free(prefix);
+}
+
+/* the result of each filter is clamped before it is passed on, the same way
+ * it would be when it is rendered to a texture */
+static char *build_effect(struct obs_filter_fragment **fragments,
+			  size_t count)
+{
+	struct dstr effect = {0};
+	struct dstr fragment = {0};
+	struct dstr prefix = {0};
+
+	dstr_copy(&effect, effect_header);
+
+	for (size_t i = 0; i < count; i++) {
+		fragment_prefix(&prefix, i, count);
+		dstr_copy(&fragment, fragments[i]->text);
+		dstr_replace(&fragment, "$", prefix.array);
+		dstr_cat_dstr(&effect, &fragment);
+		dstr_cat(&effect, "\n");
+	}
+
+	dstr_cat(&effect, "float4 PSFilter(VertData v_in) : TARGET\n{\n");
+	dstr_cat(&effect,
+		 "\tfloat4 rgba = image.Sample(textureSampler, v_in.uv);\n");
+
+	for (size_t i = 0; i < count; i++) {
+		const char *format = i + 1 < count ? call_clamped : call_last;
+
+		fragment_prefix(&prefix, i, count);
+		dstr_catf(&effect, format, prefix.len ? prefix.array : "");
+	}
+
+	dstr_cat(&effect, effect_footer);
+
+	dstr_free(&fragment);
+	dstr_free(&prefix);
+	return effect.array;
+}
+
+static struct obs_filter_fragment *find_fragment_by_file(const char *file)
+{
+	struct obs_core_video *video = &obs->video;
+
+	for (size_t i = 0; i < video->filter_fragments.num; i++) {
+		struct obs_filter_fragment *fragment =
+			video->filter_fragments.array + i;
+		if (strcmp(fragment->file, file) == 0)
+			return fragment;
+	}
+
+	return NULL;
+}
+
+static struct obs_filter_fragment *find_fragment(gs_effect_t *effect)
+{
+	struct obs_core_video *video = &obs->video;
+
+	if (!effect)
+		return NULL;
+
+	for (size_t i = 0; i < video->filter_fragments.num; i++) {
+		struct obs_filter_fragment *fragment =
+			video->filter_fragments.array + i;
+		if (fragment->effect == effect)
+			return fragment;
+	}
+
+	return NULL;
+}
+
+gs_effect_t *obs_filter_fragment_create(const char *file, char **error_string)
+{
+	struct obs_filter_fragment fragment;
+	struct obs_filter_fragment *existing;
+	struct obs_filter_fragment *fragments[1];
+	char *text;
+
+	if (!obs || !file || !gs_get_context())
+		return NULL;
+
+	existing = find_fragment_by_file(file);
+	if (existing)
+		return existing->effect;
+
+	fragment.text = os_quick_read_utf8_file(file);
+	if (!fragment.text) {
+		blog(LOG_ERROR, "Could not load effect fragment '%s'", file);
+		return NULL;
+	}
+
+	fragments[0] = &fragment;
+	text = build_effect(fragments, 1);
+
+	/* created with the file name, so graphics keeps it until it is
+	 * destroyed, along with other effects created from files */
+	fragment.effect = gs_effect_create(text, file, error_string);
+	bfree(text);
+
+	if (!fragment.effect) {
+		bfree(fragment.text);
+		return NULL;
+	}
+
+	fragment.file = bstrdup(file);
+	da_push_back(obs->video.filter_fragments, &fragment);
+	return fragment.effect;
+}
+
+bool obs_filter_fragment_valid(gs_effect_t *effect)
+{
+	return find_fragment(effect) != NULL;
+}
+
+static inline bool is_filter_param(const char *name)
+{
+	return strcmp(name, "ViewProj") != 0 && strcmp(name, "image") != 0;
+}
+
+void obs_filter_fuse_save(obs_source_t *filter, gs_effect_t *effect)
+{
+	size_t num = gs_effect_get_num_params(effect);
+
+	filter->filter_fuse_effect = effect;
+	da_resize(filter->filter_fuse_params, 0);
+
+	for (size_t i = 0; i < num; i++) {
+		gs_eparam_t *param = gs_effect_get_param_by_idx(effect, i);
+		size_t size = gs_effect_get_val_size(param);
+		void *val = gs_effect_get_val(param);
+
+		if (!val) {
+			size = gs_effect_get_default_val_size(param);
+			val = gs_effect_get_default_val(param);
+		}
+
+		da_push_back_array(filter->filter_fuse_params, &size,
+				   sizeof(size));
+		if (size)
+			da_push_back_array(filter->filter_fuse_params, val,
+					   size);
+		bfree(val);
+	}
+}
+
+void obs_filter_fuse_restore(obs_source_t *filter)
+{
+	gs_effect_t *effect = filter->filter_fuse_effect;
+	const uint8_t *vals = filter->filter_fuse_params.array;
+	const uint8_t *end = vals + filter->filter_fuse_params.num;
+	size_t num = gs_effect_get_num_params(effect);
+
+	for (size_t i = 0; i < num && vals < end; i++) {
+		gs_eparam_t *param = gs_effect_get_param_by_idx(effect, i);
+		struct gs_effect_param_info info;
+		size_t size;
+
+		memcpy(&size, vals, sizeof(size));
+		vals += sizeof(size);
+
+		gs_effect_get_param_info(param, &info);
+		if (size && is_filter_param(info.name))
+			gs_effect_set_val(param, vals, size);
+		vals += size;
+	}
+}
+
+static bool map_params(struct obs_fused_effect *fused,
+		       struct obs_filter_fragment **fragments, size_t count)
+{
+	struct dstr prefix = {0};
+	struct dstr name = {0};
+	bool success = true;
+
+	for (size_t i = 0; i < count; i++) {
+		gs_effect_t *effect = fragments[i]->effect;
+		size_t num = gs_effect_get_num_params(effect);
+
+		fragment_prefix(&prefix, i, count);
+
+		for (size_t j = 0; j < num; j++) {
+			gs_eparam_t *param =
+				gs_effect_get_param_by_idx(effect, j);
+			gs_eparam_t *fused_param = NULL;
+			struct gs_effect_param_info info;
+
+			gs_effect_get_param_info(param, &info);
+
+			if (is_filter_param(info.name)) {
+				dstr_copy_dstr(&name, &prefix);
+				dstr_cat(&name, info.name);
+				fused_param = gs_effect_get_param_by_name(
+					fused->effect, name.array);
+				if (!fused_param)
+					success = false;
+			}
+
+			da_push_back(fused->params, &fused_param);
+		}
+	}
+
+	dstr_free(&prefix);
+	dstr_free(&name);
+	return success;
+}
+
+static struct obs_fused_effect *
+create_fused_effect(const char *key, struct obs_filter_fragment **fragments,
+		    size_t count)
+{
+	struct obs_fused_effect fused = {0};
+	char *error = NULL;
+	char *text;
+
+	text = build_effect(fragments, count);
+	fused.effect = gs_effect_create(text, key, &error);
+	bfree(text);
+
+	if (!fused.effect) {
+		blog(LOG_WARNING,
+		     "Failed to create fused filter effect '%s': %s", key,
+		     error ? error : "(unknown error)");
+		bfree(error);
+		return NULL;
+	}
+
+	if (!map_params(&fused, fragments, count)) {
+		blog(LOG_WARNING, "Missing params in fused filter effect '%s'",
+		     key);
+		da_free(fused.params);
+		return NULL;
+	}
+
+	fused.key = bstrdup(key);
+	da_push_back(obs->video.fused_effects, &fused);
+	return da_end(obs->video.fused_effects);
+}
+
+static struct obs_fused_effect *find_fused_effect(const char *key)
+{
+	struct obs_core_video *video = &obs->video;
+
+	for (size_t i = 0; i < video->fused_effects.num; i++) {
+		struct obs_fused_effect *fused = video->fused_effects.array + i;
+		if (strcmp(fused->key, key) == 0)
+			return fused;
+	}
+
+	return NULL;
+}
+
+static void apply_params(struct obs_fused_effect *fused, obs_source_t **chain,
+			 size_t count)
+{
+	size_t idx = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		const uint8_t *vals = chain[i]->filter_fuse_params.array;
+		const uint8_t *end = vals + chain[i]->filter_fuse_params.num;
+
+		while (vals < end && idx < fused->params.num) {
+			gs_eparam_t *param = fused->params.array[idx++];
+			size_t size;
+
+			memcpy(&size, vals, sizeof(size));
+			vals += sizeof(size);
+
+			if (param && size)
+				gs_effect_set_val(param, vals, size);
+			vals += size;
+		}
+	}
+}
+
+gs_effect_t *obs_filter_fuse_chain(obs_source_t **chain, size_t count)
+{
+	struct obs_filter_fragment *fragments[MAX_FUSED_FILTERS];
+	struct obs_fused_effect *fused;
+	struct dstr key = {0};
+
+	if (!count || count > MAX_FUSED_FILTERS)
+		return NULL;
+
+	dstr_copy(&key, "fused:");
+
+	for (size_t i = 0; i < count; i++) {
+		fragments[i] = find_fragment(chain[i]->filter_fuse_effect);
+		if (!fragments[i]) {
+			dstr_free(&key);
+			return NULL;
+		}
+
+		if (i)
+			dstr_cat(&key, "|");
+		dstr_cat(&key, fragments[i]->file);
+	}
+
+	fused = find_fused_effect(key.array);
+	if (!fused)
+		fused = create_fused_effect(key.array, fragments, count);
+	dstr_free(&key);
+
+	if (!fused)
+		return NULL;
+
+	apply_params(fused, chain, count);
+	profile_count(fused_passes_name, (int64_t)count);
+	return fused->effect;
+}
+
+/* the effects themselves are destroyed along with the graphics context */
+void obs_free_filter_fusion(void)
+{
+	struct obs_core_video *video = &obs->video;
+
+	for (size_t i = 0; i < video->filter_fragments.num; i++) {
+		struct obs_filter_fragment *fragment =
+			video->filter_fragments.array + i;
+		bfree(fragment->file);
+		bfree(fragment->text);
+	}
+
+	for (size_t i = 0; i < video->fused_effects.num; i++) {
+		struct obs_fused_effect *fused = video->fused_effects.array + i;
+		bfree(fused->key);
+		da_free(fused->params);
+	}
+
+	da_free(video->filter_fragments);
+	da_free(video->fused_effects);
+}
@@ -21,6 +21,7 @@
 #include "media-io/format-conversion.h"
 #include "media-io/video-frame.h"
 #include "media-io/audio-io.h"
+#include "media-io/audio-mix.h"
 #include "util/threading.h"
 #include "util/platform.h"
 #include "util/util_uint64.h"
@@ -575,7 +576,7 @@ void obs_source_frame_init(struct obs_source_frame *frame,
 static inline void obs_source_frame_decref(struct obs_source_frame *frame)
 {
 	if (os_atomic_dec_long(&frame->refs) == 0)
-		obs_source_frame_destroy(frame);
+		obs_frame_pool_destroy_frame(frame);
 }
 
 static bool obs_source_filter_remove_refless(obs_source_t *source,
@@ -638,8 +639,12 @@ void obs_source_destroy(struct obs_source *source)
 	}
 	if (source->filter_texrender)
 		gs_texrender_destroy(source->filter_texrender);
+	if (source->static_cache)
+		gs_texrender_destroy(source->static_cache);
 	gs_leave_context();
 
+	da_free(source->filter_fuse_params);
+
 	for (i = 0; i < MAX_AV_PLANES; i++)
 		bfree(source->audio_data.data[i]);
 	for (i = 0; i < MAX_AUDIO_CHANNELS; i++)
@@ -665,6 +670,7 @@ void obs_source_destroy(struct obs_source *source)
 	pthread_mutex_destroy(&source->audio_mutex);
 	pthread_mutex_destroy(&source->async_mutex);
 	obs_data_release(source->private_settings);
+	obs_data_release(source->save_cache);
 	obs_context_data_free(&source->context);
 
 	if (source->owns_info_id) {
@@ -760,6 +766,7 @@ void obs_source_remove(obs_source_t *source)
 
 	if (!source->removed) {
 		source->removed = true;
+		os_atomic_inc_long(&obs->data.scene_update_gen);
 		obs_source_dosignal(source, "source_remove", "remove");
 	}
 }
@@ -866,14 +873,28 @@ static void obs_source_deferred_update(obs_source_t *source)
 				    source->context.settings);
 		os_atomic_compare_swap_long(&source->defer_update_count, count,
 					    0);
+		obs_source_video_changed(source);
 	}
 }
 
+void obs_source_mark_dirty(obs_source_t *source)
+{
+	obs_source_t *parent = source->filter_parent;
+
+	os_atomic_set_bool(&source->save_dirty, true);
+
+	/* filters are saved as part of the source they're attached to */
+	if (parent)
+		os_atomic_set_bool(&parent->save_dirty, true);
+}
+
 void obs_source_update(obs_source_t *source, obs_data_t *settings)
 {
 	if (!obs_source_valid(source, "obs_source_update"))
 		return;
 
+	obs_source_mark_dirty(source);
+
 	if (settings)
 		obs_data_apply(source->context.settings, settings);
 
@@ -893,6 +914,14 @@ void obs_source_update_properties(obs_source_t *source)
 	obs_source_dosignal(source, NULL, "update_properties");
 }
 
+void obs_source_video_changed(obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_video_changed"))
+		return;
+
+	os_atomic_inc_long(&source->video_gen);
+}
+
 void obs_source_send_mouse_click(obs_source_t *source,
 				 const struct obs_mouse_event *event,
 				 int32_t type, bool mouse_up,
@@ -1851,7 +1880,8 @@ static inline void set_eparami(gs_effect_t *effect, const char *name, int val)
 	gs_effect_set_int(param, val);
 }
 
-static bool update_async_texrender(struct obs_source *source,
+/* converts the planes of a frame that were uploaded to the textures */
+static bool convert_async_textures(struct obs_source *source,
 				   const struct obs_source_frame *frame,
 				   gs_texture_t *tex[MAX_AV_PLANES],
 				   gs_texrender_t *texrender)
@@ -1860,8 +1890,6 @@ static bool update_async_texrender(struct obs_source *source,
 
 	gs_texrender_reset(texrender);
 
-	upload_raw_frame(tex, frame);
-
 	uint32_t cx = source->async_width;
 	uint32_t cy = source->async_height;
 
@@ -1938,6 +1966,15 @@ static bool update_async_texrender(struct obs_source *source,
 	return success;
 }
 
+static bool update_async_texrender(struct obs_source *source,
+				   const struct obs_source_frame *frame,
+				   gs_texture_t *tex[MAX_AV_PLANES],
+				   gs_texrender_t *texrender)
+{
+	upload_raw_frame(tex, frame);
+	return convert_async_textures(source, frame, tex, texrender);
+}
+
 bool update_async_texture(struct obs_source *source,
 			  const struct obs_source_frame *frame,
 			  gs_texture_t *tex, gs_texrender_t *texrender)
@@ -2027,25 +2064,35 @@ static inline void check_to_swap_bgrx_bgra(obs_source_t *source,
 	}
 }
 
-static void obs_source_update_async_video(obs_source_t *source)
+/* gets the frame the source shows for the current frame of video, only once
+ * per frame */
+static struct obs_source_frame *get_async_video(obs_source_t *source)
 {
-	if (!source->async_rendered) {
-		struct obs_source_frame *frame = obs_source_get_frame(source);
+	struct obs_source_frame *frame = obs_source_get_frame(source);
 
-		if (frame)
-			frame = filter_async_video(source, frame);
+	if (frame)
+		frame = filter_async_video(source, frame);
 
-		source->async_rendered = true;
-		if (frame) {
-			check_to_swap_bgrx_bgra(source, frame);
+	source->async_rendered = true;
+	if (frame) {
+		check_to_swap_bgrx_bgra(source, frame);
 
-			if (!source->async_decoupled ||
-			    !source->async_unbuffered) {
-				source->timing_adjust = obs->video.video_time -
-							frame->timestamp;
-				source->timing_set = true;
-			}
+		if (!source->async_decoupled || !source->async_unbuffered) {
+			source->timing_adjust =
+				obs->video.video_time - frame->timestamp;
+			source->timing_set = true;
+		}
+	}
+
+	return frame;
+}
 
+static void obs_source_update_async_video(obs_source_t *source)
+{
+	if (!source->async_rendered) {
+		struct obs_source_frame *frame = get_async_video(source);
+
+		if (frame) {
 			if (source->async_update_texture) {
 				update_async_textures(source, frame,
 						      source->async_textures,
@@ -2058,6 +2105,98 @@ static void obs_source_update_async_video(obs_source_t *source)
 	}
 }
 
+static inline bool can_upload_early(const obs_source_t *source)
+{
+	return source->info.type == OBS_SOURCE_TYPE_INPUT &&
+	       (source->info.output_flags & OBS_SOURCE_ASYNC_VIDEO) ==
+		       OBS_SOURCE_ASYNC_VIDEO &&
+	       source->context.data && source->enabled &&
+	       os_atomic_load_long(&source->show_refs) > 0 &&
+	       !source->async_rendered && source->async_update_texture &&
+	       !deinterlacing_enabled(source);
+}
+
+/* maps the textures the planes of the frame are uploaded to, and leaves the
+ * copies to the upload workers */
+static bool map_async_textures(obs_source_t *source,
+			       const struct obs_source_frame *frame)
+{
+	gs_texture_t **tex = source->async_textures;
+	size_t planes;
+	bool mapped = false;
+
+	if (source->async_gpu_conversion && source->async_texrender)
+		planes = MAX_AV_PLANES;
+	else if (get_convert_type(frame->format, frame->full_range) ==
+		 CONVERT_NONE)
+		planes = 1;
+	else
+		return false;
+
+	for (size_t c = 0; c < planes; c++) {
+		uint8_t *ptr;
+		uint32_t linesize;
+
+		if (!tex[c] || !frame->data[c])
+			continue;
+		if (!gs_texture_map(tex[c], &ptr, &linesize))
+			continue;
+
+		obs_video_add_upload(ptr, linesize, frame->data[c],
+				     frame->linesize[c],
+				     gs_texture_get_height(tex[c]));
+		source->async_mapped[c] = true;
+		mapped = true;
+	}
+
+	return mapped;
+}
+
+bool obs_source_begin_async_upload(obs_source_t *source)
+{
+	struct obs_source_frame *frame;
+
+	if (!can_upload_early(source))
+		return false;
+
+	frame = get_async_video(source);
+	if (!frame)
+		return false;
+
+	source->async_flip = frame->flip;
+
+	if (map_async_textures(source, frame)) {
+		source->async_upload_frame = frame;
+		return true;
+	}
+
+	update_async_textures(source, frame, source->async_textures,
+			      source->async_texrender);
+	source->async_update_texture = false;
+	obs_source_release_frame(source, frame);
+	return false;
+}
+
+void obs_source_end_async_upload(obs_source_t *source)
+{
+	struct obs_source_frame *frame = source->async_upload_frame;
+
+	for (size_t c = 0; c < MAX_AV_PLANES; c++) {
+		if (source->async_mapped[c]) {
+			gs_texture_unmap(source->async_textures[c]);
+			source->async_mapped[c] = false;
+		}
+	}
+
+	if (source->async_gpu_conversion && source->async_texrender)
+		convert_async_textures(source, frame, source->async_textures,
+				       source->async_texrender);
+
+	source->async_update_texture = false;
+	source->async_upload_frame = NULL;
+	obs_source_release_frame(source, frame);
+}
+
 static void rotate_async_video(obs_source_t *source, long rotation)
 {
 	float x = 0;
@@ -2141,6 +2280,137 @@ static inline void obs_source_main_render(obs_source_t *source)
 					  custom_draw ? NULL : gs_get_effect());
 }
 
+/* what the source itself draws, without its filters */
+static bool static_content_gen(obs_source_t *source, uint64_t *gen)
+{
+	uint64_t content_gen = 0;
+	bool is_static;
+
+	if (source->info.type == OBS_SOURCE_TYPE_SCENE)
+		is_static = obs_scene_static_video_gen(source->context.data,
+						       &content_gen);
+	else
+		is_static = (source->info.output_flags &
+			     OBS_SOURCE_STATIC_VIDEO) != 0 &&
+			    (source->info.output_flags & OBS_SOURCE_ASYNC) == 0;
+
+	*gen = static_video_gen_add(
+		static_video_gen_add(STATIC_VIDEO_GEN_INIT, content_gen),
+		(uint64_t)os_atomic_load_long(&source->video_gen));
+	return is_static;
+}
+
+bool obs_source_static_video_gen(obs_source_t *source, uint64_t *gen)
+{
+	bool is_static = static_content_gen(source, gen);
+	size_t num;
+
+	pthread_mutex_lock(&source->filter_mutex);
+	num = source->filters.num;
+	for (size_t i = 0; is_static && i < num; i++) {
+		obs_source_t *filter = source->filters.array[i];
+		uint64_t filter_gen;
+
+		is_static = static_content_gen(filter, &filter_gen);
+		*gen = static_video_gen_add(*gen, (uint64_t)(uintptr_t)filter);
+		*gen = static_video_gen_add(*gen, filter_gen);
+	}
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	*gen = static_video_gen_add(*gen, (uint64_t)num);
+	return is_static;
+}
+
+static const char *static_cache_hits_name = "static video cache: hits";
+static const char *static_cache_misses_name = "static video cache: misses";
+
+static void draw_static_cache(obs_source_t *source)
+{
+	gs_texture_t *tex = gs_texrender_get_texture(source->static_cache);
+	gs_effect_t *effect = obs->video.default_effect;
+
+	/* the cache holds premultiplied alpha, like item textures */
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+
+	while (gs_effect_loop(effect, "Draw"))
+		obs_source_draw(tex, 0, 0, 0, 0, false);
+
+	gs_blend_state_pop();
+}
+
+/* renders sources with static video, and scenes made only of them, to a
+ * texture which is then drawn until something they draw changes.  sources
+ * and groups within a scene that is being cached aren't cached a second time,
+ * only nested scenes, which are often used in more than one place.  returns
+ * false if the source has to be rendered as usual */
+static bool render_static_cache(obs_source_t *source)
+{
+	bool nested_scene = source->info.type == OBS_SOURCE_TYPE_SCENE &&
+			    !obs_source_is_group(source);
+	uint32_t cx, cy;
+	uint64_t gen;
+
+	if (source->filters.num || source->filter_parent)
+		return false;
+	if (!nested_scene && obs->video.static_cache_depth)
+		return false;
+
+	if (!static_content_gen(source, &gen)) {
+		if (source->static_cache) {
+			gs_texrender_destroy(source->static_cache);
+			source->static_cache = NULL;
+			source->static_cache_valid = false;
+		}
+		return false;
+	}
+
+	cx = obs_source_get_base_width(source);
+	cy = obs_source_get_base_height(source);
+	if (!cx || !cy)
+		return false;
+
+	if (!source->static_cache)
+		source->static_cache = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+
+	if (source->static_cache_valid && source->static_cache_gen == gen &&
+	    source->static_cache_cx == cx && source->static_cache_cy == cy) {
+		profile_count(static_cache_hits_name, 1);
+		draw_static_cache(source);
+		return true;
+	}
+
+	profile_count(static_cache_misses_name, 1);
+
+	source->static_cache_valid = false;
+	gs_texrender_reset(source->static_cache);
+	if (!gs_texrender_begin(source->static_cache, cx, cy))
+		return false;
+
+	struct vec4 clear_color;
+	vec4_zero(&clear_color);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+	gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+	gs_blend_state_push();
+	gs_reset_blend_state();
+
+	obs->video.static_cache_depth++;
+	obs_source_main_render(source);
+	obs->video.static_cache_depth--;
+
+	gs_blend_state_pop();
+	gs_texrender_end(source->static_cache);
+
+	source->static_cache_gen = gen;
+	source->static_cache_cx = cx;
+	source->static_cache_cy = cy;
+	source->static_cache_valid = true;
+
+	draw_static_cache(source);
+	return true;
+}
+
 static bool ready_async_frame(obs_source_t *source, uint64_t sys_time);
 
 #if GS_USE_DEBUG_MARKERS
@@ -2191,8 +2461,10 @@ static inline void render_video(obs_source_t *source)
 	if (source->filters.num && !source->rendering_filter)
 		obs_source_render_filters(source);
 
-	else if (source->info.video_render)
-		obs_source_main_render(source);
+	else if (source->info.video_render) {
+		if (!render_static_cache(source))
+			obs_source_main_render(source);
+	}
 
 	else if (source->filter_target)
 		obs_source_video_render(source->filter_target);
@@ -2216,6 +2488,39 @@ void obs_source_video_render(obs_source_t *source)
 	obs_source_release(source);
 }
 
+static inline bool format_has_alpha(enum video_format format)
+{
+	switch (format) {
+	case VIDEO_FORMAT_NONE:
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_I40A:
+	case VIDEO_FORMAT_I42A:
+	case VIDEO_FORMAT_YUVA:
+	case VIDEO_FORMAT_AYUV:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool obs_source_video_opaque(const obs_source_t *source)
+{
+	if (!source->context.data || !source->enabled || source->filters.num)
+		return false;
+
+	if (source->info.video_opaque)
+		return source->info.video_opaque(source->context.data);
+
+	if (source->info.type == OBS_SOURCE_TYPE_INPUT &&
+	    (source->info.output_flags & OBS_SOURCE_ASYNC) != 0 &&
+	    !source->info.video_render)
+		return source->async_active && source->async_textures[0] &&
+		       !format_has_alpha(source->async_format);
+
+	return false;
+}
+
 static inline uint32_t get_async_width(const obs_source_t *source)
 {
 	return ((source->async_rotation % 180) == 0) ? source->async_width
@@ -2391,6 +2696,9 @@ void obs_source_filter_add(obs_source_t *source, obs_source_t *filter)
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	obs_source_mark_dirty(source);
+	obs_source_video_changed(source);
+
 	calldata_init_fixed(&cd, stack, sizeof(stack));
 	calldata_set_ptr(&cd, "source", source);
 	calldata_set_ptr(&cd, "filter", filter);
@@ -2425,6 +2733,9 @@ static bool obs_source_filter_remove_refless(obs_source_t *source,
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	obs_source_mark_dirty(source);
+	obs_source_video_changed(source);
+
 	calldata_init_fixed(&cd, stack, sizeof(stack));
 	calldata_set_ptr(&cd, "source", source);
 	calldata_set_ptr(&cd, "filter", filter);
@@ -2552,8 +2863,11 @@ void obs_source_filter_set_order(obs_source_t *source, obs_source_t *filter,
 	success = move_filter_dir(source, filter, movement);
 	pthread_mutex_unlock(&source->filter_mutex);
 
-	if (success)
+	if (success) {
+		obs_source_mark_dirty(source);
+		obs_source_video_changed(source);
 		obs_source_dosignal(source, NULL, "reorder_filters");
+	}
 }
 
 obs_data_t *obs_source_get_settings(const obs_source_t *source)
@@ -2561,6 +2875,9 @@ obs_data_t *obs_source_get_settings(const obs_source_t *source)
 	if (!obs_source_valid(source, "obs_source_get_settings"))
 		return NULL;
 
+	/* the caller may modify the settings without updating the source */
+	obs_source_mark_dirty((obs_source_t *)source);
+
 	obs_data_addref(source->context.settings);
 	return source->context.settings;
 }
@@ -2710,15 +3027,15 @@ static inline void free_async_cache(struct obs_source *source)
 
 #define MAX_UNUSED_FRAME_DURATION 5
 
-/* frees frame allocations if they haven't been used for a specific period
- * of time */
+/* returns frame allocations to the frame pool if they haven't been used for a
+ * specific period of time */
 static void clean_cache(obs_source_t *source)
 {
 	for (size_t i = source->async_cache.num; i > 0; i--) {
 		struct async_frame *af = &source->async_cache.array[i - 1];
 		if (!af->used) {
 			if (++af->unused_count == MAX_UNUSED_FRAME_DURATION) {
-				obs_source_frame_destroy(af->frame);
+				obs_frame_pool_destroy_frame(af->frame);
 				da_erase(source->async_cache, i - 1);
 			}
 		}
@@ -2767,8 +3084,8 @@ cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 	if (!new_frame) {
 		struct async_frame new_af;
 
-		new_frame = obs_source_frame_create(format, frame->width,
-						    frame->height);
+		new_frame = obs_frame_pool_create_frame(format, frame->width,
+							frame->height);
 		new_af.frame = new_frame;
 		new_af.used = true;
 		new_af.unused_count = 0;
@@ -2805,7 +3122,7 @@ obs_source_output_video_internal(obs_source_t *source,
 	pthread_mutex_lock(&source->async_mutex);
 	if (output) {
 		if (os_atomic_dec_long(&output->refs) == 0) {
-			obs_source_frame_destroy(output);
+			obs_frame_pool_destroy_frame(output);
 			output = NULL;
 		} else {
 			da_push_back(source->async_frames, &output);
@@ -3422,12 +3739,12 @@ void obs_source_release_frame(obs_source_t *source,
 		return;
 
 	if (!source) {
-		obs_source_frame_destroy(frame);
+		obs_frame_pool_destroy_frame(frame);
 	} else {
 		pthread_mutex_lock(&source->async_mutex);
 
 		if (os_atomic_dec_long(&frame->refs) == 0)
-			obs_source_frame_destroy(frame);
+			obs_frame_pool_destroy_frame(frame);
 		else
 			remove_async_frame(source, frame);
 
@@ -3453,6 +3770,8 @@ void obs_source_set_name(obs_source_t *source, const char *name)
 		char *prev_name = bstrdup(source->context.name);
 		obs_context_data_setname(&source->context, name);
 
+		obs_source_mark_dirty(source);
+
 		calldata_init(&data);
 		calldata_set_ptr(&data, "source", source);
 		calldata_set_string(&data, "new_name", source->context.name);
@@ -3531,6 +3850,103 @@ static inline bool can_bypass(obs_source_t *target, obs_source_t *parent,
 	       ((parent_flags & OBS_SOURCE_ASYNC) == 0);
 }
 
+static inline bool is_fusable(obs_source_t *filter)
+{
+	return (filter->info.output_flags & OBS_SOURCE_FUSABLE_FILTER) != 0 &&
+	       !filter->filter_fuse_failed;
+}
+
+static inline bool can_fuse(obs_source_t *filter, obs_source_t *target,
+			    obs_source_t *parent)
+{
+	int depth = filter->filter_fuse_into ? filter->filter_fuse_depth : 1;
+
+	return target != parent && is_fusable(filter) && is_fusable(target) &&
+	       target->info.type == OBS_SOURCE_TYPE_FILTER &&
+	       target->info.video_render && target->context.data &&
+	       target->enabled && depth < MAX_FUSED_FILTERS;
+}
+
+static inline bool can_defer_pass(gs_effect_t *effect, const char *tech,
+				  uint32_t width, uint32_t height)
+{
+	return !width && !height && strcmp(tech, "Draw") == 0 &&
+	       obs_filter_fragment_valid(effect);
+}
+
+/* begins the texture of a fusable filter when what its target draws has to
+ * be drawn to it after all */
+static bool begin_fuse_texrender(obs_source_t *filter, obs_source_t *target)
+{
+	uint32_t cx = get_base_width(target);
+	uint32_t cy = get_base_height(target);
+	struct vec4 clear_color;
+
+	if (!filter->filter_texrender)
+		filter->filter_texrender = gs_texrender_create(
+			filter->filter_fuse_format, GS_ZS_NONE);
+
+	if (!cx || !cy || !gs_texrender_begin(filter->filter_texrender, cx, cy))
+		return false;
+
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+	vec4_zero(&clear_color);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+	gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+	return true;
+}
+
+static void end_fuse_texrender(obs_source_t *filter)
+{
+	gs_blend_state_pop();
+	gs_texrender_end(filter->filter_texrender);
+}
+
+/* the filter draws to the texture of the fusable filter it is being rendered
+ * for, instead of leaving its pass to it */
+static bool begin_fuse_fallback(obs_source_t *filter)
+{
+	filter->filter_fuse_into->filter_fuse_fallback = true;
+	return begin_fuse_texrender(filter->filter_fuse_into, filter);
+}
+
+static void end_fuse_fallback(obs_source_t *filter)
+{
+	end_fuse_texrender(filter->filter_fuse_into);
+}
+
+/* the texture of a filter is not needed while its target is fused with it */
+static inline void free_fused_texrender(obs_source_t *filter)
+{
+	gs_texrender_destroy(filter->filter_texrender);
+	filter->filter_texrender = NULL;
+}
+
+/* renders the target of a fusable filter, which is also a fusable filter, so
+ * that it leaves its pass to this filter if it can */
+static void render_fused_target(obs_source_t *filter, obs_source_t *target,
+				enum gs_color_format format)
+{
+	target->filter_fuse_into = filter;
+	target->filter_fuse_depth =
+		(filter->filter_fuse_into ? filter->filter_fuse_depth : 1) + 1;
+	target->filter_fuse_deferred = false;
+	filter->filter_fuse_fallback = false;
+	filter->filter_fuse_format = format;
+
+	obs_source_video_render(target);
+
+	target->filter_fuse_into = NULL;
+	filter->filter_fused = target->filter_fuse_deferred;
+
+	/* nothing was drawn for the filter at all */
+	if (!filter->filter_fused && !filter->filter_fuse_fallback &&
+	    begin_fuse_texrender(filter, target))
+		end_fuse_texrender(filter);
+}
+
 bool obs_source_process_filter_begin(obs_source_t *filter,
 				     enum gs_color_format format,
 				     enum obs_allow_direct_render allow_direct)
@@ -3561,6 +3977,7 @@ bool obs_source_process_filter_begin(obs_source_t *filter,
 	cy = get_base_height(target);
 
 	filter->allow_direct = allow_direct;
+	filter->filter_fused = false;
 
 	/* if the parent does not use any custom effects, and this is the last
 	 * filter in the chain for the parent, then render the parent directly
@@ -3575,6 +3992,13 @@ bool obs_source_process_filter_begin(obs_source_t *filter,
 		return false;
 	}
 
+	/* runs of filters that only change the color of each pixel on its own
+	 * are drawn in a single pass, without a texture for each of them */
+	if (can_fuse(filter, target, parent)) {
+		render_fused_target(filter, target, format);
+		return true;
+	}
+
 	if (!filter->filter_texrender)
 		filter->filter_texrender =
 			gs_texrender_create(format, GS_ZS_NONE);
@@ -3603,26 +4027,121 @@ bool obs_source_process_filter_begin(obs_source_t *filter,
 	return true;
 }
 
-void obs_source_process_filter_tech_end(obs_source_t *filter,
-					gs_effect_t *effect, uint32_t width,
-					uint32_t height, const char *tech_name)
+/* collects the filters that left their pass to this filter, innermost first */
+static size_t get_fused_chain(obs_source_t *filter, obs_source_t **chain)
+{
+	obs_source_t *fused[MAX_FUSED_FILTERS];
+	obs_source_t *target = filter;
+	size_t count = 0;
+
+	while (target->filter_fused && count < MAX_FUSED_FILTERS - 1) {
+		target = obs_filter_get_target(target);
+		if (!target || !target->filter_fuse_deferred)
+			break;
+		fused[count++] = target;
+	}
+
+	for (size_t i = 0; i < count; i++)
+		chain[i] = fused[count - i - 1];
+	return count;
+}
+
+/* draws a pass of the chain, from what the innermost filter of the chain
+ * would have drawn its pass with, or the texture of the filter itself */
+static void render_chain_pass(obs_source_t *filter, obs_source_t *target,
+			      obs_source_t *parent, gs_effect_t *effect,
+			      bool first)
 {
-	obs_source_t *target, *parent;
 	gs_texture_t *texture;
-	uint32_t parent_flags;
 
-	if (!filter)
-		return;
+	if (first && can_bypass(target, parent, parent->info.output_flags,
+				filter->allow_direct)) {
+		render_filter_bypass(target, effect, "Draw");
+	} else {
+		texture = gs_texrender_get_texture(filter->filter_texrender);
+		if (texture)
+			render_filter_tex(texture, effect, 0, 0, "Draw");
+	}
+}
 
-	target = obs_filter_get_target(filter);
-	parent = obs_filter_get_parent(filter);
+/* draws the saved passes with the effects of the filters themselves, each to
+ * the texture of the filter after it like when they aren't fused */
+static void render_unfused_chain(obs_source_t **chain, size_t count,
+				 obs_source_t *target, obs_source_t *parent)
+{
+	for (size_t i = 0; i < count; i++) {
+		bool last = i + 1 == count;
+
+		if (!last && !begin_fuse_texrender(chain[i + 1], chain[i]))
+			return;
+
+		obs_filter_fuse_restore(chain[i]);
+		render_chain_pass(chain[i], target, parent,
+				  chain[i]->filter_fuse_effect, i == 0);
+
+		if (!last)
+			end_fuse_texrender(chain[i + 1]);
+	}
+}
+
+/* draws the passes of the chain with one effect */
+static void render_fused_chain(obs_source_t *filter, obs_source_t **chain,
+			       size_t count)
+{
+	obs_source_t *first = chain[0];
+	obs_source_t *target = obs_filter_get_target(first);
+	obs_source_t *parent = obs_filter_get_parent(first);
+	gs_effect_t *effect;
 
 	if (!target || !parent)
 		return;
 
+	effect = obs_filter_fuse_chain(chain, count);
+	if (!effect) {
+		if (!filter->filter_fuse_failed)
+			blog(LOG_WARNING,
+			     "Failed to fuse the filters of '%s', "
+			     "drawing them one at a time",
+			     parent->context.name);
+		filter->filter_fuse_failed = true;
+		render_unfused_chain(chain, count, target, parent);
+		return;
+	}
+
+	render_chain_pass(first, target, parent, effect, true);
+}
+
+static void render_filter_pass(obs_source_t *filter, gs_effect_t *effect,
+			       uint32_t width, uint32_t height,
+			       const char *tech)
+{
+	obs_source_t *target, *parent;
+	obs_source_t *chain[MAX_FUSED_FILTERS];
+	gs_texture_t *texture;
+	uint32_t parent_flags;
+	size_t count = 0;
+
+	target = obs_filter_get_target(filter);
+	parent = obs_filter_get_parent(filter);
 	parent_flags = parent->info.output_flags;
 
-	const char *tech = tech_name ? tech_name : "Draw";
+	if (filter->filter_fused)
+		count = get_fused_chain(filter, chain);
+
+	if (count && can_defer_pass(effect, tech, width, height)) {
+		obs_filter_fuse_save(filter, effect);
+		chain[count++] = filter;
+		render_fused_chain(filter, chain, count);
+		free_fused_texrender(filter);
+		return;
+	}
+
+	/* the pass of this filter can't be fused after all, so the passes left
+	 * to it are drawn to its texture first */
+	if (count && begin_fuse_texrender(filter, target)) {
+		render_fused_chain(filter, chain, count);
+		end_fuse_texrender(filter);
+	}
 
 	if (can_bypass(target, parent, parent_flags, filter->allow_direct)) {
 		render_filter_bypass(target, effect, tech);
@@ -3634,6 +4153,41 @@ void obs_source_process_filter_tech_end(obs_source_t *filter,
 	}
 }
 
+void obs_source_process_filter_tech_end(obs_source_t *filter,
+					gs_effect_t *effect, uint32_t width,
+					uint32_t height, const char *tech_name)
+{
+	obs_source_t *target, *parent;
+
+	if (!filter)
+		return;
+
+	target = obs_filter_get_target(filter);
+	parent = obs_filter_get_parent(filter);
+
+	if (!target || !parent)
+		return;
+
+	const char *tech = tech_name ? tech_name : "Draw";
+
+	/* the filter is being rendered for the fusable filter after it, which
+	 * draws this pass along with its own if it can */
+	if (filter->filter_fuse_into) {
+		if (can_defer_pass(effect, tech, width, height)) {
+			obs_filter_fuse_save(filter, effect);
+			filter->filter_fuse_deferred = true;
+			if (filter->filter_fused)
+				free_fused_texrender(filter);
+		} else if (begin_fuse_fallback(filter)) {
+			render_filter_pass(filter, effect, width, height, tech);
+			end_fuse_fallback(filter);
+		}
+		return;
+	}
+
+	render_filter_pass(filter, effect, width, height, tech);
+}
+
 void obs_source_process_filter_end(obs_source_t *filter, gs_effect_t *effect,
 				   uint32_t width, uint32_t height)
 {
@@ -3644,15 +4198,12 @@ void obs_source_process_filter_end(obs_source_t *filter, gs_effect_t *effect,
 					   "Draw");
 }
 
-void obs_source_skip_video_filter(obs_source_t *filter)
+static void skip_video_filter(obs_source_t *filter)
 {
 	obs_source_t *target, *parent;
 	bool custom_draw, async;
 	uint32_t parent_flags;
 
-	if (!obs_ptr_valid(filter, "obs_source_skip_video_filter"))
-		return;
-
 	target = obs_filter_get_target(filter);
 	parent = obs_filter_get_parent(filter);
 	parent_flags = parent->info.output_flags;
@@ -3674,6 +4225,24 @@ void obs_source_skip_video_filter(obs_source_t *filter)
 	}
 }
 
+void obs_source_skip_video_filter(obs_source_t *filter)
+{
+	if (!obs_ptr_valid(filter, "obs_source_skip_video_filter"))
+		return;
+
+	/* a skipped filter still has to draw to the texture of the fusable
+	 * filter it is being rendered for */
+	if (filter->filter_fuse_into) {
+		if (begin_fuse_fallback(filter)) {
+			skip_video_filter(filter);
+			end_fuse_fallback(filter);
+		}
+		return;
+	}
+
+	skip_video_filter(filter);
+}
+
 signal_handler_t *obs_source_get_signal_handler(const obs_source_t *source)
 {
 	return obs_source_valid(source, "obs_source_get_signal_handler")
@@ -3698,6 +4267,8 @@ void obs_source_set_volume(obs_source_t *source, float volume)
 		struct calldata data;
 		uint8_t stack[128];
 
+		obs_source_mark_dirty(source);
+
 		calldata_init_fixed(&data, stack, sizeof(stack));
 		calldata_set_ptr(&data, "source", source);
 		calldata_set_float(&data, "volume", volume);
@@ -3730,6 +4301,8 @@ void obs_source_set_sync_offset(obs_source_t *source, int64_t offset)
 		struct calldata data;
 		uint8_t stack[128];
 
+		obs_source_mark_dirty(source);
+
 		calldata_init_fixed(&data, stack, sizeof(stack));
 		calldata_set_ptr(&data, "source", source);
 		calldata_set_int(&data, "offset", offset);
@@ -3957,6 +4530,8 @@ void obs_source_load(obs_source_t *source)
 		source->info.load(source->context.data,
 				  source->context.settings);
 
+	obs_source_video_changed(source);
+
 	obs_source_dosignal(source, "source_load", "load");
 }
 
@@ -3992,6 +4567,7 @@ void obs_source_set_flags(obs_source_t *source, uint32_t flags)
 		return;
 
 	if (flags != source->flags) {
+		obs_source_mark_dirty(source);
 		source->flags = flags;
 		signal_flags_updated(source);
 	}
@@ -4024,6 +4600,8 @@ void obs_source_set_audio_mixers(obs_source_t *source, uint32_t mixers)
 	if (source->audio_mixers == mixers)
 		return;
 
+	obs_source_mark_dirty(source);
+
 	calldata_init_fixed(&data, stack, sizeof(stack));
 	calldata_set_ptr(&data, "source", source);
 	calldata_set_int(&data, "mixers", mixers);
@@ -4194,7 +4772,10 @@ void obs_source_set_enabled(obs_source_t *source, bool enabled)
 	if (!obs_source_valid(source, "obs_source_set_enabled"))
 		return;
 
+	obs_source_mark_dirty(source);
+
 	source->enabled = enabled;
+	obs_source_video_changed(source);
 
 	calldata_init_fixed(&data, stack, sizeof(stack));
 	calldata_set_ptr(&data, "source", source);
@@ -4220,6 +4801,8 @@ void obs_source_set_muted(obs_source_t *source, bool muted)
 	if (!obs_source_valid(source, "obs_source_set_muted"))
 		return;
 
+	obs_source_mark_dirty(source);
+
 	source->user_muted = muted;
 
 	calldata_init_fixed(&data, stack, sizeof(stack));
@@ -4277,6 +4860,8 @@ void obs_source_enable_push_to_mute(obs_source_t *source, bool enabled)
 	if (!obs_source_valid(source, "obs_source_enable_push_to_mute"))
 		return;
 
+	obs_source_mark_dirty(source);
+
 	pthread_mutex_lock(&source->audio_mutex);
 	bool changed = source->push_to_mute_enabled != enabled;
 	if (obs_source_get_output_flags(source) & OBS_SOURCE_AUDIO && changed)
@@ -4310,6 +4895,8 @@ void obs_source_set_push_to_mute_delay(obs_source_t *source, uint64_t delay)
 	if (!obs_source_valid(source, "obs_source_set_push_to_mute_delay"))
 		return;
 
+	obs_source_mark_dirty(source);
+
 	pthread_mutex_lock(&source->audio_mutex);
 	source->push_to_mute_delay = delay;
 
@@ -4335,6 +4922,8 @@ void obs_source_enable_push_to_talk(obs_source_t *source, bool enabled)
 	if (!obs_source_valid(source, "obs_source_enable_push_to_talk"))
 		return;
 
+	obs_source_mark_dirty(source);
+
 	pthread_mutex_lock(&source->audio_mutex);
 	bool changed = source->push_to_talk_enabled != enabled;
 	if (obs_source_get_output_flags(source) & OBS_SOURCE_AUDIO && changed)
@@ -4368,6 +4957,8 @@ void obs_source_set_push_to_talk_delay(obs_source_t *source, uint64_t delay)
 	if (!obs_source_valid(source, "obs_source_set_push_to_talk_delay"))
 		return;
 
+	obs_source_mark_dirty(source);
+
 	pthread_mutex_lock(&source->audio_mutex);
 	source->push_to_talk_delay = delay;
 
@@ -4412,24 +5003,16 @@ static float get_source_volume(obs_source_t *source, uint64_t os_time)
 static inline void multiply_output_audio(obs_source_t *source, size_t mix,
 					 size_t channels, float vol)
 {
-	register float *out = source->audio_output_buf[mix][0];
-	register float *end = out + AUDIO_OUTPUT_FRAMES * channels;
-
-	while (out < end)
-		*(out++) *= vol;
+	audio_mul(source->audio_output_buf[mix][0], vol,
+		  AUDIO_OUTPUT_FRAMES * channels);
 }
 
 static inline void multiply_vol_data(obs_source_t *source, size_t mix,
 				     size_t channels, float *vol_data)
 {
-	for (size_t ch = 0; ch < channels; ch++) {
-		register float *out = source->audio_output_buf[mix][ch];
-		register float *end = out + AUDIO_OUTPUT_FRAMES;
-		register float *vol = vol_data;
-
-		while (out < end)
-			*(out++) *= *(vol++);
-	}
+	for (size_t ch = 0; ch < channels; ch++)
+		audio_mul_array(source->audio_output_buf[mix][ch], vol_data,
+				AUDIO_OUTPUT_FRAMES);
 }
 
 static inline void apply_audio_action(obs_source_t *source,
@@ -4775,6 +5358,8 @@ void obs_source_set_monitoring_type(obs_source_t *source,
 	if (source->monitoring_type == type)
 		return;
 
+	obs_source_mark_dirty(source);
+
 	was_on = source->monitoring_type != OBS_MONITORING_TYPE_NONE;
 	now_on = type != OBS_MONITORING_TYPE_NONE;
 
@@ -4818,6 +5403,8 @@ obs_data_t *obs_source_get_private_settings(obs_source_t *source)
 	if (!obs_ptr_valid(source, "obs_source_get_private_settings"))
 		return NULL;
 
+	obs_source_mark_dirty(source);
+
 	obs_data_addref(source->private_settings);
 	return source->private_settings;
 }
@@ -4869,6 +5456,8 @@ void obs_source_set_balance_value(obs_source_t *source, float balance)
 	if (!obs_source_valid(source, "obs_source_set_balance_value"))
 		return;
 
+	obs_source_mark_dirty(source);
+
 	source->balance = balance;
 }
 
@@ -186,6 +186,36 @@ enum obs_media_state {
  */
 #define OBS_SOURCE_CONTROLLABLE_MEDIA (1 << 13)
 
+/**
+ * Source can be created on a worker thread when a scene collection is loaded
+ *
+ * Sources of this type may be created at the same time as other sources, on
+ * threads other than the UI thread.  The create callback must not wait on the
+ * UI thread, and anything it shares with other sources of the same type has
+ * to be locked.
+ */
+#define OBS_SOURCE_PARALLEL_CREATE (1 << 14)
+
+/**
+ * Source video only changes when the source is updated or reports it
+ *
+ * The source is rendered to a texture once, which is then drawn until the
+ * source is updated, changes size, or calls obs_source_video_changed.
+ * Scenes made only of such sources are cached the same way.  Only set this
+ * for sources that draw nothing outside of their width and height.
+ */
+#define OBS_SOURCE_STATIC_VIDEO (1 << 15)
+
+/**
+ * Filter only changes the color of each pixel on its own
+ *
+ * Filters of this type render with obs_source_process_filter_begin and
+ * obs_source_process_filter_end, using the "Draw" technique of an effect
+ * created with obs_filter_fragment_create at the size of their target.
+ * Neighbouring filters of such types are drawn together in a single pass.
+ */
+#define OBS_SOURCE_FUSABLE_FILTER (1 << 16)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
@@ -527,6 +557,17 @@ struct obs_source_info {
 	/* version-related stuff */
 	uint32_t version; /* increment if needed to specify a new version */
 	const char *unversioned_id; /* set internally, don't set manually */
+
+	/**
+	 * Returns whether the source currently covers its entire width and
+	 * height with fully opaque pixels when rendered.  Scenes use this to
+	 * skip drawing items that are completely hidden behind the source.
+	 * Return false if unsure.
+	 *
+	 * @param  data  Source data
+	 * @return       true if the source is fully opaque
+	 */
+	bool (*video_opaque)(void *data);
 };
 
 EXPORT void obs_register_source_s(const struct obs_source_info *info,
@@ -29,6 +29,26 @@
 #include <windows.h>
 #endif
 
+/* scenes only check their items for size changes when a source has changed
+ * size, filters don't need to be checked as the size of the source they're
+ * attached to is checked */
+static inline void check_source_size(struct obs_source *source)
+{
+	uint32_t cx, cy;
+
+	if (source->info.type == OBS_SOURCE_TYPE_FILTER)
+		return;
+
+	cx = obs_source_get_width(source);
+	cy = obs_source_get_height(source);
+
+	if (cx != source->last_tick_width || cy != source->last_tick_height) {
+		source->last_tick_width = cx;
+		source->last_tick_height = cy;
+		os_atomic_inc_long(&obs->data.scene_update_gen);
+	}
+}
+
 static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 {
 	struct obs_core_data *data = &obs->data;
@@ -72,11 +92,203 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 		}
 	}
 
+	/* ------------------------------------- */
+	/* check sizes after everything ticked   */
+
+	source = data->first_source;
+	while (source) {
+		struct obs_source *cur_source = obs_source_get_ref(source);
+		source = (struct obs_source *)source->context.next;
+
+		if (cur_source) {
+			check_source_size(cur_source);
+			obs_source_release(cur_source);
+		}
+	}
+
 	pthread_mutex_unlock(&data->sources_mutex);
 
 	return cur_time;
 }
 
+/* planes are split into jobs of about this size, so the copies of a single
+ * large frame are spread across the workers too */
+#define UPLOAD_JOB_SIZE (1024 * 1024)
+
+void obs_video_add_upload(uint8_t *dst, uint32_t dst_linesize,
+			  const uint8_t *src, uint32_t src_linesize,
+			  uint32_t rows)
+{
+	struct obs_core_video *video = &obs->video;
+	uint32_t job_rows = UPLOAD_JOB_SIZE / (dst_linesize ? dst_linesize : 1);
+
+	if (!job_rows)
+		job_rows = 1;
+
+	for (uint32_t y = 0; y < rows; y += job_rows) {
+		struct async_upload_job *job =
+			da_push_back_new(video->upload_jobs);
+
+		job->dst = dst + (size_t)y * dst_linesize;
+		job->src = src + (size_t)y * src_linesize;
+		job->dst_linesize = dst_linesize;
+		job->src_linesize = src_linesize;
+		job->rows = rows - y < job_rows ? rows - y : job_rows;
+	}
+}
+
+static void run_upload_job(const struct async_upload_job *job)
+{
+	uint32_t row_copy = job->src_linesize < job->dst_linesize
+				    ? job->src_linesize
+				    : job->dst_linesize;
+
+	if (job->src_linesize == job->dst_linesize) {
+		memcpy(job->dst, job->src, (size_t)row_copy * job->rows);
+		return;
+	}
+
+	for (uint32_t y = 0; y < job->rows; y++)
+		memcpy(job->dst + (size_t)y * job->dst_linesize,
+		       job->src + (size_t)y * job->src_linesize, row_copy);
+}
+
+static inline void finish_upload_work(struct obs_core_video *video)
+{
+	if (os_atomic_dec_long(&video->pending_upload_work) == 0)
+		os_event_signal(video->upload_done_event);
+}
+
+static void run_upload_jobs(struct obs_core_video *video)
+{
+	for (;;) {
+		size_t idx =
+			(size_t)os_atomic_inc_long(&video->next_upload_job) - 1;
+		if (idx >= video->upload_jobs.num)
+			break;
+
+		run_upload_job(video->upload_jobs.array + idx);
+		finish_upload_work(video);
+	}
+}
+
+static void *upload_worker_thread(void *param)
+{
+	struct obs_core_video *video = param;
+
+	os_set_thread_name("libobs: async upload worker");
+
+	while (os_sem_wait(video->upload_semaphore) == 0) {
+		if (os_atomic_load_bool(&video->upload_workers_stop))
+			break;
+
+		run_upload_jobs(video);
+		finish_upload_work(video);
+	}
+
+	return NULL;
+}
+
+bool obs_init_upload_workers(size_t count)
+{
+	struct obs_core_video *video = &obs->video;
+
+	os_atomic_set_bool(&video->upload_workers_stop, false);
+
+	if (os_sem_init(&video->upload_semaphore, 0) != 0)
+		return false;
+	if (os_event_init(&video->upload_done_event, OS_EVENT_TYPE_AUTO) != 0)
+		return false;
+
+	/* the graphics thread itself copies planes as well */
+	for (size_t i = 1; i < count; i++) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, upload_worker_thread,
+				   video) != 0)
+			return false;
+		da_push_back(video->upload_workers, &thread);
+	}
+
+	return true;
+}
+
+void obs_free_upload_workers(void)
+{
+	struct obs_core_video *video = &obs->video;
+	void *thread_ret;
+
+	os_atomic_set_bool(&video->upload_workers_stop, true);
+	for (size_t i = 0; i < video->upload_workers.num; i++)
+		os_sem_post(video->upload_semaphore);
+	for (size_t i = 0; i < video->upload_workers.num; i++)
+		pthread_join(video->upload_workers.array[i], &thread_ret);
+
+	da_free(video->upload_workers);
+	da_free(video->upload_jobs);
+	da_free(video->upload_sources);
+	os_sem_destroy(video->upload_semaphore);
+	os_event_destroy(video->upload_done_event);
+	video->upload_semaphore = NULL;
+	video->upload_done_event = NULL;
+}
+
+/* copies the new frames of async sources to their textures before anything is
+ * rendered, instead of one at a time when each source is first rendered */
+static void upload_async_frames(void)
+{
+	struct obs_core_video *video = &obs->video;
+	struct obs_core_data *data = &obs->data;
+	struct obs_source *source;
+	long wake = 0;
+
+	da_resize(video->upload_jobs, 0);
+	da_resize(video->upload_sources, 0);
+
+	gs_enter_context(video->graphics);
+
+	pthread_mutex_lock(&data->sources_mutex);
+
+	source = data->first_source;
+	while (source) {
+		struct obs_source *cur_source = obs_source_get_ref(source);
+		source = (struct obs_source *)source->context.next;
+
+		if (!cur_source)
+			continue;
+
+		if (obs_source_begin_async_upload(cur_source))
+			da_push_back(video->upload_sources, &cur_source);
+		else
+			obs_source_release(cur_source);
+	}
+
+	pthread_mutex_unlock(&data->sources_mutex);
+
+	if (video->upload_jobs.num > 1) {
+		wake = (long)video->upload_workers.num;
+		if (wake > (long)video->upload_jobs.num - 1)
+			wake = (long)video->upload_jobs.num - 1;
+	}
+
+	os_atomic_set_long(&video->next_upload_job, 0);
+	os_atomic_set_long(&video->pending_upload_work,
+			   (long)video->upload_jobs.num + wake);
+
+	for (long i = 0; i < wake; i++)
+		os_sem_post(video->upload_semaphore);
+
+	run_upload_jobs(video);
+	if (video->upload_jobs.num)
+		os_event_wait(video->upload_done_event);
+
+	for (size_t i = 0; i < video->upload_sources.num; i++) {
+		obs_source_end_async_upload(video->upload_sources.array[i]);
+		obs_source_release(video->upload_sources.array[i]);
+	}
+
+	gs_leave_context();
+}
+
 /* in obs-display.c */
 extern void render_display(struct obs_display *display);
 
@@ -353,6 +565,22 @@ static void render_convert_texture(struct obs_core_video *video,
 	profile_end(render_convert_texture_name);
 }
 
+static void reclaim_shared_frames(struct obs_core_video *video)
+{
+	for (size_t i = 0; i < video->shared_frames.num; i++) {
+		struct obs_shared_frame *shared = video->shared_frames.array[i];
+
+		if (!shared->mapped || os_atomic_load_long(&shared->refs))
+			continue;
+
+		for (int c = 0; c < NUM_CHANNELS; ++c) {
+			if (shared->surfaces[c])
+				gs_stagesurface_unmap(shared->surfaces[c]);
+		}
+		shared->mapped = false;
+	}
+}
+
 static const char *stage_output_texture_name = "stage_output_texture";
 static inline void stage_output_texture(struct obs_core_video *video,
 					int cur_texture)
@@ -360,6 +588,7 @@ static inline void stage_output_texture(struct obs_core_video *video,
 	profile_start(stage_output_texture_name);
 
 	unmap_last_surface(video);
+	reclaim_shared_frames(video);
 
 	if (!video->gpu_conversion) {
 		gs_stagesurf_t *copy = video->copy_surfaces[cur_texture][0];
@@ -533,6 +762,67 @@ static inline bool download_frame(struct obs_core_video *video,
 	return true;
 }
 
+static struct obs_shared_frame *get_spare_shared_frame(
+	struct obs_core_video *video)
+{
+	struct obs_shared_frame *shared;
+
+	for (size_t i = 0; i < video->shared_frames.num; i++) {
+		shared = video->shared_frames.array[i];
+		if (!shared->mapped)
+			return shared;
+	}
+
+	if (video->shared_frames.num == MAX_SHARED_FRAMES)
+		return NULL;
+
+	shared = bzalloc(sizeof(*shared));
+	if (!obs_init_copy_surfaces(shared->surfaces)) {
+		for (int c = 0; c < NUM_CHANNELS; ++c)
+			gs_stagesurface_destroy(shared->surfaces[c]);
+		bfree(shared);
+		return NULL;
+	}
+
+	da_push_back(video->shared_frames, &shared);
+	return shared;
+}
+
+/* Takes the surfaces that were just mapped for download out of the staging
+ * rotation so their planes can be handed to raw outputs directly, and puts
+ * an unmapped spare set in their place.  Returns NULL if no spare set is
+ * available, in which case the frame is copied as usual. */
+static struct obs_shared_frame *share_mapped_frame(struct obs_core_video *video,
+						   int prev_texture)
+{
+	struct obs_shared_frame *shared;
+
+	if (!video->shared_frames_supported)
+		return NULL;
+
+	shared = get_spare_shared_frame(video);
+	if (!shared)
+		return NULL;
+
+	for (int c = 0; c < NUM_CHANNELS; ++c) {
+		gs_stagesurf_t *mapped = video->copy_surfaces[prev_texture][c];
+
+		video->copy_surfaces[prev_texture][c] = shared->surfaces[c];
+		shared->surfaces[c] = mapped;
+		video->mapped_surfaces[c] = NULL;
+	}
+
+	shared->mapped = true;
+	os_atomic_set_long(&shared->refs, 1);
+	return shared;
+}
+
+static void release_shared_frame(void *param)
+{
+	struct obs_shared_frame *shared = param;
+	os_atomic_set_long(&shared->refs, 0);
+}
+
 static const uint8_t *set_gpu_converted_plane(uint32_t width, uint32_t height,
 					      uint32_t linesize_input,
 					      uint32_t linesize_output,
@@ -684,6 +974,23 @@ static inline void copy_rgbx_frame(struct video_frame *output,
 	}
 }
 
+static inline void output_shared_data(struct obs_core_video *video,
+				      struct obs_shared_frame *shared,
+				      struct video_data *input_frame, int count)
+{
+	/* the nv12 staging texture holds both planes in one mapping */
+	if (video->using_nv12_tex) {
+		input_frame->data[1] =
+			input_frame->data[0] +
+			input_frame->linesize[0] * video->output_height;
+		input_frame->linesize[1] = input_frame->linesize[0];
+	}
+
+	if (!video_output_share_frame(video->video, input_frame, count,
+				      release_shared_frame, shared))
+		release_shared_frame(shared);
+}
+
 static inline void output_video_data(struct obs_core_video *video,
 				     struct video_data *input_frame, int count)
 {
@@ -749,6 +1056,7 @@ static inline void output_frame(bool raw_active, const bool gpu_active)
 	int cur_texture = video->cur_texture;
 	int prev_texture = cur_texture == 0 ? NUM_TEXTURES - 1
 					    : cur_texture - 1;
+	struct obs_shared_frame *shared = NULL;
 	struct video_data frame;
 	bool frame_ready = 0;
 
@@ -767,6 +1075,8 @@ static inline void output_frame(bool raw_active, const bool gpu_active)
 	if (raw_active) {
 		profile_start(output_frame_download_frame_name);
 		frame_ready = download_frame(video, prev_texture, &frame);
+		if (frame_ready)
+			shared = share_mapped_frame(video, prev_texture);
 		profile_end(output_frame_download_frame_name);
 	}
 
@@ -784,7 +1094,11 @@ static inline void output_frame(bool raw_active, const bool gpu_active)
 
 		frame.timestamp = vframe_info.timestamp;
 		profile_start(output_frame_output_video_data_name);
-		output_video_data(video, &frame, vframe_info.count);
+		if (shared)
+			output_shared_data(video, shared, &frame,
+					   vframe_info.count);
+		else
+			output_video_data(video, &frame, vframe_info.count);
 		profile_end(output_frame_output_video_data_name);
 	}
 
@@ -919,6 +1233,7 @@ static void uninit_winrt_state(struct winrt_state *winrt)
 #endif // #ifdef _WIN32
 
 static const char *tick_sources_name = "tick_sources";
+static const char *upload_async_frames_name = "upload_async_frames";
 static const char *render_displays_name = "render_displays";
 static const char *output_frame_name = "output_frame";
 bool obs_graphics_thread_loop(struct obs_graphics_context *context)
@@ -963,6 +1278,10 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 
 	execute_graphics_tasks();
 
+	profile_start(upload_async_frames_name);
+	upload_async_frames();
+	profile_end(upload_async_frames_name);
+
 #ifdef _WIN32
 	MSG msg;
 	while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
@@ -154,42 +154,41 @@ static bool obs_init_gpu_conversion(struct obs_video_info *ovi)
 	return true;
 }
 
-static bool obs_init_gpu_copy_surfaces(struct obs_video_info *ovi, size_t i)
+static bool obs_init_gpu_copy_surfaces(gs_stagesurf_t *surfaces[NUM_CHANNELS])
 {
 	struct obs_core_video *video = &obs->video;
+	const uint32_t width = video->output_width;
+	const uint32_t height = video->output_height;
 
-	video->copy_surfaces[i][0] = gs_stagesurface_create(
-		ovi->output_width, ovi->output_height, GS_R8);
-	if (!video->copy_surfaces[i][0])
+	surfaces[0] = gs_stagesurface_create(width, height, GS_R8);
+	if (!surfaces[0])
 		return false;
 
 	const struct video_output_info *info =
 		video_output_get_info(video->video);
 	switch (info->format) {
 	case VIDEO_FORMAT_I420:
-		video->copy_surfaces[i][1] = gs_stagesurface_create(
-			ovi->output_width / 2, ovi->output_height / 2, GS_R8);
-		if (!video->copy_surfaces[i][1])
+		surfaces[1] =
+			gs_stagesurface_create(width / 2, height / 2, GS_R8);
+		if (!surfaces[1])
 			return false;
-		video->copy_surfaces[i][2] = gs_stagesurface_create(
-			ovi->output_width / 2, ovi->output_height / 2, GS_R8);
-		if (!video->copy_surfaces[i][2])
+		surfaces[2] =
+			gs_stagesurface_create(width / 2, height / 2, GS_R8);
+		if (!surfaces[2])
 			return false;
 		break;
 	case VIDEO_FORMAT_NV12:
-		video->copy_surfaces[i][1] = gs_stagesurface_create(
-			ovi->output_width / 2, ovi->output_height / 2, GS_R8G8);
-		if (!video->copy_surfaces[i][1])
+		surfaces[1] =
+			gs_stagesurface_create(width / 2, height / 2, GS_R8G8);
+		if (!surfaces[1])
 			return false;
 		break;
 	case VIDEO_FORMAT_I444:
-		video->copy_surfaces[i][1] = gs_stagesurface_create(
-			ovi->output_width, ovi->output_height, GS_R8);
-		if (!video->copy_surfaces[i][1])
+		surfaces[1] = gs_stagesurface_create(width, height, GS_R8);
+		if (!surfaces[1])
 			return false;
-		video->copy_surfaces[i][2] = gs_stagesurface_create(
-			ovi->output_width, ovi->output_height, GS_R8);
-		if (!video->copy_surfaces[i][2])
+		surfaces[2] = gs_stagesurface_create(width, height, GS_R8);
+		if (!surfaces[2])
 			return false;
 		break;
 	default:
@@ -199,36 +198,51 @@ static bool obs_init_gpu_copy_surfaces(struct obs_video_info *ovi, size_t i)
 	return true;
 }
 
-static bool obs_init_textures(struct obs_video_info *ovi)
+bool obs_init_copy_surfaces(gs_stagesurf_t *surfaces[NUM_CHANNELS])
 {
 	struct obs_core_video *video = &obs->video;
 
-	for (size_t i = 0; i < NUM_TEXTURES; i++) {
-#ifdef _WIN32
-		if (video->using_nv12_tex) {
-			video->copy_surfaces[i][0] =
-				gs_stagesurface_create_nv12(ovi->output_width,
-							    ovi->output_height);
-			if (!video->copy_surfaces[i][0])
-				return false;
-
-		} else {
-#endif
-			if (video->gpu_conversion) {
-				if (!obs_init_gpu_copy_surfaces(ovi, i))
-					return false;
-			} else {
-				video->copy_surfaces[i][0] =
-					gs_stagesurface_create(
-						ovi->output_width,
-						ovi->output_height, GS_RGBA);
-				if (!video->copy_surfaces[i][0])
-					return false;
-			}
 #ifdef _WIN32
-		}
+	if (video->using_nv12_tex) {
+		surfaces[0] = gs_stagesurface_create_nv12(video->output_width,
+							  video->output_height);
+		return surfaces[0] != NULL;
+	}
 #endif
+
+	if (video->gpu_conversion)
+		return obs_init_gpu_copy_surfaces(surfaces);
+
+	surfaces[0] = gs_stagesurface_create(video->output_width,
+					     video->output_height, GS_RGBA);
+	return surfaces[0] != NULL;
+}
+
+static inline bool shared_frames_supported(struct obs_core_video *video)
+{
+	if (!video->gpu_conversion)
+		return true;
+
+	switch (video_output_get_format(video->video)) {
+	case VIDEO_FORMAT_I420:
+	case VIDEO_FORMAT_NV12:
+	case VIDEO_FORMAT_I444:
+		return true;
+	default:
+		return false;
 	}
+}
+
+static bool obs_init_textures(struct obs_video_info *ovi)
+{
+	struct obs_core_video *video = &obs->video;
+
+	for (size_t i = 0; i < NUM_TEXTURES; i++) {
+		if (!obs_init_copy_surfaces(video->copy_surfaces[i]))
+			return false;
+	}
+
+	video->shared_frames_supported = shared_frames_supported(video);
 
 	video->render_texture = gs_texture_create(ovi->base_width,
 						  ovi->base_height, GS_RGBA, 1,
@@ -387,6 +401,7 @@ static int obs_init_video(struct obs_video_info *ovi)
 	struct obs_core_video *video = &obs->video;
 	struct video_output_info vi;
 	pthread_mutexattr_t attr;
+	int cores = os_get_physical_cores();
 	int errorcode;
 
 	make_video_info(&vi, ovi);
@@ -411,6 +426,10 @@ static int obs_init_video(struct obs_video_info *ovi)
 		return OBS_VIDEO_FAIL;
 	}
 
+	/* distinct conversions are rare beyond stream + recording + replay */
+	video_output_set_worker_threads(video->video,
+					cores < 3 ? (size_t)cores : 3);
+
 	gs_enter_context(video->graphics);
 
 	if (ovi->gpu_conversion && !obs_init_gpu_conversion(ovi))
@@ -429,6 +448,9 @@ static int obs_init_video(struct obs_video_info *ovi)
 	if (pthread_mutex_init(&video->task_mutex, NULL) < 0)
 		return OBS_VIDEO_FAIL;
 
+	if (!obs_init_upload_workers(cores < 4 ? (size_t)cores : 4))
+		return OBS_VIDEO_FAIL;
+
 #ifdef __APPLE__
 	errorcode = pthread_create(&video->video_thread, NULL,
 				   obs_graphics_thread_autorelease, obs);
@@ -462,6 +484,8 @@ static void obs_free_video(void)
 {
 	struct obs_core_video *video = &obs->video;
 
+	obs_free_upload_workers();
+
 	if (video->video) {
 		video_output_close(video->video);
 		video->video = NULL;
@@ -479,6 +503,22 @@ static void obs_free_video(void)
 			}
 		}
 
+		for (size_t i = 0; i < video->shared_frames.num; i++) {
+			struct obs_shared_frame *shared =
+				video->shared_frames.array[i];
+
+			for (size_t c = 0; c < NUM_CHANNELS; c++) {
+				if (!shared->surfaces[c])
+					continue;
+				if (shared->mapped)
+					gs_stagesurface_unmap(
+						shared->surfaces[c]);
+				gs_stagesurface_destroy(shared->surfaces[c]);
+			}
+			bfree(shared);
+		}
+		da_free(video->shared_frames);
+
 		for (size_t i = 0; i < NUM_TEXTURES; i++) {
 			for (size_t c = 0; c < NUM_CHANNELS; c++) {
 				if (video->copy_surfaces[i][c]) {
@@ -558,6 +598,8 @@ static void obs_free_graphics(void)
 		gs_effect_destroy(video->bilinear_lowres_effect);
 		video->default_effect = NULL;
 
+		obs_free_filter_fusion();
+
 		gs_leave_context();
 
 		gs_destroy(video->graphics);
@@ -573,6 +615,7 @@ static bool obs_init_audio(struct audio_output_info *ai)
 	pthread_mutexattr_t attr;
 
 	pthread_mutex_init_value(&audio->monitoring_mutex);
+	pthread_mutex_init_value(&audio->buffering_mutex);
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		return false;
@@ -580,12 +623,18 @@ static bool obs_init_audio(struct audio_output_info *ai)
 		return false;
 	if (pthread_mutex_init(&audio->monitoring_mutex, &attr) != 0)
 		return false;
+	if (pthread_mutex_init(&audio->buffering_mutex, NULL) != 0)
+		return false;
 
 	audio->user_volume = 1.0f;
 
 	audio->monitoring_device_name = bstrdup("Default");
 	audio->monitoring_device_id = bstrdup("default");
 
+	int cores = os_get_physical_cores();
+	if (!obs_init_audio_render_workers(cores < 4 ? (size_t)cores : 4))
+		return false;
+
 	errorcode = audio_output_open(&audio->audio, ai);
 	if (errorcode == AUDIO_OUTPUT_SUCCESS)
 		return true;
@@ -602,8 +651,11 @@ static void obs_free_audio(void)
 	struct obs_core_audio *audio = &obs->audio;
 	if (audio->audio)
 		audio_output_close(audio->audio);
+	obs_free_audio_render_workers();
 
 	circlebuf_free(&audio->buffered_timestamps);
+	circlebuf_free(&audio->buffering_history);
+	pthread_mutex_destroy(&audio->buffering_mutex);
 	da_free(audio->render_order);
 	da_free(audio->root_nodes);
 
@@ -615,6 +667,19 @@ static void obs_free_audio(void)
 	memset(audio, 0, sizeof(struct obs_core_audio));
 }
 
+static bool obs_context_index_init(struct obs_context_index *index)
+{
+	memset(index, 0, sizeof(*index));
+	return pthread_rwlock_init(&index->lock, NULL) == 0;
+}
+
+static void obs_context_index_free(struct obs_context_index *index)
+{
+	pthread_rwlock_destroy(&index->lock);
+	bfree(index->buckets);
+	memset(index, 0, sizeof(*index));
+}
+
 static bool obs_init_data(void)
 {
 	struct obs_core_data *data = &obs->data;
@@ -624,6 +689,7 @@ static bool obs_init_data(void)
 
 	pthread_mutex_init_value(&obs->data.displays_mutex);
 	pthread_mutex_init_value(&obs->data.draw_callbacks_mutex);
+	pthread_mutex_init_value(&obs->data.frame_pool.mutex);
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		return false;
@@ -643,8 +709,18 @@ static bool obs_init_data(void)
 		goto fail;
 	if (pthread_mutex_init(&obs->data.draw_callbacks_mutex, &attr) != 0)
 		goto fail;
+	if (!obs_context_index_init(&data->source_index))
+		goto fail;
+	if (!obs_context_index_init(&data->output_index))
+		goto fail;
+	if (!obs_context_index_init(&data->encoder_index))
+		goto fail;
+	if (!obs_context_index_init(&data->service_index))
+		goto fail;
 	if (!obs_view_init(&data->main_view))
 		goto fail;
+	if (!obs_frame_pool_init(&data->frame_pool))
+		goto fail;
 
 	data->private_data = obs_data_create();
 	data->valid = true;
@@ -701,9 +777,14 @@ static void obs_free_data(void)
 	pthread_mutex_destroy(&data->encoders_mutex);
 	pthread_mutex_destroy(&data->services_mutex);
 	pthread_mutex_destroy(&data->draw_callbacks_mutex);
+	obs_context_index_free(&data->source_index);
+	obs_context_index_free(&data->output_index);
+	obs_context_index_free(&data->encoder_index);
+	obs_context_index_free(&data->service_index);
 	da_free(data->draw_callbacks);
 	da_free(data->tick_callbacks);
 	obs_data_release(data->private_data);
+	obs_frame_pool_free(&data->frame_pool);
 }
 
 static const char *obs_signals[] = {
@@ -851,6 +932,7 @@ static bool obs_init(const char *locale, const char *module_config_path,
 	obs = bzalloc(sizeof(struct obs_core));
 
 	pthread_mutex_init_value(&obs->audio.monitoring_mutex);
+	pthread_mutex_init_value(&obs->audio.buffering_mutex);
 	pthread_mutex_init_value(&obs->video.gpu_encoder_mutex);
 	pthread_mutex_init_value(&obs->video.task_mutex);
 
@@ -870,6 +952,8 @@ static bool obs_init(const char *locale, const char *module_config_path,
 	if (!obs_init_hotkeys())
 		return false;
 
+	obs_init_encoder_packet_pool();
+
 	if (module_config_path)
 		obs->module_config_path = bstrdup(module_config_path);
 	obs->locale = bstrdup(locale);
@@ -1038,6 +1122,7 @@ void obs_shutdown(void)
 
 	obs_free_audio();
 	obs_free_data();
+	obs_free_encoder_packet_pool();
 	obs_free_video();
 	obs_free_hotkeys();
 	obs_free_graphics();
@@ -1239,6 +1324,43 @@ bool obs_get_audio_info(struct obs_audio_info *oai)
 	return true;
 }
 
+bool obs_get_audio_buffering_info(struct obs_audio_buffering_info *info)
+{
+	struct obs_core_audio *audio = &obs->audio;
+
+	if (!info || !audio->audio)
+		return false;
+
+	pthread_mutex_lock(&audio->buffering_mutex);
+	*info = audio->buffering_info;
+	pthread_mutex_unlock(&audio->buffering_mutex);
+	return true;
+}
+
+size_t
+obs_get_audio_buffering_history(struct obs_audio_buffering_change *changes,
+				size_t count)
+{
+	struct obs_core_audio *audio = &obs->audio;
+	size_t size = sizeof(*changes);
+	size_t available;
+
+	if (!changes || !audio->audio)
+		return 0;
+
+	pthread_mutex_lock(&audio->buffering_mutex);
+
+	available = audio->buffering_history.size / size;
+	if (count > available)
+		count = available;
+
+	/* the most recent changes sit at the back */
+	circlebuf_peek_back(&audio->buffering_history, changes, count * size);
+
+	pthread_mutex_unlock(&audio->buffering_mutex);
+	return count;
+}
+
 bool obs_enum_source_types(size_t idx, const char **id)
 {
 	if (idx >= obs->source_types.num)
@@ -1544,25 +1666,52 @@ void obs_enum_services(bool (*enum_proc)(void *, obs_service_t *), void *param)
 		 param);
 }
 
-static inline void *get_context_by_name(void *vfirst, const char *name,
-					pthread_mutex_t *mutex,
+/* FNV-1a */
+static inline uint32_t hash_context_name(const char *name)
+{
+	uint32_t hash = 2166136261U;
+
+	while (*name) {
+		hash ^= (uint8_t)*(name++);
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static inline struct obs_context_data **
+get_index_bucket(struct obs_context_index *index, uint32_t hash)
+{
+	return &index->buckets[hash & (index->num_buckets - 1)];
+}
+
+static inline void *get_context_by_name(struct obs_context_index *index,
+					const char *name,
 					void *(*addref)(void *))
 {
-	struct obs_context_data **first = vfirst;
-	struct obs_context_data *context;
+	struct obs_context_data *context = NULL;
+	uint32_t hash;
 
-	pthread_mutex_lock(mutex);
+	if (!name)
+		return NULL;
+
+	hash = hash_context_name(name);
+
+	pthread_rwlock_rdlock(&index->lock);
+
+	if (index->num_buckets)
+		context = *get_index_bucket(index, hash);
 
-	context = *first;
 	while (context) {
-		if (!context->private && strcmp(context->name, name) == 0) {
+		if (context->name_hash == hash &&
+		    strcmp(context->name, name) == 0) {
 			context = addref(context);
 			break;
 		}
-		context = context->next;
+		context = context->index_next;
 	}
 
-	pthread_mutex_unlock(mutex);
+	pthread_rwlock_unlock(&index->lock);
 	return context;
 }
 
@@ -1593,29 +1742,25 @@ static inline void *obs_id_(void *data)
 
 obs_source_t *obs_get_source_by_name(const char *name)
 {
-	return get_context_by_name(&obs->data.first_source, name,
-				   &obs->data.sources_mutex,
+	return get_context_by_name(&obs->data.source_index, name,
 				   obs_source_addref_safe_);
 }
 
 obs_output_t *obs_get_output_by_name(const char *name)
 {
-	return get_context_by_name(&obs->data.first_output, name,
-				   &obs->data.outputs_mutex,
+	return get_context_by_name(&obs->data.output_index, name,
 				   obs_output_addref_safe_);
 }
 
 obs_encoder_t *obs_get_encoder_by_name(const char *name)
 {
-	return get_context_by_name(&obs->data.first_encoder, name,
-				   &obs->data.encoders_mutex,
+	return get_context_by_name(&obs->data.encoder_index, name,
 				   obs_encoder_addref_safe_);
 }
 
 obs_service_t *obs_get_service_by_name(const char *name)
 {
-	return get_context_by_name(&obs->data.first_service, name,
-				   &obs->data.services_mutex,
+	return get_context_by_name(&obs->data.service_index, name,
 				   obs_service_addref_safe_);
 }
 
@@ -1873,33 +2018,158 @@ obs_source_t *obs_load_source(obs_data_t *source_data)
 	return obs_load_source_type(source_data);
 }
 
+static bool source_type_parallel(obs_data_t *source_data)
+{
+	const char *id = obs_data_get_string(source_data, "id");
+	const char *v_id = obs_data_get_string(source_data, "versioned_id");
+	const struct obs_source_info *info = get_source_info(*v_id ? v_id : id);
+
+	return info && (info->output_flags & OBS_SOURCE_PARALLEL_CREATE) != 0;
+}
+
+/* filters are created along with their source, so the source and all of its
+ * filters have to support being created on a worker thread */
+static bool can_create_in_parallel(obs_data_t *source_data)
+{
+	obs_data_array_t *filters = obs_data_get_array(source_data, "filters");
+	bool parallel = source_type_parallel(source_data);
+
+	if (filters) {
+		size_t count = obs_data_array_count(filters);
+
+		for (size_t i = 0; parallel && i < count; i++) {
+			obs_data_t *filter_data =
+				obs_data_array_item(filters, i);
+			parallel = source_type_parallel(filter_data);
+			obs_data_release(filter_data);
+		}
+
+		obs_data_array_release(filters);
+	}
+
+	return parallel;
+}
+
+struct source_loader {
+	obs_data_array_t *array;
+	obs_source_t **sources;
+	DARRAY(size_t) jobs;
+	volatile long next_job;
+};
+
+static void load_parallel_sources(struct source_loader *loader)
+{
+	for (;;) {
+		size_t job = (size_t)os_atomic_inc_long(&loader->next_job) - 1;
+		obs_data_t *source_data;
+		size_t idx;
+
+		if (job >= loader->jobs.num)
+			break;
+
+		idx = loader->jobs.array[job];
+		source_data = obs_data_array_item(loader->array, idx);
+		loader->sources[idx] = obs_load_source(source_data);
+		obs_data_release(source_data);
+	}
+}
+
+static void *source_loader_thread(void *param)
+{
+	os_set_thread_name("obs: source loader");
+	load_parallel_sources(param);
+	return NULL;
+}
+
+#define MAX_LOADER_THREADS 16
+
+/* creates every source in the array.  sources that support it are created on
+ * a pool of worker threads, the rest are created on this thread in the
+ * meantime, in the order they were saved in.  returns the number of threads
+ * used */
+static int create_sources(struct source_loader *loader, size_t count)
+{
+	pthread_t threads[MAX_LOADER_THREADS];
+	int num_threads = 0;
+	int max_threads;
+
+	da_init(loader->jobs);
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *source_data = obs_data_array_item(loader->array, i);
+		if (can_create_in_parallel(source_data))
+			da_push_back(loader->jobs, &i);
+		obs_data_release(source_data);
+	}
+
+	max_threads = os_get_logical_cores() - 1;
+	if (max_threads > MAX_LOADER_THREADS)
+		max_threads = MAX_LOADER_THREADS;
+	if ((size_t)max_threads >= loader->jobs.num)
+		max_threads = (int)loader->jobs.num - 1;
+
+	for (int i = 0; i < max_threads; i++) {
+		if (pthread_create(&threads[num_threads], NULL,
+				   source_loader_thread, loader) == 0)
+			num_threads++;
+	}
+
+	for (size_t i = 0, job = 0; i < count; i++) {
+		obs_data_t *source_data;
+
+		if (job < loader->jobs.num && loader->jobs.array[job] == i) {
+			job++;
+			continue;
+		}
+
+		source_data = obs_data_array_item(loader->array, i);
+		loader->sources[i] = obs_load_source(source_data);
+		obs_data_release(source_data);
+	}
+
+	load_parallel_sources(loader);
+
+	for (int i = 0; i < num_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	da_free(loader->jobs);
+	return num_threads + 1;
+}
+
+static const char *load_sources_name = "obs_load_sources";
+static const char *create_sources_name = "create sources";
+static const char *load_callbacks_name = "load sources";
+
 void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 		      void *private_data)
 {
 	struct obs_core_data *data = &obs->data;
-	DARRAY(obs_source_t *) sources;
+	struct source_loader loader = {0};
+	uint64_t start_time, created_time, end_time;
 	size_t count;
 	size_t i;
+	int threads;
 
-	da_init(sources);
+	profile_start(load_sources_name);
+	start_time = os_gettime_ns();
 
 	count = obs_data_array_count(array);
-	da_reserve(sources, count);
+	loader.array = array;
+	loader.sources = bzalloc(sizeof(obs_source_t *) * count);
 
-	pthread_mutex_lock(&data->sources_mutex);
-
-	for (i = 0; i < count; i++) {
-		obs_data_t *source_data = obs_data_array_item(array, i);
-		obs_source_t *source = obs_load_source(source_data);
+	/* sources are not locked while they are being created, the worker
+	 * threads need to be able to add them to the source list */
+	profile_start(create_sources_name);
+	threads = create_sources(&loader, count);
+	profile_end(create_sources_name);
+	created_time = os_gettime_ns();
 
-		da_push_back(sources, &source);
-
-		obs_data_release(source_data);
-	}
+	profile_start(load_callbacks_name);
+	pthread_mutex_lock(&data->sources_mutex);
 
 	/* tell sources that we want to load */
-	for (i = 0; i < sources.num; i++) {
-		obs_source_t *source = sources.array[i];
+	for (i = 0; i < count; i++) {
+		obs_source_t *source = loader.sources[i];
 		obs_data_t *source_data = obs_data_array_item(array, i);
 		if (source) {
 			if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
@@ -1916,19 +2186,30 @@ void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 		obs_data_release(source_data);
 	}
 
-	for (i = 0; i < sources.num; i++)
-		obs_source_release(sources.array[i]);
+	for (i = 0; i < count; i++)
+		obs_source_release(loader.sources[i]);
 
 	pthread_mutex_unlock(&data->sources_mutex);
+	profile_end(load_callbacks_name);
+
+	bfree(loader.sources);
+
+	end_time = os_gettime_ns();
+	profile_end(load_sources_name);
 
-	da_free(sources);
+	blog(LOG_INFO,
+	     "Loaded %d sources in %.1f ms (create: %.1f ms on %d threads, "
+	     "load: %.1f ms)",
+	     (int)count, (double)(end_time - start_time) / 1000000.0,
+	     (double)(created_time - start_time) / 1000000.0, threads,
+	     (double)(end_time - created_time) / 1000000.0);
 }
 
 obs_data_t *obs_save_source(obs_source_t *source)
 {
 	obs_data_array_t *filters = obs_data_array_create();
 	obs_data_t *source_data = obs_data_create();
-	obs_data_t *settings = obs_source_get_settings(source);
+	obs_data_t *settings = source->context.settings;
 	obs_data_t *hotkey_data = source->context.hotkey_data;
 	obs_data_t *hotkeys;
 	float volume = obs_source_get_volume(source);
@@ -2001,12 +2282,59 @@ obs_data_t *obs_save_source(obs_source_t *source)
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
-	obs_data_release(settings);
 	obs_data_array_release(filters);
 
 	return source_data;
 }
 
+/* state saved by a save callback can change without the source being marked
+ * as dirty, so those are always saved again */
+static bool save_cache_valid(obs_source_t *source, long scene_gen)
+{
+	bool valid = true;
+
+	if (!source->save_cache)
+		return false;
+	if (source->info.type == OBS_SOURCE_TYPE_SCENE)
+		return source->save_cache_scene_gen == scene_gen;
+	if (source->info.save ||
+	    source->info.type == OBS_SOURCE_TYPE_TRANSITION)
+		return false;
+
+	pthread_mutex_lock(&source->filter_mutex);
+	for (size_t i = 0; i < source->filters.num; i++) {
+		if (source->filters.array[i]->info.save) {
+			valid = false;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	return valid;
+}
+
+static obs_data_t *save_source_cached(obs_source_t *source)
+{
+	long scene_gen = os_atomic_load_long(&obs->data.scene_save_gen);
+	bool dirty = os_atomic_set_bool(&source->save_dirty, false);
+	obs_data_t *source_data;
+
+	if (dirty || !save_cache_valid(source, scene_gen)) {
+		source_data = obs_save_source(source);
+
+		/* the saved data references the settings of the source, copy
+		 * it so it can be serialized on another thread */
+		obs_data_release(source->save_cache);
+		source->save_cache = obs_data_create();
+		source->save_cache_scene_gen = scene_gen;
+		obs_data_apply(source->save_cache, source_data);
+		obs_data_release(source_data);
+	}
+
+	obs_data_addref(source->save_cache);
+	return source->save_cache;
+}
+
 obs_data_array_t *obs_save_sources_filtered(obs_save_source_filter_cb cb,
 					    void *data_)
 {
@@ -2024,7 +2352,7 @@ obs_data_array_t *obs_save_sources_filtered(obs_save_source_filter_cb cb,
 		if ((source->info.type != OBS_SOURCE_TYPE_FILTER) != 0 &&
 		    !source->context.private && !source->removed &&
 		    cb(data_, source)) {
-			obs_data_t *source_data = obs_save_source(source);
+			obs_data_t *source_data = save_source_cached(source);
 
 			obs_data_array_push_back(array, source_data);
 			obs_data_release(source_data);
@@ -2058,8 +2386,8 @@ static inline char *dup_name(const char *name, bool private)
 
 	if (!name || !*name) {
 		struct dstr unnamed = {0};
-		dstr_printf(&unnamed, "__unnamed%04lld",
-			    obs->data.unnamed_index++);
+		dstr_printf(&unnamed, "__unnamed%04ld",
+			    os_atomic_inc_long(&obs->data.unnamed_index) - 1);
 
 		return unnamed.array;
 	} else {
@@ -2128,6 +2456,94 @@ void obs_context_data_free(struct obs_context_data *context)
 	memset(context, 0, sizeof(*context));
 }
 
+#define MIN_INDEX_BUCKETS 64
+
+static struct obs_context_index *get_context_index(enum obs_obj_type type)
+{
+	switch (type) {
+	case OBS_OBJ_TYPE_SOURCE:
+		return &obs->data.source_index;
+	case OBS_OBJ_TYPE_OUTPUT:
+		return &obs->data.output_index;
+	case OBS_OBJ_TYPE_ENCODER:
+		return &obs->data.encoder_index;
+	case OBS_OBJ_TYPE_SERVICE:
+		return &obs->data.service_index;
+	case OBS_OBJ_TYPE_INVALID:
+		break;
+	}
+
+	return NULL;
+}
+
+static void grow_context_index(struct obs_context_index *index)
+{
+	struct obs_context_data **old_buckets = index->buckets;
+	size_t old_num_buckets = index->num_buckets;
+
+	index->num_buckets = old_num_buckets ? old_num_buckets * 2
+					     : MIN_INDEX_BUCKETS;
+	index->buckets =
+		bzalloc(index->num_buckets * sizeof(*index->buckets));
+
+	/* each old bucket splits into two new ones.  keep the chain order so
+	 * that the newest context with a duplicate name is still found first */
+	for (size_t i = 0; i < old_num_buckets; i++) {
+		struct obs_context_data *context = old_buckets[i];
+		struct obs_context_data **tails[2] = {
+			&index->buckets[i],
+			&index->buckets[i + old_num_buckets],
+		};
+
+		while (context) {
+			struct obs_context_data *next = context->index_next;
+			size_t half =
+				(context->name_hash & old_num_buckets) != 0;
+
+			context->index_next = NULL;
+			*tails[half] = context;
+			tails[half] = &context->index_next;
+			context = next;
+		}
+	}
+
+	bfree(old_buckets);
+}
+
+/* the index lock must be held for writing by the caller */
+static void context_index_add(struct obs_context_index *index,
+			      struct obs_context_data *context)
+{
+	struct obs_context_data **bucket;
+
+	if (index->num >= index->num_buckets)
+		grow_context_index(index);
+
+	context->name_hash = hash_context_name(context->name);
+	bucket = get_index_bucket(index, context->name_hash);
+
+	context->index_next = *bucket;
+	*bucket = context;
+	index->num++;
+}
+
+static void context_index_remove(struct obs_context_index *index,
+				 struct obs_context_data *context)
+{
+	struct obs_context_data **prev =
+		get_index_bucket(index, context->name_hash);
+
+	while (*prev) {
+		if (*prev == context) {
+			*prev = context->index_next;
+			context->index_next = NULL;
+			index->num--;
+			break;
+		}
+		prev = &(*prev)->index_next;
+	}
+}
+
 void obs_context_data_insert(struct obs_context_data *context,
 			     pthread_mutex_t *mutex, void *pfirst)
 {
@@ -2146,10 +2562,33 @@ void obs_context_data_insert(struct obs_context_data *context,
 	if (context->next)
 		context->next->prev_next = &context->next;
 	pthread_mutex_unlock(mutex);
+
+	/* private contexts can't be looked up by name */
+	if (!context->private && context->name) {
+		struct obs_context_index *index =
+			get_context_index(context->type);
+
+		if (index) {
+			pthread_rwlock_wrlock(&index->lock);
+			context_index_add(index, context);
+			context->index = index;
+			pthread_rwlock_unlock(&index->lock);
+		}
+	}
 }
 
 void obs_context_data_remove(struct obs_context_data *context)
 {
+	if (context && context->index) {
+		struct obs_context_index *index = context->index;
+
+		pthread_rwlock_wrlock(&index->lock);
+		context_index_remove(index, context);
+		pthread_rwlock_unlock(&index->lock);
+
+		context->index = NULL;
+	}
+
 	if (context && context->mutex) {
 		pthread_mutex_lock(context->mutex);
 		if (context->prev_next)
@@ -2165,12 +2604,24 @@ void obs_context_data_remove(struct obs_context_data *context)
 void obs_context_data_setname(struct obs_context_data *context,
 			      const char *name)
 {
+	struct obs_context_index *index = context->index;
+
 	pthread_mutex_lock(&context->rename_cache_mutex);
 
+	if (index) {
+		pthread_rwlock_wrlock(&index->lock);
+		context_index_remove(index, context);
+	}
+
 	if (context->name)
 		da_push_back(context->rename_cache, &context->name);
 	context->name = dup_name(name, context->private);
 
+	if (index) {
+		context_index_add(index, context);
+		pthread_rwlock_unlock(&index->lock);
+	}
+
 	pthread_mutex_unlock(&context->rename_cache_mutex);
 }
 
@@ -2338,12 +2789,20 @@ uint32_t obs_get_lagged_frames(void)
 }
 
 void start_raw_video(video_t *v, const struct video_scale_info *conversion,
+		     const struct video_queue_info *queue, bool rendition,
 		     void (*callback)(void *param, struct video_data *frame),
 		     void *param)
 {
 	struct obs_core_video *video = &obs->video;
 	os_atomic_inc_long(&video->raw_active);
-	video_output_connect(v, conversion, callback, param);
+	if (rendition)
+		video_output_connect_rendition(v, conversion, queue, callback,
+					       param);
+	else if (queue)
+		video_output_connect_queued(v, conversion, queue, callback,
+					    param);
+	else
+		video_output_connect(v, conversion, callback, param);
 }
 
 void stop_raw_video(video_t *v,
@@ -2361,7 +2820,7 @@ void obs_add_raw_video_callback(const struct video_scale_info *conversion,
 				void *param)
 {
 	struct obs_core_video *video = &obs->video;
-	start_raw_video(video->video, conversion, callback, param);
+	start_raw_video(video->video, conversion, NULL, false, callback, param);
 }
 
 void obs_remove_raw_video_callback(void (*callback)(void *param,
@@ -187,6 +187,26 @@ struct obs_audio_info {
 	enum speaker_layout speakers;
 };
 
+/**
+ * Audio buffering statistics
+ *
+ * Buffering is added when a source delivers its audio late, and removed
+ * again once every source has had enough spare audio queued for a while.
+ */
+struct obs_audio_buffering_info {
+	uint32_t buffering_ms;     /**< Current audio buffering */
+	uint32_t max_buffering_ms; /**< Highest buffering since reset */
+	uint32_t slack_ms;         /**< Lowest source slack, last window */
+	uint32_t increases;        /**< Number of times buffering grew */
+	uint32_t decreases;        /**< Number of times buffering shrank */
+};
+
+/** A change of the audio buffering, see obs_get_audio_buffering_history */
+struct obs_audio_buffering_change {
+	uint64_t timestamp;    /**< System time of the change */
+	uint32_t buffering_ms; /**< Audio buffering after the change */
+};
+
 /**
  * Sent to source filters via the filter_audio callback to allow filtering of
  * audio data
@@ -389,6 +409,21 @@ EXPORT bool obs_get_video_info(struct obs_video_info *ovi);
 /** Gets the current audio settings, returns false if no audio */
 EXPORT bool obs_get_audio_info(struct obs_audio_info *oai);
 
+/** Gets the current audio buffering statistics, returns false if no audio */
+EXPORT bool
+obs_get_audio_buffering_info(struct obs_audio_buffering_info *info);
+
+/**
+ * Gets the most recent changes of the audio buffering, oldest first
+ *
+ * @param  changes  Array to receive the changes
+ * @param  count    Maximum number of changes to return
+ * @return          Number of changes written to the array
+ */
+EXPORT size_t
+obs_get_audio_buffering_history(struct obs_audio_buffering_change *changes,
+				size_t count);
+
 /**
  * Opens a plugin module directly from a specific path.
  *
@@ -695,7 +730,11 @@ typedef void (*obs_load_source_cb)(void *private_data, obs_source_t *source);
 EXPORT void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 			     void *private_data);
 
-/** Saves sources to a data array */
+/**
+ * Saves sources to a data array.  Only sources that have changed since the
+ * last call are saved again, the data of the other sources is shared with
+ * earlier calls and must not be modified.
+ */
 EXPORT obs_data_array_t *obs_save_sources(void);
 
 typedef bool (*obs_save_source_filter_cb)(void *data, obs_source_t *source);
@@ -1240,6 +1279,12 @@ EXPORT void obs_source_output_audio(obs_source_t *source,
 /** Signal an update to any currently used properties via 'update_properties' */
 EXPORT void obs_source_update_properties(obs_source_t *source);
 
+/**
+ * Reports that the video of a source with OBS_SOURCE_STATIC_VIDEO has changed
+ * outside of its update callback, so its cached render is drawn again
+ */
+EXPORT void obs_source_video_changed(obs_source_t *source);
+
 /** Gets the current async video frame */
 EXPORT struct obs_source_frame *obs_source_get_frame(obs_source_t *source);
 
@@ -1289,6 +1334,17 @@ EXPORT void obs_source_process_filter_tech_end(obs_source_t *filter,
 /** Skips the filter if the filter is invalid and cannot be rendered */
 EXPORT void obs_source_skip_video_filter(obs_source_t *filter);
 
+/**
+ * Creates the effect of a filter with OBS_SOURCE_FUSABLE_FILTER from an effect
+ * fragment, which only declares uniforms and functions, with a leading '$' on
+ * each of their names, including a "float4 $Process(float4 rgba)" function
+ * that returns the filtered color of a pixel.  The effect that is returned has
+ * the '$' removed and a "Draw" technique.  Must be called within the graphics
+ * context.
+ */
+EXPORT gs_effect_t *obs_filter_fragment_create(const char *file,
+					       char **error_string);
+
 /**
  * Adds an active child source.  Must be called by parent sources on child
  * sources when the child is added and active.  This ensures that the source is
@@ -1955,6 +2011,16 @@ EXPORT void obs_output_signal_stop(obs_output_t *output, int code);
 
 EXPORT uint64_t obs_output_get_pause_offset(obs_output_t *output);
 
+/**
+ * Asks the video encoder of a congested output to encode only one of every
+ * interval frames, 0 or 1 to encode every frame again.  The encoder only
+ * skips frames as far as every active output using it asks for it, skipped
+ * frames are left out of the pts.  Encoders count their keyframe interval in
+ * frames, so skipping stretches it by up to the skip interval.  Does not apply
+ * to encoders that encode textures.
+ */
+EXPORT void obs_output_set_frame_skip(obs_output_t *output, uint32_t interval);
+
 /* ------------------------------------------------------------------------- */
 /* Encoders */
 
@@ -2026,6 +2092,45 @@ EXPORT enum obs_encoder_type obs_encoder_get_type(const obs_encoder_t *encoder);
 EXPORT void obs_encoder_set_scaled_size(obs_encoder_t *encoder, uint32_t width,
 					uint32_t height);
 
+/**
+ * Makes a video encoder one rendition of a set of encodings of the same video
+ * at decreasing sizes (set with obs_encoder_set_scaled_size), such as a
+ * 1080p/720p/480p ladder.  Each rendition is scaled down from the next larger
+ * one instead of the full frame.  Does not apply to encoders that encode
+ * textures.  If the encoder is active, this function will trigger a warning,
+ * and do nothing.
+ */
+EXPORT void obs_encoder_set_rendition(obs_encoder_t *encoder, bool rendition);
+
+/** For video encoders, returns true if the encoder is a rendition */
+EXPORT bool obs_encoder_is_rendition(const obs_encoder_t *encoder);
+
+/**
+ * Sets the size and policy of the queue that passes raw frames to a video
+ * encoder, which encodes on a thread of its own.  By default the queue holds
+ * 3 frames and the video thread waits when it is full.  Frames dropped by the
+ * queue are skipped in the pts.  Does not apply to encoders that encode
+ * textures.  If the encoder is active, this function will trigger a warning,
+ * and do nothing.
+ */
+EXPORT void obs_encoder_set_frame_queue(obs_encoder_t *encoder,
+					const struct video_queue_info *queue);
+
+/**
+ * Gets the depth and latency statistics of the frame queue of an active video
+ * encoder.  Returns false if the encoder has no frame queue.
+ */
+EXPORT bool obs_encoder_get_frame_queue_stats(const obs_encoder_t *encoder,
+					      struct video_queue_stats *stats);
+
+/**
+ * Returns the number of raw frames that were passed to a video encoder but
+ * did not come out as packets yet, both in its frame queue and in the encoder
+ * itself (lookahead, b-frames).  Outputs can use it to tell how much more
+ * will be buffered no matter what.
+ */
+EXPORT uint32_t obs_encoder_get_frames_in_flight(const obs_encoder_t *encoder);
+
 /** For video encoders, returns true if pre-encode scaling is enabled */
 EXPORT bool obs_encoder_scaling_enabled(const obs_encoder_t *encoder);
 
@@ -2249,6 +2354,19 @@ static inline void obs_source_frame_destroy(struct obs_source_frame *frame)
 EXPORT void obs_source_frame_copy(struct obs_source_frame *dst,
 				  const struct obs_source_frame *src);
 
+/** Memory used for the frames of async sources, shared between all sources */
+struct obs_frame_pool_stats {
+	uint64_t hits;           /**< frames that reused memory */
+	uint64_t allocations;    /**< frames that needed new memory */
+	uint64_t bytes_resident; /**< memory held, in use or idle */
+	uint64_t bytes_idle;     /**< memory held for later frames */
+};
+
+EXPORT void obs_get_frame_pool_stats(struct obs_frame_pool_stats *stats);
+
+/** Sets how much memory may be held for later frames, 0 for none */
+EXPORT void obs_set_frame_pool_limit(uint64_t bytes);
+
 /* ------------------------------------------------------------------------- */
 /* Get source icon type */
 EXPORT enum obs_icon_type obs_source_get_icon_type(const char *id);
@@ -12,8 +12,15 @@
 
 //#define TRACK_OVERHEAD
 
+typedef struct profile_counter profile_counter;
+struct profile_counter {
+	const char *name;
+	int64_t value;
+};
+
 struct profiler_snapshot {
 	DARRAY(profiler_snapshot_entry_t) roots;
+	DARRAY(profile_counter) counters;
 };
 
 struct profiler_snapshot_entry {
@@ -263,6 +270,9 @@ static DARRAY(profile_root_entry) root_entries;
 static THREAD_LOCAL profile_call *thread_context = NULL;
 static THREAD_LOCAL bool thread_enabled = true;
 
+static pthread_mutex_t counters_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(profile_counter) counters;
+
 void profiler_start(void)
 {
 	pthread_mutex_lock(&root_mutex);
@@ -334,6 +344,35 @@ void profile_register_root(const char *name,
 	pthread_mutex_unlock(&root_mutex);
 }
 
+void profile_count(const char *name, int64_t amount)
+{
+	profile_counter *counter = NULL;
+
+	pthread_mutex_lock(&counters_mutex);
+
+	/* profiler_free clears this before it frees the counters under
+	 * counters_mutex, so nothing is added back afterwards */
+	if (!enabled) {
+		pthread_mutex_unlock(&counters_mutex);
+		return;
+	}
+
+	for (size_t i = 0; i < counters.num; i++) {
+		if (counters.array[i].name == name) {
+			counter = &counters.array[i];
+			break;
+		}
+	}
+
+	if (!counter) {
+		counter = da_push_back_new(counters);
+		counter->name = name;
+	}
+
+	counter->value += amount;
+	pthread_mutex_unlock(&counters_mutex);
+}
+
 static void free_call_context(profile_call *context);
 
 static void merge_context(profile_call *context)
@@ -724,7 +763,7 @@ static void profile_print_entry_expected(profiler_snapshot_entry_t *entry,
 }
 
 void profile_print_func(const char *intro, profile_entry_print_func print,
-			profiler_snapshot_t *snap)
+			profiler_snapshot_t *snap, bool print_counters)
 {
 	struct dstr indent_buffer = {0};
 	struct dstr output_buffer = {0};
@@ -738,6 +777,14 @@ void profile_print_func(const char *intro, profile_entry_print_func print,
 		print(&snap->roots.array[i], &indent_buffer, &output_buffer, 0,
 		      0, 0);
 	}
+
+	if (print_counters && snap->counters.num) {
+		blog(LOG_INFO, "Counters:");
+		for (size_t i = 0; i < snap->counters.num; i++)
+			blog(LOG_INFO, " %s: %" PRId64,
+			     snap->counters.array[i].name,
+			     snap->counters.array[i].value);
+	}
 	blog(LOG_INFO, "=================================================");
 
 	if (free_snapshot)
@@ -750,13 +797,13 @@ void profile_print_func(const char *intro, profile_entry_print_func print,
 void profiler_print(profiler_snapshot_t *snap)
 {
 	profile_print_func("== Profiler Results =============================",
-			   profile_print_entry, snap);
+			   profile_print_entry, snap, true);
 }
 
 void profiler_print_time_between_calls(profiler_snapshot_t *snap)
 {
 	profile_print_func("== Profiler Time Between Calls ==================",
-			   profile_print_entry_expected, snap);
+			   profile_print_entry_expected, snap, false);
 }
 
 static void free_call_children(profile_call *call)
@@ -825,6 +872,10 @@ void profiler_free(void)
 	}
 
 	da_free(old_root_entries);
+
+	pthread_mutex_lock(&counters_mutex);
+	da_free(counters);
+	pthread_mutex_unlock(&counters_mutex);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -936,6 +987,10 @@ profiler_snapshot_t *profile_snapshot_create(void)
 	}
 	pthread_mutex_unlock(&root_mutex);
 
+	pthread_mutex_lock(&counters_mutex);
+	da_copy(snap->counters, counters);
+	pthread_mutex_unlock(&counters_mutex);
+
 	for (size_t i = 0; i < snap->roots.num; i++)
 		sort_snapshot_entry(&snap->roots.array[i]);
 
@@ -961,6 +1016,7 @@ void profile_snapshot_free(profiler_snapshot_t *snap)
 		free_snapshot_entry(&snap->roots.array[i]);
 
 	da_free(snap->roots);
+	da_free(snap->counters);
 	bfree(snap);
 }
 
@@ -1171,3 +1227,23 @@ uint64_t profiler_snapshot_entry_overall_between_calls_count(
 {
 	return entry ? entry->overall_between_calls_count : 0;
 }
+
+size_t profiler_snapshot_num_counters(profiler_snapshot_t *snap)
+{
+	return snap ? snap->counters.num : 0;
+}
+
+const char *profiler_snapshot_counter_name(profiler_snapshot_t *snap,
+					   size_t idx)
+{
+	if (!snap || idx >= snap->counters.num)
+		return NULL;
+	return snap->counters.array[idx].name;
+}
+
+int64_t profiler_snapshot_counter_value(profiler_snapshot_t *snap, size_t idx)
+{
+	if (!snap || idx >= snap->counters.num)
+		return 0;
+	return snap->counters.array[idx].value;
+}
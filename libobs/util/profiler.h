@@ -22,6 +22,11 @@ EXPORT void profile_end(const char *name);
 
 EXPORT void profile_reenable_thread(void);
 
+/* ------------------------------------------------------------------------- */
+/* Counters, identified by name pointer like profiler entries */
+
+EXPORT void profile_count(const char *name, int64_t amount);
+
 /* ------------------------------------------------------------------------- */
 /* Profiler control */
 
@@ -114,6 +119,12 @@ EXPORT uint64_t profiler_snapshot_entry_max_time_between_calls(
 EXPORT uint64_t profiler_snapshot_entry_overall_between_calls_count(
 	profiler_snapshot_entry_t *entry);
 
+EXPORT size_t profiler_snapshot_num_counters(profiler_snapshot_t *snap);
+EXPORT const char *profiler_snapshot_counter_name(profiler_snapshot_t *snap,
+						  size_t idx);
+EXPORT int64_t profiler_snapshot_counter_value(profiler_snapshot_t *snap,
+					       size_t idx);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,6 +1,7 @@
 #include <obs-module.h>
 #include <graphics/image-file.h>
 #include <util/platform.h>
+#include <util/threading.h>
 #include <util/dstr.h>
 #include <sys/stat.h>
 
@@ -21,6 +22,7 @@ struct image_source {
 	float update_time_elapsed;
 	uint64_t last_time;
 	bool active;
+	volatile bool texture_pending;
 
 	gs_image_file2_t if2;
 };
@@ -39,34 +41,67 @@ static const char *image_source_get_name(void *unused)
 	return obs_module_text("ImageInput");
 }
 
-static void image_source_load(struct image_source *context)
+static void image_source_unload(struct image_source *context)
 {
-	char *file = context->file;
+	/* there is no texture to free, so don't wait on the graphics thread.
+	 * this is always the case when the source is first created */
+	if (!context->if2.image.loaded) {
+		gs_image_file2_free(&context->if2);
+		return;
+	}
 
 	obs_enter_graphics();
+	os_atomic_set_bool(&context->texture_pending, false);
 	gs_image_file2_free(&context->if2);
 	obs_leave_graphics();
 
+	obs_source_video_changed(context->source);
+}
+
+/* video_tick runs outside of the graphics context, so it is only entered
+ * when there is a texture to create.  the flag is taken inside of it, so an
+ * unload on another thread can't free the image in between */
+static void image_source_upload(struct image_source *context)
+{
+	bool uploaded;
+
+	if (!os_atomic_load_bool(&context->texture_pending))
+		return;
+
+	obs_enter_graphics();
+	uploaded = os_atomic_set_bool(&context->texture_pending, false);
+	if (uploaded)
+		gs_image_file2_init_texture(&context->if2);
+	obs_leave_graphics();
+
+	if (uploaded)
+		obs_source_video_changed(context->source);
+}
+
+static void image_source_load(struct image_source *context)
+{
+	char *file = context->file;
+
+	image_source_unload(context);
+
 	if (file && *file) {
 		debug("loading texture '%s'", file);
 		context->file_timestamp = get_modified_timestamp(file);
 		gs_image_file2_init(&context->if2, file);
 		context->update_time_elapsed = 0;
 
-		obs_enter_graphics();
-		gs_image_file2_init_texture(&context->if2);
-		obs_leave_graphics();
-
-		if (!context->if2.image.loaded)
+		if (!context->if2.image.loaded) {
 			warn("failed to load texture '%s'", file);
-	}
-}
+			return;
+		}
 
-static void image_source_unload(struct image_source *context)
-{
-	obs_enter_graphics();
-	gs_image_file2_free(&context->if2);
-	obs_leave_graphics();
+		/* off the graphics thread, the texture is created on the next
+		 * tick along with those of any other images loaded meanwhile,
+		 * rather than waiting for the graphics context here */
+		os_atomic_set_bool(&context->texture_pending, true);
+		if (gs_get_context())
+			image_source_upload(context);
+	}
 }
 
 static void image_source_update(void *data, obs_data_t *settings)
@@ -158,6 +193,8 @@ static void image_source_tick(void *data, float seconds)
 	struct image_source *context = data;
 	uint64_t frame_time = obs_get_video_frame_time();
 
+	image_source_upload(context);
+
 	context->update_time_elapsed += seconds;
 
 	if (obs_source_showing(context->source)) {
@@ -188,6 +225,7 @@ static void image_source_tick(void *data, float seconds)
 				obs_enter_graphics();
 				gs_image_file2_update_texture(&context->if2);
 				obs_leave_graphics();
+				obs_source_video_changed(context->source);
 			}
 
 			context->active = false;
@@ -204,6 +242,7 @@ static void image_source_tick(void *data, float seconds)
 			obs_enter_graphics();
 			gs_image_file2_update_texture(&context->if2);
 			obs_leave_graphics();
+			obs_source_video_changed(context->source);
 		}
 	}
 
@@ -255,7 +294,8 @@ uint64_t image_source_get_memory_usage(void *data)
 static struct obs_source_info image_source_info = {
 	.id = "image_source",
 	.type = OBS_SOURCE_TYPE_INPUT,
-	.output_flags = OBS_SOURCE_VIDEO,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_PARALLEL_CREATE |
+			OBS_SOURCE_STATIC_VIDEO,
 	.get_name = image_source_get_name,
 	.create = image_source_create,
 	.destroy = image_source_destroy,
@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2015 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+/*
+ * Shared memory ring used to pass packet payloads to the muxer process.
+ *
+ * The output copies each payload into the ring and then writes the packet
+ * info to the pipe as usual, with the offset of the payload in the ring.  The
+ * pipe only carries the small info structures, the muxer reads the payloads
+ * straight from the ring.  Once the muxer is done with a packet it hands the
+ * space back by storing the end position of the packet in the ring header.
+ *
+ * When a payload does not fit in the free space of the ring, it is written to
+ * the pipe instead, so the output never has to wait for the muxer.
+ *
+ * This header is used by both obs-ffmpeg and obs-ffmpeg-mux, which does not
+ * link to libobs, so it only depends on the platform.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* must be a power of two */
+#define FFM_SHM_SIZE (32 * 1024 * 1024)
+#define FFM_SHM_ALIGN 64
+
+/* ffmpeg expects zeroed padding after the data of a packet */
+#define FFM_SHM_PADDING 64
+
+struct ffm_shm_header {
+	uint32_t size;
+
+	/* position up to which the muxer is done with the ring, modulo 2^32 */
+	volatile long released;
+};
+
+#define FFM_SHM_HEADER_SIZE FFM_SHM_ALIGN
+
+struct ffm_shm {
+	struct ffm_shm_header *header;
+	uint8_t *data;
+	uint32_t size;
+	char name[64];
+
+	/* position up to which the output has written, modulo 2^32 */
+	uint32_t write_pos;
+
+#ifdef _WIN32
+	HANDLE handle;
+#else
+	bool owner;
+#endif
+};
+
+static inline long ffm_shm_load(volatile long *val)
+{
+#ifdef _WIN32
+	return InterlockedOr(val, 0);
+#else
+	return __atomic_load_n(val, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline void ffm_shm_store(volatile long *val, long new_val)
+{
+#ifdef _WIN32
+	InterlockedExchange(val, new_val);
+#else
+	__atomic_store_n(val, new_val, __ATOMIC_RELEASE);
+#endif
+}
+
+static inline bool ffm_shm_map(struct ffm_shm *shm, size_t total)
+{
+#ifdef _WIN32
+	void *ptr = MapViewOfFile(shm->handle, FILE_MAP_ALL_ACCESS, 0, 0,
+				  total);
+#else
+	int fd = shm_open(shm->name, O_RDWR, 0600);
+	if (fd == -1)
+		return false;
+
+	if (shm->owner && ftruncate(fd, (off_t)total) != 0) {
+		close(fd);
+		return false;
+	}
+
+	void *ptr = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+			 0);
+	close(fd);
+
+	if (ptr == MAP_FAILED)
+		ptr = NULL;
+#endif
+	if (!ptr)
+		return false;
+
+	shm->header = ptr;
+	shm->data = (uint8_t *)ptr + FFM_SHM_HEADER_SIZE;
+	return true;
+}
+
+static inline void ffm_shm_close(struct ffm_shm *shm)
+{
+#ifdef _WIN32
+	if (shm->header)
+		UnmapViewOfFile(shm->header);
+	if (shm->handle)
+		CloseHandle(shm->handle);
+#else
+	if (shm->header)
+		munmap(shm->header, FFM_SHM_HEADER_SIZE + (size_t)shm->size);
+	if (shm->owner)
+		shm_unlink(shm->name);
+#endif
+	memset(shm, 0, sizeof(*shm));
+}
+
+/* creates a new ring, the muxer process opens it by name */
+static inline bool ffm_shm_create(struct ffm_shm *shm, uint32_t size)
+{
+	static volatile long counter = 0;
+	size_t total = FFM_SHM_HEADER_SIZE + (size_t)size;
+
+	memset(shm, 0, sizeof(*shm));
+
+#ifdef _WIN32
+	long idx = InterlockedIncrement(&counter);
+
+	snprintf(shm->name, sizeof(shm->name), "obs-ffmpeg-mux-%lu-%ld",
+		 (unsigned long)GetCurrentProcessId(), idx);
+
+	shm->handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL,
+					 PAGE_READWRITE, 0, (DWORD)total,
+					 shm->name);
+	if (shm->handle && GetLastError() == ERROR_ALREADY_EXISTS) {
+		CloseHandle(shm->handle);
+		shm->handle = NULL;
+	}
+	if (!shm->handle)
+		return false;
+#else
+	long idx = __atomic_add_fetch(&counter, 1, __ATOMIC_SEQ_CST);
+
+	snprintf(shm->name, sizeof(shm->name), "/obs-ffmpeg-mux-%ld-%ld",
+		 (long)getpid(), idx);
+
+	int fd = shm_open(shm->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd == -1)
+		return false;
+	close(fd);
+	shm->owner = true;
+#endif
+
+	shm->size = size;
+	if (!ffm_shm_map(shm, total)) {
+		ffm_shm_close(shm);
+		return false;
+	}
+
+	shm->header->size = size;
+	ffm_shm_store(&shm->header->released, 0);
+	return true;
+}
+
+/* opens a ring created by ffm_shm_create in another process */
+static inline bool ffm_shm_open(struct ffm_shm *shm, const char *name)
+{
+	memset(shm, 0, sizeof(*shm));
+	snprintf(shm->name, sizeof(shm->name), "%s", name);
+
+#ifdef _WIN32
+	shm->handle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, shm->name);
+	if (!shm->handle)
+		return false;
+#endif
+
+	/* maps the header first to find out the size of the ring */
+	if (!ffm_shm_map(shm, FFM_SHM_HEADER_SIZE)) {
+		ffm_shm_close(shm);
+		return false;
+	}
+
+	uint32_t size = shm->header->size;
+
+#ifdef _WIN32
+	UnmapViewOfFile(shm->header);
+#else
+	munmap(shm->header, FFM_SHM_HEADER_SIZE);
+#endif
+	shm->header = NULL;
+
+	if (!size || (size & (size - 1)) != 0 ||
+	    !ffm_shm_map(shm, FFM_SHM_HEADER_SIZE + (size_t)size)) {
+		ffm_shm_close(shm);
+		return false;
+	}
+
+	shm->size = size;
+	return true;
+}
+
+/* copies a payload into the ring, fails if there is not enough free space.
+ * end is the position the muxer releases once it is done with the payload */
+static inline bool ffm_shm_write(struct ffm_shm *shm, const uint8_t *data,
+				 uint32_t size, uint32_t *offset, uint32_t *end)
+{
+	uint32_t released = (uint32_t)ffm_shm_load(&shm->header->released);
+	uint32_t used = shm->write_pos - released;
+	uint32_t pos = shm->write_pos & (shm->size - 1);
+	uint32_t skip = 0;
+	uint64_t need;
+
+	need = ((uint64_t)size + FFM_SHM_PADDING + FFM_SHM_ALIGN - 1) &
+	       ~(uint64_t)(FFM_SHM_ALIGN - 1);
+
+	/* payloads are never split, the end of the ring is skipped instead */
+	if (pos + need > shm->size)
+		skip = shm->size - pos;
+	if (skip + need > (uint64_t)(shm->size - used))
+		return false;
+
+	if (skip)
+		pos = 0;
+
+	memcpy(shm->data + pos, data, size);
+	memset(shm->data + pos + size, 0, FFM_SHM_PADDING);
+
+	shm->write_pos += skip + (uint32_t)need;
+	*offset = pos;
+	*end = shm->write_pos;
+	return true;
+}
+
+/* called by the muxer in the order the payloads were written */
+static inline void ffm_shm_release(struct ffm_shm *shm, uint32_t end)
+{
+	ffm_shm_store(&shm->header->released, (long)end);
+}
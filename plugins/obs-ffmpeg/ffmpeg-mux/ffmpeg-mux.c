@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "ffmpeg-mux.h"
+#include "ffmpeg-mux-shm.h"
 
 #include <libavformat/avformat.h>
 
@@ -85,6 +86,7 @@ struct main_params {
 	int color_range;
 	char *acodec;
 	char *muxer_settings;
+	char *shm_name;
 };
 
 struct audio_params {
@@ -104,6 +106,13 @@ struct audio_info {
 	AVCodecContext *ctx;
 };
 
+struct shm_packet {
+	struct ffmpeg_mux *ffm;
+	uint32_t end;
+	bool done;
+	struct shm_packet *next;
+};
+
 struct ffmpeg_mux {
 	AVFormatContext *output;
 	AVStream *video_stream;
@@ -116,6 +125,10 @@ struct ffmpeg_mux {
 	int num_audio_streams;
 	bool initialized;
 	char error[4096];
+
+	struct ffm_shm shm;
+	struct shm_packet *first_shm_packet;
+	struct shm_packet *last_shm_packet;
 };
 
 static void header_free(struct header *header)
@@ -172,6 +185,14 @@ static void ffmpeg_mux_free(struct ffmpeg_mux *ffm)
 		free(ffm->audio);
 	}
 
+	while (ffm->first_shm_packet) {
+		struct shm_packet *next = ffm->first_shm_packet->next;
+		free(ffm->first_shm_packet);
+		ffm->first_shm_packet = next;
+	}
+
+	ffm_shm_close(&ffm->shm);
+
 	memset(ffm, 0, sizeof(*ffm));
 }
 
@@ -289,6 +310,10 @@ static bool init_params(int *argc, char ***argv, struct main_params *params,
 
 	get_opt_str(argc, argv, &params->muxer_settings, "muxer settings");
 
+	if (*argc)
+		get_opt_str(argc, argv, &params->shm_name,
+			    "shared memory name");
+
 	return true;
 }
 
@@ -626,6 +651,13 @@ static int ffmpeg_mux_init_internal(struct ffmpeg_mux *ffm, int argc,
 			calloc(ffm->params.tracks, sizeof(*ffm->audio_header));
 	}
 
+	if (ffm->params.shm_name &&
+	    !ffm_shm_open(&ffm->shm, ffm->params.shm_name)) {
+		fprintf(stderr, "Couldn't open shared memory '%s'\n",
+			ffm->params.shm_name);
+		return FFM_ERROR;
+	}
+
 #if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 9, 100)
 	av_register_all();
 #endif
@@ -699,6 +731,7 @@ static inline int64_t rescale_ts(struct ffmpeg_mux *ffm,
 }
 
 static inline bool ffmpeg_mux_packet(struct ffmpeg_mux *ffm, uint8_t *buf,
+				     AVBufferRef *buf_ref,
 				     struct ffm_packet_info *info)
 {
 	int idx = get_index(ffm, info);
@@ -706,6 +739,7 @@ static inline bool ffmpeg_mux_packet(struct ffmpeg_mux *ffm, uint8_t *buf,
 
 	/* The muxer might not support video/audio, or multiple audio tracks */
 	if (idx == -1) {
+		av_buffer_unref(&buf_ref);
 		return true;
 	}
 
@@ -714,6 +748,7 @@ static inline bool ffmpeg_mux_packet(struct ffmpeg_mux *ffm, uint8_t *buf,
 
 	av_init_packet(&packet);
 
+	packet.buf = buf_ref;
 	packet.data = buf;
 	packet.size = (int)info->size;
 	packet.stream_index = idx;
@@ -733,6 +768,67 @@ static inline bool ffmpeg_mux_packet(struct ffmpeg_mux *ffm, uint8_t *buf,
 	return ret >= 0;
 }
 
+/* the interleaver can hold on to packets of one stream while writing packets
+ * of another, so the ring is only released up to the oldest packet that is
+ * still in use */
+static void release_shm_packet(void *opaque, uint8_t *data)
+{
+	struct shm_packet *pkt = opaque;
+	struct ffmpeg_mux *ffm = pkt->ffm;
+
+	pkt->done = true;
+
+	while (ffm->first_shm_packet && ffm->first_shm_packet->done) {
+		struct shm_packet *first = ffm->first_shm_packet;
+
+		ffm_shm_release(&ffm->shm, first->end);
+		ffm->first_shm_packet = first->next;
+		if (!first->next)
+			ffm->last_shm_packet = NULL;
+		free(first);
+	}
+
+	(void)data;
+}
+
+static bool ffmpeg_mux_shm_packet(struct ffmpeg_mux *ffm,
+				  struct ffm_packet_info *info)
+{
+	struct shm_packet *pkt;
+	AVBufferRef *buf_ref;
+	uint8_t *data;
+
+	if (!ffm->shm.data || info->shm_offset >= ffm->shm.size ||
+	    info->size > ffm->shm.size - info->shm_offset) {
+		fprintf(stderr, "Invalid shared memory packet\n");
+		return false;
+	}
+
+	data = ffm->shm.data + info->shm_offset;
+
+	pkt = calloc(1, sizeof(*pkt));
+	pkt->ffm = ffm;
+	pkt->end = info->shm_end;
+
+	if (ffm->last_shm_packet)
+		ffm->last_shm_packet->next = pkt;
+	else
+		ffm->first_shm_packet = pkt;
+	ffm->last_shm_packet = pkt;
+
+	/* the packet references the ring directly, it is released once the
+	 * muxer has written it */
+	buf_ref = av_buffer_create(data, (int)info->size, release_shm_packet,
+				   pkt, 0);
+	if (!buf_ref) {
+		bool success = ffmpeg_mux_packet(ffm, data, NULL, info);
+		release_shm_packet(pkt, data);
+		return success;
+	}
+
+	return ffmpeg_mux_packet(ffm, data, buf_ref, info);
+}
+
 /* ------------------------------------------------------------------------- */
 
 #ifdef _WIN32
@@ -776,10 +872,15 @@ int main(int argc, char *argv[])
 	}
 
 	while (!fail && safe_read(&info, sizeof(info)) == sizeof(info)) {
+		if (info.shm) {
+			fail = !ffmpeg_mux_shm_packet(&ffm, &info);
+			continue;
+		}
+
 		resize_buf_resize(&rb, info.size);
 
 		if (safe_read(rb.buf, info.size) == info.size) {
-			fail = !ffmpeg_mux_packet(&ffm, rb.buf, &info);
+			fail = !ffmpeg_mux_packet(&ffm, rb.buf, NULL, &info);
 		} else {
 			fail = true;
 		}
@@ -34,4 +34,10 @@ struct ffm_packet_info {
 	uint32_t index;
 	enum ffm_packet_type type;
 	bool keyframe;
+
+	/* set when the payload is in the shared memory ring instead of
+	 * following the info on the pipe, see ffmpeg-mux-shm.h */
+	bool shm;
+	uint32_t shm_offset;
+	uint32_t shm_end;
 };
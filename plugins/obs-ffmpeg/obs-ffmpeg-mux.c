@@ -22,9 +22,10 @@
 #include <util/pipe.h>
 #include <util/darray.h>
 #include <util/platform.h>
-#include <util/circlebuf.h>
 #include <util/threading.h>
 #include "ffmpeg-mux/ffmpeg-mux.h"
+#include "ffmpeg-mux/ffmpeg-mux-shm.h"
+#include "obs-ffmpeg-replay-store.h"
 
 #ifdef _WIN32
 #include "util/windows/win-version.h"
@@ -42,6 +43,7 @@
 struct ffmpeg_muxer {
 	obs_output_t *output;
 	os_process_pipe_t *pipe;
+	struct ffm_shm shm;
 	int64_t stop_ts;
 	uint64_t total_bytes;
 	struct dstr path;
@@ -51,16 +53,13 @@ struct ffmpeg_muxer {
 	volatile bool capturing;
 
 	/* replay buffer */
-	struct circlebuf packets;
-	int64_t cur_size;
-	int64_t cur_time;
+	struct replay_store store;
 	int64_t max_size;
 	int64_t max_time;
 	int64_t save_ts;
-	int keyframes;
 	obs_hotkey_id hotkey;
 
-	DARRAY(struct encoder_packet) mux_packets;
+	DARRAY(struct replay_segment *) mux_segments;
 	pthread_t mux_thread;
 	bool mux_thread_joinable;
 	volatile bool muxing;
@@ -82,19 +81,10 @@ static const char *ffmpeg_mpegts_mux_getname(void *type)
 
 static inline void replay_buffer_clear(struct ffmpeg_muxer *stream)
 {
-	while (stream->packets.size > 0) {
-		struct encoder_packet pkt;
-		circlebuf_pop_front(&stream->packets, &pkt, sizeof(pkt));
-		obs_encoder_packet_release(&pkt);
-	}
-
-	circlebuf_free(&stream->packets);
-	stream->cur_size = 0;
-	stream->cur_time = 0;
+	replay_store_free(&stream->store);
 	stream->max_size = 0;
 	stream->max_time = 0;
 	stream->save_ts = 0;
-	stream->keyframes = 0;
 }
 
 static void ffmpeg_mux_destroy(void *data)
@@ -104,9 +94,10 @@ static void ffmpeg_mux_destroy(void *data)
 	replay_buffer_clear(stream);
 	if (stream->mux_thread_joinable)
 		pthread_join(stream->mux_thread, NULL);
-	da_free(stream->mux_packets);
+	da_free(stream->mux_segments);
 
 	os_process_pipe_destroy(stream->pipe);
+	ffm_shm_close(&stream->shm);
 	dstr_free(&stream->path);
 	bfree(stream);
 }
@@ -292,16 +283,33 @@ static void build_command_line(struct ffmpeg_muxer *stream, struct dstr *cmd,
 	}
 
 	add_muxer_params(cmd, stream);
+
+	if (stream->shm.data)
+		dstr_catf(cmd, "\"%s\" ", stream->shm.name);
 }
 
 static inline void start_pipe(struct ffmpeg_muxer *stream, const char *path)
 {
 	struct dstr cmd;
+
+	/* packets are sent through the pipe if this fails */
+	if (!ffm_shm_create(&stream->shm, FFM_SHM_SIZE))
+		warn("Failed to create shared memory, using the pipe only");
+
 	build_command_line(stream, &cmd, path);
 	stream->pipe = os_process_pipe_create(cmd.array, "w");
 	dstr_free(&cmd);
 }
 
+/* waits for the muxer process to exit before it unmaps the shared memory */
+static inline int stop_pipe(struct ffmpeg_muxer *stream)
+{
+	int ret = os_process_pipe_destroy(stream->pipe);
+	stream->pipe = NULL;
+	ffm_shm_close(&stream->shm);
+	return ret;
+}
+
 static void set_file_not_readable_error(struct ffmpeg_muxer *stream,
 					obs_data_t *settings, const char *path)
 {
@@ -365,6 +373,7 @@ static bool ffmpeg_mux_start(void *data)
 	obs_data_release(settings);
 
 	if (!stream->pipe) {
+		ffm_shm_close(&stream->shm);
 		obs_output_set_last_error(
 			stream->output, obs_module_text("HelperProcessFailed"));
 		warn("Failed to create process pipe");
@@ -386,8 +395,7 @@ static int deactivate(struct ffmpeg_muxer *stream, int code)
 	int ret = -1;
 
 	if (active(stream)) {
-		ret = os_process_pipe_destroy(stream->pipe);
-		stream->pipe = NULL;
+		ret = stop_pipe(stream);
 
 		os_atomic_set_bool(&stream->active, false);
 		os_atomic_set_bool(&stream->sent_headers, false);
@@ -451,8 +459,8 @@ static void signal_failure(struct ffmpeg_muxer *stream)
 	os_atomic_set_bool(&stream->capturing, false);
 }
 
-static bool write_packet(struct ffmpeg_muxer *stream,
-			 struct encoder_packet *packet)
+static bool write_packet_internal(struct ffmpeg_muxer *stream,
+				  struct encoder_packet *packet, bool use_shm)
 {
 	bool is_video = packet->type == OBS_ENCODER_VIDEO;
 	size_t ret;
@@ -465,6 +473,11 @@ static bool write_packet(struct ffmpeg_muxer *stream,
 							: FFM_PACKET_AUDIO,
 				       .keyframe = packet->keyframe};
 
+	if (use_shm && stream->shm.data)
+		info.shm = ffm_shm_write(&stream->shm, packet->data,
+					 (uint32_t)packet->size,
+					 &info.shm_offset, &info.shm_end);
+
 	ret = os_process_pipe_write(stream->pipe, (const uint8_t *)&info,
 				    sizeof(info));
 	if (ret != sizeof(info)) {
@@ -473,6 +486,11 @@ static bool write_packet(struct ffmpeg_muxer *stream,
 		return false;
 	}
 
+	if (info.shm) {
+		stream->total_bytes += packet->size;
+		return true;
+	}
+
 	ret = os_process_pipe_write(stream->pipe, packet->data, packet->size);
 	if (ret != packet->size) {
 		warn("os_process_pipe_write for packet data failed");
@@ -484,6 +502,20 @@ static bool write_packet(struct ffmpeg_muxer *stream,
 	return true;
 }
 
+static inline bool write_packet(struct ffmpeg_muxer *stream,
+				struct encoder_packet *packet)
+{
+	return write_packet_internal(stream, packet, true);
+}
+
+/* headers are read before the muxer is set up, they always go through the
+ * pipe */
+static inline bool write_header(struct ffmpeg_muxer *stream,
+				struct encoder_packet *packet)
+{
+	return write_packet_internal(stream, packet, false);
+}
+
 static bool send_audio_headers(struct ffmpeg_muxer *stream,
 			       obs_encoder_t *aencoder, size_t idx)
 {
@@ -491,7 +523,7 @@ static bool send_audio_headers(struct ffmpeg_muxer *stream,
 		.type = OBS_ENCODER_AUDIO, .timebase_den = 1, .track_idx = idx};
 
 	obs_encoder_get_extra_data(aencoder, &packet.data, &packet.size);
-	return write_packet(stream, &packet);
+	return write_header(stream, &packet);
 }
 
 static bool send_video_headers(struct ffmpeg_muxer *stream)
@@ -502,7 +534,7 @@ static bool send_video_headers(struct ffmpeg_muxer *stream)
 					.timebase_den = 1};
 
 	obs_encoder_get_extra_data(vencoder, &packet.data, &packet.size);
-	return write_packet(stream, &packet);
+	return write_header(stream, &packet);
 }
 
 static bool send_headers(struct ffmpeg_muxer *stream)
@@ -711,6 +743,18 @@ static bool replay_buffer_start(void *data)
 	obs_data_t *s = obs_output_get_settings(stream->output);
 	stream->max_time = obs_data_get_int(s, "max_time_sec") * 1000000LL;
 	stream->max_size = obs_data_get_int(s, "max_size_mb") * (1024 * 1024);
+
+	int64_t max_mem = obs_data_get_int(s, "max_memory_mb") * (1024 * 1024);
+	const char *spill_dir = obs_data_get_string(s, "spill_directory");
+	char *default_dir = NULL;
+
+	if (max_mem && !*spill_dir) {
+		default_dir = obs_module_config_path("replay-buffer");
+		spill_dir = default_dir;
+	}
+
+	replay_store_init(&stream->store, max_mem, spill_dir);
+	bfree(default_dir);
 	obs_data_release(s);
 
 	os_atomic_set_bool(&stream->active, true);
@@ -721,96 +765,137 @@ static bool replay_buffer_start(void *data)
 	return true;
 }
 
-static bool purge_front(struct ffmpeg_muxer *stream)
-{
-	struct encoder_packet pkt;
-	bool keyframe;
-
-	circlebuf_pop_front(&stream->packets, &pkt, sizeof(pkt));
-
-	keyframe = pkt.type == OBS_ENCODER_VIDEO && pkt.keyframe;
+#define REPLAY_TRACKS (MAX_AUDIO_MIXES + 1)
 
-	if (keyframe)
-		stream->keyframes--;
-
-	if (!stream->packets.size) {
-		stream->cur_size = 0;
-		stream->cur_time = 0;
-	} else {
-		struct encoder_packet first;
-		circlebuf_peek_front(&stream->packets, &first, sizeof(first));
-		stream->cur_time = first.dts_usec;
-		stream->cur_size -= (int64_t)pkt.size;
-	}
+struct replay_cursor {
+	size_t segment;
+	size_t idx;
+};
 
-	obs_encoder_packet_release(&pkt);
-	return keyframe;
+static inline size_t replay_track(const struct encoder_packet *pkt)
+{
+	return pkt->type == OBS_ENCODER_VIDEO ? 0 : pkt->track_idx + 1;
 }
 
-static inline void purge(struct ffmpeg_muxer *stream)
+/* moves the cursor to the next packet of a track, or past the last segment
+ * if there are no more */
+static void seek_track(struct ffmpeg_muxer *stream,
+		       struct replay_cursor *cursor, size_t track)
 {
-	if (purge_front(stream)) {
-		struct encoder_packet pkt;
+	while (cursor->segment < stream->mux_segments.num) {
+		struct replay_segment *segment =
+			stream->mux_segments.array[cursor->segment];
 
-		for (;;) {
-			circlebuf_peek_front(&stream->packets, &pkt,
-					     sizeof(pkt));
-			if (pkt.type == OBS_ENCODER_VIDEO && pkt.keyframe)
+		for (; cursor->idx < segment->packets.num; cursor->idx++) {
+			if (replay_track(segment->packets.array +
+					 cursor->idx) == track)
 				return;
-
-			purge_front(stream);
 		}
+
+		cursor->segment++;
+		cursor->idx = 0;
 	}
 }
 
-static inline void replay_buffer_purge(struct ffmpeg_muxer *stream,
-				       struct encoder_packet *pkt)
+static inline struct encoder_packet *
+cursor_packet(struct ffmpeg_muxer *stream, struct replay_cursor *cursor)
 {
-	if (stream->max_size) {
-		if (!stream->packets.size || stream->keyframes <= 2)
-			return;
+	struct replay_segment *segment =
+		stream->mux_segments.array[cursor->segment];
+	return segment->packets.array + cursor->idx;
+}
 
-		while ((stream->cur_size + (int64_t)pkt->size) >
-		       stream->max_size)
-			purge(stream);
-	}
+static inline bool cursor_before(const struct replay_cursor *a,
+				 const struct replay_cursor *b)
+{
+	return a->segment < b->segment ||
+	       (a->segment == b->segment && a->idx < b->idx);
+}
 
-	if (!stream->packets.size || stream->keyframes <= 2)
+/* every track starts at 0 in the saved file.  packets of each track are
+ * already in order, so they're merged by their offset timestamps straight
+ * from the segments */
+static void write_replay_segments(struct ffmpeg_muxer *stream)
+{
+	size_t num_segments = stream->mux_segments.num;
+	struct replay_segment_map *maps;
+	struct replay_cursor cursors[REPLAY_TRACKS] = {0};
+	bool found[REPLAY_TRACKS] = {0};
+	int64_t offsets[REPLAY_TRACKS] = {0};
+	int64_t dts_offsets[REPLAY_TRACKS] = {0};
+
+	if (!num_segments)
 		return;
 
-	while ((pkt->dts_usec - stream->cur_time) > stream->max_time)
-		purge(stream);
-}
+	maps = bzalloc(sizeof(*maps) * num_segments);
 
-static void insert_packet(struct darray *array, struct encoder_packet *packet,
-			  int64_t video_offset, int64_t *audio_offsets,
-			  int64_t video_dts_offset, int64_t *audio_dts_offsets)
-{
-	struct encoder_packet pkt;
-	DARRAY(struct encoder_packet) packets;
-	packets.da = *array;
-	size_t idx;
+	for (size_t i = 0; i < num_segments; i++) {
+		struct replay_segment *segment = stream->mux_segments.array[i];
 
-	obs_encoder_packet_ref(&pkt, packet);
+		replay_segment_map(segment, &maps[i]);
 
-	if (pkt.type == OBS_ENCODER_VIDEO) {
-		pkt.dts_usec -= video_offset;
-		pkt.dts -= video_dts_offset;
-		pkt.pts -= video_dts_offset;
-	} else {
-		pkt.dts_usec -= audio_offsets[pkt.track_idx];
-		pkt.dts -= audio_dts_offsets[pkt.track_idx];
-		pkt.pts -= audio_dts_offsets[pkt.track_idx];
+		for (size_t j = 0; j < segment->packets.num; j++) {
+			struct encoder_packet *pkt = segment->packets.array + j;
+			size_t track = replay_track(pkt);
+
+			if (!found[track]) {
+				found[track] = true;
+				offsets[track] = pkt->dts_usec;
+				dts_offsets[track] = pkt->dts;
+			}
+		}
 	}
 
-	for (idx = packets.num; idx > 0; idx--) {
-		struct encoder_packet *p = packets.array + (idx - 1);
-		if (p->dts_usec < pkt.dts_usec)
+	for (size_t track = 0; track < REPLAY_TRACKS; track++)
+		seek_track(stream, &cursors[track], track);
+
+	for (;;) {
+		struct replay_cursor *next = NULL;
+		size_t next_track = 0;
+		int64_t next_usec = 0;
+		struct encoder_packet pkt;
+
+		for (size_t track = 0; track < REPLAY_TRACKS; track++) {
+			struct replay_cursor *cursor = &cursors[track];
+			int64_t usec;
+
+			if (cursor->segment == num_segments)
+				continue;
+
+			usec = cursor_packet(stream, cursor)->dts_usec -
+			       offsets[track];
+
+			if (!next || usec < next_usec ||
+			    (usec == next_usec &&
+			     cursor_before(cursor, next))) {
+				next = cursor;
+				next_track = track;
+				next_usec = usec;
+			}
+		}
+
+		if (!next)
 			break;
+
+		replay_segment_get_packet(
+			stream->mux_segments.array[next->segment],
+			&maps[next->segment], next->idx, &pkt);
+
+		pkt.dts_usec -= offsets[next_track];
+		pkt.dts -= dts_offsets[next_track];
+		pkt.pts -= dts_offsets[next_track];
+
+		/* the payload of a segment that couldn't be mapped is lost */
+		if (pkt.data || !pkt.size)
+			write_packet(stream, &pkt);
+
+		next->idx++;
+		seek_track(stream, next, next_track);
 	}
 
-	da_insert(packets, idx, &pkt);
-	*array = packets.da;
+	for (size_t i = 0; i < num_segments; i++)
+		replay_segment_unmap(&maps[i]);
+	bfree(maps);
 }
 
 static void *replay_buffer_mux_thread(void *data)
@@ -830,61 +915,25 @@ static void *replay_buffer_mux_thread(void *data)
 		goto error;
 	}
 
-	for (size_t i = 0; i < stream->mux_packets.num; i++) {
-		struct encoder_packet *pkt = &stream->mux_packets.array[i];
-		write_packet(stream, pkt);
-		obs_encoder_packet_release(pkt);
-	}
+	write_replay_segments(stream);
 
 	info("Wrote replay buffer to '%s'", stream->path.array);
 
 error:
-	os_process_pipe_destroy(stream->pipe);
-	stream->pipe = NULL;
-	da_free(stream->mux_packets);
+	stop_pipe(stream);
+	for (size_t i = 0; i < stream->mux_segments.num; i++)
+		replay_segment_release(stream->mux_segments.array[i]);
+	da_free(stream->mux_segments);
 	os_atomic_set_bool(&stream->muxing, false);
 	return NULL;
 }
 
 static void replay_buffer_save(struct ffmpeg_muxer *stream)
 {
-	const size_t size = sizeof(struct encoder_packet);
-	size_t num_packets = stream->packets.size / size;
-
-	da_reserve(stream->mux_packets, num_packets);
-
 	/* ---------------------------- */
-	/* reorder packets */
-
-	bool found_video = false;
-	bool found_audio[MAX_AUDIO_MIXES] = {0};
-	int64_t video_offset = 0;
-	int64_t video_dts_offset = 0;
-	int64_t audio_offsets[MAX_AUDIO_MIXES] = {0};
-	int64_t audio_dts_offsets[MAX_AUDIO_MIXES] = {0};
-
-	for (size_t i = 0; i < num_packets; i++) {
-		struct encoder_packet *pkt;
-		pkt = circlebuf_data(&stream->packets, i * size);
-
-		if (pkt->type == OBS_ENCODER_VIDEO) {
-			if (!found_video) {
-				video_offset = pkt->dts_usec;
-				video_dts_offset = pkt->dts;
-				found_video = true;
-			}
-		} else {
-			if (!found_audio[pkt->track_idx]) {
-				found_audio[pkt->track_idx] = true;
-				audio_offsets[pkt->track_idx] = pkt->dts_usec;
-				audio_dts_offsets[pkt->track_idx] = pkt->dts;
-			}
-		}
+	/* reference the buffered segments */
 
-		insert_packet(&stream->mux_packets.da, pkt, video_offset,
-			      audio_offsets, video_dts_offset,
-			      audio_dts_offsets);
-	}
+	replay_store_get_segments(&stream->store, &stream->mux_segments.da);
 
 	/* ---------------------------- */
 	/* generate filename */
@@ -938,7 +987,6 @@ static void deactivate_replay_buffer(struct ffmpeg_muxer *stream, int code)
 static void replay_buffer_data(void *data, struct encoder_packet *packet)
 {
 	struct ffmpeg_muxer *stream = data;
-	struct encoder_packet pkt;
 
 	if (!active(stream))
 		return;
@@ -956,17 +1004,9 @@ static void replay_buffer_data(void *data, struct encoder_packet *packet)
 		}
 	}
 
-	obs_encoder_packet_ref(&pkt, packet);
-	replay_buffer_purge(stream, &pkt);
-
-	if (!stream->packets.size)
-		stream->cur_time = pkt.dts_usec;
-	stream->cur_size += pkt.size;
-
-	circlebuf_push_back(&stream->packets, packet, sizeof(*packet));
-
-	if (packet->type == OBS_ENCODER_VIDEO && packet->keyframe)
-		stream->keyframes++;
+	replay_store_purge(&stream->store, stream->max_size, stream->max_time,
+			   packet);
+	replay_store_push(&stream->store, packet);
 
 	if (stream->save_ts && packet->sys_dts_usec >= stream->save_ts) {
 		if (os_atomic_load_bool(&stream->muxing))
@@ -986,6 +1026,8 @@ static void replay_buffer_defaults(obs_data_t *s)
 {
 	obs_data_set_default_int(s, "max_time_sec", 15);
 	obs_data_set_default_int(s, "max_size_mb", 500);
+	obs_data_set_default_int(s, "max_memory_mb", 0);
+	obs_data_set_default_string(s, "spill_directory", "");
 	obs_data_set_default_string(s, "format", "%CCYY-%MM-%DD %hh-%mm-%ss");
 	obs_data_set_default_string(s, "extension", "mp4");
 	obs_data_set_default_bool(s, "allow_spaces", true);
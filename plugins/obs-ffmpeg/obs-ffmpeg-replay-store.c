@@ -0,0 +1,520 @@
+/******************************************************************************
+    Copyright (C) 2015 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include "obs-ffmpeg-replay-store.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static void *spill_thread(void *data);
+
+static bool start_spill_thread(struct replay_store *store)
+{
+	if (pthread_mutex_init(&store->spill_mutex, NULL) != 0)
+		return false;
+	if (os_sem_init(&store->spill_sem, 0) != 0) {
+		pthread_mutex_destroy(&store->spill_mutex);
+		return false;
+	}
+	if (os_event_init(&store->spill_done_event, OS_EVENT_TYPE_AUTO) != 0) {
+		os_sem_destroy(store->spill_sem);
+		pthread_mutex_destroy(&store->spill_mutex);
+		return false;
+	}
+	if (pthread_create(&store->spill_thread, NULL, spill_thread, store) !=
+	    0) {
+		os_event_destroy(store->spill_done_event);
+		os_sem_destroy(store->spill_sem);
+		pthread_mutex_destroy(&store->spill_mutex);
+		return false;
+	}
+
+	store->spill_thread_active = true;
+	return true;
+}
+
+void replay_store_init(struct replay_store *store, int64_t max_mem,
+		       const char *spill_dir)
+{
+	memset(store, 0, sizeof(*store));
+	store->max_mem = max_mem;
+
+	if (max_mem && spill_dir && *spill_dir) {
+		if (!start_spill_thread(store)) {
+			blog(LOG_WARNING, "[replay buffer] Failed to start "
+					  "spill thread, keeping everything "
+					  "in memory");
+			return;
+		}
+
+		store->spill_dir = bstrdup(spill_dir);
+		os_mkdirs(spill_dir);
+	}
+}
+
+void replay_segment_release(struct replay_segment *segment)
+{
+	if (!segment || os_atomic_dec_long(&segment->refs) != 0)
+		return;
+
+	for (size_t i = 0; i < segment->packets.num; i++)
+		obs_encoder_packet_release(segment->packets.array + i);
+
+	if (segment->spill_path) {
+		os_unlink(segment->spill_path);
+		bfree(segment->spill_path);
+	}
+
+	da_free(segment->packets);
+	da_free(segment->spill_offsets);
+	bfree(segment);
+}
+
+static void free_spill(struct replay_spill *spill)
+{
+	if (spill->success)
+		os_unlink(spill->path);
+
+	spill->segment->spilling = false;
+	replay_segment_release(spill->segment);
+	bfree(spill->path);
+	da_free(spill->offsets);
+}
+
+/* every spill has been swapped in by replay_store_finish_spills, so the
+ * thread only has to be told to stop */
+static void stop_spill_thread(struct replay_store *store)
+{
+	os_atomic_set_bool(&store->spill_stop, true);
+	os_sem_post(store->spill_sem);
+	pthread_join(store->spill_thread, NULL);
+
+	da_free(store->spill_queue);
+	da_free(store->spill_done);
+	os_event_destroy(store->spill_done_event);
+	os_sem_destroy(store->spill_sem);
+	pthread_mutex_destroy(&store->spill_mutex);
+}
+
+void replay_store_free(struct replay_store *store)
+{
+	if (store->spill_thread_active) {
+		replay_store_finish_spills(store);
+		stop_spill_thread(store);
+	}
+
+	for (size_t i = 0; i < store->segments.num; i++)
+		replay_segment_release(store->segments.array[i]);
+
+	da_free(store->segments);
+	bfree(store->spill_dir);
+	memset(store, 0, sizeof(*store));
+}
+
+/* runs on the spill thread.  the spill holds a reference to the segment, and
+ * the output thread doesn't change the packets of a segment while it is
+ * spilling, so they can be read here */
+static void write_spill(struct replay_spill *spill)
+{
+	struct replay_segment *segment = spill->segment;
+	uint64_t offset = 0;
+	bool success = true;
+	FILE *file;
+
+	file = os_fopen(spill->path, "wb");
+	if (!file) {
+		blog(LOG_WARNING, "[replay buffer] Failed to create '%s'",
+		     spill->path);
+		return;
+	}
+
+	da_reserve(spill->offsets, segment->packets.num);
+
+	for (size_t i = 0; i < segment->packets.num; i++) {
+		struct encoder_packet *pkt = segment->packets.array + i;
+
+		if (fwrite(pkt->data, 1, pkt->size, file) != pkt->size) {
+			success = false;
+			break;
+		}
+
+		da_push_back(spill->offsets, &offset);
+		offset += pkt->size;
+	}
+
+	if (fclose(file) != 0)
+		success = false;
+
+	if (!success) {
+		blog(LOG_WARNING, "[replay buffer] Failed to write '%s'",
+		     spill->path);
+		os_unlink(spill->path);
+		da_free(spill->offsets);
+		return;
+	}
+
+	spill->success = true;
+}
+
+static void *spill_thread(void *data)
+{
+	struct replay_store *store = data;
+
+	os_set_thread_name("replay buffer: spill thread");
+
+	while (os_sem_wait(store->spill_sem) == 0) {
+		struct replay_spill spill;
+
+		if (os_atomic_load_bool(&store->spill_stop))
+			break;
+
+		pthread_mutex_lock(&store->spill_mutex);
+		spill = store->spill_queue.array[0];
+		da_erase(store->spill_queue, 0);
+		pthread_mutex_unlock(&store->spill_mutex);
+
+		write_spill(&spill);
+
+		pthread_mutex_lock(&store->spill_mutex);
+		da_push_back(store->spill_done, &spill);
+		pthread_mutex_unlock(&store->spill_mutex);
+
+		os_event_signal(store->spill_done_event);
+	}
+
+	return NULL;
+}
+
+/* a segment referenced by a save, or purged, while it was written keeps its
+ * packets in memory, it may be spilled again once the save is done */
+static void swap_in_spill(struct replay_store *store,
+			  struct replay_spill *spill)
+{
+	struct replay_segment *segment = spill->segment;
+
+	store->spill_jobs--;
+	store->spill_pending -= segment->size;
+
+	if (!spill->success || segment->purged ||
+	    os_atomic_load_long(&segment->refs) > 2) {
+		free_spill(spill);
+		return;
+	}
+
+	/* keeps everything but the payload */
+	for (size_t i = 0; i < segment->packets.num; i++) {
+		struct encoder_packet *pkt = segment->packets.array + i;
+		struct encoder_packet info = *pkt;
+
+		obs_encoder_packet_release(pkt);
+		*pkt = info;
+		pkt->data = NULL;
+	}
+
+	segment->spill_path = spill->path;
+	segment->spill_offsets.da = spill->offsets.da;
+	segment->spilled = true;
+	segment->spilling = false;
+	store->mem_size -= segment->size;
+
+	replay_segment_release(segment);
+}
+
+static void swap_in_spills(struct replay_store *store)
+{
+	DARRAY(struct replay_spill) done;
+
+	if (!store->spill_jobs)
+		return;
+
+	pthread_mutex_lock(&store->spill_mutex);
+	done.da = store->spill_done.da;
+	da_init(store->spill_done);
+	pthread_mutex_unlock(&store->spill_mutex);
+
+	for (size_t i = 0; i < done.num; i++)
+		swap_in_spill(store, done.array + i);
+
+	da_free(done);
+}
+
+/* saving references segments on the output thread too, so a segment that
+ * only the store references can't be picked up while it is spilled */
+static void spill_segments(struct replay_store *store)
+{
+	if (!store->spill_dir)
+		return;
+
+	swap_in_spills(store);
+
+	for (size_t i = 0; i < store->segments.num; i++) {
+		struct replay_segment *segment = store->segments.array[i];
+		struct replay_spill spill = {0};
+		struct dstr path = {0};
+
+		if (store->mem_size - store->spill_pending <= store->max_mem)
+			break;
+		if (segment == store->cur || segment->spilled ||
+		    segment->spilling ||
+		    os_atomic_load_long(&segment->refs) > 1)
+			continue;
+
+		dstr_printf(&path, "%s/replay-%p-%ld.tmp", store->spill_dir,
+			    store, ++store->spill_count);
+
+		os_atomic_inc_long(&segment->refs);
+		segment->spilling = true;
+		spill.segment = segment;
+		spill.path = path.array;
+
+		store->spill_jobs++;
+		store->spill_pending += segment->size;
+
+		pthread_mutex_lock(&store->spill_mutex);
+		da_push_back(store->spill_queue, &spill);
+		pthread_mutex_unlock(&store->spill_mutex);
+		os_sem_post(store->spill_sem);
+	}
+}
+
+void replay_store_finish_spills(struct replay_store *store)
+{
+	for (;;) {
+		swap_in_spills(store);
+		if (!store->spill_jobs)
+			break;
+
+		os_event_wait(store->spill_done_event);
+	}
+}
+
+static inline void end_segment(struct replay_store *store)
+{
+	store->cur = NULL;
+	spill_segments(store);
+}
+
+/* a segment split by a save ends at the next keyframe too */
+static inline bool segment_full(struct replay_segment *segment,
+				struct encoder_packet *next)
+{
+	int64_t duration = next->dts_usec - segment->packets.array[0].dts_usec;
+
+	return segment->size >= REPLAY_SEGMENT_SIZE ||
+	       duration >= REPLAY_SEGMENT_USEC || !segment->starts_keyframe;
+}
+
+void replay_store_push(struct replay_store *store,
+		       struct encoder_packet *packet)
+{
+	bool keyframe = packet->type == OBS_ENCODER_VIDEO && packet->keyframe;
+	struct replay_segment *segment = store->cur;
+	struct encoder_packet pkt;
+
+	swap_in_spills(store);
+
+	if (segment && keyframe && segment_full(segment, packet)) {
+		end_segment(store);
+		segment = NULL;
+	}
+
+	if (!segment) {
+		segment = bzalloc(sizeof(*segment));
+		segment->refs = 1;
+		segment->starts_keyframe = keyframe;
+		da_push_back(store->segments, &segment);
+		store->cur = segment;
+	}
+
+	obs_encoder_packet_ref(&pkt, packet);
+	da_push_back(segment->packets, &pkt);
+
+	segment->size += (int64_t)pkt.size;
+	store->size += (int64_t)pkt.size;
+	store->mem_size += (int64_t)pkt.size;
+}
+
+static void purge_segment(struct replay_store *store)
+{
+	struct replay_segment *segment = store->segments.array[0];
+
+	if (segment == store->cur)
+		store->cur = NULL;
+
+	segment->purged = true;
+	store->size -= segment->size;
+	if (!segment->spilled)
+		store->mem_size -= segment->size;
+
+	da_erase(store->segments, 0);
+	replay_segment_release(segment);
+}
+
+/* whole segments are dropped, along with the rest of the group of pictures
+ * when it was split by a save */
+static void purge_front(struct replay_store *store)
+{
+	purge_segment(store);
+
+	while (store->segments.num &&
+	       store->segments.array[0] != store->cur &&
+	       !store->segments.array[0]->starts_keyframe)
+		purge_segment(store);
+}
+
+static inline bool can_purge(struct replay_store *store)
+{
+	return store->segments.num > 2;
+}
+
+/* the size limit may purge everything but the segment being written, as
+ * long as what is left starts at a keyframe */
+static bool can_purge_size(struct replay_store *store)
+{
+	for (size_t i = 1; i < store->segments.num; i++) {
+		if (store->segments.array[i]->starts_keyframe)
+			return true;
+	}
+
+	return false;
+}
+
+static inline int64_t first_dts_usec(struct replay_store *store)
+{
+	return store->segments.array[0]->packets.array[0].dts_usec;
+}
+
+void replay_store_purge(struct replay_store *store, int64_t max_size,
+			int64_t max_time, struct encoder_packet *next)
+{
+	if (max_size) {
+		while (can_purge_size(store) &&
+		       store->size + (int64_t)next->size > max_size)
+			purge_front(store);
+	}
+
+	while (can_purge(store) &&
+	       next->dts_usec - first_dts_usec(store) > max_time)
+		purge_front(store);
+}
+
+void replay_store_get_segments(struct replay_store *store,
+			       struct darray *segments)
+{
+	DARRAY(struct replay_segment *) refs;
+	refs.da = *segments;
+
+	/* packets added after this go into a new segment, so the referenced
+	 * ones don't change anymore */
+	if (store->cur)
+		end_segment(store);
+
+	for (size_t i = 0; i < store->segments.num; i++) {
+		struct replay_segment *segment = store->segments.array[i];
+
+		os_atomic_inc_long(&segment->refs);
+		da_push_back(refs, &segment);
+	}
+
+	*segments = refs.da;
+}
+
+bool replay_segment_map(struct replay_segment *segment,
+			struct replay_segment_map *map)
+{
+	memset(map, 0, sizeof(*map));
+
+	if (!segment->spilled || !segment->size)
+		return true;
+
+	map->size = (size_t)segment->size;
+
+#ifdef _WIN32
+	wchar_t *wpath;
+	HANDLE file;
+
+	if (!os_utf8_to_wcs_ptr(segment->spill_path, 0, &wpath))
+		return false;
+
+	file = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ, NULL,
+			   OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	bfree(wpath);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	map->file = file;
+	map->mapping =
+		CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (map->mapping)
+		map->data = MapViewOfFile(map->mapping, FILE_MAP_READ, 0, 0,
+					  map->size);
+#else
+	int fd = open(segment->spill_path, O_RDONLY);
+	if (fd == -1)
+		return false;
+
+	map->data = mmap(NULL, map->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (map->data == MAP_FAILED)
+		map->data = NULL;
+#endif
+
+	if (!map->data) {
+		blog(LOG_WARNING, "[replay buffer] Failed to map '%s'",
+		     segment->spill_path);
+		replay_segment_unmap(map);
+		return false;
+	}
+
+	return true;
+}
+
+void replay_segment_unmap(struct replay_segment_map *map)
+{
+#ifdef _WIN32
+	if (map->data)
+		UnmapViewOfFile(map->data);
+	if (map->mapping)
+		CloseHandle(map->mapping);
+	if (map->file)
+		CloseHandle(map->file);
+#else
+	if (map->data)
+		munmap(map->data, map->size);
+#endif
+	memset(map, 0, sizeof(*map));
+}
+
+void replay_segment_get_packet(struct replay_segment *segment,
+			       struct replay_segment_map *map, size_t idx,
+			       struct encoder_packet *packet)
+{
+	*packet = segment->packets.array[idx];
+
+	if (segment->spilled && map->data)
+		packet->data = map->data + segment->spill_offsets.array[idx];
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <obs.h>
+#include <util/darray.h>
+#include <util/threading.h>
+
+/*
+ * Packets of the replay buffer are kept in segments that start at a video
+ * keyframe, so whole segments can be dropped from the front.  Saving takes a
+ * reference to each segment instead of copying its packets, and segments are
+ * only changed by the output thread as long as nothing else references them.
+ *
+ * With a memory limit, the payloads of the oldest segments are written to a
+ * file and mapped back in when the replay is saved.  The files are written by
+ * a worker thread, the output thread then swaps in the spilled state of the
+ * segments that still aren't referenced by anything else.
+ */
+
+/* a segment is ended at the first keyframe after it reached this size or
+ * duration.  purging drops whole segments, so the duration limits how much
+ * shorter than the maximum time a replay can be to about one segment, or the
+ * keyframe interval if that is longer */
+#define REPLAY_SEGMENT_SIZE (2 * 1024 * 1024)
+#define REPLAY_SEGMENT_USEC 1000000LL
+
+struct replay_segment {
+	volatile long refs;
+	DARRAY(struct encoder_packet) packets;
+	int64_t size;
+	bool starts_keyframe;
+
+	/* the payloads of spilled segments are in a file instead, the data of
+	 * their packets is NULL */
+	bool spilled;
+	char *spill_path;
+	DARRAY(uint64_t) spill_offsets;
+
+	/* only used by the output thread */
+	bool spilling;
+	bool purged;
+};
+
+struct replay_spill {
+	struct replay_segment *segment;
+	char *path;
+	DARRAY(uint64_t) offsets;
+	bool success;
+};
+
+struct replay_store {
+	DARRAY(struct replay_segment *) segments;
+	struct replay_segment *cur;
+	int64_t size;
+	int64_t mem_size;
+
+	/* 0 keeps everything in memory */
+	int64_t max_mem;
+	char *spill_dir;
+	long spill_count;
+
+	pthread_t spill_thread;
+	bool spill_thread_active;
+	os_sem_t *spill_sem;
+	os_event_t *spill_done_event;
+	pthread_mutex_t spill_mutex;
+	DARRAY(struct replay_spill) spill_queue;
+	DARRAY(struct replay_spill) spill_done;
+	volatile bool spill_stop;
+
+	/* segments queued or written but not swapped in yet */
+	size_t spill_jobs;
+	int64_t spill_pending;
+};
+
+struct replay_segment_map {
+	uint8_t *data;
+	size_t size;
+#ifdef _WIN32
+	void *file;
+	void *mapping;
+#endif
+};
+
+extern void replay_store_init(struct replay_store *store, int64_t max_mem,
+			      const char *spill_dir);
+extern void replay_store_free(struct replay_store *store);
+
+extern void replay_store_push(struct replay_store *store,
+			      struct encoder_packet *packet);
+extern void replay_store_purge(struct replay_store *store, int64_t max_size,
+			       int64_t max_time, struct encoder_packet *next);
+
+/* waits for the segments that are being written to their spill files and
+ * swaps in their spilled state, replay_store_free does this too */
+extern void replay_store_finish_spills(struct replay_store *store);
+
+/* ends the current segment and adds a reference to every segment */
+extern void replay_store_get_segments(struct replay_store *store,
+				      struct darray *segments);
+extern void replay_segment_release(struct replay_segment *segment);
+
+/* maps the payloads of a spilled segment, does nothing for other segments */
+extern bool replay_segment_map(struct replay_segment *segment,
+			       struct replay_segment_map *map);
+extern void replay_segment_unmap(struct replay_segment_map *map);
+
+/* returns a packet of a segment without a new reference, the data is valid
+ * while the segment is referenced and mapped */
+extern void replay_segment_get_packet(struct replay_segment *segment,
+				      struct replay_segment_map *map,
+				      size_t idx,
+				      struct encoder_packet *packet);
@@ -304,7 +304,7 @@ static void *color_correction_filter_create(obs_data_t *settings,
 	obs_enter_graphics();
 
 	/* Load the shader on the GPU. */
-	filter->effect = gs_effect_create_from_file(effect_path, NULL);
+	filter->effect = obs_filter_fragment_create(effect_path, NULL);
 
 	/* If the filter is active pass the parameters to the filter. */
 	if (filter->effect) {
@@ -417,7 +417,7 @@ static void color_correction_filter_defaults(obs_data_t *settings)
 struct obs_source_info color_filter = {
 	.id = "color_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_FUSABLE_FILTER,
 	.get_name = color_correction_filter_name,
 	.create = color_correction_filter_create,
 	.destroy = color_correction_filter_destroy,
@@ -135,7 +135,7 @@ static void *color_key_create(obs_data_t *settings, obs_source_t *context)
 
 	obs_enter_graphics();
 
-	filter->effect = gs_effect_create_from_file(effect_path, NULL);
+	filter->effect = obs_filter_fragment_create(effect_path, NULL);
 	if (filter->effect) {
 		filter->color_param =
 			gs_effect_get_param_by_name(filter->effect, "color");
@@ -251,7 +251,7 @@ static void color_key_defaults(obs_data_t *settings)
 struct obs_source_info color_key_filter = {
 	.id = "color_key_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_FUSABLE_FILTER,
 	.get_name = color_key_name,
 	.create = color_key_create,
 	.destroy = color_key_destroy,
@@ -93,7 +93,7 @@ static void *luma_key_create(obs_data_t *settings, obs_source_t *context)
 
 	obs_enter_graphics();
 
-	filter->effect = gs_effect_create_from_file(effect_path, NULL);
+	filter->effect = obs_filter_fragment_create(effect_path, NULL);
 	if (filter->effect) {
 		filter->luma_max_param =
 			gs_effect_get_param_by_name(filter->effect, "lumaMax");
@@ -183,7 +183,7 @@ static void luma_key_defaults(obs_data_t *settings)
 struct obs_source_info luma_key_filter = {
 	.id = "luma_key_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_FUSABLE_FILTER,
 	.get_name = luma_key_name,
 	.create = luma_key_create,
 	.destroy = luma_key_destroy,
@@ -254,6 +254,33 @@ void flv_packet_mux(struct encoder_packet *packet, int32_t dts_offset,
 	*size = data.bytes.num;
 }
 
+void flv_packet_tag(struct encoder_packet *packet, int32_t dts_offset,
+		    struct flv_tag *tag, bool is_header)
+{
+	int32_t time_ms = get_ms_time(packet, packet->dts) - dts_offset;
+	uint8_t *prefix = tag->prefix;
+
+	tag->timestamp = (uint32_t)time_ms & 0x7FFFFFFF;
+
+	if (packet->type == OBS_ENCODER_VIDEO) {
+		int32_t offset = get_ms_time(packet, packet->pts - packet->dts);
+
+		tag->type = RTMP_PACKET_TYPE_VIDEO;
+		*prefix++ = packet->keyframe ? 0x17 : 0x27;
+		*prefix++ = is_header ? 0 : 1;
+		*prefix++ = (uint8_t)(offset >> 16);
+		*prefix++ = (uint8_t)(offset >> 8);
+		*prefix++ = (uint8_t)offset;
+	} else {
+		tag->type = RTMP_PACKET_TYPE_AUDIO;
+		*prefix++ = 0xaf;
+		*prefix++ = is_header ? 0 : 1;
+	}
+
+	tag->prefix_size = prefix - tag->prefix;
+	tag->size = 11 + tag->prefix_size + packet->size + 4;
+}
+
 /* ------------------------------------------------------------------------- */
 /* stuff for additional media streams                                        */
 
@@ -34,6 +34,20 @@ extern void flv_additional_meta_data(obs_output_t *context, uint8_t **output,
 				     size_t *size);
 extern void flv_packet_mux(struct encoder_packet *packet, int32_t dts_offset,
 			   uint8_t **output, size_t *size, bool is_header);
+
+struct flv_tag {
+	uint8_t type;
+	uint32_t timestamp;
+	uint8_t prefix[5];
+	size_t prefix_size;
+	size_t size;
+};
+
+/* gets the tag fields flv_packet_mux would write, without copying the packet
+ * data.  the tag body is the prefix followed by the packet data, and size is
+ * the size of the whole muxed tag */
+extern void flv_packet_tag(struct encoder_packet *packet, int32_t dts_offset,
+			   struct flv_tag *tag, bool is_header);
 extern void flv_additional_packet_mux(struct encoder_packet *packet,
 				      int32_t dts_offset, uint8_t **output,
 				      size_t *size, bool is_header,
@@ -4050,18 +4050,14 @@ RTMP_SendChunk(RTMP *r, RTMPChunk *chunk)
     return wrote;
 }
 
-int
-RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
+/* picks the smallest header type the previous packet on the channel allows,
+ * and returns the timestamp the new one is relative to */
+static int
+PrepareOutPacket(RTMP *r, RTMPPacket *packet, uint32_t *last)
 {
     const RTMPPacket *prevPacket;
-    uint32_t last = 0;
-    int nSize;
-    int hSize, cSize;
-    char *header, *hptr, *hend, hbuf[RTMP_MAX_HEADER_SIZE], c;
-    uint32_t t;
-    char *buffer, *tbuf = NULL, *toff = NULL;
-    int nChunkSize;
-    int tlen;
+
+    *last = 0;
 
     if (packet->m_nChannel >= r->m_channelsAllocatedOut)
     {
@@ -4091,7 +4087,7 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
         if (prevPacket->m_nTimeStamp == packet->m_nTimeStamp
                 && packet->m_headerType == RTMP_PACKET_SIZE_SMALL)
             packet->m_headerType = RTMP_PACKET_SIZE_MINIMUM;
-        last = prevPacket->m_nTimeStamp;
+        *last = prevPacket->m_nTimeStamp;
     }
 
     if (packet->m_headerType > 3)	/* sanity */
@@ -4101,6 +4097,32 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
         return FALSE;
     }
 
+    return TRUE;
+}
+
+static void
+SetOutPacket(RTMP *r, RTMPPacket *packet)
+{
+    if (!r->m_vecChannelsOut[packet->m_nChannel])
+        r->m_vecChannelsOut[packet->m_nChannel] = malloc(sizeof(RTMPPacket));
+    memcpy(r->m_vecChannelsOut[packet->m_nChannel], packet, sizeof(RTMPPacket));
+}
+
+int
+RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
+{
+    uint32_t last;
+    int nSize;
+    int hSize, cSize;
+    char *header, *hptr, *hend, hbuf[RTMP_MAX_HEADER_SIZE], c;
+    uint32_t t;
+    char *buffer, *tbuf = NULL, *toff = NULL;
+    int nChunkSize;
+    int tlen;
+
+    if (!PrepareOutPacket(r, packet, &last))
+        return FALSE;
+
     nSize = packetSize[packet->m_headerType];
     hSize = nSize;
     cSize = 0;
@@ -4261,9 +4283,7 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
         }
     }
 
-    if (!r->m_vecChannelsOut[packet->m_nChannel])
-        r->m_vecChannelsOut[packet->m_nChannel] = malloc(sizeof(RTMPPacket));
-    memcpy(r->m_vecChannelsOut[packet->m_nChannel], packet, sizeof(RTMPPacket));
+    SetOutPacket(r, packet);
     return TRUE;
 }
 
@@ -5356,3 +5376,305 @@ RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx)
     }
     return size+s2;
 }
+
+#ifdef _WIN32
+#define IOV_BASE(v)	((v).buf)
+#define IOV_LEN(v)	((v).len)
+#else
+#define IOV_BASE(v)	((v).iov_base)
+#define IOV_LEN(v)	((v).iov_len)
+#endif
+
+static int
+BatchHasRoom(const RTMPBatch *batch, int iovs, int bytes)
+{
+    return batch->num_iov + iovs <= RTMP_BATCH_MAX_IOV &&
+           batch->arena_len + bytes <= RTMP_BATCH_ARENA_SIZE;
+}
+
+static void
+BatchAppend(RTMPBatch *batch, const char *buf, int len)
+{
+    RTMP_IOVEC *prev = batch->num_iov ? &batch->iov[batch->num_iov - 1] : NULL;
+
+    if (!len)
+        return;
+
+    batch->num_bytes += len;
+
+    /* headers and prefixes written back to back share one entry */
+    if (prev && (const char *)IOV_BASE(*prev) + IOV_LEN(*prev) == buf)
+    {
+        IOV_LEN(*prev) += len;
+        return;
+    }
+
+    IOV_BASE(batch->iov[batch->num_iov]) = (char *)buf;
+    IOV_LEN(batch->iov[batch->num_iov]) = len;
+    batch->num_iov++;
+}
+
+static char *
+EncodeChannel(char *hptr, int headerType, int channel, int cSize)
+{
+    char c = headerType << 6;
+
+    switch (cSize)
+    {
+    case 0:
+        c |= channel;
+        break;
+    case 1:
+        break;
+    case 2:
+        c |= 1;
+        break;
+    }
+    *hptr++ = c;
+    if (cSize)
+    {
+        int tmp = channel - 64;
+        *hptr++ = tmp & 0xff;
+        if (cSize == 2)
+            *hptr++ = tmp >> 8;
+    }
+    return hptr;
+}
+
+int
+RTMP_BatchWrite(RTMP *r, RTMPBatch *batch, int streamIdx,
+                uint8_t packetType, uint32_t timestamp,
+                const char *prefix, int prefixSize,
+                const char *data, int size)
+{
+    RTMPPacket packet = {0};
+    uint32_t last, t;
+    int nSize, cSize = 0;
+    int nChunkSize = r->m_outChunkSize;
+    char *header, *hptr, *hend;
+    int pos, len;
+
+    if (prefixSize > RTMP_BATCH_MAX_PREFIX || prefixSize >= nChunkSize)
+        return FALSE;
+
+    packet.m_nChannel = 0x04;	/* source channel */
+    packet.m_nInfoField2 = r->Link.streams[streamIdx].id;
+    packet.m_packetType = packetType;
+    packet.m_nTimeStamp = timestamp;
+    packet.m_nBodySize = prefixSize + size;
+
+    if (((packetType == RTMP_PACKET_TYPE_AUDIO
+            || packetType == RTMP_PACKET_TYPE_VIDEO) &&
+            !timestamp) || packetType == RTMP_PACKET_TYPE_INFO)
+        packet.m_headerType = RTMP_PACKET_SIZE_LARGE;
+    else
+        packet.m_headerType = RTMP_PACKET_SIZE_MEDIUM;
+
+    if (!PrepareOutPacket(r, &packet, &last))
+        return FALSE;
+
+    nSize = packetSize[packet.m_headerType];
+    t = packet.m_nTimeStamp - last;
+
+    if (packet.m_nChannel > 319)
+        cSize = 2;
+    else if (packet.m_nChannel > 63)
+        cSize = 1;
+
+    if (!BatchHasRoom(batch, 2, RTMP_MAX_HEADER_SIZE + prefixSize) &&
+            !RTMP_BatchFlush(r, batch))
+        return FALSE;
+
+    header = batch->arena + batch->arena_len;
+    hend = batch->arena + RTMP_BATCH_ARENA_SIZE;
+
+    hptr = EncodeChannel(header, packet.m_headerType, packet.m_nChannel,
+                         cSize);
+
+    if (nSize > 1)
+        hptr = AMF_EncodeInt24(hptr, hend, t > 0xffffff ? 0xffffff : t);
+
+    if (nSize > 4)
+    {
+        hptr = AMF_EncodeInt24(hptr, hend, packet.m_nBodySize);
+        *hptr++ = packet.m_packetType;
+    }
+
+    if (nSize > 8)
+        hptr += EncodeInt32LE(hptr, packet.m_nInfoField2);
+
+    if (nSize > 1 && t >= 0xffffff)
+        hptr = AMF_EncodeInt32(hptr, hend, t);
+
+    memcpy(hptr, prefix, prefixSize);
+    hptr += prefixSize;
+
+    batch->arena_len += (int)(hptr - header);
+    BatchAppend(batch, header, (int)(hptr - header));
+
+    len = size < nChunkSize - prefixSize ? size : nChunkSize - prefixSize;
+    BatchAppend(batch, data, len);
+
+    for (pos = len; pos < size; pos += len)
+    {
+        len = size - pos < nChunkSize ? size - pos : nChunkSize;
+
+        if (!BatchHasRoom(batch, 2, 1 + cSize) && !RTMP_BatchFlush(r, batch))
+            return FALSE;
+
+        header = batch->arena + batch->arena_len;
+        hptr = EncodeChannel(header, RTMP_PACKET_SIZE_MINIMUM,
+                             packet.m_nChannel, cSize);
+
+        batch->arena_len += (int)(hptr - header);
+        BatchAppend(batch, header, (int)(hptr - header));
+        BatchAppend(batch, data + pos, len);
+    }
+
+    SetOutPacket(r, &packet);
+    return TRUE;
+}
+
+static int
+CanSendVectored(RTMP *r)
+{
+    if (r->Link.protocol & RTMP_FEATURE_HTTP)
+        return FALSE;
+    if (r->m_bCustomSend && r->m_customSendFunc)
+        return FALSE;
+#ifdef CRYPTO
+    if (r->Link.rc4keyOut)
+        return FALSE;
+#endif
+#if defined(CRYPTO) && !defined(NO_SSL)
+    if (r->m_sb.sb_ssl)
+        return FALSE;
+#endif
+#if defined(RTMP_NETSTACK_DUMP)
+    return FALSE;
+#else
+    return TRUE;
+#endif
+}
+
+static int
+SendVectored(RTMP *r, RTMPBatch *batch)
+{
+    RTMP_IOVEC *iov = batch->iov;
+    int n = batch->num_iov;
+
+    while (n > 0)
+    {
+        int nBytes;
+#ifdef _WIN32
+        DWORD sent = 0;
+
+        if (WSASend(r->m_sb.sb_socket, iov, n, &sent, 0, NULL, NULL) == 0)
+            nBytes = (int)sent;
+        else
+            nBytes = -1;
+#else
+        struct msghdr msg;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+        nBytes = (int)sendmsg(r->m_sb.sb_socket, &msg, MSG_NOSIGNAL);
+#endif
+
+        if (nBytes < 0)
+        {
+            int sockerr = GetSockError();
+            RTMP_Log(RTMP_LOGERROR, "%s, RTMP send error %d (%d bytes)", __FUNCTION__,
+                     sockerr, batch->num_bytes);
+
+            if (sockerr == EINTR && !RTMP_ctrlC)
+                continue;
+
+            r->last_error_code = sockerr;
+
+            RTMP_Close(r);
+            return FALSE;
+        }
+
+        if (nBytes == 0)
+            return FALSE;
+
+        /* skip whatever was sent, and resume partway into the next entry */
+        while (n > 0 && (size_t)nBytes >= (size_t)IOV_LEN(*iov))
+        {
+            nBytes -= (int)IOV_LEN(*iov);
+            iov++;
+            n--;
+        }
+        if (n > 0)
+        {
+            IOV_BASE(*iov) = (char *)IOV_BASE(*iov) + nBytes;
+            IOV_LEN(*iov) -= nBytes;
+        }
+    }
+
+    return TRUE;
+}
+
+static int
+SendFlattened(RTMP *r, RTMPBatch *batch)
+{
+    char *ptr;
+    int i;
+
+    if (batch->flat_size < batch->num_bytes)
+    {
+        char *flat = realloc(batch->flat, batch->num_bytes);
+        if (!flat)
+            return FALSE;
+        batch->flat = flat;
+        batch->flat_size = batch->num_bytes;
+    }
+
+    ptr = batch->flat;
+    for (i = 0; i < batch->num_iov; i++)
+    {
+        memcpy(ptr, IOV_BASE(batch->iov[i]), IOV_LEN(batch->iov[i]));
+        ptr += IOV_LEN(batch->iov[i]);
+    }
+
+    return WriteN(r, batch->flat, batch->num_bytes);
+}
+
+int
+RTMP_BatchFlush(RTMP *r, RTMPBatch *batch)
+{
+    int ret;
+
+    if (!batch->num_iov)
+        return TRUE;
+
+    RTMP_Log(RTMP_LOGDEBUG2, "%s: fd=%d, size=%d, entries=%d", __FUNCTION__,
+             (int)r->m_sb.sb_socket, batch->num_bytes, batch->num_iov);
+
+    if (CanSendVectored(r))
+        ret = SendVectored(r, batch);
+    else
+        ret = SendFlattened(r, batch);
+
+    RTMP_BatchReset(batch);
+    return ret;
+}
+
+void
+RTMP_BatchReset(RTMPBatch *batch)
+{
+    batch->num_iov = 0;
+    batch->num_bytes = 0;
+    batch->arena_len = 0;
+}
+
+void
+RTMP_BatchFree(RTMPBatch *batch)
+{
+    free(batch->flat);
+    batch->flat = NULL;
+    batch->flat_size = 0;
+    RTMP_BatchReset(batch);
+}
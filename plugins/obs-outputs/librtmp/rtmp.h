@@ -43,6 +43,7 @@
 #include <ws2tcpip.h>
 #else
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #define SOCKET int
 #endif
@@ -457,6 +458,30 @@ extern "C"
 #endif
     } RTMP;
 
+#define RTMP_BATCH_MAX_IOV 512
+#define RTMP_BATCH_ARENA_SIZE (RTMP_BATCH_MAX_IOV * RTMP_MAX_HEADER_SIZE)
+#define RTMP_BATCH_MAX_PREFIX 16
+
+#ifdef _WIN32
+    typedef WSABUF RTMP_IOVEC;
+#else
+    typedef struct iovec RTMP_IOVEC;
+#endif
+
+    /* gathers the chunks of several packets so they can be sent with one
+     * vectored write.  chunk headers are built in the arena, packet payloads
+     * are referenced and must stay valid until the batch is flushed */
+    typedef struct RTMPBatch
+    {
+        RTMP_IOVEC iov[RTMP_BATCH_MAX_IOV];
+        int num_iov;
+        int num_bytes;
+        char arena[RTMP_BATCH_ARENA_SIZE];
+        int arena_len;
+        char *flat;		/* used when the socket can't do vectored writes */
+        int flat_size;
+    } RTMPBatch;
+
     int RTMP_ParseURL(const char *url, int *protocol, AVal *host,
                       unsigned int *port, AVal *app);
 
@@ -539,6 +564,18 @@ extern "C"
     int RTMP_Read(RTMP *r, char *buf, int size);
     int RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx);
 
+    /* same as RTMP_Write, but takes the FLV tag fields directly and queues
+     * the chunks in the batch instead of sending them.  prefix is the part
+     * of the tag body before data, and is copied.  the batch is flushed
+     * early if it runs out of room */
+    int RTMP_BatchWrite(RTMP *r, RTMPBatch *batch, int streamIdx,
+                        uint8_t packetType, uint32_t timestamp,
+                        const char *prefix, int prefixSize,
+                        const char *data, int size);
+    int RTMP_BatchFlush(RTMP *r, RTMPBatch *batch);
+    void RTMP_BatchReset(RTMPBatch *batch);
+    void RTMP_BatchFree(RTMPBatch *batch);
+
 #ifdef USE_HASHSWF
     /* hashswf.c */
     int RTMP_HashSWF(const char *url, unsigned int *size, unsigned char *hash,
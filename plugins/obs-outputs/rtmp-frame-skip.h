@@ -0,0 +1,63 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Frames are skipped before they are encoded once the packets waiting to be
+ * sent, together with the frames that are still in the encoder, reach half of
+ * the drop threshold.  Frames in the encoder will be buffered no matter what,
+ * so with lookahead the stream reacts that much earlier than by dropping
+ * packets, and no time is spent encoding frames that would be dropped.
+ *
+ * Every other frame is skipped up to the drop threshold, three of four above
+ * it.  Frames are encoded again once the buffer is below a quarter of the
+ * drop threshold.
+ *
+ * Encoders count their keyframe interval in frames, so while skipping the
+ * keyframes are up to four times as far apart.  Services that require a fixed
+ * keyframe interval would reject that, which is why it is off by default.
+ */
+
+#define FRAME_SKIP_HALF 2
+#define FRAME_SKIP_QUARTER 4
+
+/* returns the new skip interval, 0 encodes every frame */
+static inline uint32_t frame_skip_interval(uint32_t cur, int64_t buffer_usec,
+					   int64_t in_flight_usec,
+					   int64_t drop_threshold_usec)
+{
+	int64_t usec = buffer_usec + in_flight_usec;
+
+	if (usec >= drop_threshold_usec)
+		return FRAME_SKIP_QUARTER;
+	if (usec >= drop_threshold_usec / 2)
+		return cur > FRAME_SKIP_HALF ? cur : FRAME_SKIP_HALF;
+	if (usec < drop_threshold_usec / 4)
+		return 0;
+	return cur;
+}
+
+/* frames that are still in the encoder are buffered after the packets waiting
+ * to be sent no matter what */
+static inline int64_t frame_skip_in_flight_usec(uint32_t frames,
+						uint64_t frame_time_ns)
+{
+	return (int64_t)frames * (int64_t)(frame_time_ns / 1000);
+}
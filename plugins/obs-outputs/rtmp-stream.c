@@ -35,6 +35,11 @@
 #define MIN_ESTIMATE_DURATION_MS 1000
 #define MAX_ESTIMATE_DURATION_MS 2000
 
+/* batches only take packets that are already queued, and are flushed once
+ * the first packet has waited this long or they grow too large */
+#define BATCH_MAX_LATENCY_NS (10ULL * MSEC_TO_NSEC)
+#define BATCH_MAX_BYTES (512 * 1024)
+
 static const char *rtmp_stream_getname(void *unused)
 {
 	UNUSED_PARAMETER(unused);
@@ -111,6 +116,9 @@ static void rtmp_stream_destroy(void *data)
 	}
 
 	RTMP_TLS_Free(&stream->rtmp);
+	RTMP_BatchFree(&stream->batch);
+	da_free(stream->batch_packets);
+	da_free(stream->batch_frames);
 	free_packets(stream);
 	dstr_free(&stream->path);
 	dstr_free(&stream->key);
@@ -398,30 +406,39 @@ retry_send:
 	return len;
 }
 
+static bool check_recv_data(struct rtmp_stream *stream)
+{
+	int recv_size = 0;
+	int ret;
+
+	if (stream->new_socket_loop)
+		return true;
+
+#ifdef _WIN32
+	ret = ioctlsocket(stream->rtmp.m_sb.sb_socket, FIONREAD,
+			  (u_long *)&recv_size);
+#else
+	ret = ioctl(stream->rtmp.m_sb.sb_socket, FIONREAD, &recv_size);
+#endif
+
+	if (ret >= 0 && recv_size > 0)
+		return discard_recv_data(stream, (size_t)recv_size);
+
+	return true;
+}
+
 static int send_packet(struct rtmp_stream *stream,
 		       struct encoder_packet *packet, bool is_header,
 		       size_t idx)
 {
 	uint8_t *data;
 	size_t size;
-	int recv_size = 0;
 	int ret = 0;
 
 	assert(idx < RTMP_MAX_STREAMS);
 
-	if (!stream->new_socket_loop) {
-#ifdef _WIN32
-		ret = ioctlsocket(stream->rtmp.m_sb.sb_socket, FIONREAD,
-				  (u_long *)&recv_size);
-#else
-		ret = ioctl(stream->rtmp.m_sb.sb_socket, FIONREAD, &recv_size);
-#endif
-
-		if (ret >= 0 && recv_size > 0) {
-			if (!discard_recv_data(stream, (size_t)recv_size))
-				return -1;
-		}
-	}
+	if (!check_recv_data(stream))
+		return -1;
 
 	if (idx > 0) {
 		flv_additional_packet_mux(
@@ -569,6 +586,145 @@ static void dbr_add_frame(struct rtmp_stream *stream, struct dbr_frame *back)
 
 static void dbr_set_bitrate(struct rtmp_stream *stream);
 
+static int send_single_packet(struct rtmp_stream *stream,
+			      struct encoder_packet *packet)
+{
+	struct dbr_frame dbr_frame;
+	int ret;
+
+	if (stream->dbr_enabled) {
+		dbr_frame.send_beg = os_gettime_ns();
+		dbr_frame.size = packet->size;
+	}
+
+	ret = send_packet(stream, packet, false, packet->track_idx);
+
+	if (ret >= 0 && stream->dbr_enabled) {
+		dbr_frame.send_end = os_gettime_ns();
+
+		pthread_mutex_lock(&stream->dbr_mutex);
+		dbr_add_frame(stream, &dbr_frame);
+		pthread_mutex_unlock(&stream->dbr_mutex);
+	}
+
+	return ret;
+}
+
+static void release_batch(struct rtmp_stream *stream)
+{
+	for (size_t i = 0; i < stream->batch_packets.num; i++)
+		obs_encoder_packet_release(&stream->batch_packets.array[i]);
+
+	da_resize(stream->batch_packets, 0);
+	da_resize(stream->batch_frames, 0);
+	stream->batch_flv_size = 0;
+	RTMP_BatchReset(&stream->batch);
+}
+
+static int flush_batch(struct rtmp_stream *stream)
+{
+	bool success;
+
+	if (!stream->batch_packets.num)
+		return 0;
+
+	success = check_recv_data(stream) &&
+		  RTMP_BatchFlush(&stream->rtmp, &stream->batch);
+
+	if (success) {
+		stream->total_bytes_sent += stream->batch_flv_size;
+
+		if (stream->dbr_enabled) {
+			uint64_t send_end = os_gettime_ns();
+
+			pthread_mutex_lock(&stream->dbr_mutex);
+			for (size_t i = 0; i < stream->batch_frames.num; i++) {
+				struct dbr_frame *frame =
+					&stream->batch_frames.array[i];
+				frame->send_end = send_end;
+				dbr_add_frame(stream, frame);
+			}
+			pthread_mutex_unlock(&stream->dbr_mutex);
+		}
+	}
+
+	release_batch(stream);
+	return success ? 0 : -1;
+}
+
+static inline bool packets_pending(struct rtmp_stream *stream)
+{
+	bool pending;
+
+	pthread_mutex_lock(&stream->packets_mutex);
+	pending = stream->packets.size != 0;
+	pthread_mutex_unlock(&stream->packets_mutex);
+
+	return pending;
+}
+
+static inline bool batch_ready(struct rtmp_stream *stream)
+{
+	return !packets_pending(stream) ||
+	       stream->batch.num_bytes >= BATCH_MAX_BYTES ||
+	       os_gettime_ns() - stream->batch_start_ts >= BATCH_MAX_LATENCY_NS;
+}
+
+/* chunks the packet into the batch around its payload instead of muxing it
+ * into a new buffer, and flushes the batch when nothing else is queued */
+static int batch_packet(struct rtmp_stream *stream,
+			struct encoder_packet *packet)
+{
+	struct flv_tag tag;
+
+	/* additional tracks are wrapped in AMF, send them the regular way */
+	if (packet->track_idx > 0) {
+		if (flush_batch(stream) < 0) {
+			obs_encoder_packet_release(packet);
+			return -1;
+		}
+		return send_single_packet(stream, packet);
+	}
+
+	/* flv_packet_mux writes no tag for empty packets either, so they never
+	 * went out on the wire */
+	if (!packet->data || !packet->size) {
+		obs_encoder_packet_release(packet);
+		return 0;
+	}
+
+	flv_packet_tag(packet, stream->start_dts_offset, &tag, false);
+
+#ifdef TEST_FRAMEDROPS
+	droptest_cap_data_rate(stream, tag.size);
+#endif
+
+	if (!stream->batch_packets.num)
+		stream->batch_start_ts = os_gettime_ns();
+
+	if (!RTMP_BatchWrite(&stream->rtmp, &stream->batch, 0, tag.type,
+			     tag.timestamp, (const char *)tag.prefix,
+			     (int)tag.prefix_size, (const char *)packet->data,
+			     (int)packet->size)) {
+		obs_encoder_packet_release(packet);
+		release_batch(stream);
+		return -1;
+	}
+
+	if (stream->dbr_enabled) {
+		struct dbr_frame frame = {
+			.send_beg = os_gettime_ns(),
+			.size = packet->size,
+		};
+		da_push_back(stream->batch_frames, &frame);
+	}
+
+	da_push_back(stream->batch_packets, packet);
+	stream->batch_flv_size += tag.size;
+
+	return batch_ready(stream) ? flush_batch(stream) : 0;
+}
+
 static void *send_thread(void *data)
 {
 	struct rtmp_stream *stream = data;
@@ -577,7 +733,7 @@ static void *send_thread(void *data)
 
 	while (os_sem_wait(stream->send_sem) == 0) {
 		struct encoder_packet packet;
-		struct dbr_frame dbr_frame;
+		int ret;
 
 		if (stopping(stream) && stream->stop_ts == 0) {
 			break;
@@ -600,25 +756,22 @@ static void *send_thread(void *data)
 			}
 		}
 
-		if (stream->dbr_enabled) {
-			dbr_frame.send_beg = os_gettime_ns();
-			dbr_frame.size = packet.size;
-		}
+		/* the socket thread already coalesces writes */
+		if (stream->new_socket_loop)
+			ret = send_single_packet(stream, &packet);
+		else
+			ret = batch_packet(stream, &packet);
 
-		if (send_packet(stream, &packet, false, packet.track_idx) < 0) {
+		if (ret < 0) {
 			os_atomic_set_bool(&stream->disconnected, true);
 			break;
 		}
-
-		if (stream->dbr_enabled) {
-			dbr_frame.send_end = os_gettime_ns();
-
-			pthread_mutex_lock(&stream->dbr_mutex);
-			dbr_add_frame(stream, &dbr_frame);
-			pthread_mutex_unlock(&stream->dbr_mutex);
-		}
 	}
 
+	if (!disconnected(stream) && flush_batch(stream) < 0)
+		os_atomic_set_bool(&stream->disconnected, true);
+	release_batch(stream);
+
 	bool encode_error = os_atomic_load_bool(&stream->encode_error);
 
 	if (disconnected(stream)) {
@@ -1052,6 +1205,7 @@ static bool init_connect(struct rtmp_stream *stream)
 	stream->total_bytes_sent = 0;
 	stream->dropped_frames = 0;
 	stream->min_priority = 0;
+	stream->frame_skip = 0;
 	stream->got_first_video = false;
 
 	settings = obs_output_get_settings(stream->output);
@@ -1094,6 +1248,10 @@ static bool init_connect(struct rtmp_stream *stream)
 		info("Dynamic bitrate enabled.  Dropped frames begone!");
 	}
 
+	stream->frame_skip_enabled =
+		obs_data_get_bool(settings, OPT_FRAME_SKIP_ENABLED) &&
+		!stream->dbr_enabled;
+
 	obs_data_release(vsettings);
 	obs_data_release(asettings);
 
@@ -1321,10 +1479,34 @@ static void dbr_inc_bitrate(struct rtmp_stream *stream)
 	}
 }
 
+static int64_t get_in_flight_usec(struct rtmp_stream *stream)
+{
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
+	video_t *video = obs_encoder_video(vencoder);
+	uint32_t frames = obs_encoder_get_frames_in_flight(vencoder);
+
+	if (!video)
+		return 0;
+
+	return frame_skip_in_flight_usec(frames,
+					 video_output_get_frame_time(video));
+}
+
+static void set_frame_skip(struct rtmp_stream *stream, uint32_t interval)
+{
+	if (stream->frame_skip == interval)
+		return;
+
+	debug("frame skip interval: %u", interval);
+	stream->frame_skip = interval;
+	obs_output_set_frame_skip(stream->output, interval);
+}
+
 static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 {
 	struct encoder_packet first;
 	int64_t buffer_duration_usec;
+	int64_t in_flight_usec = 0;
 	size_t num_packets = num_buffered_packets(stream);
 	const char *name = pframes ? "p-frames" : "b-frames";
 	int priority = pframes ? OBS_NAL_PRIORITY_HIGHEST
@@ -1345,8 +1527,10 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 	}
 
 	if (num_packets < 5) {
-		if (!pframes)
+		if (!pframes) {
 			stream->congestion = 0.0f;
+			set_frame_skip(stream, 0);
+		}
 		return;
 	}
 
@@ -1360,6 +1544,7 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 	if (!pframes) {
 		stream->congestion =
 			(float)buffer_duration_usec / (float)drop_threshold;
+		in_flight_usec = get_in_flight_usec(stream);
 	}
 
 	/* alternatively, drop only pframes:
@@ -1373,7 +1558,8 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 			return;
 		}
 
-		if ((uint64_t)buffer_duration_usec >= DBR_TRIGGER_USEC) {
+		if ((uint64_t)(buffer_duration_usec + in_flight_usec) >=
+		    DBR_TRIGGER_USEC) {
 			pthread_mutex_lock(&stream->dbr_mutex);
 			bitrate_changed = dbr_bitrate_lowered(stream);
 			pthread_mutex_unlock(&stream->dbr_mutex);
@@ -1387,6 +1573,14 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 		return;
 	}
 
+	if (!pframes && stream->frame_skip_enabled) {
+		uint32_t interval = frame_skip_interval(stream->frame_skip,
+							buffer_duration_usec,
+							in_flight_usec,
+							drop_threshold);
+		set_frame_skip(stream, interval);
+	}
+
 	if (buffer_duration_usec > drop_threshold) {
 		debug("buffer_duration_usec: %" PRId64, buffer_duration_usec);
 		drop_frames(stream, name, priority, pframes);
@@ -1460,6 +1654,7 @@ static void rtmp_stream_defaults(obs_data_t *defaults)
 {
 	obs_data_set_default_int(defaults, OPT_DROP_THRESHOLD, 700);
 	obs_data_set_default_int(defaults, OPT_PFRAME_DROP_THRESHOLD, 900);
+	obs_data_set_default_bool(defaults, OPT_FRAME_SKIP_ENABLED, false);
 	obs_data_set_default_int(defaults, OPT_MAX_SHUTDOWN_TIME_SEC, 30);
 	obs_data_set_default_string(defaults, OPT_BIND_IP, "default");
 	obs_data_set_default_bool(defaults, OPT_NEWSOCKETLOOP_ENABLED, false);
@@ -2,6 +2,7 @@
 #include <obs-avc.h>
 #include <util/platform.h>
 #include <util/circlebuf.h>
+#include <util/darray.h>
 #include <util/dstr.h>
 #include <util/threading.h>
 #include <inttypes.h>
@@ -9,6 +10,7 @@
 #include "librtmp/log.h"
 #include "flv-mux.h"
 #include "net-if.h"
+#include "rtmp-frame-skip.h"
 
 #ifdef _WIN32
 #include <Iphlpapi.h>
@@ -27,6 +29,7 @@
 #define OPT_DYN_BITRATE "dyn_bitrate"
 #define OPT_DROP_THRESHOLD "drop_threshold_ms"
 #define OPT_PFRAME_DROP_THRESHOLD "pframe_drop_threshold_ms"
+#define OPT_FRAME_SKIP_ENABLED "frame_skip_enabled"
 #define OPT_MAX_SHUTDOWN_TIME_SEC "max_shutdown_time_sec"
 #define OPT_BIND_IP "bind_ip"
 #define OPT_NEWSOCKETLOOP_ENABLED "new_socket_loop_enabled"
@@ -88,6 +91,8 @@ struct rtmp_stream {
 	int64_t pframe_drop_threshold_usec;
 	int min_priority;
 	float congestion;
+	bool frame_skip_enabled;
+	uint32_t frame_skip;
 
 	int64_t last_dts_usec;
 
@@ -115,6 +120,14 @@ struct rtmp_stream {
 
 	RTMP rtmp;
 
+	/* packets sent together with one vectored write, kept referenced until
+	 * the batch is flushed */
+	RTMPBatch batch;
+	DARRAY(struct encoder_packet) batch_packets;
+	DARRAY(struct dbr_frame) batch_frames;
+	uint64_t batch_start_ts;
+	size_t batch_flv_size;
+
 	bool new_socket_loop;
 	bool low_latency_mode;
 	bool disable_send_window_optimization;
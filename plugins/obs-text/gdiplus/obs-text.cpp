@@ -853,6 +853,7 @@ inline void TextSource::Tick(float seconds)
 			LoadFileText();
 			TransformText();
 			RenderText();
+			obs_source_video_changed(source);
 			update_file = false;
 		}
 
@@ -1094,7 +1095,7 @@ bool obs_module_load(void)
 	si.id = "text_gdiplus";
 	si.type = OBS_SOURCE_TYPE_INPUT;
 	si.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW |
-			  OBS_SOURCE_CAP_OBSOLETE;
+			  OBS_SOURCE_CAP_OBSOLETE | OBS_SOURCE_STATIC_VIDEO;
 	si.get_properties = get_properties;
 	si.icon_type = OBS_ICON_TYPE_TEXT;
 
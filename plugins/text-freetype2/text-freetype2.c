@@ -17,6 +17,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <obs-module.h>
 #include <util/platform.h>
+#include <util/threading.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include <sys/stat.h>
@@ -26,6 +27,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 FT_Library ft2_lib;
 
+/* sources can be created on several threads at once, and the library is
+ * shared between them */
+static pthread_mutex_t ft2_lib_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("text-freetype2", "en-US")
 MODULE_EXPORT const char *obs_module_description(void)
@@ -39,7 +44,7 @@ static struct obs_source_info freetype2_source_info_v1 = {
 	.id = "text_ft2_source",
 	.type = OBS_SOURCE_TYPE_INPUT,
 	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CAP_OBSOLETE |
-			OBS_SOURCE_CUSTOM_DRAW,
+			OBS_SOURCE_CUSTOM_DRAW | OBS_SOURCE_PARALLEL_CREATE,
 	.get_name = ft2_source_get_name,
 	.create = ft2_source_create_v1,
 	.destroy = ft2_source_destroy,
@@ -60,7 +65,7 @@ static struct obs_source_info freetype2_source_info_v2 = {
 #ifdef _WIN32
 			OBS_SOURCE_DEPRECATED |
 #endif
-			OBS_SOURCE_CUSTOM_DRAW,
+			OBS_SOURCE_CUSTOM_DRAW | OBS_SOURCE_PARALLEL_CREATE,
 	.get_name = ft2_source_get_name,
 	.create = ft2_source_create_v2,
 	.destroy = ft2_source_destroy,
@@ -77,20 +82,25 @@ static bool plugin_initialized = false;
 
 static void init_plugin(void)
 {
+	pthread_mutex_lock(&ft2_lib_mutex);
+
 	if (plugin_initialized)
-		return;
+		goto unlock;
 
 	FT_Init_FreeType(&ft2_lib);
 
 	if (ft2_lib == NULL) {
 		blog(LOG_WARNING, "FT2-text: Failed to initialize FT2.");
-		return;
+		goto unlock;
 	}
 
 	if (!load_cached_os_font_list())
 		load_os_font_list();
 
 	plugin_initialized = true;
+
+unlock:
+	pthread_mutex_unlock(&ft2_lib_mutex);
 }
 
 bool obs_module_load()
@@ -192,7 +202,9 @@ static void ft2_source_destroy(void *data)
 	struct ft2_source *srcdata = data;
 
 	if (srcdata->font_face != NULL) {
+		pthread_mutex_lock(&ft2_lib_mutex);
 		FT_Done_Face(srcdata->font_face);
+		pthread_mutex_unlock(&ft2_lib_mutex);
 		srcdata->font_face = NULL;
 	}
 
@@ -297,15 +309,22 @@ static bool init_font(struct ft2_source *srcdata)
 	const char *path = get_font_path(srcdata->font_name, srcdata->font_size,
 					 srcdata->font_style,
 					 srcdata->font_flags, &index);
+	bool success;
+
 	if (!path)
 		return false;
 
+	pthread_mutex_lock(&ft2_lib_mutex);
+
 	if (srcdata->font_face != NULL) {
 		FT_Done_Face(srcdata->font_face);
 		srcdata->font_face = NULL;
 	}
 
-	return FT_New_Face(ft2_lib, path, index, &srcdata->font_face) == 0;
+	success = FT_New_Face(ft2_lib, path, index, &srcdata->font_face) == 0;
+
+	pthread_mutex_unlock(&ft2_lib_mutex);
+	return success;
 }
 
 static void ft2_source_update(void *data, obs_data_t *settings)
@@ -0,0 +1,121 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <media-io/audio-io.h>
+
+#define SAMPLE_RATE 48000
+#define SKIP_TICK 5
+#define TEST_TICKS 20
+
+struct gap_test {
+	/* only used by the audio thread */
+	long ticks;
+	uint64_t skipped_ns;
+	uint64_t first_ts;
+	uint64_t frames;
+	int64_t max_offset;
+	size_t silent_frames;
+
+	volatile long received;
+};
+
+/* from SKIP_TICK on the timestamps are one tick ahead, like after a tick was
+ * dropped to shrink audio buffering */
+static bool input_audio(void *param, uint64_t start_ts, uint64_t end_ts,
+			uint64_t *new_ts, uint32_t active_mixers,
+			struct audio_output_data *mixes)
+{
+	struct gap_test *test = param;
+
+	if (++test->ticks == SKIP_TICK)
+		test->skipped_ns = end_ts - start_ts;
+
+	*new_ts = start_ts + test->skipped_ns;
+
+	if (active_mixers & 1) {
+		for (size_t i = 0; i < AUDIO_OUTPUT_FRAMES; i++)
+			mixes[0].data[0][i] = 0.5f;
+	}
+
+	return true;
+}
+
+static void receive_audio(void *param, size_t mix_idx, struct audio_data *data)
+{
+	struct gap_test *test = param;
+	const float *samples = (const float *)data->data[0];
+	int64_t offset;
+	bool silent = true;
+
+	if (!test->first_ts)
+		test->first_ts = data->timestamp;
+
+	offset = (int64_t)(data->timestamp - test->first_ts) -
+		 (int64_t)audio_frames_to_ns(SAMPLE_RATE, test->frames);
+	if (offset < 0)
+		offset = -offset;
+	if (offset > test->max_offset)
+		test->max_offset = offset;
+
+	for (uint32_t i = 0; i < data->frames; i++) {
+		if (samples[i] != 0.0f)
+			silent = false;
+	}
+
+	if (silent)
+		test->silent_frames += data->frames;
+
+	test->frames += data->frames;
+	os_atomic_inc_long(&test->received);
+
+	UNUSED_PARAMETER(mix_idx);
+}
+
+/* the frame count of the output keeps matching its timestamps when ticks are
+ * skipped, the skipped tick is output as silence */
+static void gap_test(void **state)
+{
+	struct gap_test *test = bzalloc(sizeof(*test));
+	struct audio_output_info info = {
+		.name = "test_audio_io",
+		.samples_per_sec = SAMPLE_RATE,
+		.format = AUDIO_FORMAT_FLOAT_PLANAR,
+		.speakers = SPEAKERS_MONO,
+		.input_callback = input_audio,
+		.input_param = test,
+	};
+	audio_t *audio;
+
+	assert_int_equal(audio_output_open(&audio, &info),
+			 AUDIO_OUTPUT_SUCCESS);
+	assert_true(
+		audio_output_connect(audio, 0, NULL, receive_audio, test));
+
+	for (int i = 0; i < 200; i++) {
+		if (os_atomic_load_long(&test->received) >= TEST_TICKS)
+			break;
+		os_sleep_ms(10);
+	}
+
+	audio_output_close(audio);
+
+	assert_true(test->received >= TEST_TICKS);
+	assert_true(test->max_offset < 1000);
+	assert_int_equal(test->silent_frames, AUDIO_OUTPUT_FRAMES);
+
+	bfree(test);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(gap_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,132 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/audio-mix.h>
+
+#define FRAMES 1024
+#define CHANNELS 2
+#define BENCH_TICKS 200
+
+static void fill(float *data, size_t count, uint32_t seed)
+{
+	for (size_t i = 0; i < count; i++) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = ((float)(seed >> 16) / 32768.0f) - 1.0f;
+	}
+}
+
+/* odd sizes and offsets exercise the unaligned heads and scalar tails */
+static void kernels_match_scalar_test(void **state)
+{
+	float src[FRAMES + 3], gain[FRAMES + 3];
+	float dst[FRAMES + 3], ref[FRAMES + 3];
+	const size_t count = FRAMES - 5;
+
+	fill(src, FRAMES + 3, 1);
+	fill(gain, FRAMES + 3, 2);
+	fill(dst, FRAMES + 3, 3);
+	memcpy(ref, dst, sizeof(ref));
+
+	audio_mix_add(dst + 1, src + 3, count);
+	for (size_t i = 0; i < count; i++)
+		ref[i + 1] += src[i + 3];
+	assert_memory_equal(dst, ref, sizeof(ref));
+
+	audio_mix_add_mul(dst + 2, src + 1, gain + 3, count);
+	for (size_t i = 0; i < count; i++)
+		ref[i + 2] += src[i + 1] * gain[i + 3];
+	assert_memory_equal(dst, ref, sizeof(ref));
+
+	audio_mul(dst + 3, 0.5f, count);
+	for (size_t i = 0; i < count; i++)
+		ref[i + 3] *= 0.5f;
+	assert_memory_equal(dst, ref, sizeof(ref));
+
+	audio_mul_array(dst, gain + 1, count);
+	for (size_t i = 0; i < count; i++)
+		ref[i] *= gain[i + 1];
+	assert_memory_equal(dst, ref, sizeof(ref));
+
+	for (size_t i = 0; i < FRAMES + 3; i++) {
+		dst[i] *= 4.0f;
+		ref[i] = dst[i] > 1.0f ? 1.0f
+					: (dst[i] < -1.0f ? -1.0f : dst[i]);
+	}
+	audio_clamp(dst, FRAMES + 3);
+	assert_memory_equal(dst, ref, sizeof(ref));
+}
+
+static void bench_mix(size_t sources, size_t tracks)
+{
+	size_t planes = tracks * CHANNELS;
+	float *src = bmalloc(sizeof(float) * FRAMES * sources * planes);
+	float *mix = bzalloc(sizeof(float) * FRAMES * planes);
+	uint64_t scalar_ns, simd_ns, start;
+
+	fill(src, FRAMES * sources * planes, 4);
+
+	start = os_gettime_ns();
+	for (int tick = 0; tick < BENCH_TICKS; tick++) {
+		for (size_t s = 0; s < sources; s++) {
+			for (size_t p = 0; p < planes; p++) {
+				float *in = src + (s * planes + p) * FRAMES;
+				float *out = mix + p * FRAMES;
+
+				for (size_t i = 0; i < FRAMES; i++)
+					out[i] += in[i];
+			}
+		}
+
+		for (size_t i = 0; i < FRAMES * planes; i++) {
+			float val = mix[i];
+			val = (val > 1.0f) ? 1.0f : val;
+			val = (val < -1.0f) ? -1.0f : val;
+			mix[i] = val;
+		}
+	}
+	scalar_ns = os_gettime_ns() - start;
+
+	start = os_gettime_ns();
+	for (int tick = 0; tick < BENCH_TICKS; tick++) {
+		for (size_t s = 0; s < sources; s++) {
+			for (size_t p = 0; p < planes; p++)
+				audio_mix_add(mix + p * FRAMES,
+					      src + (s * planes + p) * FRAMES,
+					      FRAMES);
+		}
+
+		audio_clamp(mix, FRAMES * planes);
+	}
+	simd_ns = os_gettime_ns() - start;
+
+	print_message("%2zu sources x %zu tracks: %.2fus/tick "
+		      "(scalar %.2fus/tick)\n",
+		      sources, tracks,
+		      (double)simd_ns / BENCH_TICKS / 1000.0,
+		      (double)scalar_ns / BENCH_TICKS / 1000.0);
+
+	bfree(src);
+	bfree(mix);
+}
+
+static void mix_benchmark_test(void **state)
+{
+	bench_mix(8, 1);
+	bench_mix(8, 6);
+	bench_mix(32, 1);
+	bench_mix(32, 6);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(kernels_match_scalar_test),
+		cmocka_unit_test(mix_benchmark_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,173 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+
+#define LOOKUPS 20000
+
+static const size_t collection_sizes[] = {100, 1000, 2000, 5000};
+
+static const char *lookup_test_get_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Lookup Test";
+}
+
+static void *lookup_test_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void lookup_test_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static struct obs_source_info lookup_test = {
+	.id = "lookup_test",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.get_name = lookup_test_get_name,
+	.create = lookup_test_create,
+	.destroy = lookup_test_destroy,
+};
+
+static obs_source_t *create_source(const char *format, size_t idx)
+{
+	struct dstr name = {0};
+	obs_source_t *source;
+
+	dstr_printf(&name, format, (int)idx);
+	source = obs_source_create("lookup_test", name.array, NULL, NULL);
+	dstr_free(&name);
+	return source;
+}
+
+static void index_test(void **state)
+{
+	obs_source_t *source = create_source("source %d", 0);
+	obs_source_t *private_source =
+		obs_source_create_private("lookup_test", "private", NULL);
+	obs_source_t *found;
+
+	found = obs_get_source_by_name("source 0");
+	assert_ptr_equal(found, source);
+	obs_source_release(found);
+
+	assert_null(obs_get_source_by_name("private"));
+	assert_null(obs_get_source_by_name("missing"));
+
+	obs_source_set_name(source, "renamed");
+	assert_null(obs_get_source_by_name("source 0"));
+	found = obs_get_source_by_name("renamed");
+	assert_ptr_equal(found, source);
+	obs_source_release(found);
+
+	obs_source_release(source);
+	assert_null(obs_get_source_by_name("renamed"));
+
+	obs_source_release(private_source);
+}
+
+struct linear_lookup {
+	const char *name;
+	obs_source_t *found;
+};
+
+static bool find_source_linear(void *param, obs_source_t *source)
+{
+	struct linear_lookup *lookup = param;
+
+	if (strcmp(obs_source_get_name(source), lookup->name) == 0) {
+		lookup->found = obs_source_get_ref(source);
+		return false;
+	}
+	return true;
+}
+
+/* compares the indexed lookup to walking the source list, which is what
+ * name lookups used to do */
+static void benchmark_test(void **state)
+{
+	DARRAY(obs_source_t *) sources;
+	DARRAY(char *) names;
+
+	da_init(sources);
+	da_init(names);
+
+	for (size_t s = 0; s < sizeof(collection_sizes) / sizeof(size_t); s++) {
+		size_t size = collection_sizes[s];
+		uint64_t start, indexed_ns, linear_ns;
+
+		while (sources.num < size) {
+			obs_source_t *source =
+				create_source("collection source %d",
+					      sources.num);
+			char *name = bstrdup(obs_source_get_name(source));
+			da_push_back(sources, &source);
+			da_push_back(names, &name);
+		}
+
+		start = os_gettime_ns();
+		for (size_t i = 0; i < LOOKUPS; i++) {
+			size_t idx = (i * 7919) % size;
+			obs_source_t *found =
+				obs_get_source_by_name(names.array[idx]);
+			assert_ptr_equal(found, sources.array[idx]);
+			obs_source_release(found);
+		}
+		indexed_ns = os_gettime_ns() - start;
+
+		start = os_gettime_ns();
+		for (size_t i = 0; i < LOOKUPS; i++) {
+			size_t idx = (i * 7919) % size;
+			struct linear_lookup lookup = {names.array[idx], NULL};
+			obs_enum_sources(find_source_linear, &lookup);
+			assert_ptr_equal(lookup.found, sources.array[idx]);
+			obs_source_release(lookup.found);
+		}
+		linear_ns = os_gettime_ns() - start;
+
+		print_message("%5d sources: indexed %6.0fns, linear %8.0fns "
+			      "per lookup\n",
+			      (int)size, (double)indexed_ns / LOOKUPS,
+			      (double)linear_ns / LOOKUPS);
+	}
+
+	for (size_t i = 0; i < sources.num; i++) {
+		obs_source_release(sources.array[i]);
+		bfree(names.array[i]);
+	}
+	da_free(sources);
+	da_free(names);
+}
+
+static int setup(void **state)
+{
+	if (!obs_startup("en-US", NULL, NULL))
+		return -1;
+
+	obs_register_source(&lookup_test);
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	obs_shutdown();
+	return 0;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(index_test),
+		cmocka_unit_test(benchmark_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
@@ -0,0 +1,155 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs.h>
+#include <obs-avc.h>
+#include <util/profiler.h>
+
+/* obs_duplicate_encoder_packet is the only exported way to make a pooled
+ * copy of a packet */
+#if defined(__GNUC__)
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+
+#define QUEUE_DEPTH 32
+#define WARMUP_PACKETS 200
+#define TEST_PACKETS 5000
+
+#define HEAP_ALLOCS "encoder packets: heap allocs"
+#define POOL_REUSES "encoder packets: pool reuses"
+
+static uint8_t payload[64 * 1024];
+
+static int64_t get_counter(const char *name)
+{
+	profiler_snapshot_t *snap = profile_snapshot_create();
+	int64_t value = 0;
+
+	for (size_t i = 0; i < profiler_snapshot_num_counters(snap); i++) {
+		if (strcmp(profiler_snapshot_counter_name(snap, i), name) == 0)
+			value = profiler_snapshot_counter_value(snap, i);
+	}
+
+	profile_snapshot_free(snap);
+	return value;
+}
+
+static void make_packet(struct encoder_packet *pkt, size_t size, int64_t pts)
+{
+	memset(pkt, 0, sizeof(*pkt));
+	pkt->data = payload;
+	pkt->size = size;
+	pkt->pts = pts;
+	pkt->dts = pts;
+}
+
+static void refcount_test(void **state)
+{
+	struct encoder_packet src, a, b, c;
+
+	make_packet(&src, 1000, 1);
+	obs_duplicate_encoder_packet(&a, &src);
+	obs_encoder_packet_ref(&b, &a);
+	obs_encoder_packet_ref(&c, &b);
+
+	assert_ptr_not_equal(a.data, payload);
+	assert_ptr_equal(a.data, b.data);
+	assert_ptr_equal(b.data, c.data);
+	assert_memory_equal(c.data, payload, 1000);
+
+	obs_encoder_packet_release(&a);
+	obs_encoder_packet_release(&b);
+	assert_memory_equal(c.data, payload, 1000);
+	obs_encoder_packet_release(&c);
+
+	assert_null(c.data);
+}
+
+/* parsed packets are released by outputs like any other packet */
+static void avc_parse_test(void **state)
+{
+	static const uint8_t annexb[] = {0, 0, 0, 1, 0x06, 0x01, 0,    0,
+					 1, 0x65, 0xAA, 0xBB, 0xCC};
+	static const uint8_t avcc[] = {0, 0, 0, 2,    0x06, 0x01, 0,   0,
+				       0, 4, 0x65, 0xAA, 0xBB, 0xCC};
+	struct encoder_packet src, pooled, parsed, ref;
+
+	make_packet(&src, 0, 1);
+	src.data = (uint8_t *)annexb;
+	src.size = sizeof(annexb);
+	src.type = OBS_ENCODER_VIDEO;
+	obs_duplicate_encoder_packet(&pooled, &src);
+
+	obs_parse_avc_packet(&parsed, &pooled);
+	obs_encoder_packet_release(&pooled);
+
+	assert_int_equal(parsed.size, sizeof(avcc));
+	assert_memory_equal(parsed.data, avcc, sizeof(avcc));
+	assert_true(parsed.keyframe);
+	assert_int_equal(parsed.priority, OBS_NAL_PRIORITY_HIGHEST);
+	assert_int_equal(parsed.drop_priority, OBS_NAL_PRIORITY_HIGHEST);
+
+	obs_encoder_packet_ref(&ref, &parsed);
+	obs_encoder_packet_release(&parsed);
+	assert_memory_equal(ref.data, avcc, sizeof(avcc));
+	obs_encoder_packet_release(&ref);
+}
+
+/* mimics an interleaver holding a queue of shared packets while a mix of
+ * large video and small audio payloads flows through */
+static void steady_state_test(void **state)
+{
+	struct encoder_packet queue[QUEUE_DEPTH] = {0};
+	int64_t heap_allocs = 0;
+
+	for (int i = 0; i < WARMUP_PACKETS + TEST_PACKETS; i++) {
+		struct encoder_packet src, shared;
+		size_t size = (i % 3) ? (size_t)(300 + (i % 7) * 10)
+				      : 10000 + (size_t)(i * 7919) % 50000;
+
+		if (i == WARMUP_PACKETS)
+			heap_allocs = get_counter(HEAP_ALLOCS);
+
+		make_packet(&src, size, i);
+		obs_duplicate_encoder_packet(&shared, &src);
+
+		obs_encoder_packet_release(&queue[i % QUEUE_DEPTH]);
+		obs_encoder_packet_ref(&queue[i % QUEUE_DEPTH], &shared);
+		obs_encoder_packet_release(&shared);
+	}
+
+	assert_int_equal(get_counter(HEAP_ALLOCS), heap_allocs);
+	print_message("%d packets after warmup, %lld pooled reuses\n",
+		      TEST_PACKETS,
+		      (long long)get_counter(POOL_REUSES));
+
+	for (int i = 0; i < QUEUE_DEPTH; i++)
+		obs_encoder_packet_release(&queue[i]);
+}
+
+static int setup(void **state)
+{
+	profiler_start();
+	return obs_startup("en-US", NULL, NULL) ? 0 : -1;
+}
+
+static int teardown(void **state)
+{
+	obs_shutdown();
+	profiler_stop();
+	profiler_free();
+	return 0;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(refcount_test),
+		cmocka_unit_test(avc_parse_test),
+		cmocka_unit_test(steady_state_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
@@ -0,0 +1,206 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+
+#include "ffmpeg-mux-shm.h"
+#include "ffmpeg-mux.h"
+
+#define RING_SIZE (16 * 1024)
+#define RING_PACKET 5000
+
+/* 512 MiB per run, so the ring is reused many times */
+#define BENCH_PACKET (256 * 1024)
+#define BENCH_PACKETS 2048
+
+static void ring_test(void **state)
+{
+	struct ffm_shm out, in;
+	uint8_t packet[RING_PACKET];
+	uint32_t offset = 0, end = 0, first_end = 0;
+	int count = 0;
+
+	assert_true(ffm_shm_create(&out, RING_SIZE));
+	assert_true(ffm_shm_open(&in, out.name));
+	assert_int_equal(in.size, RING_SIZE);
+
+	/* fills the ring until a packet doesn't fit anymore */
+	for (;;) {
+		memset(packet, count, sizeof(packet));
+		if (!ffm_shm_write(&out, packet, sizeof(packet), &offset, &end))
+			break;
+
+		assert_int_equal(in.data[offset], count);
+		assert_int_equal(in.data[offset + RING_PACKET - 1], count);
+		for (int i = 0; i < FFM_SHM_PADDING; i++)
+			assert_int_equal(in.data[offset + RING_PACKET + i], 0);
+
+		if (!count)
+			first_end = end;
+		count++;
+	}
+
+	assert_true(count > 0);
+
+	/* once the first packet is released, the next one wraps around to
+	 * the start of the ring */
+	ffm_shm_release(&in, first_end);
+	memset(packet, 0xAA, sizeof(packet));
+	assert_true(ffm_shm_write(&out, packet, sizeof(packet), &offset, &end));
+	assert_int_equal(offset, 0);
+	assert_int_equal(in.data[0], 0xAA);
+
+	/* larger than the ring, these always go through the pipe */
+	ffm_shm_release(&in, end);
+	assert_false(ffm_shm_write(&out, in.data, RING_SIZE, &offset, &end));
+
+	ffm_shm_close(&in);
+	ffm_shm_close(&out);
+}
+
+static bool read_all(int fd, void *vdata, size_t size)
+{
+	uint8_t *data = vdata;
+
+	while (size) {
+		ssize_t ret = read(fd, data, size);
+		if (ret <= 0)
+			return false;
+		data += ret;
+		size -= (size_t)ret;
+	}
+
+	return true;
+}
+
+static bool write_all(int fd, const void *vdata, size_t size)
+{
+	const uint8_t *data = vdata;
+
+	while (size) {
+		ssize_t ret = write(fd, data, size);
+		if (ret <= 0)
+			return false;
+		data += ret;
+		size -= (size_t)ret;
+	}
+
+	return true;
+}
+
+/* reads packets the same way the muxer process does, checks the first and
+ * last byte of each one */
+static int run_consumer(int fd, const char *shm_name)
+{
+	struct ffm_packet_info info;
+	struct ffm_shm shm = {0};
+	uint8_t *buf = malloc(BENCH_PACKET);
+	int idx = 0;
+
+	if (shm_name && !ffm_shm_open(&shm, shm_name))
+		return 1;
+
+	while (read_all(fd, &info, sizeof(info))) {
+		const uint8_t *data = buf;
+
+		if (info.shm)
+			data = shm.data + info.shm_offset;
+		else if (!read_all(fd, buf, info.size))
+			return 1;
+
+		if (data[0] != (uint8_t)idx ||
+		    data[info.size - 1] != (uint8_t)idx)
+			return 1;
+		if (info.shm)
+			ffm_shm_release(&shm, info.shm_end);
+		idx++;
+	}
+
+	ffm_shm_close(&shm);
+	free(buf);
+	return idx == BENCH_PACKETS ? 0 : 1;
+}
+
+static double run_transport(bool use_shm, int *pipe_packets)
+{
+	struct ffm_shm shm = {0};
+	uint8_t *packet = bzalloc(BENCH_PACKET);
+	int fds[2];
+	int status;
+	uint64_t start;
+	pid_t pid;
+
+	if (use_shm)
+		assert_true(ffm_shm_create(&shm, FFM_SHM_SIZE));
+
+	assert_int_equal(pipe(fds), 0);
+
+	pid = fork();
+	assert_true(pid >= 0);
+	if (pid == 0) {
+		close(fds[1]);
+		_exit(run_consumer(fds[0], use_shm ? shm.name : NULL));
+	}
+
+	close(fds[0]);
+	*pipe_packets = 0;
+	start = os_gettime_ns();
+
+	for (int i = 0; i < BENCH_PACKETS; i++) {
+		struct ffm_packet_info info = {.size = BENCH_PACKET};
+
+		packet[0] = (uint8_t)i;
+		packet[BENCH_PACKET - 1] = (uint8_t)i;
+
+		if (use_shm)
+			info.shm = ffm_shm_write(&shm, packet, BENCH_PACKET,
+						 &info.shm_offset,
+						 &info.shm_end);
+
+		assert_true(write_all(fds[1], &info, sizeof(info)));
+		if (!info.shm) {
+			assert_true(write_all(fds[1], packet, BENCH_PACKET));
+			(*pipe_packets)++;
+		}
+	}
+
+	close(fds[1]);
+	assert_int_equal(waitpid(pid, &status, 0), pid);
+	assert_true(WIFEXITED(status));
+	assert_int_equal(WEXITSTATUS(status), 0);
+
+	double sec = (double)(os_gettime_ns() - start) / 1000000000.0;
+
+	ffm_shm_close(&shm);
+	bfree(packet);
+	return (double)BENCH_PACKET * BENCH_PACKETS / (1024.0 * 1024.0) / sec;
+}
+
+static void benchmark_test(void **state)
+{
+	int pipe_packets;
+	double mib_s;
+
+	mib_s = run_transport(false, &pipe_packets);
+	print_message("pipe:          %8.1f MiB/s\n", mib_s);
+
+	mib_s = run_transport(true, &pipe_packets);
+	print_message("shared memory: %8.1f MiB/s, %d of %d packets through "
+		      "the pipe\n",
+		      mib_s, pipe_packets, BENCH_PACKETS);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(ring_test),
+		cmocka_unit_test(benchmark_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,207 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/format-conversion.h>
+
+#define BENCH_ITERATIONS 10
+
+struct test_frame {
+	uint32_t width;
+	uint32_t height;
+	uint8_t *uyvx;
+	uint8_t *planes[3];
+	uint8_t *ref_planes[3];
+	uint32_t linesize[3];
+};
+
+/* scalar references for the packed UYVX layout: U, Y, V, X */
+
+static void ref_uyvx_to_i420(const struct test_frame *f, uint8_t *out[])
+{
+	for (uint32_t y = 0; y < f->height; y += 2) {
+		const uint8_t *line0 = f->uyvx + y * f->width * 4;
+		const uint8_t *line1 = line0 + f->width * 4;
+
+		for (uint32_t x = 0; x < f->width; x += 2) {
+			const uint8_t *p00 = line0 + x * 4;
+			const uint8_t *p10 = line1 + x * 4;
+			uint32_t c = (y / 2) * f->linesize[1] + x / 2;
+
+			out[0][y * f->linesize[0] + x] = p00[1];
+			out[0][y * f->linesize[0] + x + 1] = p00[5];
+			out[0][(y + 1) * f->linesize[0] + x] = p10[1];
+			out[0][(y + 1) * f->linesize[0] + x + 1] = p10[5];
+
+			out[1][c] = (p00[0] + p00[4] + p10[0] + p10[4]) >> 2;
+			out[2][c] = (p00[2] + p00[6] + p10[2] + p10[6]) >> 2;
+		}
+	}
+}
+
+static void ref_uyvx_to_nv12(const struct test_frame *f, uint8_t *out[])
+{
+	for (uint32_t y = 0; y < f->height; y += 2) {
+		const uint8_t *line0 = f->uyvx + y * f->width * 4;
+		const uint8_t *line1 = line0 + f->width * 4;
+
+		for (uint32_t x = 0; x < f->width; x += 2) {
+			const uint8_t *p00 = line0 + x * 4;
+			const uint8_t *p10 = line1 + x * 4;
+			uint32_t c = (y / 2) * f->linesize[1] + x;
+
+			out[0][y * f->linesize[0] + x] = p00[1];
+			out[0][y * f->linesize[0] + x + 1] = p00[5];
+			out[0][(y + 1) * f->linesize[0] + x] = p10[1];
+			out[0][(y + 1) * f->linesize[0] + x + 1] = p10[5];
+
+			out[1][c] = (p00[0] + p00[4] + p10[0] + p10[4]) >> 2;
+			out[1][c + 1] =
+				(p00[2] + p00[6] + p10[2] + p10[6]) >> 2;
+		}
+	}
+}
+
+static void ref_uyvx_to_i444(const struct test_frame *f, uint8_t *out[])
+{
+	for (uint32_t y = 0; y < f->height; y++) {
+		const uint8_t *line = f->uyvx + y * f->width * 4;
+
+		for (uint32_t x = 0; x < f->width; x++) {
+			uint32_t pos = y * f->linesize[0] + x;
+
+			out[0][pos] = line[x * 4 + 1];
+			out[1][pos] = line[x * 4 + 0];
+			out[2][pos] = line[x * 4 + 2];
+		}
+	}
+}
+
+enum layout {
+	LAYOUT_I420,
+	LAYOUT_NV12,
+	LAYOUT_I444,
+};
+
+static const size_t layout_planes[] = {3, 2, 3};
+
+static inline uint32_t plane_height(enum layout layout, size_t plane,
+				    uint32_t height)
+{
+	return (plane && layout != LAYOUT_I444) ? height / 2 : height;
+}
+
+static void init_frame(struct test_frame *f, uint32_t width, uint32_t height,
+		       enum layout layout)
+{
+	uint32_t seed = 12345;
+
+	f->width = width;
+	f->height = height;
+	f->uyvx = bmalloc(width * height * 4);
+	f->linesize[0] = width;
+	f->linesize[1] = layout == LAYOUT_I420 ? width / 2 : width;
+	f->linesize[2] = layout == LAYOUT_I420 ? width / 2 : width;
+
+	for (uint32_t i = 0; i < width * height * 4; i++) {
+		seed = seed * 1103515245 + 12345;
+		f->uyvx[i] = (uint8_t)(seed >> 16);
+	}
+
+	for (size_t i = 0; i < 3; i++) {
+		size_t size = f->linesize[i] * plane_height(layout, i, height);
+
+		f->planes[i] = bzalloc(size);
+		f->ref_planes[i] = bzalloc(size);
+	}
+}
+
+static void free_frame(struct test_frame *f)
+{
+	bfree(f->uyvx);
+	for (size_t i = 0; i < 3; i++) {
+		bfree(f->planes[i]);
+		bfree(f->ref_planes[i]);
+	}
+}
+
+typedef void (*kernel_t)(const uint8_t *input, uint32_t in_linesize,
+			 uint32_t start_y, uint32_t end_y, uint8_t *output[],
+			 const uint32_t out_linesize[]);
+typedef void (*ref_kernel_t)(const struct test_frame *f, uint8_t *out[]);
+
+static void check_kernel(const char *name, kernel_t kernel, ref_kernel_t ref,
+			 uint32_t width, uint32_t height, enum layout layout)
+{
+	struct test_frame f;
+	uint64_t start, kernel_ns, ref_ns;
+
+	init_frame(&f, width, height, layout);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCH_ITERATIONS; i++)
+		kernel(f.uyvx, width * 4, 0, height, f.planes, f.linesize);
+	kernel_ns = os_gettime_ns() - start;
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCH_ITERATIONS; i++)
+		ref(&f, f.ref_planes);
+	ref_ns = os_gettime_ns() - start;
+
+	for (size_t i = 0; i < layout_planes[layout]; i++)
+		assert_memory_equal(f.planes[i], f.ref_planes[i],
+				    f.linesize[i] *
+					    plane_height(layout, i, height));
+
+	double mpix = (double)width * height * BENCH_ITERATIONS / 1000000.0;
+	print_message("%s %ux%u: %.0f MPix/s (scalar %.0f MPix/s)\n", name,
+		      width, height, mpix / ((double)kernel_ns / 1e9),
+		      mpix / ((double)ref_ns / 1e9));
+
+	free_frame(&f);
+}
+
+static const uint32_t sizes[][2] = {
+	{1920, 1080},
+	{2560, 1440},
+	{3840, 2160},
+	{1284, 720}, /* not a multiple of 8 pixels */
+};
+
+static void uyvx_to_i420_test(void **state)
+{
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+		check_kernel("uyvx_to_i420", compress_uyvx_to_i420,
+			     ref_uyvx_to_i420, sizes[i][0], sizes[i][1],
+			     LAYOUT_I420);
+}
+
+static void uyvx_to_nv12_test(void **state)
+{
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+		check_kernel("uyvx_to_nv12", compress_uyvx_to_nv12,
+			     ref_uyvx_to_nv12, sizes[i][0], sizes[i][1],
+			     LAYOUT_NV12);
+}
+
+static void uyvx_to_i444_test(void **state)
+{
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+		check_kernel("uyvx_to_i444", convert_uyvx_to_i444,
+			     ref_uyvx_to_i444, sizes[i][0], sizes[i][1],
+			     LAYOUT_I444);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(uyvx_to_i420_test),
+		cmocka_unit_test(uyvx_to_nv12_test),
+		cmocka_unit_test(uyvx_to_i444_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,124 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs.h>
+
+static const char *pool_test_get_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Frame Pool Test";
+}
+
+static void *pool_test_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void pool_test_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static struct obs_source_info pool_test = {
+	.id = "frame_pool_test",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_ASYNC_VIDEO,
+	.get_name = pool_test_get_name,
+	.create = pool_test_create,
+	.destroy = pool_test_destroy,
+};
+
+static void output_frame(obs_source_t *source, uint32_t cx, uint32_t cy)
+{
+	struct obs_source_frame *frame =
+		obs_source_frame_create(VIDEO_FORMAT_NV12, cx, cy);
+
+	obs_source_output_video(source, frame);
+	obs_source_frame_destroy(frame);
+}
+
+/* a source that switches between resolutions gets its earlier frames back
+ * from the pool, and so does another source using the same resolution */
+static void reuse_test(void **state)
+{
+	obs_source_t *source1 =
+		obs_source_create_private("frame_pool_test", "one", NULL);
+	obs_source_t *source2 =
+		obs_source_create_private("frame_pool_test", "two", NULL);
+	struct obs_frame_pool_stats start, stats;
+
+	obs_get_frame_pool_stats(&start);
+
+	output_frame(source1, 640, 480);
+	output_frame(source1, 1280, 720);
+	output_frame(source1, 640, 480);
+
+	obs_get_frame_pool_stats(&stats);
+	assert_int_equal(stats.allocations - start.allocations, 2);
+	assert_int_equal(stats.hits - start.hits, 1);
+
+	/* the 1280x720 frame of the first source is idle again */
+	output_frame(source2, 1280, 720);
+
+	obs_get_frame_pool_stats(&stats);
+	assert_int_equal(stats.allocations - start.allocations, 2);
+	assert_int_equal(stats.hits - start.hits, 2);
+	assert_true(stats.bytes_resident >=
+		    640 * 480 * 3 / 2 + 1280 * 720 * 3 / 2);
+
+	obs_source_release(source1);
+	obs_source_release(source2);
+
+	obs_get_frame_pool_stats(&stats);
+	assert_int_equal(stats.bytes_idle, stats.bytes_resident);
+}
+
+static void limit_test(void **state)
+{
+	obs_source_t *source =
+		obs_source_create_private("frame_pool_test", "source", NULL);
+	struct obs_frame_pool_stats stats;
+
+	output_frame(source, 320, 240);
+	output_frame(source, 640, 480);
+
+	obs_set_frame_pool_limit(0);
+
+	obs_get_frame_pool_stats(&stats);
+	assert_int_equal(stats.bytes_idle, 0);
+	assert_true(stats.bytes_resident >= 640 * 480 * 3 / 2);
+
+	obs_source_release(source);
+
+	obs_get_frame_pool_stats(&stats);
+	assert_int_equal(stats.bytes_idle, 0);
+	assert_int_equal(stats.bytes_resident, 0);
+}
+
+static int setup(void **state)
+{
+	if (!obs_startup("en-US", NULL, NULL))
+		return -1;
+
+	obs_register_source(&pool_test);
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	obs_shutdown();
+	return 0;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(reuse_test),
+		cmocka_unit_test(limit_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
@@ -0,0 +1,225 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs-interleave.h>
+#include <util/platform.h>
+
+#define AUDIO_TRACKS 6
+#define VIDEO_FRAME_USEC 16667
+#define AUDIO_FRAME_USEC 21333
+#define VIDEO_LATENCY_USEC 50000
+#define AUDIO_LATENCY_USEC 5000
+
+#define ORDER_PACKETS 20000
+#define ORDER_DEPTH 64
+#define BENCH_PACKETS 50000
+#define BENCH_DEPTH 3000
+
+struct packet_list {
+	DARRAY(struct encoder_packet) packets;
+};
+
+/* the old linear insert, used as the reference ordering */
+static void reference_insert(struct packet_list *list,
+			     struct encoder_packet *out)
+{
+	size_t idx;
+	for (idx = 0; idx < list->packets.num; idx++) {
+		struct encoder_packet *cur = list->packets.array + idx;
+
+		if (out->dts_usec == cur->dts_usec &&
+		    out->type == OBS_ENCODER_VIDEO) {
+			break;
+		} else if (out->dts_usec < cur->dts_usec) {
+			break;
+		}
+	}
+
+	da_insert(list->packets, idx, out);
+}
+
+/* generates one video and several audio streams, in the order they would
+ * arrive from the encoders: video is held back for b-frames, and a few audio
+ * tracks share timestamps to exercise tie breaking.  the pts of each packet
+ * is a unique id */
+static void generate_streams(struct packet_list *list, size_t count)
+{
+	int64_t video_dts = 0;
+	int64_t audio_dts[AUDIO_TRACKS] = {0};
+	int64_t id = 0;
+
+	da_init(list->packets);
+
+	while (list->packets.num < count) {
+		int64_t video_ready = video_dts + VIDEO_LATENCY_USEC;
+		size_t next = AUDIO_TRACKS;
+		int64_t next_ready = video_ready;
+		struct encoder_packet pkt = {0};
+
+		for (size_t i = 0; i < AUDIO_TRACKS; i++) {
+			int64_t jitter = (int64_t)((id * 7 + i * 13) % 3000);
+			int64_t ready = audio_dts[i] + AUDIO_LATENCY_USEC +
+					jitter;
+			if (ready < next_ready) {
+				next_ready = ready;
+				next = i;
+			}
+		}
+
+		pkt.pts = id++;
+		if (next == AUDIO_TRACKS) {
+			pkt.type = OBS_ENCODER_VIDEO;
+			pkt.dts_usec = video_dts;
+			video_dts += VIDEO_FRAME_USEC;
+		} else {
+			pkt.type = OBS_ENCODER_AUDIO;
+			pkt.track_idx = next;
+			pkt.dts_usec = audio_dts[next];
+			audio_dts[next] += (next % 2) ? AUDIO_FRAME_USEC + 1
+						      : AUDIO_FRAME_USEC;
+		}
+
+		da_push_back(list->packets, &pkt);
+	}
+}
+
+static void order_test(void **state)
+{
+	struct interleave_queue queue = {0};
+	struct packet_list input;
+	struct packet_list reference = {0};
+
+	generate_streams(&input, ORDER_PACKETS);
+
+	for (size_t i = 0; i < input.packets.num; i++) {
+		interleave_queue_push(&queue, &input.packets.array[i]);
+		reference_insert(&reference, &input.packets.array[i]);
+
+		while (interleave_queue_count(&queue) > ORDER_DEPTH) {
+			struct encoder_packet out;
+
+			assert_true(interleave_queue_pop(&queue, &out));
+			assert_int_equal(out.pts,
+					 reference.packets.array[0].pts);
+			da_erase(reference.packets, 0);
+		}
+	}
+
+	for (size_t i = 0; i < reference.packets.num; i++) {
+		struct encoder_packet out;
+
+		assert_true(interleave_queue_pop(&queue, &out));
+		assert_int_equal(out.pts, reference.packets.array[i].pts);
+	}
+
+	assert_null(interleave_queue_peek(&queue));
+	assert_int_equal(interleave_queue_count(&queue), 0);
+
+	interleave_queue_free(&queue);
+	da_free(reference.packets);
+	da_free(input.packets);
+}
+
+static void push_packet(struct interleave_queue *queue,
+			enum obs_encoder_type type, size_t track_idx,
+			int64_t dts_usec, int64_t id)
+{
+	struct encoder_packet pkt = {0};
+	pkt.type = type;
+	pkt.track_idx = track_idx;
+	pkt.dts_usec = dts_usec;
+	pkt.pts = id;
+	interleave_queue_push(queue, &pkt);
+}
+
+static void track_test(void **state)
+{
+	struct interleave_queue queue = {0};
+	struct encoder_packet *pkt;
+	struct encoder_packet out;
+
+	push_packet(&queue, OBS_ENCODER_AUDIO, 1, 100, 0);
+	push_packet(&queue, OBS_ENCODER_AUDIO, 0, 100, 1);
+	push_packet(&queue, OBS_ENCODER_VIDEO, 0, 100, 2);
+	push_packet(&queue, OBS_ENCODER_AUDIO, 0, 300, 3);
+	push_packet(&queue, OBS_ENCODER_VIDEO, 0, 200, 4);
+	/* out of order within a track */
+	push_packet(&queue, OBS_ENCODER_AUDIO, 0, 50, 5);
+
+	pkt = interleave_queue_first(&queue, OBS_ENCODER_AUDIO, 0);
+	assert_int_equal(pkt->pts, 5);
+	pkt = interleave_queue_last(&queue, OBS_ENCODER_AUDIO, 0);
+	assert_int_equal(pkt->pts, 3);
+	pkt = interleave_queue_last(&queue, OBS_ENCODER_VIDEO, 0);
+	assert_int_equal(pkt->pts, 4);
+	assert_null(interleave_queue_first(&queue, OBS_ENCODER_AUDIO, 2));
+
+	/* video first on equal timestamps, then audio in push order */
+	pkt = interleave_queue_first(&queue, OBS_ENCODER_AUDIO, 1);
+	interleave_queue_discard(&queue, pkt, false);
+	assert_int_equal(interleave_queue_count(&queue), 4);
+	assert_int_equal(interleave_queue_peek(&queue)->pts, 0);
+
+	pkt = interleave_queue_first(&queue, OBS_ENCODER_AUDIO, 0);
+	interleave_queue_discard(&queue, pkt, true);
+	assert_int_equal(interleave_queue_count(&queue), 2);
+
+	assert_true(interleave_queue_pop(&queue, &out));
+	assert_int_equal(out.pts, 4);
+	assert_true(interleave_queue_pop(&queue, &out));
+	assert_int_equal(out.pts, 3);
+	assert_false(interleave_queue_pop(&queue, &out));
+
+	interleave_queue_free(&queue);
+}
+
+/* a long queue, as with several audio tracks and output delay enabled */
+static void throughput_test(void **state)
+{
+	struct interleave_queue queue = {0};
+	struct packet_list input;
+	struct packet_list reference = {0};
+	uint64_t start, queue_ns, reference_ns;
+
+	generate_streams(&input, BENCH_PACKETS);
+
+	start = os_gettime_ns();
+	for (size_t i = 0; i < input.packets.num; i++) {
+		struct encoder_packet out;
+
+		interleave_queue_push(&queue, &input.packets.array[i]);
+		if (interleave_queue_count(&queue) > BENCH_DEPTH)
+			interleave_queue_pop(&queue, &out);
+	}
+	queue_ns = os_gettime_ns() - start;
+
+	start = os_gettime_ns();
+	for (size_t i = 0; i < input.packets.num; i++) {
+		reference_insert(&reference, &input.packets.array[i]);
+		if (reference.packets.num > BENCH_DEPTH)
+			da_erase(reference.packets, 0);
+	}
+	reference_ns = os_gettime_ns() - start;
+
+	print_message("%d packets, depth %d: interleave queue %.2fms, "
+		      "linear insert %.2fms\n",
+		      BENCH_PACKETS, BENCH_DEPTH, (double)queue_ns / 1000000.0,
+		      (double)reference_ns / 1000000.0);
+
+	interleave_queue_free(&queue);
+	da_free(reference.packets);
+	da_free(input.packets);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(order_test),
+		cmocka_unit_test(track_test),
+		cmocka_unit_test(throughput_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
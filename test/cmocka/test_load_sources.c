@@ -0,0 +1,180 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#define NUM_SOURCES 64
+#define CREATE_TIME_MS 10
+
+static pthread_t load_thread;
+static volatile long creating = 0;
+static volatile long max_creating = 0;
+static volatile long serial_created = 0;
+static bool serial_on_load_thread = true;
+static bool serial_in_order = true;
+
+/* simulates a source that spends a while decoding a file when created */
+static void *parallel_test_create(obs_data_t *settings, obs_source_t *source)
+{
+	long num = os_atomic_inc_long(&creating);
+	long max = os_atomic_load_long(&max_creating);
+
+	while (num > max &&
+	       !os_atomic_compare_swap_long(&max_creating, max, num))
+		max = os_atomic_load_long(&max_creating);
+
+	os_sleep_ms(CREATE_TIME_MS);
+	os_atomic_dec_long(&creating);
+
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void *serial_test_create(obs_data_t *settings, obs_source_t *source)
+{
+	long idx = (long)obs_data_get_int(settings, "serial_idx");
+
+	if (!pthread_equal(pthread_self(), load_thread))
+		serial_on_load_thread = false;
+	if (idx != os_atomic_inc_long(&serial_created) - 1)
+		serial_in_order = false;
+
+	return source;
+}
+
+static const char *load_test_get_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Load Test";
+}
+
+static void load_test_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static struct obs_source_info parallel_test = {
+	.id = "parallel_load_test",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_PARALLEL_CREATE,
+	.get_name = load_test_get_name,
+	.create = parallel_test_create,
+	.destroy = load_test_destroy,
+};
+
+static struct obs_source_info serial_test = {
+	.id = "serial_load_test",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.get_name = load_test_get_name,
+	.create = serial_test_create,
+	.destroy = load_test_destroy,
+};
+
+struct load_state {
+	size_t loaded;
+	bool in_order;
+};
+
+static void source_loaded(void *param, obs_source_t *source)
+{
+	struct load_state *state = param;
+	struct dstr name = {0};
+
+	dstr_printf(&name, "source %d", (int)state->loaded++);
+	if (strcmp(obs_source_get_name(source), name.array) != 0)
+		state->in_order = false;
+	dstr_free(&name);
+}
+
+/* every fourth source can't be created in parallel */
+static obs_data_array_t *create_collection(void)
+{
+	obs_data_array_t *array = obs_data_array_create();
+	long serial_idx = 0;
+
+	for (int i = 0; i < NUM_SOURCES; i++) {
+		obs_data_t *source_data = obs_data_create();
+		obs_data_t *settings = obs_data_create();
+		struct dstr name = {0};
+		bool serial = i % 4 == 0;
+
+		dstr_printf(&name, "source %d", i);
+		obs_data_set_string(source_data, "name", name.array);
+		obs_data_set_string(source_data, "id",
+				    serial ? "serial_load_test"
+					   : "parallel_load_test");
+		if (serial)
+			obs_data_set_int(settings, "serial_idx", serial_idx++);
+		obs_data_set_obj(source_data, "settings", settings);
+
+		obs_data_array_push_back(array, source_data);
+		obs_data_release(settings);
+		obs_data_release(source_data);
+		dstr_free(&name);
+	}
+
+	return array;
+}
+
+static void load_test(void **state)
+{
+	obs_data_array_t *array = create_collection();
+	struct load_state load = {0, true};
+	uint64_t start, elapsed;
+
+	load_thread = pthread_self();
+
+	start = os_gettime_ns();
+	obs_load_sources(array, source_loaded, &load);
+	elapsed = os_gettime_ns() - start;
+
+	assert_int_equal(load.loaded, NUM_SOURCES);
+	assert_true(load.in_order);
+	assert_true(serial_on_load_thread);
+	assert_true(serial_in_order);
+	assert_int_equal(serial_created, NUM_SOURCES / 4);
+
+	/* the sources were released again after loading, nothing else holds
+	 * a reference to them */
+	assert_null(obs_get_source_by_name("source 0"));
+
+	print_message("%d sources loaded in %.1fms, up to %ld created at once "
+		      "(%dms each when created one by one)\n",
+		      NUM_SOURCES, (double)elapsed / 1000000.0, max_creating,
+		      CREATE_TIME_MS);
+
+	if (os_get_logical_cores() > 1)
+		assert_true(max_creating > 1);
+
+	obs_data_array_release(array);
+}
+
+static int setup(void **state)
+{
+	if (!obs_startup("en-US", NULL, NULL))
+		return -1;
+
+	obs_register_source(&parallel_test);
+	obs_register_source(&serial_test);
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	obs_shutdown();
+	return 0;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(load_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
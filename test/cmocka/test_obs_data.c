@@ -0,0 +1,359 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs-data.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+
+#define INDEX_KEYS 1000
+
+#define BENCH_SOURCES 1500
+#define BENCH_SCENES 60
+#define BENCH_ITEMS_PER_SCENE 40
+#define BENCH_RUNS 5
+
+static obs_data_t *create_test_data(void)
+{
+	obs_data_t *data = obs_data_create();
+	obs_data_t *obj = obs_data_create();
+	obs_data_array_t *array = obs_data_array_create();
+
+	obs_data_set_string(data, "string", "text \xE2\x9C\x93 \"quoted\"");
+	obs_data_set_string(data, "empty", "");
+	obs_data_set_int(data, "int", -1234567890123LL);
+	obs_data_set_double(data, "double", 0.1);
+	obs_data_set_bool(data, "true", true);
+	obs_data_set_bool(data, "false", false);
+
+	/* defaults are not saved */
+	obs_data_set_default_int(data, "default", 5);
+
+	obs_data_set_int(obj, "x", 1);
+	obs_data_set_string(obj, "string", "shared key");
+	obs_data_set_obj(data, "obj", obj);
+
+	for (int i = 0; i < 3; i++) {
+		obs_data_t *item = obs_data_create();
+		obs_data_set_int(item, "idx", i);
+		obs_data_set_obj(item, "obj", obj);
+		obs_data_array_push_back(array, item);
+		obs_data_release(item);
+	}
+	obs_data_set_array(data, "array", array);
+
+	obs_data_array_release(array);
+	obs_data_release(obj);
+	return data;
+}
+
+static void round_trip_test(void **state)
+{
+	obs_data_t *data = create_test_data();
+	obs_data_t *loaded;
+	const void *binary;
+	size_t size;
+
+	binary = obs_data_get_binary(data, &size);
+	assert_non_null(binary);
+
+	loaded = obs_data_create_from_binary(binary, size);
+	assert_non_null(loaded);
+
+	assert_string_equal(obs_data_get_json(loaded), obs_data_get_json(data));
+	assert_false(obs_data_has_user_value(loaded, "default"));
+	assert_true(obs_data_get_double(loaded, "double") == 0.1);
+
+	obs_data_release(loaded);
+	obs_data_release(data);
+}
+
+/* every truncated or modified copy has to be rejected or loaded without
+ * reading out of bounds */
+static void corrupt_test(void **state)
+{
+	obs_data_t *data = create_test_data();
+	size_t size;
+	const uint8_t *binary = obs_data_get_binary(data, &size);
+	uint8_t *copy = bmalloc(size);
+
+	for (size_t len = 0; len < size; len++) {
+		memcpy(copy, binary, len);
+		assert_null(obs_data_create_from_binary(copy, len));
+	}
+
+	for (size_t i = 0; i < size; i++) {
+		memcpy(copy, binary, size);
+		copy[i] ^= 0xFF;
+		obs_data_release(obs_data_create_from_binary(copy, size));
+	}
+
+	bfree(copy);
+	obs_data_release(data);
+}
+
+static void index_test(void **state)
+{
+	obs_data_t *data = obs_data_create();
+	struct dstr name = {0};
+	struct dstr val = {0};
+
+	/* out of order, so items are inserted in the middle of the list */
+	for (int i = 0; i < INDEX_KEYS; i++) {
+		dstr_printf(&name, "key %d", (i * 7919) % INDEX_KEYS);
+		obs_data_set_int(data, name.array, (i * 7919) % INDEX_KEYS);
+	}
+
+	/* removes every other key */
+	for (int i = 0; i < INDEX_KEYS; i += 2) {
+		dstr_printf(&name, "key %d", i);
+		obs_data_erase(data, name.array);
+	}
+
+	/* grows the remaining items, which reallocates them */
+	for (int i = 1; i < INDEX_KEYS; i += 4) {
+		dstr_printf(&name, "key %d", i);
+		obs_data_set_default_string(data, name.array,
+					    "a much longer default value");
+	}
+
+	for (int i = 0; i < INDEX_KEYS; i++) {
+		dstr_printf(&name, "key %d", i);
+		assert_int_equal(obs_data_has_user_value(data, name.array),
+				 i % 2 == 1);
+		if (i % 2)
+			assert_int_equal(obs_data_get_int(data, name.array), i);
+	}
+
+	/* list order is still sorted after all that */
+	obs_data_item_t *item = obs_data_first(data);
+	for (; item; obs_data_item_next(&item)) {
+		const char *item_name = obs_data_item_get_name(item);
+		if (val.len)
+			assert_true(strcmp(val.array, item_name) < 0);
+		dstr_copy(&val, item_name);
+	}
+
+	dstr_free(&name);
+	dstr_free(&val);
+	obs_data_release(data);
+}
+
+static obs_data_t *create_settings(int i)
+{
+	obs_data_t *settings = obs_data_create();
+	obs_data_t *font = obs_data_create();
+	struct dstr str = {0};
+
+	dstr_printf(&str, "C:/Users/streamer/Pictures/overlays/image_%04d.png",
+		    i);
+	obs_data_set_string(settings, "file", str.array);
+	dstr_printf(&str, "Source %d text that is displayed on screen", i);
+	obs_data_set_string(settings, "text", str.array);
+	obs_data_set_int(settings, "color", 0xFF00FF00 + i);
+	obs_data_set_bool(settings, "unload", i % 2 == 0);
+	obs_data_set_double(settings, "speed", 1.0 + i / 100.0);
+
+	obs_data_set_string(font, "face", "Arial");
+	obs_data_set_string(font, "style", "Regular");
+	obs_data_set_int(font, "size", 48);
+	obs_data_set_int(font, "flags", 0);
+	obs_data_set_obj(settings, "font", font);
+
+	obs_data_release(font);
+	dstr_free(&str);
+	return settings;
+}
+
+static obs_data_t *create_source(const char *name, const char *id,
+				 obs_data_t *settings,
+				 obs_data_array_t *filters)
+{
+	obs_data_t *source = obs_data_create();
+	obs_data_t *hotkeys = obs_data_create();
+	obs_data_array_t *empty = obs_data_array_create();
+
+	obs_data_set_string(source, "name", name);
+	obs_data_set_string(source, "id", id);
+	obs_data_set_string(source, "versioned_id", id);
+	obs_data_set_obj(source, "settings", settings);
+	obs_data_set_int(source, "mixers", 0x3F);
+	obs_data_set_int(source, "sync", 0);
+	obs_data_set_int(source, "flags", 0);
+	obs_data_set_double(source, "volume", 1.0);
+	obs_data_set_double(source, "balance", 0.5);
+	obs_data_set_bool(source, "enabled", true);
+	obs_data_set_bool(source, "muted", false);
+	obs_data_set_int(source, "monitoring_type", 0);
+	obs_data_set_int(source, "deinterlace_mode", 0);
+	obs_data_set_int(source, "prev_ver", 0x1A000000);
+	obs_data_set_array(hotkeys, "libobs.mute", empty);
+	obs_data_set_array(hotkeys, "libobs.unmute", empty);
+	obs_data_set_obj(source, "hotkeys", hotkeys);
+	obs_data_set_obj(source, "private_settings", hotkeys);
+	if (filters)
+		obs_data_set_array(source, "filters", filters);
+
+	obs_data_array_release(empty);
+	obs_data_release(hotkeys);
+	return source;
+}
+
+static obs_data_t *create_scene_item(int scene, int idx)
+{
+	obs_data_t *item = obs_data_create();
+	obs_data_t *pos = obs_data_create();
+	obs_data_t *scale = obs_data_create();
+	struct dstr name = {0};
+
+	dstr_printf(&name, "source %d",
+		    (scene * BENCH_ITEMS_PER_SCENE + idx) % BENCH_SOURCES);
+	obs_data_set_string(item, "name", name.array);
+	obs_data_set_int(item, "id", idx + 1);
+	obs_data_set_bool(item, "visible", true);
+	obs_data_set_bool(item, "locked", false);
+	obs_data_set_double(item, "rot", 0.0);
+	obs_data_set_int(item, "align", 5);
+	obs_data_set_int(item, "bounds_type", 0);
+	obs_data_set_int(item, "scale_filter", 0);
+
+	obs_data_set_double(pos, "x", idx * 10.5);
+	obs_data_set_double(pos, "y", idx * 20.25);
+	obs_data_set_obj(item, "pos", pos);
+	obs_data_set_double(scale, "x", 1.0);
+	obs_data_set_double(scale, "y", 1.0);
+	obs_data_set_obj(item, "scale", scale);
+	obs_data_set_obj(item, "bounds", scale);
+
+	obs_data_release(pos);
+	obs_data_release(scale);
+	dstr_free(&name);
+	return item;
+}
+
+/* built to resemble a large scene collection as saved by the frontend */
+static obs_data_t *create_collection(void)
+{
+	obs_data_t *collection = obs_data_create();
+	obs_data_array_t *sources = obs_data_array_create();
+	struct dstr name = {0};
+
+	for (int i = 0; i < BENCH_SOURCES; i++) {
+		obs_data_t *settings = create_settings(i);
+		obs_data_array_t *filters = obs_data_array_create();
+		obs_data_t *source;
+
+		for (int j = 0; j < i % 3; j++) {
+			obs_data_t *filter_settings = create_settings(j);
+			obs_data_t *filter;
+
+			dstr_printf(&name, "filter %d", j);
+			filter = create_source(name.array, "color_filter",
+					       filter_settings, NULL);
+			obs_data_array_push_back(filters, filter);
+			obs_data_release(filter);
+			obs_data_release(filter_settings);
+		}
+
+		dstr_printf(&name, "source %d", i);
+		source = create_source(name.array, "image_source", settings,
+				       filters);
+		obs_data_array_push_back(sources, source);
+
+		obs_data_release(source);
+		obs_data_array_release(filters);
+		obs_data_release(settings);
+	}
+
+	for (int i = 0; i < BENCH_SCENES; i++) {
+		obs_data_t *settings = obs_data_create();
+		obs_data_array_t *items = obs_data_array_create();
+		obs_data_t *scene;
+
+		for (int j = 0; j < BENCH_ITEMS_PER_SCENE; j++) {
+			obs_data_t *item = create_scene_item(i, j);
+			obs_data_array_push_back(items, item);
+			obs_data_release(item);
+		}
+
+		obs_data_set_array(settings, "items", items);
+		obs_data_set_int(settings, "id_counter",
+				 BENCH_ITEMS_PER_SCENE);
+
+		dstr_printf(&name, "scene %d", i);
+		scene = create_source(name.array, "scene", settings, NULL);
+		obs_data_array_push_back(sources, scene);
+
+		obs_data_release(scene);
+		obs_data_array_release(items);
+		obs_data_release(settings);
+	}
+
+	obs_data_set_string(collection, "name", "Benchmark");
+	obs_data_set_string(collection, "current_scene", "scene 0");
+	obs_data_set_array(collection, "sources", sources);
+
+	obs_data_array_release(sources);
+	dstr_free(&name);
+	return collection;
+}
+
+static double ms_since(uint64_t start)
+{
+	return (double)(os_gettime_ns() - start) / 1000000.0 / BENCH_RUNS;
+}
+
+static void benchmark_test(void **state)
+{
+	obs_data_t *collection = create_collection();
+	double json_save, json_load, binary_save, binary_load;
+	const char *json = NULL;
+	const void *binary = NULL;
+	size_t binary_size = 0;
+	uint64_t start;
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCH_RUNS; i++)
+		json = obs_data_get_json(collection);
+	json_save = ms_since(start);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCH_RUNS; i++)
+		obs_data_release(obs_data_create_from_json(json));
+	json_load = ms_since(start);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCH_RUNS; i++)
+		binary = obs_data_get_binary(collection, &binary_size);
+	binary_save = ms_since(start);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCH_RUNS; i++)
+		obs_data_release(
+			obs_data_create_from_binary(binary, binary_size));
+	binary_load = ms_since(start);
+
+	obs_data_t *loaded = obs_data_create_from_binary(binary, binary_size);
+	assert_string_equal(obs_data_get_json(loaded), json);
+	obs_data_release(loaded);
+
+	print_message("json:   %7.2f KiB, save %7.2fms, load %7.2fms\n",
+		      (double)strlen(json) / 1024.0, json_save, json_load);
+	print_message("binary: %7.2f KiB, save %7.2fms, load %7.2fms\n",
+		      (double)binary_size / 1024.0, binary_save, binary_load);
+
+	obs_data_release(collection);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(round_trip_test),
+		cmocka_unit_test(corrupt_test),
+		cmocka_unit_test(index_test),
+		cmocka_unit_test(benchmark_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,310 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs.h>
+#include <util/platform.h>
+
+#include "obs-ffmpeg-replay-store.h"
+
+/* obs_duplicate_encoder_packet is the only exported way to make a pooled
+ * copy of a packet */
+#if defined(__GNUC__)
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+
+#define KEYFRAME_SIZE (1024 * 1024)
+#define FRAME_SIZE (128 * 1024)
+#define AUDIO_SIZE 1024
+#define GOP_FRAMES 10
+
+/* the first byte of every payload is its sequence number */
+static uint8_t payload[KEYFRAME_SIZE];
+static int64_t sequence = 0;
+
+static void push_packet(struct replay_store *store, int64_t max_size,
+			enum obs_encoder_type type, bool keyframe, size_t size)
+{
+	struct encoder_packet src = {0};
+	struct encoder_packet pkt;
+
+	payload[0] = (uint8_t)sequence;
+
+	src.data = payload;
+	src.size = size;
+	src.type = type;
+	src.keyframe = keyframe;
+	src.pts = sequence;
+	src.dts = sequence;
+	src.dts_usec = sequence * 1000;
+	sequence++;
+
+	obs_duplicate_encoder_packet(&pkt, &src);
+	replay_store_purge(store, max_size, INT64_MAX, &pkt);
+	replay_store_push(store, &pkt);
+	obs_encoder_packet_release(&pkt);
+}
+
+static void push_gop(struct replay_store *store, int64_t max_size)
+{
+	for (int i = 0; i < GOP_FRAMES; i++) {
+		push_packet(store, max_size, OBS_ENCODER_VIDEO, i == 0,
+			    i == 0 ? KEYFRAME_SIZE : FRAME_SIZE);
+		push_packet(store, max_size, OBS_ENCODER_AUDIO, false,
+			    AUDIO_SIZE);
+	}
+}
+
+static void push_timed(struct replay_store *store, int64_t max_time,
+		       bool keyframe, int64_t dts_usec)
+{
+	struct encoder_packet src = {0};
+	struct encoder_packet pkt;
+
+	src.data = payload;
+	src.size = AUDIO_SIZE;
+	src.type = OBS_ENCODER_VIDEO;
+	src.keyframe = keyframe;
+	src.dts_usec = dts_usec;
+
+	obs_duplicate_encoder_packet(&pkt, &src);
+	replay_store_purge(store, 0, max_time, &pkt);
+	replay_store_push(store, &pkt);
+	obs_encoder_packet_release(&pkt);
+}
+
+static inline struct encoder_packet *first_packet(struct replay_store *store)
+{
+	return store->segments.array[0]->packets.array;
+}
+
+static void purge_test(void **state)
+{
+	const int64_t max_size = 10 * 1024 * 1024;
+	DARRAY(struct replay_segment *) segments = {0};
+	struct replay_store store;
+
+	replay_store_init(&store, 0, NULL);
+
+	for (int i = 0; i < 20; i++)
+		push_gop(&store, max_size);
+
+	assert_true(store.size <= max_size);
+	assert_true(store.segments.num > 2);
+	assert_int_equal(first_packet(&store)->type, OBS_ENCODER_VIDEO);
+	assert_true(first_packet(&store)->keyframe);
+
+	/* saving in the middle of a group of pictures splits it, the rest
+	 * of it goes with the segment before it when that is purged */
+	push_packet(&store, max_size, OBS_ENCODER_VIDEO, true, KEYFRAME_SIZE);
+	replay_store_get_segments(&store, &segments.da);
+	push_packet(&store, max_size, OBS_ENCODER_VIDEO, false, FRAME_SIZE);
+	assert_false(store.cur->starts_keyframe);
+
+	for (int i = 0; i < 20; i++)
+		push_gop(&store, max_size);
+
+	assert_true(first_packet(&store)->keyframe);
+
+	/* the saved segments are still there */
+	for (size_t i = 0; i < segments.num; i++) {
+		assert_true(segments.array[i]->packets.num > 0);
+		replay_segment_release(segments.array[i]);
+	}
+
+	da_free(segments);
+	replay_store_free(&store);
+}
+
+/* a size limit below two groups of pictures keeps only the one being
+ * written */
+static void small_size_test(void **state)
+{
+	const int64_t max_size = 3 * 1024 * 1024;
+	struct replay_store store;
+
+	replay_store_init(&store, 0, NULL);
+
+	for (int i = 0; i < 5; i++)
+		push_gop(&store, max_size);
+
+	assert_true(store.size <= max_size);
+	assert_int_equal(store.segments.num, 1);
+	assert_true(first_packet(&store)->keyframe);
+
+	replay_store_free(&store);
+}
+
+/* low bitrate segments are ended by their duration instead of their size, so
+ * the replay is at most about one segment shorter than the maximum time */
+static void duration_test(void **state)
+{
+	const int64_t frame_usec = 33333;
+	const int64_t gop_usec = 15 * frame_usec;
+	const int64_t max_time = 5000000;
+	struct replay_store store;
+	int64_t last = 0;
+	int64_t duration;
+
+	replay_store_init(&store, 0, NULL);
+
+	/* 10 seconds at 30 fps with a keyframe every half second, segments
+	 * end at the first keyframe after a second */
+	for (int i = 0; i < 300; i++) {
+		last = i * frame_usec;
+		push_timed(&store, max_time, i % 15 == 0, last);
+	}
+
+	for (size_t i = 0; i + 1 < store.segments.num; i++) {
+		struct replay_segment *segment = store.segments.array[i];
+		struct encoder_packet *first = segment->packets.array;
+		struct encoder_packet *end = first + segment->packets.num - 1;
+
+		assert_true(end->dts_usec - first->dts_usec <
+			    REPLAY_SEGMENT_USEC + gop_usec);
+	}
+
+	duration = last - first_packet(&store)->dts_usec;
+	assert_true(duration <= max_time);
+	assert_true(duration > max_time - REPLAY_SEGMENT_USEC - gop_usec);
+
+	replay_store_free(&store);
+}
+
+static void spill_test(void **state)
+{
+	const int64_t max_mem = 4 * 1024 * 1024;
+	DARRAY(struct replay_segment *) segments = {0};
+	struct replay_store store;
+	char *spill_path = NULL;
+	size_t spilled = 0;
+
+	replay_store_init(&store, max_mem, "replay_store_test");
+
+	for (int i = 0; i < 10; i++)
+		push_gop(&store, 0);
+
+	replay_store_finish_spills(&store);
+
+	/* only the segment being written can be over the limit */
+	assert_true(store.mem_size <= max_mem + store.cur->size);
+
+	replay_store_get_segments(&store, &segments.da);
+	assert_int_equal(segments.num, store.segments.num);
+
+	int64_t expected = first_packet(&store)->pts;
+
+	for (size_t i = 0; i < segments.num; i++) {
+		struct replay_segment *segment = segments.array[i];
+		struct replay_segment_map map;
+
+		assert_true(replay_segment_map(segment, &map));
+
+		for (size_t j = 0; j < segment->packets.num; j++) {
+			struct encoder_packet pkt;
+
+			replay_segment_get_packet(segment, &map, j, &pkt);
+			assert_int_equal(pkt.pts, expected);
+			assert_int_equal(pkt.data[0], (uint8_t)expected);
+			expected++;
+		}
+
+		replay_segment_unmap(&map);
+
+		if (segment->spilled) {
+			spill_path = segment->spill_path;
+			assert_true(os_file_exists(spill_path));
+			spilled++;
+		}
+	}
+
+	assert_true(spilled > 0);
+
+	for (size_t i = 0; i < segments.num; i++)
+		replay_segment_release(segments.array[i]);
+	da_free(segments);
+
+	/* the files go away with the last reference */
+	spill_path = bstrdup(spill_path);
+	replay_store_free(&store);
+	assert_false(os_file_exists(spill_path));
+
+	bfree(spill_path);
+	os_rmdir("replay_store_test");
+}
+
+/* segments that a save references while they are written keep their packets,
+ * the save may already be reading them */
+static void spill_saved_test(void **state)
+{
+	const int64_t max_mem = 4 * 1024 * 1024;
+	DARRAY(struct replay_segment *) segments = {0};
+	DARRAY(bool) spilling = {0};
+	struct replay_store store;
+	size_t saved = 0;
+
+	replay_store_init(&store, max_mem, "replay_store_test");
+
+	for (int i = 0; i < 10; i++)
+		push_gop(&store, 0);
+
+	replay_store_get_segments(&store, &segments.da);
+
+	for (size_t i = 0; i < segments.num; i++)
+		da_push_back(spilling, &segments.array[i]->spilling);
+
+	replay_store_finish_spills(&store);
+
+	for (size_t i = 0; i < segments.num; i++) {
+		struct replay_segment *segment = segments.array[i];
+
+		if (!spilling.array[i])
+			continue;
+
+		assert_false(segment->spilled);
+		assert_false(segment->spilling);
+		assert_non_null(segment->packets.array[0].data);
+		saved++;
+	}
+
+	assert_true(saved > 0);
+
+	for (size_t i = 0; i < segments.num; i++)
+		replay_segment_release(segments.array[i]);
+	da_free(segments);
+	da_free(spilling);
+
+	/* spilled when the next segment ends after the save is done */
+	push_gop(&store, 0);
+	push_gop(&store, 0);
+	replay_store_finish_spills(&store);
+	assert_true(store.mem_size <= max_mem + store.cur->size);
+
+	replay_store_free(&store);
+	os_rmdir("replay_store_test");
+}
+
+static int setup(void **state)
+{
+	return obs_startup("en-US", NULL, NULL) ? 0 : -1;
+}
+
+static int teardown(void **state)
+{
+	obs_shutdown();
+	return 0;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(purge_test),
+		cmocka_unit_test(small_size_test),
+		cmocka_unit_test(duration_test),
+		cmocka_unit_test(spill_test),
+		cmocka_unit_test(spill_saved_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
@@ -0,0 +1,163 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <obs.h>
+#include <util/darray.h>
+
+#include "librtmp/rtmp.h"
+#include "flv-mux.h"
+
+static uint8_t payload[10000];
+
+struct wire {
+	RTMP rtmp;
+	int fds[2];
+};
+
+static void wire_init(struct wire *wire)
+{
+	assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, wire->fds), 0);
+	fcntl(wire->fds[1], F_SETFL, O_NONBLOCK);
+
+	RTMP_Init(&wire->rtmp);
+	wire->rtmp.m_sb.sb_socket = wire->fds[0];
+	wire->rtmp.Link.nStreams = 1;
+	wire->rtmp.Link.streams[0].id = 1;
+}
+
+static void wire_read(struct wire *wire, struct darray *out)
+{
+	uint8_t buf[4096];
+	ssize_t ret;
+
+	while ((ret = read(wire->fds[1], buf, sizeof(buf))) > 0)
+		darray_push_back_array(1, out, buf, (size_t)ret);
+}
+
+static void wire_free(struct wire *wire)
+{
+	wire->rtmp.m_sb.sb_socket = -1;
+	RTMP_Close(&wire->rtmp);
+	close(wire->fds[0]);
+	close(wire->fds[1]);
+}
+
+static void make_packet(struct encoder_packet *pkt, enum obs_encoder_type type,
+			size_t size, int64_t dts)
+{
+	memset(pkt, 0, sizeof(*pkt));
+	pkt->type = type;
+	pkt->data = size ? payload : NULL;
+	pkt->size = size;
+	pkt->pts = dts;
+	pkt->dts = dts;
+	pkt->timebase_num = 1;
+	pkt->timebase_den = 1000;
+	pkt->keyframe = dts == 0;
+}
+
+/* muxes every packet into its own FLV tag, what rtmp-stream did before
+ * packets were batched */
+static void send_muxed(struct wire *wire, struct encoder_packet *packets,
+		       size_t num)
+{
+	for (size_t i = 0; i < num; i++) {
+		uint8_t *data;
+		size_t size;
+
+		flv_packet_mux(&packets[i], 0, &data, &size, false);
+		assert_true(RTMP_Write(&wire->rtmp, (char *)data, (int)size,
+				       0) >= 0);
+		bfree(data);
+	}
+}
+
+static void send_batched(struct wire *wire, struct encoder_packet *packets,
+			 size_t num)
+{
+	RTMPBatch *batch = bzalloc(sizeof(*batch));
+
+	for (size_t i = 0; i < num; i++) {
+		struct flv_tag tag;
+
+		/* like batch_packet in rtmp-stream */
+		if (!packets[i].data || !packets[i].size)
+			continue;
+
+		flv_packet_tag(&packets[i], 0, &tag, false);
+		assert_true(RTMP_BatchWrite(&wire->rtmp, batch, 0, tag.type,
+					    tag.timestamp,
+					    (const char *)tag.prefix,
+					    (int)tag.prefix_size,
+					    (const char *)packets[i].data,
+					    (int)packets[i].size));
+	}
+
+	assert_true(RTMP_BatchFlush(&wire->rtmp, batch));
+	RTMP_BatchFree(batch);
+	bfree(batch);
+}
+
+/* batching sends the same bytes as muxing every packet into its own tag,
+ * zero-size packets are left out by both */
+static void empty_packet_test(void **state)
+{
+	struct encoder_packet packets[5];
+	struct encoder_packet non_empty[3];
+	struct wire muxed, batched, non_empty_muxed;
+	DARRAY(uint8_t) muxed_bytes = {0};
+	DARRAY(uint8_t) batched_bytes = {0};
+	DARRAY(uint8_t) non_empty_bytes = {0};
+
+	make_packet(&packets[0], OBS_ENCODER_VIDEO, sizeof(payload), 0);
+	make_packet(&packets[1], OBS_ENCODER_AUDIO, 300, 10);
+	make_packet(&packets[2], OBS_ENCODER_VIDEO, 0, 33);
+	make_packet(&packets[3], OBS_ENCODER_AUDIO, 0, 43);
+	make_packet(&packets[4], OBS_ENCODER_VIDEO, 500, 66);
+
+	non_empty[0] = packets[0];
+	non_empty[1] = packets[1];
+	non_empty[2] = packets[4];
+
+	wire_init(&muxed);
+	wire_init(&batched);
+	wire_init(&non_empty_muxed);
+
+	send_muxed(&muxed, packets, 5);
+	send_batched(&batched, packets, 5);
+	send_muxed(&non_empty_muxed, non_empty, 3);
+
+	wire_read(&muxed, &muxed_bytes.da);
+	wire_read(&batched, &batched_bytes.da);
+	wire_read(&non_empty_muxed, &non_empty_bytes.da);
+
+	assert_true(muxed_bytes.num > sizeof(payload) + 300 + 500);
+	assert_int_equal(batched_bytes.num, muxed_bytes.num);
+	assert_memory_equal(batched_bytes.array, muxed_bytes.array,
+			    muxed_bytes.num);
+
+	assert_int_equal(non_empty_bytes.num, muxed_bytes.num);
+	assert_memory_equal(non_empty_bytes.array, muxed_bytes.array,
+			    muxed_bytes.num);
+
+	da_free(muxed_bytes);
+	da_free(batched_bytes);
+	da_free(non_empty_bytes);
+	wire_free(&muxed);
+	wire_free(&batched);
+	wire_free(&non_empty_muxed);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(empty_packet_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
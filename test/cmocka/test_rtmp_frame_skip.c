@@ -0,0 +1,523 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <util/circlebuf.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#include <obs-frame-skip.h>
+#include "rtmp-frame-skip.h"
+
+/* 60 fps of 10 KB frames (4.8 Mbps) into a link that takes 2.4 Mbps */
+#define FRAME_NS 16666667ULL
+#define FRAME_USEC 16667LL
+#define FRAME_SIZE 10000
+#define KEYFRAME_INTERVAL 120
+#define RUN_FRAMES 180
+#define THROTTLE_BYTES_PER_SEC 300000ULL
+#define READ_CHUNK 2048
+
+/* frames the encoder holds before the first packet comes out */
+#define ENCODER_DELAY 10
+
+#define DROP_THRESHOLD_USEC 700000LL
+
+struct test_packet {
+	uint64_t capture_ts;
+	int64_t dts_usec;
+	bool keyframe;
+};
+
+struct stream_test {
+	bool frame_skip_enabled;
+	uint32_t frame_skip;
+
+	/* packets waiting to be sent, like in rtmp-stream */
+	pthread_mutex_t mutex;
+	struct circlebuf packets;
+	os_sem_t *send_sem;
+	volatile bool stop;
+	int fds[2];
+
+	/* frames in the encoder and its skip state, like in obs-encoder */
+	struct circlebuf encoder;
+	uint64_t skip_count;
+	uint64_t last_ts;
+	int64_t pts;
+
+	int encoded;
+	int skipped;
+	int dropped;
+
+	int received;
+	uint64_t total_latency;
+	uint64_t max_latency;
+};
+
+static bool write_all(int fd, const void *vdata, size_t size)
+{
+	const uint8_t *data = vdata;
+
+	while (size) {
+		ssize_t ret = write(fd, data, size);
+		if (ret <= 0)
+			return false;
+		data += ret;
+		size -= (size_t)ret;
+	}
+
+	return true;
+}
+
+static void receive_packet(struct stream_test *test,
+			   struct test_packet *packet, uint64_t now)
+{
+	uint64_t latency = now - packet->capture_ts;
+
+	test->total_latency += latency;
+	if (latency > test->max_latency)
+		test->max_latency = latency;
+	test->received++;
+}
+
+static void *send_thread(void *data)
+{
+	struct stream_test *test = data;
+	uint8_t payload[FRAME_SIZE] = {0};
+
+	while (os_sem_wait(test->send_sem) == 0) {
+		struct test_packet packet;
+
+		pthread_mutex_lock(&test->mutex);
+		if (!test->packets.size) {
+			pthread_mutex_unlock(&test->mutex);
+			if (os_atomic_load_bool(&test->stop))
+				break;
+			continue;
+		}
+		circlebuf_pop_front(&test->packets, &packet, sizeof(packet));
+		pthread_mutex_unlock(&test->mutex);
+
+		memcpy(payload, &packet, sizeof(packet));
+		if (!write_all(test->fds[0], payload, sizeof(payload)))
+			break;
+	}
+
+	close(test->fds[0]);
+	return NULL;
+}
+
+/* the other end of the connection, it reads no faster than the throttled
+ * rate and measures the latency from capture to arrival */
+static void *receive_thread(void *data)
+{
+	struct stream_test *test = data;
+	uint8_t packet[FRAME_SIZE];
+	uint64_t start = os_gettime_ns();
+	uint64_t total = 0;
+	size_t pos = 0;
+
+	for (;;) {
+		size_t size = FRAME_SIZE - pos;
+		ssize_t ret;
+
+		if (size > READ_CHUNK)
+			size = READ_CHUNK;
+
+		ret = read(test->fds[1], packet + pos, size);
+		if (ret <= 0)
+			break;
+
+		pos += (size_t)ret;
+		total += (uint64_t)ret;
+
+		if (pos == FRAME_SIZE) {
+			struct test_packet info;
+
+			memcpy(&info, packet, sizeof(info));
+			receive_packet(test, &info, os_gettime_ns());
+			pos = 0;
+		}
+
+		os_sleepto_ns(start + total * 1000000000ULL /
+					      THROTTLE_BYTES_PER_SEC);
+	}
+
+	close(test->fds[1]);
+	return NULL;
+}
+
+static inline size_t num_packets(struct stream_test *test)
+{
+	return test->packets.size / sizeof(struct test_packet);
+}
+
+static int64_t buffer_duration_usec(struct stream_test *test, int64_t last)
+{
+	size_t count = num_packets(test);
+
+	for (size_t i = 0; i < count; i++) {
+		struct test_packet *cur = circlebuf_data(
+			&test->packets, i * sizeof(struct test_packet));
+		if (!cur->keyframe)
+			return last - cur->dts_usec;
+	}
+
+	return 0;
+}
+
+/* what rtmp-stream does with every video packet in check_to_drop_frames:
+ * decide about skipping frames in the encoder, then drop buffered packets
+ * past the threshold */
+static void add_packet(struct stream_test *test, struct test_packet *packet)
+{
+	struct circlebuf kept = {0};
+	int64_t duration;
+
+	pthread_mutex_lock(&test->mutex);
+
+	duration = buffer_duration_usec(test, packet->dts_usec);
+
+	if (test->frame_skip_enabled) {
+		uint32_t frames = frame_skip_in_flight(
+			0, (long)(test->encoder.size /
+				  sizeof(struct test_packet)));
+		int64_t in_flight =
+			frame_skip_in_flight_usec(frames, FRAME_NS);
+
+		test->frame_skip =
+			num_packets(test) < 5
+				? 0
+				: frame_skip_interval(test->frame_skip,
+						      duration, in_flight,
+						      DROP_THRESHOLD_USEC);
+	}
+
+	if (num_packets(test) >= 5 && duration > DROP_THRESHOLD_USEC) {
+		while (test->packets.size) {
+			struct test_packet cur;
+
+			circlebuf_pop_front(&test->packets, &cur, sizeof(cur));
+			if (cur.keyframe)
+				circlebuf_push_back(&kept, &cur, sizeof(cur));
+			else
+				test->dropped++;
+		}
+
+		circlebuf_free(&test->packets);
+		test->packets = kept;
+	}
+
+	circlebuf_push_back(&test->packets, packet, sizeof(*packet));
+	pthread_mutex_unlock(&test->mutex);
+
+	os_sem_post(test->send_sem);
+}
+
+/* what the encoder does with every raw frame in receive_video */
+static void encode_frame(struct stream_test *test, uint64_t ts)
+{
+	struct test_packet frame;
+	uint32_t interval;
+
+	pthread_mutex_lock(&test->mutex);
+	interval = test->frame_skip;
+	pthread_mutex_unlock(&test->mutex);
+
+	if (frame_skip_check(&test->skip_count, (long)interval)) {
+		test->skipped++;
+		return;
+	}
+
+	test->pts += frame_skip_gap(&test->last_ts, ts, FRAME_NS);
+
+	frame.capture_ts = ts;
+	frame.dts_usec = test->pts++ * FRAME_USEC;
+
+	/* the encoder counts its keyframe interval in encoded frames */
+	frame.keyframe = test->encoded++ % KEYFRAME_INTERVAL == 0;
+
+	circlebuf_push_back(&test->encoder, &frame, sizeof(frame));
+
+	if (test->encoder.size > ENCODER_DELAY * sizeof(frame)) {
+		struct test_packet packet;
+
+		circlebuf_pop_front(&test->encoder, &packet, sizeof(packet));
+		add_packet(test, &packet);
+	}
+}
+
+static void init_stream(struct stream_test *test, bool frame_skip)
+{
+	memset(test, 0, sizeof(*test));
+	test->frame_skip_enabled = frame_skip;
+
+	pthread_mutex_init(&test->mutex, NULL);
+	os_sem_init(&test->send_sem, 0);
+}
+
+static void free_stream(struct stream_test *test, const char *type)
+{
+	print_message("%s %s: %d encoded, %d skipped before encoding, "
+		      "%d dropped after encoding, latency mean %.1fms, "
+		      "max %.1fms\n",
+		      type,
+		      test->frame_skip_enabled ? "frame skip" : "drop only ",
+		      test->encoded, test->skipped, test->dropped,
+		      test->received ? (double)test->total_latency /
+					       test->received / 1000000.0
+				     : 0.0,
+		      (double)test->max_latency / 1000000.0);
+
+	circlebuf_free(&test->packets);
+	circlebuf_free(&test->encoder);
+	os_sem_destroy(test->send_sem);
+	pthread_mutex_destroy(&test->mutex);
+}
+
+/* sends over a link modelled in frame time, so that the result does not
+ * depend on how the test is scheduled */
+static void run_simulated(struct stream_test *test, bool frame_skip)
+{
+	const uint64_t frame_bytes =
+		THROTTLE_BYTES_PER_SEC * FRAME_NS / 1000000000ULL;
+	uint64_t budget = 0;
+
+	init_stream(test, frame_skip);
+
+	for (int i = 0; i < RUN_FRAMES; i++) {
+		uint64_t now = (uint64_t)(i + 1) * FRAME_NS;
+
+		encode_frame(test, now);
+
+		budget += frame_bytes;
+		while (budget >= FRAME_SIZE && test->packets.size) {
+			struct test_packet packet;
+
+			circlebuf_pop_front(&test->packets, &packet,
+					    sizeof(packet));
+			receive_packet(test, &packet, now);
+			budget -= FRAME_SIZE;
+		}
+
+		/* an idle link does not save up bandwidth */
+		if (!test->packets.size && budget > FRAME_SIZE)
+			budget = FRAME_SIZE;
+	}
+
+	free_stream(test, "simulated");
+}
+
+static void run_socket(struct stream_test *test, bool frame_skip)
+{
+	pthread_t send, receive;
+	uint64_t start;
+	int buf_size = 8192;
+
+	init_stream(test, frame_skip);
+
+	assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, test->fds), 0);
+	setsockopt(test->fds[0], SOL_SOCKET, SO_SNDBUF, &buf_size,
+		   sizeof(buf_size));
+	setsockopt(test->fds[1], SOL_SOCKET, SO_RCVBUF, &buf_size,
+		   sizeof(buf_size));
+
+	pthread_create(&send, NULL, send_thread, test);
+	pthread_create(&receive, NULL, receive_thread, test);
+
+	start = os_gettime_ns();
+
+	for (int i = 0; i < RUN_FRAMES; i++) {
+		os_sleepto_ns(start + (uint64_t)i * FRAME_NS);
+		encode_frame(test, os_gettime_ns());
+	}
+
+	os_atomic_set_bool(&test->stop, true);
+	os_sem_post(test->send_sem);
+	pthread_join(send, NULL);
+	pthread_join(receive, NULL);
+
+	free_stream(test, "socket   ");
+}
+
+static void frame_skip_interval_test(void **state)
+{
+	const int64_t threshold = DROP_THRESHOLD_USEC;
+
+	assert_int_equal(frame_skip_interval(0, 0, 0, threshold), 0);
+
+	/* frames in the encoder count as buffered */
+	assert_int_equal(frame_skip_interval(0, threshold / 4, 0, threshold),
+			 0);
+	assert_int_equal(frame_skip_interval(0, threshold / 4, threshold / 4,
+					     threshold),
+			 FRAME_SKIP_HALF);
+	assert_int_equal(frame_skip_interval(0, threshold, 0, threshold),
+			 FRAME_SKIP_QUARTER);
+
+	/* frames are encoded again only well below the threshold */
+	assert_int_equal(frame_skip_interval(FRAME_SKIP_QUARTER,
+					     threshold / 2, 0, threshold),
+			 FRAME_SKIP_QUARTER);
+	assert_int_equal(frame_skip_interval(FRAME_SKIP_HALF, threshold / 3, 0,
+					     threshold),
+			 FRAME_SKIP_HALF);
+	assert_int_equal(frame_skip_interval(FRAME_SKIP_HALF, threshold / 5, 0,
+					     threshold),
+			 0);
+}
+
+static void skip_check_test(void **state)
+{
+	const bool quarter[] = {false, true, true, true, false, true, true};
+	const bool half[] = {false, true, false, true, false};
+	uint64_t count = 0;
+
+	for (size_t i = 0; i < sizeof(quarter) / sizeof(quarter[0]); i++)
+		assert_int_equal(frame_skip_check(&count, FRAME_SKIP_QUARTER),
+				 quarter[i]);
+
+	/* encoding every frame again starts the pattern over */
+	assert_false(frame_skip_check(&count, 0));
+	assert_int_equal(count, 0);
+	assert_false(frame_skip_check(&count, 1));
+
+	for (size_t i = 0; i < sizeof(half) / sizeof(half[0]); i++)
+		assert_int_equal(frame_skip_check(&count, FRAME_SKIP_HALF),
+				 half[i]);
+}
+
+static void skip_merge_test(void **state)
+{
+	long interval = frame_skip_merge(0, FRAME_SKIP_QUARTER, true);
+	assert_int_equal(interval, FRAME_SKIP_QUARTER);
+
+	interval = frame_skip_merge(interval, FRAME_SKIP_HALF, false);
+	assert_int_equal(interval, FRAME_SKIP_HALF);
+	interval = frame_skip_merge(interval, FRAME_SKIP_QUARTER, false);
+	assert_int_equal(interval, FRAME_SKIP_HALF);
+
+	/* an output that isn't congested stops skipping altogether */
+	interval = frame_skip_merge(interval, 0, false);
+	assert_int_equal(interval, 0);
+}
+
+static void frame_gap_test(void **state)
+{
+	const uint64_t start = 1000 * FRAME_NS;
+	uint64_t last_ts = 0;
+	uint64_t ts = start;
+
+	assert_int_equal(frame_skip_gap(&last_ts, ts, FRAME_NS), 0);
+	ts += FRAME_NS;
+	assert_int_equal(frame_skip_gap(&last_ts, ts, FRAME_NS), 0);
+	ts += 4 * FRAME_NS;
+	assert_int_equal(frame_skip_gap(&last_ts, ts, FRAME_NS), 3);
+
+	/* timestamps jitter by less than half a frame */
+	ts += FRAME_NS + FRAME_NS / 3;
+	assert_int_equal(frame_skip_gap(&last_ts, ts, FRAME_NS), 0);
+	ts += 2 * FRAME_NS - FRAME_NS / 3;
+	assert_int_equal(frame_skip_gap(&last_ts, ts, FRAME_NS), 1);
+
+	assert_int_equal(frame_skip_gap(&last_ts, ts - FRAME_NS, FRAME_NS), 0);
+	assert_int_equal(frame_skip_gap(&last_ts, ts, 0), 0);
+
+	/* a pause resets the last timestamp, the paused time is no gap */
+	last_ts = 0;
+	assert_int_equal(frame_skip_gap(&last_ts, ts + 100 * FRAME_NS,
+					FRAME_NS),
+			 0);
+}
+
+/* skipped frames are kept in the pts, so every encoded frame keeps the pts of
+ * its capture time */
+static void skipped_pts_test(void **state)
+{
+	uint64_t count = 0;
+	uint64_t last_ts = 0;
+	int64_t pts = 0;
+	int encoded = 0;
+
+	for (int i = 0; i < 40; i++) {
+		long interval = i < 20 ? FRAME_SKIP_QUARTER : FRAME_SKIP_HALF;
+
+		if (frame_skip_check(&count, interval))
+			continue;
+
+		pts += frame_skip_gap(&last_ts, (uint64_t)(i + 1) * FRAME_NS,
+				      FRAME_NS);
+		assert_int_equal(pts, i);
+		pts++;
+		encoded++;
+	}
+
+	assert_int_equal(encoded, 5 + 10);
+}
+
+static void in_flight_test(void **state)
+{
+	assert_int_equal(frame_skip_in_flight(3, 2), 5);
+	assert_int_equal(frame_skip_in_flight(0, 0), 0);
+
+	/* packets of frames passed to the encoder before it was started */
+	assert_int_equal(frame_skip_in_flight(0, -2), 0);
+
+	assert_int_equal(frame_skip_in_flight_usec(6, FRAME_NS),
+			 6 * (int64_t)(FRAME_NS / 1000));
+	assert_int_equal(frame_skip_in_flight_usec(0, FRAME_NS), 0);
+}
+
+static void congestion_test(void **state)
+{
+	struct stream_test drop_only, frame_skip;
+
+	run_simulated(&drop_only, false);
+	run_simulated(&frame_skip, true);
+
+	/* the congested stream only drops encoded frames without skipping,
+	 * skipping before encoding saves most of that work */
+	assert_int_equal(drop_only.encoded, RUN_FRAMES);
+	assert_int_equal(drop_only.skipped, 0);
+	assert_true(drop_only.dropped > 0);
+
+	assert_true(frame_skip.skipped > 0);
+	assert_int_equal(frame_skip.encoded + frame_skip.skipped, RUN_FRAMES);
+	assert_true(frame_skip.dropped < drop_only.dropped);
+	assert_true(frame_skip.max_latency < drop_only.max_latency);
+}
+
+/* the same against a throttled local socket, only prints the results because
+ * they depend on scheduling */
+static void socket_benchmark_test(void **state)
+{
+	struct stream_test drop_only, frame_skip;
+
+	run_socket(&drop_only, false);
+	run_socket(&frame_skip, true);
+}
+
+int main(int argc, char *argv[])
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(frame_skip_interval_test),
+		cmocka_unit_test(skip_check_test),
+		cmocka_unit_test(skip_merge_test),
+		cmocka_unit_test(frame_gap_test),
+		cmocka_unit_test(skipped_pts_test),
+		cmocka_unit_test(in_flight_test),
+		cmocka_unit_test(congestion_test),
+	};
+	const struct CMUnitTest benchmarks[] = {
+		cmocka_unit_test(socket_benchmark_test),
+	};
+
+	if (argc > 1 && strcmp(argv[1], "--benchmark") == 0)
+		return cmocka_run_group_tests(benchmarks, NULL, NULL);
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,152 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs.h>
+
+static const char *save_test_get_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Save Test";
+}
+
+static void *save_test_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void save_test_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static struct obs_source_info save_test = {
+	.id = "save_test",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.get_name = save_test_get_name,
+	.create = save_test_create,
+	.destroy = save_test_destroy,
+};
+
+/* returns the saved data of a source without a new reference, it is still
+ * held by the array */
+static obs_data_t *find_saved(obs_data_array_t *array, const char *name)
+{
+	size_t count = obs_data_array_count(array);
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *data = obs_data_array_item(array, i);
+		obs_data_release(data);
+
+		if (strcmp(obs_data_get_string(data, "name"), name) == 0)
+			return data;
+	}
+
+	return NULL;
+}
+
+static void cache_test(void **state)
+{
+	obs_source_t *source1 =
+		obs_source_create("save_test", "one", NULL, NULL);
+	obs_source_t *source2 =
+		obs_source_create("save_test", "two", NULL, NULL);
+	obs_data_t *settings = obs_data_create();
+	obs_data_array_t *first, *second, *third;
+	obs_data_t *saved_settings;
+
+	first = obs_save_sources();
+	second = obs_save_sources();
+
+	assert_non_null(find_saved(first, "one"));
+	assert_ptr_equal(find_saved(first, "one"), find_saved(second, "one"));
+	assert_ptr_equal(find_saved(first, "two"), find_saved(second, "two"));
+
+	obs_data_set_int(settings, "value", 5);
+	obs_source_update(source1, settings);
+
+	third = obs_save_sources();
+	assert_ptr_not_equal(find_saved(second, "one"),
+			     find_saved(third, "one"));
+	assert_ptr_equal(find_saved(second, "two"), find_saved(third, "two"));
+
+	/* the saved data is a copy of the settings */
+	saved_settings = obs_data_get_obj(find_saved(third, "one"), "settings");
+	assert_int_equal(obs_data_get_int(saved_settings, "value"), 5);
+	assert_ptr_not_equal(saved_settings, settings);
+
+	obs_data_set_int(settings, "value", 6);
+	obs_source_update(source1, settings);
+	assert_int_equal(obs_data_get_int(saved_settings, "value"), 5);
+
+	obs_data_release(saved_settings);
+	obs_data_array_release(first);
+	obs_data_array_release(second);
+	obs_data_array_release(third);
+	obs_data_release(settings);
+	obs_source_remove(source1);
+	obs_source_remove(source2);
+	obs_source_release(source1);
+	obs_source_release(source2);
+}
+
+static void scene_test(void **state)
+{
+	obs_scene_t *scene = obs_scene_create("scene");
+	obs_source_t *scene_source = obs_scene_get_source(scene);
+	obs_source_t *source =
+		obs_source_create("save_test", "item", NULL, NULL);
+	obs_sceneitem_t *item = obs_scene_add(scene, source);
+	obs_data_array_t *first, *second, *third;
+	struct vec2 pos = {10.0f, 20.0f};
+
+	first = obs_save_sources();
+
+	obs_sceneitem_set_pos(item, &pos);
+	second = obs_save_sources();
+	assert_ptr_not_equal(find_saved(first, "scene"),
+			     find_saved(second, "scene"));
+	assert_ptr_equal(find_saved(first, "item"), find_saved(second, "item"));
+
+	/* items are saved with the name of their source */
+	obs_source_set_name(source, "renamed");
+	third = obs_save_sources();
+	assert_ptr_not_equal(find_saved(second, "scene"),
+			     find_saved(third, "scene"));
+	assert_non_null(find_saved(third, "renamed"));
+
+	obs_data_array_release(first);
+	obs_data_array_release(second);
+	obs_data_array_release(third);
+	obs_source_remove(source);
+	obs_source_remove(scene_source);
+	obs_source_release(source);
+	obs_scene_release(scene);
+}
+
+static int setup(void **state)
+{
+	if (!obs_startup("en-US", NULL, NULL))
+		return -1;
+
+	obs_register_source(&save_test);
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	obs_shutdown();
+	return 0;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(cache_test),
+		cmocka_unit_test(scene_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
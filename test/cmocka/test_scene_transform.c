@@ -0,0 +1,193 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs.h>
+
+#define SOURCE_CX 100
+#define SOURCE_CY 50
+
+/* reports twice the width once set */
+static obs_source_t *wide_source = NULL;
+
+/* number of item_transform signals of the scene */
+static long transforms = 0;
+
+static const char *transform_test_get_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Transform Test";
+}
+
+static void *transform_test_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void transform_test_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static uint32_t transform_test_get_width(void *data)
+{
+	return data == wide_source ? SOURCE_CX * 2 : SOURCE_CX;
+}
+
+static uint32_t transform_test_get_height(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return SOURCE_CY;
+}
+
+static struct obs_source_info transform_test = {
+	.id = "transform_test",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_VIDEO,
+	.get_name = transform_test_get_name,
+	.create = transform_test_create,
+	.destroy = transform_test_destroy,
+	.get_width = transform_test_get_width,
+	.get_height = transform_test_get_height,
+};
+
+/* the size of a group comes from the bounds of its items */
+static void group_bounds_test(void **state)
+{
+	obs_scene_t *scene = obs_scene_create_private("scene");
+	obs_source_t *source =
+		obs_source_create_private("transform_test", "source", NULL);
+	obs_sceneitem_t *items[2];
+	obs_sceneitem_t *group;
+	struct vec2 pos;
+
+	items[0] = obs_scene_add(scene, source);
+	items[1] = obs_scene_add(scene, source);
+
+	vec2_set(&pos, 10.0f, 20.0f);
+	obs_sceneitem_set_pos(items[0], &pos);
+	vec2_set(&pos, 200.0f, 100.0f);
+	obs_sceneitem_set_pos(items[1], &pos);
+
+	group = obs_scene_insert_group(scene, "group", items, 2);
+	assert_non_null(group);
+
+	obs_sceneitem_get_pos(group, &pos);
+	assert_true(close_float(pos.x, 10.0f, EPSILON));
+	assert_true(close_float(pos.y, 20.0f, EPSILON));
+
+	assert_int_equal(obs_source_get_width(obs_sceneitem_get_source(group)),
+			 200 + SOURCE_CX - 10);
+	assert_int_equal(obs_source_get_height(obs_sceneitem_get_source(group)),
+			 100 + SOURCE_CY - 20);
+
+	/* the items are moved to the top left corner of the group */
+	obs_sceneitem_get_pos(items[0], &pos);
+	assert_true(close_float(pos.x, 0.0f, EPSILON));
+	assert_true(close_float(pos.y, 0.0f, EPSILON));
+
+	obs_source_release(source);
+	obs_scene_release(scene);
+}
+
+static void item_transform(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(cd);
+	transforms++;
+}
+
+/* without a video context nothing is drawn and nothing is ticked, rendering
+ * only updates the item transforms */
+static long render_scene(obs_scene_t *scene)
+{
+	transforms = 0;
+	obs_source_video_render(obs_scene_get_source(scene));
+	return transforms;
+}
+
+/* the items of a scene are only checked when the scene was marked dirty */
+static void dirty_flag_test(void **state)
+{
+	obs_scene_t *scene = obs_scene_create_private("scene");
+	obs_source_t *sources[3];
+	obs_sceneitem_t *items[2];
+	signal_handler_t *sh;
+	struct obs_sceneitem_crop crop = {1, 2, 3, 4};
+	struct vec2 pos;
+
+	for (size_t i = 0; i < 3; i++)
+		sources[i] = obs_source_create_private("transform_test",
+						       "source", NULL);
+
+	items[0] = obs_scene_add(scene, sources[0]);
+	items[1] = obs_scene_add(scene, sources[1]);
+
+	sh = obs_source_get_signal_handler(obs_scene_get_source(scene));
+	signal_handler_connect(sh, "item_transform", item_transform, NULL);
+
+	/* added items are dirty */
+	assert_int_equal(render_scene(scene), 2);
+	assert_int_equal(render_scene(scene), 0);
+
+	/* a size change is only noticed by the size check of the next frame,
+	 * until then the items of the scene aren't checked at all */
+	wide_source = sources[0];
+	assert_int_equal(render_scene(scene), 0);
+
+	/* which marks every scene dirty, like removing a source does */
+	obs_source_remove(sources[2]);
+	assert_int_equal(render_scene(scene), 1);
+	assert_int_equal(render_scene(scene), 0);
+
+	/* crop is applied on the next render */
+	obs_sceneitem_set_crop(items[1], &crop);
+	assert_int_equal(render_scene(scene), 1);
+	assert_int_equal(render_scene(scene), 0);
+
+	/* the items of a scene are moved right away */
+	transforms = 0;
+	vec2_set(&pos, 10.0f, 20.0f);
+	obs_sceneitem_set_pos(items[0], &pos);
+	assert_int_equal(transforms, 1);
+	assert_int_equal(render_scene(scene), 0);
+
+	/* dirty items are checked along with the ones that changed size */
+	wide_source = sources[1];
+	obs_sceneitem_set_crop(items[0], &crop);
+	assert_int_equal(render_scene(scene), 2);
+
+	signal_handler_disconnect(sh, "item_transform", item_transform, NULL);
+	wide_source = NULL;
+
+	for (size_t i = 0; i < 3; i++)
+		obs_source_release(sources[i]);
+	obs_scene_release(scene);
+}
+
+static int setup(void **state)
+{
+	if (!obs_startup("en-US", NULL, NULL))
+		return -1;
+
+	obs_register_source(&transform_test);
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	obs_shutdown();
+	return 0;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(group_bounds_test),
+		cmocka_unit_test(dirty_flag_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
@@ -0,0 +1,475 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <media-io/video-io.h>
+#include <media-io/video-frame.h>
+
+#define TEST_FRAMES 120
+
+struct handoff_stats {
+	volatile long received;
+	uint64_t latency_ns[TEST_FRAMES];
+};
+
+static void receive_frame(void *param, struct video_data *frame)
+{
+	struct handoff_stats *stats = param;
+	long idx = os_atomic_load_long(&stats->received);
+
+	if (idx < TEST_FRAMES)
+		stats->latency_ns[idx] = os_gettime_ns() - frame->timestamp;
+	os_atomic_inc_long(&stats->received);
+}
+
+static void run_handoff(uint32_t fps)
+{
+	struct video_output_info ovi = {
+		.name = "test_video_io",
+		.format = VIDEO_FORMAT_BGRA,
+		.fps_num = fps,
+		.fps_den = 1,
+		.width = 64,
+		.height = 64,
+		.cache_size = 16,
+	};
+	struct handoff_stats *stats = bzalloc(sizeof(*stats));
+	video_t *video;
+
+	assert_int_equal(video_output_open(&video, &ovi), VIDEO_OUTPUT_SUCCESS);
+	assert_true(video_output_connect(video, NULL, receive_frame, stats));
+
+	uint64_t interval = video_output_get_frame_time(video);
+	uint64_t t = os_gettime_ns();
+
+	for (int i = 0; i < TEST_FRAMES; i++) {
+		struct video_frame frame;
+
+		t += interval;
+		os_sleepto_ns(t);
+
+		assert_true(video_output_lock_frame(video, &frame, 1,
+						    os_gettime_ns()));
+		video_output_unlock_frame(video);
+	}
+
+	for (int i = 0; i < 100; i++) {
+		if (os_atomic_load_long(&stats->received) >= TEST_FRAMES)
+			break;
+		os_sleep_ms(10);
+	}
+
+	video_output_disconnect(video, receive_frame, stats);
+
+	assert_int_equal(os_atomic_load_long(&stats->received), TEST_FRAMES);
+	assert_int_equal(video_output_get_skipped_frames(video), 0);
+
+	double mean = 0.0;
+	double jitter = 0.0;
+	uint64_t max = 0;
+
+	for (int i = 0; i < TEST_FRAMES; i++) {
+		mean += (double)stats->latency_ns[i];
+		if (stats->latency_ns[i] > max)
+			max = stats->latency_ns[i];
+	}
+	mean /= TEST_FRAMES;
+
+	for (int i = 0; i < TEST_FRAMES; i++) {
+		double diff = (double)stats->latency_ns[i] - mean;
+		jitter += diff < 0.0 ? -diff : diff;
+	}
+	jitter /= TEST_FRAMES;
+
+	print_message("%3u fps: handoff latency mean %.1fus, max %.1fus, "
+		      "jitter %.1fus\n",
+		      fps, mean / 1000.0, (double)max / 1000.0,
+		      jitter / 1000.0);
+
+	video_output_close(video);
+	bfree(stats);
+}
+
+static void handoff_60fps_test(void **state)
+{
+	run_handoff(60);
+}
+
+static void handoff_120fps_test(void **state)
+{
+	run_handoff(120);
+}
+
+static void handoff_240fps_test(void **state)
+{
+	run_handoff(240);
+}
+
+#define SLOW_FRAME_MS 40
+
+struct slow_input {
+	volatile long received;
+	volatile long overwritten;
+};
+
+/* takes longer than a frame, and checks that the frame is not reused while
+ * the callback still uses it */
+static void receive_slow_frame(void *param, struct video_data *frame)
+{
+	struct slow_input *slow = param;
+	uint8_t value = frame->data[0][0];
+
+	os_sleep_ms(SLOW_FRAME_MS);
+
+	if (frame->data[0][0] != value)
+		os_atomic_inc_long(&slow->overwritten);
+	os_atomic_inc_long(&slow->received);
+}
+
+static void run_queue(enum video_queue_policy policy, const char *name)
+{
+	struct video_output_info ovi = {
+		.name = "test_video_io",
+		.format = VIDEO_FORMAT_BGRA,
+		.fps_num = 60,
+		.fps_den = 1,
+		.width = 64,
+		.height = 64,
+		.cache_size = 16,
+	};
+	struct video_queue_info queue = {.size = 2, .policy = policy};
+	struct handoff_stats *stats = bzalloc(sizeof(*stats));
+	struct slow_input slow = {0};
+	struct video_queue_stats queue_stats;
+	video_t *video;
+
+	assert_int_equal(video_output_open(&video, &ovi), VIDEO_OUTPUT_SUCCESS);
+	assert_true(video_output_connect(video, NULL, receive_frame, stats));
+	assert_true(video_output_connect_queued(video, NULL, &queue,
+						receive_slow_frame, &slow));
+
+	uint64_t interval = video_output_get_frame_time(video);
+	uint64_t t = os_gettime_ns();
+
+	for (int i = 0; i < TEST_FRAMES; i++) {
+		struct video_frame frame;
+
+		t += interval;
+		os_sleepto_ns(t);
+
+		if (!video_output_lock_frame(video, &frame, 1,
+					     os_gettime_ns()))
+			continue;
+		frame.data[0][0] = (uint8_t)i;
+		video_output_unlock_frame(video);
+	}
+
+	/* done once nothing changed for longer than one slow frame */
+	uint64_t last_frames = 0;
+	int idle = 0;
+
+	for (int i = 0; i < 1000 && idle < 2 * SLOW_FRAME_MS / 10; i++) {
+		assert_true(video_output_get_queue_stats(
+			video, receive_slow_frame, &slow, &queue_stats));
+		if (!queue_stats.depth && queue_stats.frames == last_frames)
+			idle++;
+		else
+			idle = 0;
+
+		last_frames = queue_stats.frames;
+		os_sleep_ms(10);
+	}
+
+	video_output_disconnect(video, receive_slow_frame, &slow);
+	video_output_disconnect(video, receive_frame, stats);
+
+	assert_int_equal(os_atomic_load_long(&slow.overwritten), 0);
+	assert_int_equal(queue_stats.max_depth, 2);
+
+	if (policy != VIDEO_QUEUE_BLOCK) {
+		/* the other input is not held up by the slow one */
+		assert_int_equal(os_atomic_load_long(&stats->received),
+				 TEST_FRAMES);
+		assert_int_equal(video_output_get_skipped_frames(video), 0);
+		assert_true(queue_stats.dropped > 0);
+		assert_int_equal(queue_stats.frames + queue_stats.dropped,
+				 TEST_FRAMES);
+	} else {
+		assert_int_equal(queue_stats.dropped, 0);
+	}
+
+	print_message("%s: %llu frames, %llu dropped, %u skipped, blocked "
+		      "%.1fms, latency mean %.1fms, max %.1fms\n",
+		      name, (unsigned long long)queue_stats.frames,
+		      (unsigned long long)queue_stats.dropped,
+		      video_output_get_skipped_frames(video),
+		      (double)queue_stats.blocked_ns / 1000000.0,
+		      (double)queue_stats.avg_latency_ns / 1000000.0,
+		      (double)queue_stats.max_latency_ns / 1000000.0);
+
+	video_output_close(video);
+	bfree(stats);
+}
+
+static void queue_policy_test(void **state)
+{
+	run_queue(VIDEO_QUEUE_BLOCK, "block      ");
+	run_queue(VIDEO_QUEUE_DROP_OLDEST, "drop oldest");
+	run_queue(VIDEO_QUEUE_DROP_NEWEST, "drop newest");
+}
+
+struct reconnect_input {
+	video_t *video;
+	volatile long received;
+	volatile bool disconnect;
+	os_event_t *event;
+};
+
+/* disconnects itself like an encoder does on an encode error */
+static void receive_and_disconnect(void *param, struct video_data *frame)
+{
+	struct reconnect_input *input = param;
+
+	os_atomic_inc_long(&input->received);
+
+	if (os_atomic_load_bool(&input->disconnect)) {
+		os_atomic_set_bool(&input->disconnect, false);
+		video_output_disconnect(input->video, receive_and_disconnect,
+					input);
+	}
+
+	os_event_signal(input->event);
+}
+
+static void push_frame(video_t *video)
+{
+	struct video_frame frame;
+
+	assert_true(video_output_lock_frame(video, &frame, 1, os_gettime_ns()));
+	video_output_unlock_frame(video);
+}
+
+static void reconnect_test(void **state)
+{
+	struct video_output_info ovi = {
+		.name = "test_video_io",
+		.format = VIDEO_FORMAT_BGRA,
+		.fps_num = 60,
+		.fps_den = 1,
+		.width = 64,
+		.height = 64,
+		.cache_size = 16,
+	};
+	struct reconnect_input input = {0};
+
+	assert_int_equal(video_output_open(&input.video, &ovi),
+			 VIDEO_OUTPUT_SUCCESS);
+	assert_int_equal(os_event_init(&input.event, OS_EVENT_TYPE_AUTO), 0);
+
+	input.disconnect = true;
+	assert_true(video_output_connect_queued(input.video, NULL, NULL,
+						receive_and_disconnect,
+						&input));
+
+	push_frame(input.video);
+	assert_int_equal(os_event_wait(input.event), 0);
+
+	/* the video thread has not removed the input yet, connecting again
+	 * must replace it instead of being undone by the removal */
+	assert_true(video_output_connect_queued(input.video, NULL, NULL,
+						receive_and_disconnect,
+						&input));
+
+	push_frame(input.video);
+	assert_int_equal(os_event_timedwait(input.event, 1000), 0);
+	push_frame(input.video);
+	assert_int_equal(os_event_timedwait(input.event, 1000), 0);
+
+	assert_int_equal(os_atomic_load_long(&input.received), 3);
+
+	video_output_disconnect(input.video, receive_and_disconnect, &input);
+	video_output_close(input.video);
+	os_event_destroy(input.event);
+}
+
+#define LADDER_FRAMES 60
+#define LADDER_RUNGS 3
+#define LADDER_LUMA 100
+#define ENCODE_PASSES 2
+
+static const uint32_t ladder_sizes[LADDER_RUNGS][2] = {
+	{1920, 1080},
+	{1280, 720},
+	{852, 480},
+};
+
+struct rendition {
+	uint32_t width;
+	uint32_t height;
+	volatile long received;
+	volatile long bad_frames;
+	uint32_t checksum;
+	uint64_t latency_ns[LADDER_FRAMES];
+};
+
+/* stands in for an encoder, the work grows with the size of the frame */
+static void encode_frame(void *param, struct video_data *frame)
+{
+	struct rendition *rendition = param;
+	long idx = os_atomic_load_long(&rendition->received);
+	const uint8_t *center = frame->data[0] +
+				rendition->height / 2 * frame->linesize[0] +
+				rendition->width / 2;
+	uint32_t sum = 0;
+
+	/* the canvas is a single color, so every rung has to be too */
+	if (frame->data[0][0] != LADDER_LUMA || *center != LADDER_LUMA)
+		os_atomic_inc_long(&rendition->bad_frames);
+
+	for (int pass = 0; pass < ENCODE_PASSES; pass++) {
+		for (uint32_t y = 0; y < rendition->height; y++) {
+			const uint8_t *line =
+				frame->data[0] + y * frame->linesize[0];
+			for (uint32_t x = 0; x < rendition->width; x++)
+				sum = sum * 31 + line[x];
+		}
+	}
+
+	rendition->checksum += sum;
+
+	if (idx < LADDER_FRAMES)
+		rendition->latency_ns[idx] = os_gettime_ns() - frame->timestamp;
+	os_atomic_inc_long(&rendition->received);
+}
+
+static void run_ladder(bool renditions)
+{
+	struct video_output_info ovi = {
+		.name = "test_video_io",
+		.format = VIDEO_FORMAT_NV12,
+		.fps_num = 30,
+		.fps_den = 1,
+		.width = 1920,
+		.height = 1080,
+		.range = VIDEO_RANGE_PARTIAL,
+		.colorspace = VIDEO_CS_709,
+		.cache_size = 16,
+	};
+	struct rendition *rungs = bzalloc(sizeof(*rungs) * LADDER_RUNGS);
+	video_t *video;
+
+	assert_int_equal(video_output_open(&video, &ovi), VIDEO_OUTPUT_SUCCESS);
+
+	for (int i = 0; i < LADDER_RUNGS; i++) {
+		struct video_scale_info info = {
+			.format = ovi.format,
+			.width = ladder_sizes[i][0],
+			.height = ladder_sizes[i][1],
+			.range = ovi.range,
+			.colorspace = ovi.colorspace,
+		};
+
+		rungs[i].width = info.width;
+		rungs[i].height = info.height;
+
+		if (renditions)
+			assert_true(video_output_connect_rendition(
+				video, &info, NULL, encode_frame, &rungs[i]));
+		else
+			assert_true(video_output_connect(video, &info,
+							 encode_frame,
+							 &rungs[i]));
+	}
+
+	uint64_t interval = video_output_get_frame_time(video);
+	uint64_t t = os_gettime_ns();
+
+	for (int i = 0; i < LADDER_FRAMES; i++) {
+		struct video_frame frame;
+
+		t += interval;
+		os_sleepto_ns(t);
+
+		/* a full cache repeats the last frame instead */
+		if (!video_output_lock_frame(video, &frame, 1,
+					     os_gettime_ns()))
+			continue;
+		memset(frame.data[0], LADDER_LUMA,
+		       frame.linesize[0] * ovi.height);
+		memset(frame.data[1], 128, frame.linesize[1] * ovi.height / 2);
+		video_output_unlock_frame(video);
+	}
+
+	for (int i = 0; i < 500; i++) {
+		if (os_atomic_load_long(&rungs[LADDER_RUNGS - 1].received) >=
+		    LADDER_FRAMES)
+			break;
+		os_sleep_ms(10);
+	}
+
+	for (int i = 0; i < LADDER_RUNGS; i++)
+		video_output_disconnect(video, encode_frame, &rungs[i]);
+
+	/* a frame is done once its smallest rung is */
+	double mean = 0.0;
+
+	for (int i = 0; i < LADDER_RUNGS; i++) {
+		assert_true(os_atomic_load_long(&rungs[i].received) >=
+			    LADDER_FRAMES);
+		assert_int_equal(os_atomic_load_long(&rungs[i].bad_frames), 0);
+	}
+
+	for (int i = 0; i < LADDER_FRAMES; i++) {
+		uint64_t latency = 0;
+		for (int j = 0; j < LADDER_RUNGS; j++) {
+			if (rungs[j].latency_ns[i] > latency)
+				latency = rungs[j].latency_ns[i];
+		}
+		mean += (double)latency;
+	}
+	mean /= LADDER_FRAMES;
+
+	print_message("%s: frame latency mean %.2fms, %u skipped frames\n",
+		      renditions ? "renditions" : "inputs    ",
+		      mean / 1000000.0, video_output_get_skipped_frames(video));
+
+	video_output_close(video);
+	bfree(rungs);
+}
+
+/* 1080p/720p/480p from a 1080p canvas, as separate inputs and as
+ * renditions that are scaled in a cascade and encoded in parallel */
+static void ladder_test(void **state)
+{
+	run_ladder(false);
+	run_ladder(true);
+}
+
+static int setup(void **state)
+{
+	return obs_startup("en-US", NULL, NULL) ? 0 : -1;
+}
+
+static int teardown(void **state)
+{
+	obs_shutdown();
+	return 0;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(handoff_60fps_test),
+		cmocka_unit_test(handoff_120fps_test),
+		cmocka_unit_test(handoff_240fps_test),
+		cmocka_unit_test(queue_policy_test),
+		cmocka_unit_test(reconnect_test),
+		cmocka_unit_test(ladder_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
@@ -0,0 +1,257 @@
+#include <util/bmem.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <obs.h>
+
+/* Feeds a set of child audio sources with a known ramp and checks, on every
+ * audio tick, that the output buffers the audio render workers produced for
+ * them are bit-identical to what a serial render would have produced. */
+
+#define NUM_CHILDREN 8
+#define RAMP_MASK 0xFFFFF
+#define RAMP_SCALE (1.0f / (float)(RAMP_MASK + 1))
+#define MAX_REPORTED_MISMATCHES 10
+
+struct parallel_audio_test {
+	obs_source_t *source;
+	obs_source_t *children[NUM_CHILDREN];
+	float volumes[NUM_CHILDREN];
+
+	bool initialized_thread;
+	pthread_t thread;
+	os_event_t *event;
+
+	uint64_t checked;
+	uint64_t mismatches;
+};
+
+static inline float ramp_sample(uint32_t idx)
+{
+	return (float)((idx & RAMP_MASK) + 1) * RAMP_SCALE;
+}
+
+static void *parallel_audio_thread(void *data)
+{
+	struct parallel_audio_test *pat = data;
+	uint32_t sample_rate = audio_output_get_sample_rate(obs_get_audio());
+	size_t channels = audio_output_get_channels(obs_get_audio());
+	uint32_t frames = sample_rate / 100;
+	uint64_t last_time = os_gettime_ns();
+	uint32_t counter = 0;
+	float *samples = bmalloc(frames * sizeof(float));
+
+	while (os_event_try(pat->event) == EAGAIN) {
+		if (!os_sleepto_ns(last_time += 10000000))
+			last_time = os_gettime_ns();
+
+		for (size_t i = 0; i < NUM_CHILDREN; i++) {
+			struct obs_source_audio audio = {
+				.frames = frames,
+				.speakers = (enum speaker_layout)channels,
+				.format = AUDIO_FORMAT_FLOAT_PLANAR,
+				.samples_per_sec = sample_rate,
+				.timestamp = last_time,
+			};
+
+			/* offset each child so no two produce the same data */
+			for (uint32_t j = 0; j < frames; j++)
+				samples[j] = ramp_sample(counter + j +
+							 (uint32_t)i * 4096);
+
+			for (size_t ch = 0; ch < channels; ch++)
+				audio.data[ch] = (const uint8_t *)samples;
+
+			obs_source_output_audio(pat->children[i], &audio);
+		}
+
+		counter += frames;
+	}
+
+	bfree(samples);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool check_child(struct parallel_audio_test *pat, size_t idx,
+			size_t channels)
+{
+	obs_source_t *child = pat->children[idx];
+	struct obs_source_audio_mix audio;
+	float vol = pat->volumes[idx];
+
+	if (obs_source_audio_pending(child) ||
+	    (obs_source_get_audio_mixers(child) & 1) == 0)
+		return true;
+
+	obs_source_get_audio_mix(child, &audio);
+
+	for (size_t ch = 0; ch < channels; ch++) {
+		const float *data = audio.output[0].data[ch];
+
+		/* gaps are filled with silence, nothing to compare against */
+		if (data[0] == 0.0f)
+			continue;
+
+		uint32_t first = (uint32_t)(data[0] / vol / RAMP_SCALE + 0.5f);
+
+		for (size_t i = 0; i < AUDIO_OUTPUT_FRAMES; i++) {
+			float expected =
+				ramp_sample(first - 1 + (uint32_t)i) * vol;
+
+			if (data[i] != expected) {
+				if (pat->mismatches < MAX_REPORTED_MISMATCHES)
+					blog(LOG_WARNING,
+					     "parallel audio render test: "
+					     "child %d, channel %d, frame %d: "
+					     "%f != %f",
+					     (int)idx, (int)ch, (int)i,
+					     data[i], expected);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static bool parallel_audio_render(void *data, uint64_t *ts_out,
+				  struct obs_source_audio_mix *audio_output,
+				  uint32_t mixers, size_t channels,
+				  size_t sample_rate)
+{
+	struct parallel_audio_test *pat = data;
+
+	if ((mixers & 1) == 0)
+		return false;
+
+	for (size_t i = 0; i < NUM_CHILDREN; i++) {
+		if (!check_child(pat, i, channels))
+			pat->mismatches++;
+	}
+
+	if (++pat->checked % 1000 == 0)
+		blog(LOG_INFO,
+		     "parallel audio render test: %llu ticks checked, "
+		     "%llu mismatches",
+		     (unsigned long long)pat->checked,
+		     (unsigned long long)pat->mismatches);
+
+	/* only verifies, does not contribute any audio itself */
+	UNUSED_PARAMETER(ts_out);
+	UNUSED_PARAMETER(audio_output);
+	UNUSED_PARAMETER(sample_rate);
+	return false;
+}
+
+static void parallel_audio_enum_sources(void *data, obs_source_enum_proc_t cb,
+					void *param)
+{
+	struct parallel_audio_test *pat = data;
+
+	for (size_t i = 0; i < NUM_CHILDREN; i++) {
+		if (pat->children[i])
+			cb(pat->source, pat->children[i], param);
+	}
+}
+
+static const char *parallel_audio_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Parallel Audio Render Test";
+}
+
+static void parallel_audio_destroy(void *data)
+{
+	struct parallel_audio_test *pat = data;
+
+	if (pat->initialized_thread) {
+		void *ret;
+		os_event_signal(pat->event);
+		pthread_join(pat->thread, &ret);
+	}
+
+	for (size_t i = 0; i < NUM_CHILDREN; i++) {
+		if (pat->children[i]) {
+			obs_source_remove_active_child(pat->source,
+						       pat->children[i]);
+			obs_source_release(pat->children[i]);
+		}
+	}
+
+	os_event_destroy(pat->event);
+	bfree(pat);
+}
+
+static void *parallel_audio_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct parallel_audio_test *pat = bzalloc(sizeof(*pat));
+	pat->source = source;
+
+	for (size_t i = 0; i < NUM_CHILDREN; i++) {
+		obs_source_t *child = obs_source_create_private(
+			"parallel_audio_test_child", NULL, NULL);
+		if (!child)
+			goto fail;
+
+		/* distinct non-unity volumes so every child is multiplied */
+		pat->children[i] = child;
+		pat->volumes[i] = 0.1f * (float)(i + 1);
+		obs_source_set_volume(child, pat->volumes[i]);
+		obs_source_add_active_child(source, child);
+	}
+
+	if (os_event_init(&pat->event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+	if (pthread_create(&pat->thread, NULL, parallel_audio_thread, pat) != 0)
+		goto fail;
+
+	pat->initialized_thread = true;
+
+	UNUSED_PARAMETER(settings);
+	return pat;
+
+fail:
+	parallel_audio_destroy(pat);
+	return NULL;
+}
+
+struct obs_source_info parallel_audio_test = {
+	.id = "parallel_audio_test",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_AUDIO | OBS_SOURCE_COMPOSITE,
+	.get_name = parallel_audio_getname,
+	.create = parallel_audio_create,
+	.destroy = parallel_audio_destroy,
+	.audio_render = parallel_audio_render,
+	.enum_active_sources = parallel_audio_enum_sources,
+};
+
+/* ------------------------------------------------------------------------- */
+
+static const char *parallel_audio_child_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Parallel Audio Render Test (Child)";
+}
+
+static void *parallel_audio_child_create(obs_data_t *settings,
+					 obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void parallel_audio_child_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+struct obs_source_info parallel_audio_test_child = {
+	.id = "parallel_audio_test_child",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_AUDIO | OBS_SOURCE_CAP_DISABLED,
+	.get_name = parallel_audio_child_getname,
+	.create = parallel_audio_child_create,
+	.destroy = parallel_audio_child_destroy,
+};
@@ -9,10 +9,28 @@ struct buffering_async_sync_test {
 	pthread_t thread;
 	bool initialized;
 	bool buffer_audio;
+	bool stall_audio;
+
+	/* how far the timestamps of the mixed audio are ahead of its frame
+	 * count, which is what encoders use for the audio timestamps */
+	pthread_mutex_t offset_mutex;
+	bool offset_mutex_valid;
+	bool mix_connected;
+	uint64_t first_mix_ts;
+	uint64_t mix_frames;
+	int64_t av_offset;
 };
 
 #define CYCLE_COUNT 7
 
+/* a stall holds back 750 milliseconds of audio, which is then delivered all
+ * at once; the buffering added for it has to be removed again in time */
+#define STALL_CYCLES 3
+#define STALL_RECOVERY_NS 60000000000ULL
+
+/* audio is in sync if the offset is less than a tenth of an audio tick */
+#define MAX_AV_OFFSET_NS 2000000LL
+
 static const double aud_rates[CYCLE_COUNT] = {
 	220.00 / 48000.0, /* A */
 	233.08 / 48000.0, /* A# */
@@ -49,15 +67,52 @@ static const char *bast_getname(void *unused)
 	return "Audio Buffering Sync Test (Async Video/Audio Source)";
 }
 
+static void receive_mix(void *param, size_t mix_idx, struct audio_data *data)
+{
+	struct buffering_async_sync_test *bast = param;
+	uint32_t sample_rate = audio_output_get_sample_rate(obs_get_audio());
+
+	pthread_mutex_lock(&bast->offset_mutex);
+
+	if (!bast->first_mix_ts)
+		bast->first_mix_ts = data->timestamp;
+
+	bast->av_offset =
+		(int64_t)(data->timestamp - bast->first_mix_ts) -
+		(int64_t)audio_frames_to_ns(sample_rate, bast->mix_frames);
+	bast->mix_frames += data->frames;
+
+	pthread_mutex_unlock(&bast->offset_mutex);
+
+	UNUSED_PARAMETER(mix_idx);
+}
+
+static int64_t get_av_offset(struct buffering_async_sync_test *bast)
+{
+	int64_t offset;
+
+	pthread_mutex_lock(&bast->offset_mutex);
+	offset = bast->av_offset;
+	pthread_mutex_unlock(&bast->offset_mutex);
+
+	return offset;
+}
+
 static void bast_destroy(void *data)
 {
 	struct buffering_async_sync_test *bast = data;
 
+	if (bast->mix_connected)
+		audio_output_disconnect(obs_get_audio(), 0, receive_mix, bast);
+
 	if (bast->initialized) {
 		os_event_signal(bast->stop_signal);
 		pthread_join(bast->thread, NULL);
 	}
 
+	if (bast->offset_mutex_valid)
+		pthread_mutex_destroy(&bast->offset_mutex);
+
 	os_event_destroy(bast->stop_signal);
 	bfree(bast);
 }
@@ -73,6 +128,116 @@ static inline void fill_texture(uint32_t *pixels, uint32_t color)
 	}
 }
 
+enum stall_state {
+	STALL_NONE,
+	STALL_HOLDING,
+	STALL_RECOVERING,
+};
+
+struct audio_stall {
+	enum stall_state state;
+	float *held;
+	uint64_t timestamps[STALL_CYCLES];
+	int held_cycles;
+
+	uint64_t start_time;
+	uint32_t buffering_before;
+	uint32_t increases_before;
+	uint32_t peak;
+};
+
+static void check_stall_recovery(struct buffering_async_sync_test *bast,
+				 struct audio_stall *stall)
+{
+	struct obs_audio_buffering_info info;
+	uint64_t elapsed = os_gettime_ns() - stall->start_time;
+
+	if (!obs_get_audio_buffering_info(&info))
+		return;
+
+	if (info.buffering_ms > stall->peak)
+		stall->peak = info.buffering_ms;
+
+	if (info.increases != stall->increases_before &&
+	    info.buffering_ms <= stall->buffering_before) {
+		int64_t offset = get_av_offset(bast);
+
+		blog(LOG_INFO,
+		     "audio buffering test: buffering went from %u ms to "
+		     "%u ms and back to %u ms within %.1f seconds",
+		     stall->buffering_before, stall->peak, info.buffering_ms,
+		     (double)elapsed / 1000000000.0);
+
+		/* removed buffering must not move audio ahead of video */
+		if (offset > MAX_AV_OFFSET_NS || offset < -MAX_AV_OFFSET_NS)
+			blog(LOG_WARNING,
+			     "audio buffering test: FAILED, the mixed audio "
+			     "is %.1f ms ahead of its frame count",
+			     (double)offset / 1000000.0);
+		else
+			blog(LOG_INFO,
+			     "audio buffering test: audio is still in sync "
+			     "(offset %.1f ms)",
+			     (double)offset / 1000000.0);
+
+		stall->state = STALL_NONE;
+
+	} else if (elapsed > STALL_RECOVERY_NS) {
+		blog(LOG_WARNING,
+		     "audio buffering test: FAILED, buffering is still %u ms "
+		     "(peak %u ms) %d seconds after the stall, it was %u ms "
+		     "before",
+		     info.buffering_ms, stall->peak,
+		     (int)(elapsed / 1000000000), stall->buffering_before);
+		stall->state = STALL_NONE;
+	}
+}
+
+static void output_audio(struct buffering_async_sync_test *bast,
+			 struct audio_stall *stall,
+			 const struct obs_source_audio *audio)
+{
+	if (stall->state == STALL_NONE && bast->stall_audio) {
+		struct obs_audio_buffering_info info = {0};
+
+		obs_get_audio_buffering_info(&info);
+		bast->stall_audio = false;
+		stall->state = STALL_HOLDING;
+		stall->held_cycles = 0;
+		stall->buffering_before = info.buffering_ms;
+		stall->increases_before = info.increases;
+		blog(LOG_DEBUG, "okay, stalling audio: now");
+	}
+
+	if (stall->state != STALL_HOLDING) {
+		obs_source_output_audio(bast->source, audio);
+		if (stall->state == STALL_RECOVERING)
+			check_stall_recovery(bast, stall);
+		return;
+	}
+
+	memcpy(stall->held + stall->held_cycles * audio->frames,
+	       audio->data[0], audio->frames * sizeof(float));
+	stall->timestamps[stall->held_cycles] = audio->timestamp;
+
+	if (++stall->held_cycles < STALL_CYCLES)
+		return;
+
+	/* deliver everything late, with the original timestamps */
+	for (int i = 0; i < STALL_CYCLES; i++) {
+		struct obs_source_audio held = *audio;
+		float *held_data = stall->held + i * audio->frames;
+
+		held.data[0] = (const uint8_t *)held_data;
+		held.timestamp = stall->timestamps[i];
+		obs_source_output_audio(bast->source, &held);
+	}
+
+	stall->state = STALL_RECOVERING;
+	stall->peak = stall->buffering_before;
+	stall->start_time = os_gettime_ns();
+}
+
 static void *video_thread(void *data)
 {
 	struct buffering_async_sync_test *bast = data;
@@ -87,6 +252,9 @@ static void *video_thread(void *data)
 	double cos_val = 0.0;
 	uint64_t start_time = cur_time;
 	bool audio_buffering_enabled = false;
+	struct audio_stall stall = {
+		.held = bmalloc(sample_rate / 4 * STALL_CYCLES * sizeof(float)),
+	};
 
 	struct obs_source_frame frame = {
 		.data = {[0] = (uint8_t *)pixels},
@@ -134,7 +302,7 @@ static void *video_thread(void *data)
 		}
 
 		obs_source_output_video(bast->source, &frame);
-		obs_source_output_audio(bast->source, &audio);
+		output_audio(bast, &stall, &audio);
 
 		os_sleepto_ns(cur_time += 250000000);
 
@@ -146,6 +314,7 @@ static void *video_thread(void *data)
 
 	bfree(pixels);
 	bfree(samples);
+	bfree(stall.held);
 
 	return NULL;
 }
@@ -162,6 +331,18 @@ static void bast_buffer_audio(void *data, obs_hotkey_id id,
 		bast->buffer_audio = true;
 }
 
+static void bast_stall_audio(void *data, obs_hotkey_id id,
+			     obs_hotkey_t *hotkey, bool pressed)
+{
+	struct buffering_async_sync_test *bast = data;
+
+	UNUSED_PARAMETER(id);
+	UNUSED_PARAMETER(hotkey);
+
+	if (pressed)
+		bast->stall_audio = true;
+}
+
 static void *bast_create(obs_data_t *settings, obs_source_t *source)
 {
 	struct buffering_async_sync_test *bast = bzalloc(sizeof(*bast));
@@ -172,6 +353,15 @@ static void *bast_create(obs_data_t *settings, obs_source_t *source)
 		return NULL;
 	}
 
+	if (pthread_mutex_init(&bast->offset_mutex, NULL) != 0) {
+		bast_destroy(bast);
+		return NULL;
+	}
+	bast->offset_mutex_valid = true;
+
+	bast->mix_connected = audio_output_connect(obs_get_audio(), 0, NULL,
+						   receive_mix, bast);
+
 	if (pthread_create(&bast->thread, NULL, video_thread, bast) != 0) {
 		bast_destroy(bast);
 		return NULL;
@@ -179,6 +369,8 @@ static void *bast_create(obs_data_t *settings, obs_source_t *source)
 
 	obs_hotkey_register_source(source, "AudioBufferingSyncTest.Buffer",
 				   "Buffer Audio", bast_buffer_audio, bast);
+	obs_hotkey_register_source(source, "AudioBufferingSyncTest.Stall",
+				   "Stall Audio", bast_stall_audio, bast);
 
 	bast->initialized = true;
 
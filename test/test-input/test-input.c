@@ -9,6 +9,8 @@ extern struct obs_source_info async_sync_test;
 extern struct obs_source_info buffering_async_sync_test;
 extern struct obs_source_info sync_video;
 extern struct obs_source_info sync_audio;
+extern struct obs_source_info parallel_audio_test;
+extern struct obs_source_info parallel_audio_test_child;
 
 bool obs_module_load(void)
 {
@@ -19,5 +21,7 @@ bool obs_module_load(void)
 	obs_register_source(&buffering_async_sync_test);
 	obs_register_source(&sync_video);
 	obs_register_source(&sync_audio);
+	obs_register_source(&parallel_audio_test);
+	obs_register_source(&parallel_audio_test_child);
 	return true;
 }